@@ -171,7 +171,14 @@ struct CopyMidiBufferOp  : public AudioGraphRenderingOp<CopyMidiBufferOp>
     template <typename FloatType>
     void perform (AudioBuffer<FloatType>&, const OwnedArray<MidiBuffer>& sharedMidiBuffers, const int)
     {
-        *sharedMidiBuffers.getUnchecked (dstBufferNum) = *sharedMidiBuffers.getUnchecked (srcBufferNum);
+        // <Open-Ephys>
+        // Modified by Open-Ephys.
+        // =======================================================================
+        // copies into the destination's reserved storage instead of replacing it
+        MidiBuffer& dst = *sharedMidiBuffers.getUnchecked (dstBufferNum);
+        dst.clear();
+        dst.addEvents (*sharedMidiBuffers.getUnchecked (srcBufferNum), 0, -1, 0);
+        // =======================================================================
     }
 
     const int srcBufferNum, dstBufferNum;
@@ -1034,7 +1041,7 @@ struct AudioProcessorGraph::AudioProcessorGraphBufferHelpers
 
 //==============================================================================
 AudioProcessorGraph::AudioProcessorGraph()
-    : lastNodeId (0), audioBuffers (new AudioProcessorGraphBufferHelpers),
+    : lastNodeId (0), midiBufferReserve (0), audioBuffers (new AudioProcessorGraphBufferHelpers),
       currentMidiInputBuffer (nullptr)
 {
 }
@@ -1370,6 +1377,13 @@ void AudioProcessorGraph::buildRenderingSequence()
         while (midiBuffers.size() < numMidiBuffersNeeded)
             midiBuffers.add (new MidiBuffer());
 
+        // <Open-Ephys>
+        // Modified by Open-Ephys.
+        // =======================================================================
+        for (int i = midiBuffers.size(); --i >= 0;)
+            midiBuffers.getUnchecked(i)->ensureSize (midiBufferReserve);
+        // =======================================================================
+
         renderingOps.swapWith (newRenderingOps);
     }
 
@@ -1377,6 +1391,22 @@ void AudioProcessorGraph::buildRenderingSequence()
     deleteRenderOpArray (newRenderingOps);
 }
 
+// <Open-Ephys>
+// Modified by Open-Ephys.
+// =======================================================================
+void AudioProcessorGraph::setMidiBufferReserve (size_t numBytes)
+{
+    const ScopedLock sl (getCallbackLock());
+
+    midiBufferReserve = numBytes;
+
+    for (int i = midiBuffers.size(); --i >= 0;)
+        midiBuffers.getUnchecked(i)->ensureSize (numBytes);
+
+    currentMidiOutputBuffer.ensureSize (numBytes);
+}
+// =======================================================================
+
 void AudioProcessorGraph::handleAsyncUpdate()
 {
     buildRenderingSequence();
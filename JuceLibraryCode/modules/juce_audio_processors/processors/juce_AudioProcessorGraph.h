@@ -373,6 +373,14 @@ public:
     void getStateInformation (juce::MemoryBlock&) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
+    // <Open-Ephys>
+    // Modified by Open-Ephys.
+    // =======================================================================
+    /** Reserves this many bytes in every MIDI buffer used while rendering, now and whenever
+        the rendering sequence is rebuilt, so that adding events to them doesn't reallocate. */
+    void setMidiBufferReserve (size_t numBytes);
+    // =======================================================================
+
 private:
     //==============================================================================
     template <typename floatType>
@@ -383,6 +391,7 @@ private:
     OwnedArray<Connection> connections;
     uint32 lastNodeId;
     OwnedArray<MidiBuffer> midiBuffers;
+    size_t midiBufferReserve;
     Array<void*> renderingOps;
 
     friend class AudioGraphIOProcessor;
@@ -65,6 +65,12 @@ void shutdownBroadcaster()
     bc = nullptr;
 }
 
+void setProcessorGraph(ProcessorGraph* pg_)
+{
+    if (ui == nullptr)
+        pg = pg_;
+}
+
 /** Returns a pointer to the application's EditorViewport. */
 EditorViewport* getEditorViewport()
 {
@@ -50,6 +50,11 @@ void setUIComponent(UIComponent*);
 
 void shutdownBroadcaster();
 
+/** Provides the ProcessorGraph to tools that run processors without a
+	UIComponent (e.g. the processor benchmark). Ignored once a UIComponent
+	has been set. */
+void setProcessorGraph(ProcessorGraph*);
+
 
 /** Returns a pointer to the application's EditorViewport. */
 EditorViewport* getEditorViewport();
@@ -23,9 +23,13 @@
 
 
 #include "AudioComponent.h"
+#include "../Processors/ProcessorGraph/ProcessorGraph.h"
+#include "../Processors/SourceNode/SourceNode.h"
 #include <stdio.h>
 
-AudioComponent::AudioComponent() : isPlaying(false)
+AudioComponent::AudioComponent() : isPlaying(false), useAudioDevice(true), monitorAudio(true),
+    freeRunning(false), savedUseAudioDevice(true), savedMonitorAudio(true),
+    processingBlockSize(1024), graph(nullptr)
 {
     // if this is nonempty, we got an error
     String error = deviceManager.initialise(0,  // numInputChannelsNeeded
@@ -60,16 +64,17 @@ AudioComponent::AudioComponent() : isPlaying(false)
 
     AudioIODevice* aIOd = deviceManager.getCurrentAudioDevice();
 
+    graphPlayer = new AudioProcessorPlayer();
+    processingThread = new ProcessingThread();
+
     // the error string doesn't tell you if there's no audio device found...
     if (aIOd == 0)
     {
-        String titleMessage = String("No audio device found");
-        String contentMessage = String("Couldn't find an audio device. ") +
-                                String("Perhaps some other program has control of the default one.");
-        AlertWindow::showMessageBox(AlertWindow::InfoIcon,
-                                    titleMessage,
-                                    contentMessage);
-        JUCEApplication::quit();
+        // headless machines can still acquire data using the internal clock
+        std::cout << "No audio device found, using the internal processing clock." << std::endl;
+        useAudioDevice = false;
+        monitorAudio = false;
+        return;
     }
 
 
@@ -103,8 +108,6 @@ AudioComponent::AudioComponent() : isPlaying(false)
     std::cout << "Audio device sample rate: " <<  sr << std::endl;
     std::cout << "Audio device buffer size: " << buffSize << std::endl << std::endl;
 
-    graphPlayer = new AudioProcessorPlayer();
-
     stopDevice(); // reduces the amount of background processing when
     // device is not in use
 
@@ -121,6 +124,15 @@ AudioComponent::~AudioComponent()
 
 void AudioComponent::setBufferSize(int s)
 {
+    if (!useAudioDevice)
+    {
+        if (s > 16 && s < 6000)
+            processingBlockSize = s;
+        else
+            std::cout << "Buffer size out of range." << std::endl;
+        return;
+    }
+
     AudioDeviceManager::AudioDeviceSetup setup;
     deviceManager.getAudioDeviceSetup(setup);
 
@@ -138,6 +150,9 @@ void AudioComponent::setBufferSize(int s)
 
 int AudioComponent::getBufferSize()
 {
+    if (!useAudioDevice)
+        return processingBlockSize;
+
     AudioDeviceManager::AudioDeviceSetup setup;
     deviceManager.getAudioDeviceSetup(setup);
 
@@ -146,6 +161,9 @@ int AudioComponent::getBufferSize()
 
 int AudioComponent::getBufferSizeMs()
 {
+    if (!useAudioDevice)
+        return int(float(processingBlockSize)/44100.0f*1000);
+
     AudioDeviceManager::AudioDeviceSetup setup;
     deviceManager.getAudioDeviceSetup(setup);
 
@@ -156,6 +174,7 @@ void AudioComponent::connectToProcessorGraph(AudioProcessorGraph* processorGraph
 {
 
     graphPlayer->setProcessor(processorGraph);
+    graph = processorGraph;
 
 }
 
@@ -163,6 +182,7 @@ void AudioComponent::disconnectProcessorGraph()
 {
 
     graphPlayer->setProcessor(0);
+    graph = nullptr;
 
 }
 
@@ -171,6 +191,74 @@ bool AudioComponent::callbacksAreActive()
     return isPlaying;
 }
 
+void AudioComponent::setUseAudioDevice(bool state)
+{
+    if (isPlaying)
+    {
+        std::cout << "Can't change the processing clock while acquisition is active." << std::endl;
+        return;
+    }
+
+    if (state && deviceManager.getCurrentAudioDevice() == 0)
+    {
+        std::cout << "No audio device available, keeping the internal processing clock." << std::endl;
+        return;
+    }
+
+    useAudioDevice = state;
+}
+
+bool AudioComponent::isUsingAudioDevice() const
+{
+    return useAudioDevice;
+}
+
+void AudioComponent::setAudioMonitoring(bool state)
+{
+    if (!isPlaying)
+        monitorAudio = state;
+}
+
+bool AudioComponent::isAudioMonitoringEnabled() const
+{
+    return monitorAudio;
+}
+
+void AudioComponent::setFreeRunning(bool state)
+{
+    if (isPlaying || state == freeRunning)
+        return;
+
+    if (state)
+    {
+        savedUseAudioDevice = useAudioDevice;
+        savedMonitorAudio = monitorAudio;
+        useAudioDevice = false;
+        monitorAudio = false;
+    }
+    else
+    {
+        useAudioDevice = savedUseAudioDevice;
+        monitorAudio = savedMonitorAudio;
+    }
+
+    freeRunning = state;
+    processingThread->setFreeRunning(state);
+}
+
+bool AudioComponent::isFreeRunning() const
+{
+    return freeRunning;
+}
+
+double AudioComponent::getCpuUsage()
+{
+    if (useAudioDevice)
+        return deviceManager.getCpuUsage();
+    else
+        return processingThread->getCpuUsage();
+}
+
 void AudioComponent::restartDevice()
 {
     deviceManager.restartLastAudioDevice();
@@ -186,7 +274,22 @@ void AudioComponent::stopDevice()
 void AudioComponent::beginCallbacks()
 {
 
-    if (!isPlaying)
+    if (!isPlaying && !useAudioDevice)
+    {
+        std::cout << std::endl << "Starting processing thread (" << processingBlockSize
+                  << " samples per block)." << std::endl;
+
+        processingThread->startProcessing(graph, processingBlockSize, monitorAudio);
+
+        if (monitorAudio)
+        {
+            restartDevice();
+            deviceManager.addAudioCallback(processingThread);
+        }
+
+        isPlaying = true;
+    }
+    else if (!isPlaying)
     {
 
         //const MessageManagerLock mmLock;
@@ -259,8 +362,18 @@ void AudioComponent::endCallbacks()
     //     std::cout << "NOT THE MESSAGE THREAD -- AUDIO COMPONENT" << std::endl;
 
 
-    std::cout << std::endl << "Removing audio callback." << std::endl;
-    deviceManager.removeAudioCallback(graphPlayer);
+    if (useAudioDevice)
+    {
+        std::cout << std::endl << "Removing audio callback." << std::endl;
+        deviceManager.removeAudioCallback(graphPlayer);
+    }
+    else
+    {
+        std::cout << std::endl << "Stopping processing thread." << std::endl;
+        if (monitorAudio)
+            deviceManager.removeAudioCallback(processingThread);
+        processingThread->stopProcessing();
+    }
     isPlaying = false;
 
     stopDevice();
@@ -276,3 +389,196 @@ void AudioComponent::endCallbacks()
 
 }
 
+
+
+ProcessingThread::ProcessingThread() : Thread("Processing Thread"), processorGraph(nullptr),
+    primarySource(nullptr), blockSize(1024), monitorAudio(false), freeRunning(false), monitorFifo(1)
+{
+}
+
+ProcessingThread::~ProcessingThread()
+{
+    stopThread(1000);
+}
+
+void ProcessingThread::startProcessing(AudioProcessorGraph* graph, int size, bool monitor)
+{
+    if (graph == nullptr || isThreadRunning())
+        return;
+
+    processorGraph = graph;
+    blockSize = size;
+    monitorAudio = monitor;
+
+    graphBuffer.setSize(jmax(2, graph->getTotalNumOutputChannels()), blockSize);
+    midiBuffer.ensureSize(blockSize * 16);
+
+    monitorBuffer.setSize(2, blockSize * 8);
+    monitorBuffer.clear();
+    monitorFifo.setTotalSize(blockSize * 8);
+    monitorFifo.reset();
+
+    cpuUsagePermille = 0;
+
+    // the first SourceNode with a working DataThread sets the pace
+    primarySource = nullptr;
+
+    if (ProcessorGraph* pg = dynamic_cast<ProcessorGraph*>(graph))
+    {
+        Array<GenericProcessor*> processors = pg->getListOfProcessors();
+
+        for (int i = 0; i < processors.size(); i++)
+        {
+            SourceNode* source = dynamic_cast<SourceNode*>(processors[i]);
+
+            if (source != nullptr && source->isSourcePresent())
+            {
+                primarySource = source;
+                break;
+            }
+        }
+    }
+
+    processorGraph->setRateAndBufferSizeDetails(44100.0, blockSize);
+    processorGraph->prepareToPlay(44100.0, blockSize);
+
+    startThread(9);
+}
+
+void ProcessingThread::stopProcessing()
+{
+    stopThread(1000);
+
+    if (processorGraph != nullptr)
+        processorGraph->releaseResources();
+
+    primarySource = nullptr;
+}
+
+void ProcessingThread::setFreeRunning(bool state)
+{
+    freeRunning = state;
+}
+
+double ProcessingThread::getCpuUsage() const
+{
+    return cpuUsagePermille.get() / 1000.0;
+}
+
+void ProcessingThread::run()
+{
+    // sources without a DataBuffer (e.g. the FileReader) expect the nominal 44.1 kHz graph clock
+    const double blockPeriodMs = 1000.0 * blockSize / 44100.0;
+    double nextBlockTime = Time::getMillisecondCounterHiRes() + blockPeriodMs;
+    double lastCycleStart = Time::getMillisecondCounterHiRes();
+    double load = 0.0;
+
+    while (!threadShouldExit())
+    {
+        if (freeRunning)
+        {
+            // no pacing: the next block starts as soon as this one is done
+        }
+        else if (primarySource != nullptr)
+        {
+            const float sourceRate = primarySource->getSampleRate();
+            const int timeOut = jmax(1, int(2000.0 * blockSize / sourceRate));
+
+            primarySource->waitForSamples(blockSize, timeOut);
+        }
+        else
+        {
+            const double now = Time::getMillisecondCounterHiRes();
+
+            if (nextBlockTime > now)
+                wait(int(nextBlockTime - now));
+
+            // don't try to catch up after a long stall
+            nextBlockTime = jmax(nextBlockTime + blockPeriodMs, now);
+        }
+
+        if (threadShouldExit())
+            break;
+
+        const double cycleStart = Time::getMillisecondCounterHiRes();
+
+        graphBuffer.clear();
+        midiBuffer.clear();
+
+        {
+            const ScopedLock sl(processorGraph->getCallbackLock());
+
+            if (!processorGraph->isSuspended())
+                processorGraph->processBlock(graphBuffer, midiBuffer);
+        }
+
+        if (monitorAudio)
+        {
+            int start1, size1, start2, size2;
+            monitorFifo.prepareToWrite(blockSize, start1, size1, start2, size2);
+
+            // drop the block if the audio device has fallen behind
+            if (size1 + size2 == blockSize)
+            {
+                for (int chan = 0; chan < 2; chan++)
+                {
+                    monitorBuffer.copyFrom(chan, start1, graphBuffer, chan, 0, size1);
+
+                    if (size2 > 0)
+                        monitorBuffer.copyFrom(chan, start2, graphBuffer, chan, size1, size2);
+                }
+
+                monitorFifo.finishedWrite(size1 + size2);
+            }
+        }
+
+        const double cycleEnd = Time::getMillisecondCounterHiRes();
+        const double cycleLength = cycleEnd - lastCycleStart;
+
+        if (cycleLength > 0)
+        {
+            load += 0.2 * ((cycleEnd - cycleStart) / cycleLength - load);
+            cpuUsagePermille = int(jlimit(0.0, 1.0, load) * 1000.0);
+        }
+
+        lastCycleStart = cycleStart;
+    }
+}
+
+void ProcessingThread::audioDeviceIOCallback(const float** /*inputChannelData*/, int /*numInputChannels*/,
+                                             float** outputChannelData, int numOutputChannels,
+                                             int numSamples)
+{
+    int start1, size1, start2, size2;
+    monitorFifo.prepareToRead(numSamples, start1, size1, start2, size2);
+
+    for (int chan = 0; chan < numOutputChannels; chan++)
+    {
+        if (outputChannelData[chan] == nullptr)
+            continue;
+
+        if (chan < 2)
+        {
+            if (size1 > 0)
+                FloatVectorOperations::copy(outputChannelData[chan], monitorBuffer.getReadPointer(chan, start1), size1);
+            if (size2 > 0)
+                FloatVectorOperations::copy(outputChannelData[chan] + size1, monitorBuffer.getReadPointer(chan, start2), size2);
+
+            FloatVectorOperations::clear(outputChannelData[chan] + size1 + size2, numSamples - size1 - size2);
+        }
+        else
+        {
+            FloatVectorOperations::clear(outputChannelData[chan], numSamples);
+        }
+    }
+
+    monitorFifo.finishedRead(size1 + size2);
+}
+
+void ProcessingThread::audioDeviceAboutToStart(AudioIODevice* /*device*/)
+{
+}
+
+void ProcessingThread::audioDeviceStopped()
+{
+}
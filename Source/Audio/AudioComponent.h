@@ -26,11 +26,80 @@
 
 #include "../../JuceLibraryCode/JuceHeader.h"
 
+class SourceNode;
+
+/**
+
+  Drives the ProcessorGraph without relying on the sound card.
+
+  Each cycle waits until the primary SourceNode's DataBuffer holds a full
+  block (or, for sources without a DataBuffer, until one block period of the
+  nominal 44.1 kHz graph clock has elapsed) and then calls processBlock()
+  on the graph directly.
+
+  In free-running mode the loop doesn't wait at all, so file-based sources
+  are processed as fast as the signal chain allows.
+
+  When audio monitoring is enabled, the graph output is pushed into a FIFO
+  which the audio device drains from its own callback, so the sound card
+  becomes an optional consumer rather than the master clock.
+
+  @see AudioComponent
+
+*/
+
+class ProcessingThread : public Thread,
+    public AudioIODeviceCallback
+{
+public:
+    ProcessingThread();
+    ~ProcessingThread();
+
+    /** Prepares the graph and starts the processing loop.*/
+    void startProcessing(AudioProcessorGraph* graph, int blockSize, bool monitor);
+
+    /** Stops the processing loop and releases the graph.*/
+    void stopProcessing();
+
+    /** Disables (true) or enables (false) real-time pacing. Takes effect at the next startProcessing().*/
+    void setFreeRunning(bool);
+
+    /** Returns the fraction of each block period spent inside processBlock().*/
+    double getCpuUsage() const;
+
+    void run() override;
+
+    void audioDeviceIOCallback(const float** inputChannelData, int numInputChannels,
+                               float** outputChannelData, int numOutputChannels,
+                               int numSamples) override;
+    void audioDeviceAboutToStart(AudioIODevice* device) override;
+    void audioDeviceStopped() override;
+
+private:
+    AudioProcessorGraph* processorGraph;
+    SourceNode* primarySource;
+
+    int blockSize;
+    bool monitorAudio;
+    bool freeRunning;
+
+    AudioSampleBuffer graphBuffer;
+    MidiBuffer midiBuffer;
+
+    AbstractFifo monitorFifo;
+    AudioSampleBuffer monitorBuffer;
+
+    Atomic<int> cpuUsagePermille;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProcessingThread);
+};
+
 /**
 
   Interfaces with system audio hardware.
 
-  Uses the audio card to generate the callbacks to run the ProcessorGraph
+  Uses the audio card (or, if selected, an internal ProcessingThread clocked
+  by the data source) to generate the callbacks to run the ProcessorGraph
   during data acquisition.
 
   Sends output to the audio card for audio monitoring.
@@ -85,13 +154,47 @@ public:
     /** Sets the buffer size in samples.*/
     void setBufferSize(int);
 
+    /** Selects whether the audio device (true) or the internal ProcessingThread
+    (false) clocks the ProcessorGraph. Ignored while acquisition is running.*/
+    void setUseAudioDevice(bool);
+
+    /** Returns true if the audio device is clocking the ProcessorGraph.*/
+    bool isUsingAudioDevice() const;
+
+    /** Enables or disables audio output when the ProcessingThread is the clock.*/
+    void setAudioMonitoring(bool);
+
+    /** Returns true if audio output is produced when the ProcessingThread is the clock.*/
+    bool isAudioMonitoringEnabled() const;
+
+    /** Runs the ProcessorGraph from the ProcessingThread as fast as possible, without
+    audio output, for offline reprocessing of recorded files. Ignored while acquisition
+    is running; the previous clock settings are restored when switched off.*/
+    void setFreeRunning(bool);
+
+    /** Returns true if the ProcessorGraph is running without real-time pacing.*/
+    bool isFreeRunning() const;
+
+    /** Returns the processing load of whichever clock is active (0-1).*/
+    double getCpuUsage();
+
     AudioDeviceManager deviceManager;
 
 private:
 
     bool isPlaying;
 
+    bool useAudioDevice;
+    bool monitorAudio;
+    bool freeRunning;
+    bool savedUseAudioDevice;
+    bool savedMonitorAudio;
+    int processingBlockSize;
+
+    AudioProcessorGraph* graph;
+
     ScopedPointer<AudioProcessorPlayer> graphPlayer;
+    ScopedPointer<ProcessingThread> processingThread;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioComponent);
 
@@ -0,0 +1,216 @@
+/*
+------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "BatchReprocessor.h"
+#include "AudioComponent.h"
+#include "../AccessClass.h"
+#include "../CoreServices.h"
+#include "../UI/EditorViewport.h"
+#include "../Processors/ProcessorGraph/ProcessorGraph.h"
+#include "../Processors/FileReader/FileReader.h"
+#include "../Processors/RecordNode/RecordNode.h"
+
+BatchReprocessor::BatchReprocessor(const File& chain, const File& output,
+                                   const String& engineId, bool quit)
+    : chainFile(chain), outputDirectory(output), recordEngineId(engineId),
+      quitWhenDone(quit), started(false), finished(false), startTimeMs(0)
+{
+    // start from the message loop, once the main window is up
+    startTimer(100);
+}
+
+BatchReprocessor::~BatchReprocessor()
+{
+    stopTimer();
+
+    if (started && !finished)
+        finish();
+}
+
+bool BatchReprocessor::isFinished() const
+{
+    return finished;
+}
+
+BatchReprocessor* BatchReprocessor::createFromCommandLine(const StringArray& parameters)
+{
+    const int batchIndex = parameters.indexOf("--batch", true);
+
+    if (batchIndex < 0)
+        return nullptr;
+
+    const File cwd = File::getCurrentWorkingDirectory();
+    const File chain = cwd.getChildFile(parameters[batchIndex + 1].unquoted());
+
+    File output;
+    const int outputIndex = parameters.indexOf("--output", true);
+    if (outputIndex >= 0)
+        output = cwd.getChildFile(parameters[outputIndex + 1].unquoted());
+
+    String engine;
+    const int engineIndex = parameters.indexOf("--engine", true);
+    if (engineIndex >= 0)
+        engine = parameters[engineIndex + 1];
+
+    return new BatchReprocessor(chain, output, engine, true);
+}
+
+void BatchReprocessor::timerCallback()
+{
+    if (!started)
+    {
+        stopTimer();
+
+        if (start())
+            startTimer(250);
+        else
+            finish();
+
+        return;
+    }
+
+    for (int i = 0; i < readers.size(); i++)
+    {
+        if (!readers[i]->hasReachedEnd())
+            return;
+    }
+
+    stopTimer();
+    finish();
+}
+
+bool BatchReprocessor::start()
+{
+    started = true;
+
+    if (!chainFile.existsAsFile())
+    {
+        std::cerr << "Batch: signal chain " << chainFile.getFullPathName() << " not found." << std::endl;
+        return false;
+    }
+
+    std::cout << "Batch: loading " << chainFile.getFullPathName() << std::endl;
+    AccessClass::getEditorViewport()->loadState(chainFile);
+
+    Array<GenericProcessor*> processors = AccessClass::getProcessorGraph()->getListOfProcessors();
+
+    for (int i = 0; i < processors.size(); i++)
+    {
+        if (FileReader* reader = dynamic_cast<FileReader*>(processors[i]))
+        {
+            if (reader->getFile().isEmpty())
+            {
+                std::cerr << "Batch: a File Reader in the signal chain has no file selected." << std::endl;
+                return false;
+            }
+
+            readers.add(reader);
+        }
+    }
+
+    if (readers.size() == 0)
+    {
+        std::cerr << "Batch: the signal chain has no File Reader." << std::endl;
+        return false;
+    }
+
+    if (recordEngineId.isNotEmpty() && !CoreServices::setSelectedRecordEngineId(recordEngineId))
+        std::cerr << "Batch: record engine " << recordEngineId << " not available, using "
+                  << CoreServices::getSelectedRecordEngineId() << std::endl;
+
+    if (outputDirectory != File::nonexistent)
+    {
+        outputDirectory.createDirectory();
+        CoreServices::setRecordingDirectory(outputDirectory.getFullPathName());
+    }
+
+    readerLooping.clearQuick();
+
+    for (int i = 0; i < readers.size(); i++)
+    {
+        readerLooping.add(readers[i]->isLooping());
+        readers[i]->setLooping(false);
+    }
+
+    AccessClass::getProcessorGraph()->getRecordNode()->setBlockingWrites(true);
+    AccessClass::getAudioComponent()->setFreeRunning(true);
+
+    // the control panel starts recording before the callbacks, so no block reaches the
+    // record node before it is recording
+    startTimeMs = Time::getMillisecondCounterHiRes();
+    CoreServices::setRecordingStatus(true);
+
+    if (!CoreServices::getRecordingStatus())
+    {
+        std::cerr << "Batch: could not start recording." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void BatchReprocessor::finish()
+{
+    const double seconds = (Time::getMillisecondCounterHiRes() - startTimeMs) / 1000.0;
+
+    if (CoreServices::getRecordingStatus())
+        CoreServices::setRecordingStatus(false);
+
+    if (CoreServices::getAcquisitionStatus())
+        CoreServices::setAcquisitionStatus(false);
+
+    AccessClass::getProcessorGraph()->getRecordNode()->setBlockingWrites(false);
+    AccessClass::getAudioComponent()->setFreeRunning(false);
+
+    int64 samples = 0;
+    int64 channelSamples = 0;
+    double dataSeconds = 0;
+
+    for (int i = 0; i < readers.size(); i++)
+    {
+        const int64 n = readers[i]->getNumSamplesSent();
+
+        samples += n;
+        channelSamples += n * readers[i]->getNumHeadstageOutputs();
+        dataSeconds = jmax(dataSeconds, n / double(readers[i]->getDefaultSampleRate()));
+
+        readers[i]->setLooping(readerLooping[i]);
+    }
+
+    if (started && seconds > 0 && samples > 0)
+    {
+        String report;
+        report << "Batch: processed " << samples << " samples (" << channelSamples << " channel-samples) in "
+               << String(seconds, 2) << " s: " << String(samples / seconds, 0) << " samples/s, "
+               << String(channelSamples / seconds, 0) << " channel-samples/s, "
+               << String(dataSeconds / seconds, 1) << "x real time.";
+
+        std::cout << report << std::endl;
+        CoreServices::sendStatusMessage(report);
+    }
+
+    finished = true;
+
+    if (quitWhenDone)
+        JUCEApplication::getInstance()->systemRequestedQuit();
+}
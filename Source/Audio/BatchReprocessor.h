@@ -0,0 +1,83 @@
+/*
+------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __BATCHREPROCESSOR_H_5E21B7A0__
+#define __BATCHREPROCESSOR_H_5E21B7A0__
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+
+class FileReader;
+
+/**
+  Reprocesses recorded data through a saved signal chain as fast as possible.
+
+  Loads the chain, switches its File Readers to play their selected recording
+  once from the start, and records while the AudioComponent runs the graph
+  without real-time pacing. The RecordNode waits for the RecordThread instead
+  of dropping data, so the output written by the selected RecordEngine is
+  complete. Recording stops when every File Reader has reached the end of its
+  file, and the achieved throughput is reported.
+
+  Started from the command line with:
+  --batch <chain.xml> [--output <directory>] [--engine <record engine id>]
+
+  @see FileReader, AudioComponent
+*/
+
+class BatchReprocessor : private Timer
+{
+public:
+    BatchReprocessor(const File& chainFile, const File& outputDirectory,
+                     const String& recordEngineId, bool quitWhenDone);
+    ~BatchReprocessor();
+
+    /** Returns true once the run has completed, or failed to start.*/
+    bool isFinished() const;
+
+    /** Builds a BatchReprocessor from the application's command line, or returns nullptr if
+    --batch wasn't given.*/
+    static BatchReprocessor* createFromCommandLine(const StringArray& parameters);
+
+private:
+    void timerCallback() override;
+
+    bool start();
+    void finish();
+
+    File chainFile;
+    File outputDirectory;
+    String recordEngineId;
+    bool quitWhenDone;
+
+    Array<FileReader*> readers;
+    Array<bool> readerLooping;
+
+    bool started;
+    bool finished;
+    double startTimeMs;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BatchReprocessor);
+};
+
+
+#endif  // __BATCHREPROCESSOR_H_5E21B7A0__
@@ -0,0 +1,920 @@
+/*
+------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+    Standalone benchmark for individual processors.
+
+    Builds a headless ProcessorGraph (so the record node and AccessClass lookups
+    work), feeds each processor under test from a synthetic source node and times
+    every processBlock() call. Nothing here touches the main window, so it can be
+    run over ssh on an acquisition machine.
+
+    Example:
+        open-ephys-benchmark --processors filter,car,record --channels 32,256,1024
+                             --block-sizes 256,1024 --spike-rate 20 --seconds 10
+
+    --decoder-check instead compares the SIMD and scalar paths of the Rhythm USB
+    block decoder, and the per-frame loop RHD2000Thread used before it, on a raw
+    block, e.g. one saved from readRawDataBlock():
+        open-ephys-benchmark --decoder-check --rhd-block block.bin --rhd-streams 4
+*/
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+#include "../AccessClass.h"
+#include "../Processors/GenericProcessor/GenericProcessor.h"
+#include "../Processors/Editors/GenericEditor.h"
+#include "../Processors/ProcessorGraph/ProcessorGraph.h"
+#include "../Processors/RecordNode/RecordNode.h"
+#include "../Processors/RecordNode/RecordEngine.h"
+#include "../Processors/PluginManager/PluginManager.h"
+#include "../Processors/DataThreads/RhythmNode/RHD2000BlockDecoder.h"
+#include "../Processors/DataThreads/RhythmNode/rhythm-api/rhd2000datablock.h"
+
+#include <stdio.h>
+
+
+//==============================================================================
+/** Source node producing Gaussian noise with Poisson-distributed spikes on every channel. */
+class SyntheticSource : public GenericProcessor
+{
+public:
+    SyntheticSource (int numChannels_, float sampleRate_, float spikeRate_)
+        : GenericProcessor  ("Synthetic Source")
+        , numChannels       (numChannels_)
+        , sampleRate        (sampleRate_)
+        , spikeRate         (spikeRate_)
+        , noisePosition     (0)
+        , timestamp         (0)
+        , random            (12345)
+    {
+        setProcessorType (PROCESSOR_TYPE_SOURCE);
+
+        // Box-Muller noise table, read back at a different offset for each channel
+        noise.malloc (NOISE_TABLE_SIZE);
+
+        for (int i = 0; i < NOISE_TABLE_SIZE; ++i)
+        {
+            const double u1 = jmax (1.0e-12, random.nextDouble());
+            const double u2 = random.nextDouble();
+            noise[i] = (float) (NOISE_UV * std::sqrt (-2.0 * std::log (u1)) * std::cos (2.0 * double_Pi * u2));
+        }
+
+        // biphasic waveform, ~1 ms long
+        const int length = jmax (8, (int) (sampleRate * 0.001f));
+
+        for (int i = 0; i < length; ++i)
+        {
+            const float t = (float) i / (float) length;
+            spikeTemplate.add (-SPIKE_UV * std::sin (float_Pi * t * 2.0f) * std::exp (-3.0f * t));
+        }
+
+        nextSpike.insertMultiple (0, 0, numChannels);
+        spikePhase.insertMultiple (0, -1, numChannels);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            nextSpike.set (ch, drawInterval());
+    }
+
+    bool isGeneratesTimestamps() const override     { return true; }
+    float getDefaultSampleRate() const override     { return sampleRate; }
+    int getNumHeadstageOutputs() const override     { return numChannels; }
+    float getBitVolts (Channel*) const override     { return 0.195f; }
+
+    void process (AudioSampleBuffer& buffer, MidiBuffer& events) override
+    {
+        const int numSamples = buffer.getNumSamples();
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            float* const dest = buffer.getWritePointer (ch);
+
+            // 7919 is prime, so channels don't share noise
+            int position = (noisePosition + ch * 7919) & (NOISE_TABLE_SIZE - 1);
+            int done = 0;
+
+            while (done < numSamples)
+            {
+                const int n = jmin (numSamples - done, NOISE_TABLE_SIZE - position);
+                FloatVectorOperations::copy (dest + done, noise + position, n);
+                done += n;
+                position = 0;
+            }
+
+            if (spikeRate > 0.0f)
+                addSpikes (ch, dest, numSamples);
+        }
+
+        noisePosition = (noisePosition + numSamples) & (NOISE_TABLE_SIZE - 1);
+
+        setTimestamp (events, timestamp);
+        setNumSamples (events, numSamples);
+
+        timestamp += numSamples;
+    }
+
+private:
+    void addSpikes (int ch, float* dest, int numSamples)
+    {
+        int phase = spikePhase[ch];
+        int64 next = nextSpike[ch];
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            if (phase < 0 && timestamp + i >= next)
+            {
+                phase = 0;
+                next = timestamp + i + drawInterval();
+            }
+
+            if (phase >= 0)
+            {
+                dest[i] += spikeTemplate[phase];
+
+                if (++phase >= spikeTemplate.size())
+                    phase = -1;
+            }
+        }
+
+        spikePhase.set (ch, phase);
+        nextSpike.set (ch, next);
+    }
+
+    int64 drawInterval()
+    {
+        if (spikeRate <= 0.0f)
+            return std::numeric_limits<int64>::max() / 2;
+
+        const double u = jmax (1.0e-12, random.nextDouble());
+        return 1 + (int64) (-std::log (u) * sampleRate / spikeRate);
+    }
+
+    enum { NOISE_TABLE_SIZE = 1 << 16 };
+
+    static constexpr float NOISE_UV = 10.0f;
+    static constexpr float SPIKE_UV = 100.0f;
+
+    const int numChannels;
+    const float sampleRate;
+    const float spikeRate;
+
+    HeapBlock<float> noise;
+    int noisePosition;
+    Array<float> spikeTemplate;
+    Array<int64> nextSpike;
+    Array<int> spikePhase;
+
+    int64 timestamp;
+    Random random;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SyntheticSource);
+};
+
+
+//==============================================================================
+struct BenchmarkSettings
+{
+    StringArray processors;
+    Array<int> channelCounts;
+    Array<int> blockSizes;
+    float spikeRate;
+    float sampleRate;
+    double seconds;
+    File outputDirectory;
+    File csvFile;
+    String engine;
+};
+
+
+struct BenchmarkResult
+{
+    String processor;
+    int numChannels;
+    int blockSize;
+    int numBlocks;
+    double p50, p90, p99, p999, maxUs;
+    double samplesPerSecond;
+    double realtimeFactor;
+};
+
+
+/** Maps the short names accepted on the command line to plugin processor names. */
+static String getPluginName (const String& shortName)
+{
+    if (shortName == "filter")          return "Bandpass Filter";
+    if (shortName == "car")             return "Common Avg Ref";
+    if (shortName == "channelmap")      return "Channel Map";
+    if (shortName == "spikedetector")   return "Spike Detector";
+    if (shortName == "phasedetector")   return "Phase Detector";
+
+    return shortName;
+}
+
+
+static double percentile (const Array<double>& sorted, double fraction)
+{
+    if (sorted.size() == 0)
+        return 0.0;
+
+    const int index = jlimit (0, sorted.size() - 1, (int) std::ceil (fraction * sorted.size()) - 1);
+    return sorted[index];
+}
+
+
+/** Sets the processor up the way a user would for a typical recording, through the
+    same editor and XML paths the GUI uses. */
+static void configureProcessor (const String& shortName, GenericProcessor* processor, int numChannels)
+{
+    GenericEditor* editor = processor->getEditor();
+
+    if (shortName == "car")
+    {
+        // reference and affected: every channel
+        TextButton referenceButton ("Reference");
+        TextButton affectedButton ("Affected");
+
+        editor->buttonClicked (&referenceButton);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            editor->channelChanged (ch, true);
+
+        editor->buttonClicked (&affectedButton);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            editor->channelChanged (ch, true);
+    }
+    else if (shortName == "spikedetector")
+    {
+        // one tetrode per four channels, 50 uV threshold
+        ScopedPointer<XmlElement> xml = new XmlElement ("PROCESSOR");
+
+        for (int e = 0; e < numChannels / 4; ++e)
+        {
+            XmlElement* electrode = xml->createNewChildElement ("ELECTRODE");
+            electrode->setAttribute ("numChannels", 4);
+            electrode->setAttribute ("electrodeID", e + 1);
+            electrode->setAttribute ("name", "Tetrode " + String (e + 1));
+
+            for (int i = 0; i < 4; ++i)
+            {
+                XmlElement* subchannel = electrode->createNewChildElement ("SUBCHANNEL");
+                subchannel->setAttribute ("ch", e * 4 + i);
+                subchannel->setAttribute ("thresh", 50.0);
+                subchannel->setAttribute ("isActive", 1);
+            }
+        }
+
+        processor->parametersAsXml = xml;
+        processor->loadFromXml();
+        processor->parametersAsXml = nullptr;
+    }
+    else if (shortName == "phasedetector")
+    {
+        // peak detectors on the first few channels, all writing to event channel 0
+        ScopedPointer<XmlElement> xml = new XmlElement ("PROCESSOR");
+        XmlElement* editorXml = xml->createNewChildElement ("EDITOR");
+
+        for (int i = 0; i < jmin (numChannels, 4); ++i)
+        {
+            XmlElement* detector = editorXml->createNewChildElement ("DETECTOR");
+            detector->setAttribute ("PHASE", 1);
+            detector->setAttribute ("INPUT", i);
+            detector->setAttribute ("GATE", -1);
+            detector->setAttribute ("OUTPUT", 0);
+        }
+
+        processor->parametersAsXml = xml;
+        processor->loadFromXml();
+        processor->parametersAsXml = nullptr;
+    }
+}
+
+
+static bool createRecordEngine (ProcessorGraph& graph, PluginManager& plugins, const String& engineName,
+                                OwnedArray<RecordEngineManager>& managers)
+{
+    RecordEngineManager* manager = nullptr;
+
+    Plugin::RecordEngineInfo info = plugins.getRecordEngineInfo (engineName);
+
+    if (info.creator != nullptr)
+    {
+        manager = info.creator();
+    }
+    else
+    {
+        for (int i = 0; i < RecordEngineManager::getNumOfBuiltInEngines(); ++i)
+        {
+            ScopedPointer<RecordEngineManager> builtIn = RecordEngineManager::createBuiltInEngineManager (i);
+
+            if (builtIn->getID() == engineName || builtIn->getName() == engineName)
+            {
+                manager = builtIn.release();
+                break;
+            }
+        }
+    }
+
+    if (manager == nullptr)
+        return false;
+
+    managers.add (manager);
+
+    RecordEngine* engine = manager->instantiateEngine();
+    engine->registerManager (manager);
+
+    graph.getRecordNode()->clearRecordEngines();
+    graph.getRecordNode()->registerRecordEngine (engine);
+
+    return true;
+}
+
+
+static bool runBenchmark (const String& shortName, int numChannels, int blockSize, const BenchmarkSettings& settings,
+                          ProcessorGraph& graph, PluginManager& plugins, OwnedArray<RecordEngineManager>& managers,
+                          BenchmarkResult& result)
+{
+    const bool isRecord = (shortName == "record");
+
+    SyntheticSource source (numChannels, settings.sampleRate, settings.spikeRate);
+    source.setNodeId (100);
+    graph.shareGraphResources (&source);
+    source.createEditor();
+    source.update();
+
+    ScopedPointer<GenericProcessor> ownedProcessor;
+    GenericProcessor* target = nullptr;
+
+    if (isRecord)
+    {
+        if (! createRecordEngine (graph, plugins, settings.engine, managers))
+        {
+            std::cerr << "Record engine \"" << settings.engine << "\" not found" << std::endl;
+            return false;
+        }
+
+        RecordNode* recordNode = graph.getRecordNode();
+        recordNode->resetConnections();
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            recordNode->addInputChannel (&source, ch);
+
+        recordNode->setDataDirectory (settings.outputDirectory);
+        recordNode->setBlockingWrites (true);
+
+        target = recordNode;
+    }
+    else
+    {
+        Plugin::ProcessorInfo info = plugins.getProcessorInfo (getPluginName (shortName));
+
+        if (info.creator == nullptr)
+        {
+            std::cerr << "Processor \"" << shortName << "\" not found; was the plugin built?" << std::endl;
+            return false;
+        }
+
+        ownedProcessor = info.creator();
+        target = ownedProcessor;
+
+        target->setNodeId (101);
+        graph.shareGraphResources (target);
+        target->setSourceNode (&source);
+        target->createEditor();
+        target->update();
+
+        configureProcessor (shortName, target, numChannels);
+    }
+
+    const int numBlocks = jmax (1, (int) (settings.seconds * settings.sampleRate / blockSize));
+
+    AudioSampleBuffer buffer (jmax (numChannels, target->getNumOutputs()), blockSize);
+    MidiBuffer events;
+    Array<double> blockTimesUs;
+    blockTimesUs.ensureStorageAllocated (numBlocks);
+
+    source.prepareToPlay (settings.sampleRate, blockSize);
+    target->prepareToPlay (settings.sampleRate, blockSize);
+
+    // reserve the event buffer like the ProcessorGraph does before acquisition
+    const int eventBufferBytes = source.getEventBufferReserve (blockSize) + target->getEventBufferReserve (blockSize);
+    events.ensureSize ((size_t) eventBufferBytes);
+    source.prepareEventBuffers (blockSize, eventBufferBytes);
+    target->prepareEventBuffers (blockSize, eventBufferBytes);
+
+    source.enable();
+    target->enable();
+
+    if (isRecord)
+        target->setParameter (1, 0.0f);
+
+    const int64 startTicks = Time::getHighResolutionTicks();
+    double processingUs = 0.0;
+
+    for (int block = 0; block < numBlocks; ++block)
+    {
+        buffer.clear();
+        events.clear();
+
+        static_cast<AudioProcessor&> (source).processBlock (buffer, events);
+
+        const int64 blockStart = Time::getHighResolutionTicks();
+        static_cast<AudioProcessor*> (target)->processBlock (buffer, events);
+        const double us = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - blockStart) * 1.0e6;
+
+        blockTimesUs.add (us);
+        processingUs += us;
+    }
+
+    if (isRecord)
+    {
+        // include the time it takes the record thread to drain the queues
+        target->setParameter (0, 0.0f);
+        processingUs = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks) * 1.0e6;
+    }
+
+    target->disable();
+    source.disable();
+
+    if (isRecord)
+        graph.getRecordNode()->resetConnections();
+
+    blockTimesUs.sort();
+
+    const double totalSamples = (double) numBlocks * blockSize;
+
+    result.processor        = shortName;
+    result.numChannels      = numChannels;
+    result.blockSize        = blockSize;
+    result.numBlocks        = numBlocks;
+    result.p50              = percentile (blockTimesUs, 0.5);
+    result.p90              = percentile (blockTimesUs, 0.9);
+    result.p99              = percentile (blockTimesUs, 0.99);
+    result.p999             = percentile (blockTimesUs, 0.999);
+    result.maxUs            = blockTimesUs.getLast();
+    result.samplesPerSecond = totalSamples / (processingUs * 1.0e-6);
+    result.realtimeFactor   = result.samplesPerSecond / settings.sampleRate;
+
+    return true;
+}
+
+
+/** The per-frame loop RHD2000Thread::updateBuffer() decoded USB blocks with before
+    RHD2000BlockDecoder, kept as an independent reference for it. Writes numChannels
+    samples per frame into frames and returns the number of frames with a good header. */
+static int decodeBlockLegacy (const uint8* block, int numFrames, const Array<RHD2000BlockDecoder::StreamLayout>& streams,
+                              bool decodeAdc, int numChannels, float* frames, int64* timestamps, uint64* eventCodes)
+{
+    unsigned char* const bufferPtr = const_cast<unsigned char*> (block);
+    const int numStreams = streams.size();
+
+    HeapBlock<float> auxBuffer ((size_t) numChannels, true);
+    HeapBlock<float> auxSamples ((size_t) numStreams * 3, true);
+    int index = 0;
+
+    for (int samp = 0; samp < numFrames; ++samp)
+    {
+        int channel = -1;
+        float* const thisSample = frames + samp * numChannels;
+
+        if (! Rhd2000DataBlock::checkUsbHeader (bufferPtr, index))
+            return samp;
+
+        index += 8;
+        timestamps[samp] = Rhd2000DataBlock::convertUsbTimeStamp (bufferPtr, index);
+        index += 4;
+        int auxIndex = index;
+
+        // skip the aux channels and do the neural data channels first
+        index += numStreams * 6;
+
+        for (int dataStream = 0; dataStream < numStreams; ++dataStream)
+        {
+            const RHD2000BlockDecoder::StreamLayout& stream = streams.getReference (dataStream);
+            int chanIndex = index + 2 * dataStream + 2 * stream.firstChannel * numStreams;
+
+            for (int chan = 0; chan < stream.numChannels; ++chan)
+            {
+                channel++;
+                thisSample[channel] = float (*(uint16*) (bufferPtr + chanIndex) - 32768) * 0.195f;
+                chanIndex += 2 * numStreams;
+            }
+        }
+
+        index += 64 * numStreams;
+
+        // now the aux channels, which hold each result until the next one comes in
+        auxIndex += 2 * numStreams;
+
+        for (int dataStream = 0; dataStream < numStreams; ++dataStream)
+        {
+            if (streams.getReference (dataStream).hasAux)
+            {
+                const int auxNum = (samp + 3) % 4;
+
+                if (auxNum < 3)
+                    auxSamples[dataStream * 3 + auxNum] = float (*(uint16*) (bufferPtr + auxIndex) - 32768) * 0.0000374;
+
+                for (int chan = 0; chan < 3; ++chan)
+                {
+                    channel++;
+
+                    if (auxNum == 3)
+                        auxBuffer[channel] = auxSamples[dataStream * 3 + chan];
+
+                    thisSample[channel] = auxBuffer[channel];
+                }
+            }
+
+            auxIndex += 2;
+        }
+
+        index += 2 * numStreams;
+
+        if (decodeAdc)
+        {
+            for (int adcChan = 0; adcChan < 8; ++adcChan)
+            {
+                channel++;
+                // volts, accounting for the +/-5V input range and DC offset
+                thisSample[channel] = 0.00015258789 * float (*(uint16*) (bufferPtr + index)) - 5 - 0.4096;
+                index += 2;
+            }
+        }
+        else
+        {
+            index += 16;
+        }
+
+        eventCodes[samp] = *(uint16*) (bufferPtr + index);
+        index += 4;
+    }
+
+    return numFrames;
+}
+
+
+/** Decodes a raw Rhythm USB block with both paths of RHD2000BlockDecoder and with the loop
+    it replaced, checks that they all agree bit for bit and times them. Without a captured
+    block, random words with valid frame headers are used. */
+static bool checkBlockDecoder (const File& capturedBlock, int numStreams, bool decodeAdc, int numFrames, int repetitions)
+{
+    Array<RHD2000BlockDecoder::StreamLayout> streams;
+
+    for (int i = 0; i < numStreams; ++i)
+    {
+        RHD2000BlockDecoder::StreamLayout stream = { 32, 0, true };
+        streams.add (stream);
+    }
+
+    // the frame size only depends on the number of streams
+    RHD2000BlockDecoder layout;
+    layout.setLayout (streams, decodeAdc, 1);
+    const int frameBytes = layout.getFrameSizeInBytes();
+
+    MemoryBlock block;
+
+    if (capturedBlock != File::nonexistent)
+    {
+        if (! capturedBlock.loadFileAsData (block) || block.getSize() < (size_t) frameBytes)
+        {
+            std::cerr << "Could not read a raw block from " << capturedBlock.getFullPathName() << std::endl;
+            return false;
+        }
+
+        numFrames = (int) (block.getSize() / frameBytes);
+    }
+    else
+    {
+        block.setSize ((size_t) numFrames * frameBytes);
+        Random random (12345);
+
+        for (size_t i = 0; i < block.getSize(); ++i)
+            block[(int) i] = (char) random.nextInt (256);
+
+        for (int frame = 0; frame < numFrames; ++frame)
+        {
+            uint8* const data = static_cast<uint8*> (block.getData()) + frame * frameBytes;
+            const uint64 header = ByteOrder::swapIfBigEndian ((uint64) RHD2000_HEADER_MAGIC_NUMBER);
+            const uint32 timestamp = ByteOrder::swapIfBigEndian ((uint32) frame);
+
+            memcpy (data, &header, 8);
+            memcpy (data + 8, &timestamp, 4);
+        }
+    }
+
+    RHD2000BlockDecoder simd, scalar;
+    simd.setLayout (streams, decodeAdc, numFrames);
+    scalar.setLayout (streams, decodeAdc, numFrames);
+
+    const uint8* const data = static_cast<const uint8*> (block.getData());
+    const int simdFrames = simd.decodeBlock (data, numFrames);
+    const int scalarFrames = scalar.decodeBlockScalar (data, numFrames);
+
+    printf ("\nRHD2000 block decoder: %d streams%s, %d frames of %d bytes (%s)\n",
+            numStreams, decodeAdc ? " + ADCs" : "", numFrames, frameBytes,
+            capturedBlock != File::nonexistent ? capturedBlock.getFileName().toRawUTF8() : "random words");
+
+    bool identical = (simdFrames == scalarFrames);
+
+    if (! identical)
+        printf ("  decoded %d frames with SIMD, %d with the scalar decoder\n", simdFrames, scalarFrames);
+
+    for (int ch = 0; ch < simd.getNumChannels() && identical; ++ch)
+    {
+        const float* const a = simd.getChannelPointers()[ch];
+        const float* const b = scalar.getChannelPointers()[ch];
+
+        for (int s = 0; s < simdFrames; ++s)
+        {
+            if (memcmp (a + s, b + s, sizeof (float)) != 0)
+            {
+                printf ("  channel %d, frame %d: SIMD %.9g, scalar %.9g\n", ch, s, a[s], b[s]);
+                identical = false;
+                break;
+            }
+        }
+    }
+
+    if (identical && (memcmp (simd.getTimestamps(), scalar.getTimestamps(), sizeof (int64) * simdFrames) != 0
+                      || memcmp (simd.getEventCodes(), scalar.getEventCodes(), sizeof (uint64) * simdFrames) != 0))
+    {
+        printf ("  timestamps or TTL codes differ\n");
+        identical = false;
+    }
+
+    // the loop RHD2000Thread used before the block decoder, on the same frames
+    const int numChannels = simd.getNumChannels();
+    HeapBlock<float> legacySamples ((size_t) jmax (1, numChannels) * numFrames);
+    HeapBlock<int64> legacyTimestamps ((size_t) numFrames);
+    HeapBlock<uint64> legacyEventCodes ((size_t) numFrames);
+
+    const int legacyFrames = decodeBlockLegacy (data, numFrames, streams, decodeAdc, numChannels,
+                                                legacySamples, legacyTimestamps, legacyEventCodes);
+    bool matchesLegacy = (legacyFrames == simdFrames);
+
+    if (! matchesLegacy)
+        printf ("  decoded %d frames with SIMD, %d with the legacy loop\n", simdFrames, legacyFrames);
+
+    for (int ch = 0; ch < numChannels && matchesLegacy; ++ch)
+    {
+        const float* const a = simd.getChannelPointers()[ch];
+
+        for (int s = 0; s < simdFrames; ++s)
+        {
+            const float b = legacySamples[s * numChannels + ch];
+
+            if (memcmp (a + s, &b, sizeof (float)) != 0)
+            {
+                printf ("  channel %d, frame %d: SIMD %.9g, legacy %.9g\n", ch, s, a[s], b);
+                matchesLegacy = false;
+                break;
+            }
+        }
+    }
+
+    if (matchesLegacy && (memcmp (simd.getTimestamps(), legacyTimestamps, sizeof (int64) * simdFrames) != 0
+                          || memcmp (simd.getEventCodes(), legacyEventCodes, sizeof (uint64) * simdFrames) != 0))
+    {
+        printf ("  timestamps or TTL codes differ from the legacy loop\n");
+        matchesLegacy = false;
+    }
+
+    if (simdFrames < numFrames)
+        printf ("  frame %d has a bad header; only the frames before it were compared\n", simdFrames);
+
+    printf ("  SIMD and scalar outputs %s\n", identical ? "identical" : "DIFFER");
+    printf ("  legacy loop output %s\n", matchesLegacy ? "identical" : "DIFFERS");
+
+    double simdUs = 0.0, scalarUs = 0.0, legacyUs = 0.0;
+
+    for (int i = 0; i < repetitions; ++i)
+    {
+        int64 start = Time::getHighResolutionTicks();
+        simd.decodeBlock (data, numFrames);
+        simdUs += Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start) * 1.0e6;
+
+        start = Time::getHighResolutionTicks();
+        scalar.decodeBlockScalar (data, numFrames);
+        scalarUs += Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start) * 1.0e6;
+
+        start = Time::getHighResolutionTicks();
+        decodeBlockLegacy (data, numFrames, streams, decodeAdc, numChannels,
+                           legacySamples, legacyTimestamps, legacyEventCodes);
+        legacyUs += Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start) * 1.0e6;
+    }
+
+    if (repetitions > 0)
+    {
+#if defined (__AVX2__)
+        const char* simdName = "AVX2";
+#elif JUCE_INTEL
+        const char* simdName = "SSE2";
+#else
+        const char* simdName = "no SIMD";
+#endif
+        printf ("  %-8s %10.2f us/block\n", simdName, simdUs / repetitions);
+        printf ("  %-8s %10.2f us/block (%.2fx)\n", "scalar", scalarUs / repetitions,
+                simdUs > 0.0 ? scalarUs / simdUs : 0.0);
+        printf ("  %-8s %10.2f us/block (%.2fx)\n", "legacy", legacyUs / repetitions,
+                simdUs > 0.0 ? legacyUs / simdUs : 0.0);
+    }
+
+    return identical && matchesLegacy;
+}
+
+
+static Array<int> parseIntList (const String& text)
+{
+    StringArray tokens;
+    tokens.addTokens (text, ",", String::empty);
+
+    Array<int> values;
+
+    for (int i = 0; i < tokens.size(); ++i)
+    {
+        if (tokens[i].trim().getIntValue() > 0)
+            values.add (tokens[i].trim().getIntValue());
+    }
+
+    return values;
+}
+
+
+static String getOption (const StringArray& args, const String& name, const String& defaultValue)
+{
+    const int index = args.indexOf (name);
+
+    if (index >= 0 && index + 1 < args.size())
+        return args[index + 1];
+
+    return defaultValue;
+}
+
+
+static void printUsage()
+{
+    std::cout << "usage: open-ephys-benchmark [options]" << std::endl
+              << "  --processors <list>     filter,car,channelmap,spikedetector,phasedetector,record" << std::endl
+              << "  --channels <list>       channel counts, e.g. 32,128,512,2048" << std::endl
+              << "  --block-sizes <list>    samples per block, e.g. 256,1024" << std::endl
+              << "  --spike-rate <Hz>       mean spike rate per channel (default 10)" << std::endl
+              << "  --sample-rate <Hz>      default 30000" << std::endl
+              << "  --seconds <s>           signal duration per run (default 10)" << std::endl
+              << "  --engine <name>         record engine for \"record\" (default Binary)" << std::endl
+              << "  --output <dir>          where \"record\" writes its data (default: temp dir)" << std::endl
+              << "  --plugins <dir>         plugin directory (default: next to the executable)" << std::endl
+              << "  --csv <file>            also write the results as CSV" << std::endl
+              << std::endl
+              << "  --decoder-check         compare the Rhythm block decoders with the legacy loop, then exit" << std::endl
+              << "  --rhd-block <file>      raw USB block to decode (default: random frames)" << std::endl
+              << "  --rhd-streams <n>       32-channel data streams in the block (default 4)" << std::endl
+              << "  --rhd-frames <n>        frames in the random block (default 256)" << std::endl
+              << "  --rhd-adc               also decode the board ADCs" << std::endl
+              << "  --repeat <n>            decodes to time (default 1000)" << std::endl;
+}
+
+
+int main (int argc, char* argv[])
+{
+    StringArray args;
+
+    for (int i = 1; i < argc; ++i)
+        args.add (argv[i]);
+
+    if (args.contains ("--help") || args.contains ("-h"))
+    {
+        printUsage();
+        return 0;
+    }
+
+    ScopedJuceInitialiser_GUI juceInitialiser;
+
+    const File cwd = File::getCurrentWorkingDirectory();
+
+    if (args.contains ("--decoder-check"))
+    {
+        const File capturedBlock = args.contains ("--rhd-block")
+                                    ? cwd.getChildFile (getOption (args, "--rhd-block", String::empty))
+                                    : File::nonexistent;
+
+        const int numStreams = getOption (args, "--rhd-streams", "4").getIntValue();
+        const int numFrames = getOption (args, "--rhd-frames", "256").getIntValue();
+
+        if (numStreams <= 0 || numFrames <= 0)
+        {
+            printUsage();
+            return 1;
+        }
+
+        return checkBlockDecoder (capturedBlock, numStreams, args.contains ("--rhd-adc"), numFrames,
+                                  jmax (0, getOption (args, "--repeat", "1000").getIntValue())) ? 0 : 1;
+    }
+
+    BenchmarkSettings settings;
+    settings.processors.addTokens (getOption (args, "--processors", "filter,car,channelmap,spikedetector,phasedetector,record"), ",", String::empty);
+    settings.processors.trim();
+    settings.processors.removeEmptyStrings();
+    settings.channelCounts  = parseIntList (getOption (args, "--channels", "32,128,512,2048"));
+    settings.blockSizes     = parseIntList (getOption (args, "--block-sizes", "1024"));
+    settings.spikeRate      = getOption (args, "--spike-rate", "10").getFloatValue();
+    settings.sampleRate     = getOption (args, "--sample-rate", "30000").getFloatValue();
+    settings.seconds        = getOption (args, "--seconds", "10").getDoubleValue();
+    settings.engine         = getOption (args, "--engine", "Binary");
+    settings.outputDirectory = args.contains ("--output")
+                                ? cwd.getChildFile (getOption (args, "--output", String::empty))
+                                : File::getSpecialLocation (File::tempDirectory).getChildFile ("open-ephys-benchmark");
+
+    if (args.contains ("--csv"))
+        settings.csvFile = cwd.getChildFile (getOption (args, "--csv", String::empty));
+
+    if (settings.channelCounts.size() == 0 || settings.blockSizes.size() == 0 || settings.sampleRate <= 0.0f)
+    {
+        printUsage();
+        return 1;
+    }
+
+    PluginManager plugins;
+
+    if (args.contains ("--plugins"))
+        plugins.loadPlugins (cwd.getChildFile (getOption (args, "--plugins", String::empty)));
+    else
+        plugins.loadAllPlugins();
+
+    // a bare graph with the default nodes; no editors, no audio device
+    ProcessorGraph graph;
+    graph.createDefaultNodes();
+    AccessClass::setProcessorGraph (&graph);
+
+    OwnedArray<RecordEngineManager> engineManagers;
+    Array<BenchmarkResult> results;
+
+    printf ("\n%-14s %8s %8s %8s %10s %10s %10s %10s %10s %14s %10s\n",
+            "processor", "channels", "block", "blocks", "p50 us", "p90 us", "p99 us", "p99.9 us", "max us", "ch-samples/s", "x realtime");
+
+    for (int p = 0; p < settings.processors.size(); ++p)
+    {
+        for (int c = 0; c < settings.channelCounts.size(); ++c)
+        {
+            for (int b = 0; b < settings.blockSizes.size(); ++b)
+            {
+                BenchmarkResult r;
+
+                if (! runBenchmark (settings.processors[p], settings.channelCounts[c], settings.blockSizes[b],
+                                    settings, graph, plugins, engineManagers, r))
+                    continue;
+
+                printf ("%-14s %8d %8d %8d %10.1f %10.1f %10.1f %10.1f %10.1f %14.4g %10.2f\n",
+                        r.processor.toRawUTF8(), r.numChannels, r.blockSize, r.numBlocks,
+                        r.p50, r.p90, r.p99, r.p999, r.maxUs,
+                        r.samplesPerSecond * r.numChannels, r.realtimeFactor);
+                fflush (stdout);
+
+                results.add (r);
+            }
+        }
+    }
+
+    if (settings.csvFile != File::nonexistent)
+    {
+        String csv = "processor,channels,block_size,spike_rate,sample_rate,blocks,p50_us,p90_us,p99_us,p999_us,max_us,"
+                     "samples_per_s,channel_samples_per_s,realtime_factor\n";
+
+        for (int i = 0; i < results.size(); ++i)
+        {
+            const BenchmarkResult& r = results.getReference (i);
+
+            csv << r.processor << "," << r.numChannels << "," << r.blockSize << ","
+                << settings.spikeRate << "," << settings.sampleRate << "," << r.numBlocks << ","
+                << r.p50 << "," << r.p90 << "," << r.p99 << "," << r.p999 << "," << r.maxUs << ","
+                << r.samplesPerSecond << "," << r.samplesPerSecond * r.numChannels << "," << r.realtimeFactor << "\n";
+        }
+
+        if (! settings.csvFile.replaceWithText (csv))
+            std::cerr << "Could not write " << settings.csvFile.getFullPathName() << std::endl;
+    }
+
+    graph.getRecordNode()->clearRecordEngines();
+    AccessClass::setProcessorGraph (nullptr);
+
+    return 0;
+}
@@ -39,7 +39,8 @@ namespace CoreServices
 {
 void updateSignalChain(GenericEditor* source)
 {
-    getEditorViewport()->makeEditorVisible(source, false, true);
+    if (getEditorViewport() != nullptr)
+        getEditorViewport()->makeEditorVisible(source, false, true);
 }
 
 bool getRecordingStatus()
@@ -64,17 +65,21 @@ void setAcquisitionStatus(bool enable)
 
 void sendStatusMessage(const String& text)
 {
-    getBroadcaster()->sendActionMessage(text);
+    if (getBroadcaster() != nullptr)
+        getBroadcaster()->sendActionMessage(text);
+    else
+        std::cout << text << std::endl;
 }
 
 void sendStatusMessage(const char* text)
 {
-    getBroadcaster()->sendActionMessage(text);
+    sendStatusMessage(String(text));
 }
 
 void highlightEditor(GenericEditor* ed)
 {
-    getEditorViewport()->makeEditorVisible(ed);
+    if (getEditorViewport() != nullptr)
+        getEditorViewport()->makeEditorVisible(ed);
 }
 
 int64 getGlobalTimestamp()
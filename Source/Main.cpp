@@ -27,6 +27,7 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "MainWindow.h"
 #include "UI/LookAndFeel/CustomLookAndFeel.h"
+#include "Audio/BatchReprocessor.h"
 
 #include <stdio.h>
 #include <fstream>
@@ -87,6 +88,8 @@ public:
 
         mainWindow = new MainWindow();
 
+        // --batch <chain.xml>: reprocess the chain's files offline, then quit
+        batchReprocessor = BatchReprocessor::createFromCommandLine(parameters);
 
 
     }
@@ -119,6 +122,7 @@ public:
 private:
     ScopedPointer <MainWindow> mainWindow;
     ScopedPointer <CustomLookAndFeel> customLookAndFeel;
+    ScopedPointer <BatchReprocessor> batchReprocessor;
     std::ofstream console_out;
 };
 
@@ -27,7 +27,6 @@
 
 SpikeDetector::SpikeDetector()
     : GenericProcessor      ("Spike Detector")
-    , overflowBuffer        (2, 100)
     , dataBuffer            (nullptr),
       overflowBufferSize    (100)
     , currentElectrode      (-1)
@@ -66,9 +65,6 @@ SpikeDetector::SpikeDetector()
     {
         electrodeCounter.add (0);
     }
-
-    //spikeBuffer = new uint8_t[MAX_SPIKE_BUFFER_LEN]; // MAX_SPIKE_BUFFER_LEN defined in SpikeObject.h
-    spikeBuffer.malloc (MAX_SPIKE_BUFFER_LEN);
 }
 
 
@@ -86,9 +82,6 @@ AudioProcessorEditor* SpikeDetector::createEditor()
 
 void SpikeDetector::updateSettings()
 {
-    if (getNumInputs() > 0)
-        overflowBuffer.setSize (getNumInputs(), overflowBufferSize);
-
     for (int i = 0; i < electrodes.size(); ++i)
     {
         Channel* ch = new Channel (this,i,ELECTRODE_CHANNEL);
@@ -149,6 +142,7 @@ bool SpikeDetector::addElectrode (int nChans, int electrodeID)
     newElectrode->isActive.malloc (nChans);
     newElectrode->channels.malloc (nChans);
     newElectrode->isMonitored = false;
+    newElectrode->overflowBuffer.setSize (nChans, overflowBufferSize);
 
     for (int i = 0; i < nChans; ++i)
     {
@@ -201,6 +195,7 @@ StringArray SpikeDetector::getElectrodeNames() const
 void SpikeDetector::resetElectrode (SimpleElectrode* e)
 {
     e->lastBufferIndex = 0;
+    e->overflowBuffer.clear();
 }
 
 
@@ -325,6 +320,21 @@ void SpikeDetector::setParameter (int parameterIndex, float newValue)
 }
 
 
+int SpikeDetector::getEventBufferReserve (int maxBlockSamples) const
+{
+    int numBytes = GenericProcessor::getEventBufferReserve (maxBlockSamples);
+
+    // detection resumes postPeakSamples after each peak
+    for (int i = 0; i < electrodes.size(); ++i)
+    {
+        const int maxSpikes = maxBlockSamples / (electrodes[i]->postPeakSamples + 1) + 1;
+        numBytes += maxSpikes * (MAX_SPIKE_BUFFER_LEN + 6);
+    }
+
+    return numBytes;
+}
+
+
 bool SpikeDetector::enable()
 {
     sampleRateForElectrode = (uint16_t) getSampleRate();
@@ -355,12 +365,15 @@ void SpikeDetector::addSpikeEvent (SpikeObject* s, MidiBuffer& eventBuffer, int
 
     s->eventType = SPIKE_EVENT_CODE;
 
+    // local so that electrodes on different threads don't share it
+    uint8_t spikeBuffer[MAX_SPIKE_BUFFER_LEN];
+
     int numBytes = packSpike (s,                        // SpikeObject
                               spikeBuffer,              // uint8_t*
                               MAX_SPIKE_BUFFER_LEN);    // int
 
     if (numBytes > 0)
-        eventBuffer.addEvent (spikeBuffer, numBytes, peakIndex);
+        addEventData (eventBuffer, spikeBuffer, numBytes, peakIndex);
 
     //std::cout << "Adding spike" << std::endl;
 }
@@ -369,7 +382,9 @@ void SpikeDetector::addSpikeEvent (SpikeObject* s, MidiBuffer& eventBuffer, int
 void SpikeDetector::addWaveformToSpikeObject (SpikeObject* s,
                                               int& peakIndex,
                                               int& electrodeNumber,
-                                              int& currentChannel)
+                                              int& currentChannel,
+                                              int sampleIndex,
+                                              int& currentIndex)
 {
     int spikeLength = electrodes[electrodeNumber]->prePeakSamples
                       + electrodes[electrodeNumber]->postPeakSamples;
@@ -405,7 +420,7 @@ void SpikeDetector::addWaveformToSpikeObject (SpikeObject* s,
         for (int sample = 0; sample < spikeLength; ++sample)
         {
             // warning -- be careful of bitvolts conversion
-            s->data[currentIndex] = uint16 (getNextSample (*(electrodes[electrodeNumber]->channels+currentChannel)) 
+            s->data[currentIndex] = uint16 (getNextSample (electrodes[electrodeNumber], currentChannel, sampleIndex) 
                                                 / channels[chan]->bitVolts + 32768);
 
             ++currentIndex;
@@ -425,8 +440,6 @@ void SpikeDetector::addWaveformToSpikeObject (SpikeObject* s,
             //std::cout << currentIndex << std::endl;
         }
     }
-
-    sampleIndex -= spikeLength; // reset sample index
 }
 
 
@@ -443,28 +456,36 @@ void SpikeDetector::handleEvent (int eventType, MidiMessage& event, int sampleNu
 
 void SpikeDetector::process (AudioSampleBuffer& buffer, MidiBuffer& events)
 {
-    // cycle through electrodes
-    SimpleElectrode* electrode;
     dataBuffer = &buffer;
 
     checkForEvents (events); // need to find any timestamp events before extracting spikes
 
     //std::cout << dataBuffer.getMagnitude(0,nSamples) << std::endl;
 
-    for (int i = 0; i < electrodes.size(); ++i)
+    // electrodes are independent of each other, so they can be spread across threads
+    processChannelsInParallel (electrodes.size(), buffer, events);
+}
+
+
+void SpikeDetector::processChannelRange (int firstElectrode, int lastElectrode, AudioSampleBuffer& buffer, MidiBuffer& events)
+{
+    // cycle through electrodes
+    SimpleElectrode* electrode;
+
+    for (int i = firstElectrode; i < lastElectrode; ++i)
     {
         //  std::cout << "ELECTRODE " << i << std::endl;
 
         electrode = electrodes[i];
 
         // refresh buffer index for this electrode
-        sampleIndex = electrode->lastBufferIndex - 1; // subtract 1 to account for
+        int sampleIndex = electrode->lastBufferIndex - 1; // subtract 1 to account for
         // increment at start of getNextSample()
 
         const int nSamples = getNumSamples (*electrode->channels);
 
         // cycle through samples
-        while (samplesAvailable (nSamples))
+        while (samplesAvailable (nSamples, sampleIndex))
         {
             ++sampleIndex;
 
@@ -474,15 +495,13 @@ void SpikeDetector::process (AudioSampleBuffer& buffer, MidiBuffer& events)
                 // std::cout << "  channel " << chan << std::endl;
                 if (*(electrode->isActive + chan))
                 {
-                    int currentChannel = *(electrode->channels + chan);
-
-                    if (-getNextSample (currentChannel) > *(electrode->thresholds + chan)) // trigger spike
+                    if (-getNextSample (electrode, chan, sampleIndex) > *(electrode->thresholds + chan)) // trigger spike
                     {
                         //std::cout << "Spike detected on electrode " << i << std::endl;
                         // find the peak
                         int peakIndex = sampleIndex;
 
-                        while (-getCurrentSample(currentChannel) < -getNextSample(currentChannel)
+                        while (-getCurrentSample(electrode, chan, sampleIndex) < -getNextSample(electrode, chan, sampleIndex)
                                && sampleIndex < peakIndex + electrode->postPeakSamples)
                         {
                             ++sampleIndex;
@@ -517,7 +536,7 @@ void SpikeDetector::process (AudioSampleBuffer& buffer, MidiBuffer& events)
                         newSpike.channel             = 0;
                         newSpike.samplingFrequencyHz = sampleRateForElectrode;
 
-                        currentIndex = 0;
+                        int currentIndex = 0;
 
                         // package spikes;
                         for (int channel = 0; channel < electrode->numChannels; ++channel)
@@ -525,7 +544,9 @@ void SpikeDetector::process (AudioSampleBuffer& buffer, MidiBuffer& events)
                             addWaveformToSpikeObject (&newSpike,
                                                       peakIndex,
                                                       i,
-                                                      channel);
+                                                      channel,
+                                                      sampleIndex,
+                                                      currentIndex);
                         }
 
                         //for (int xxx = 0; xxx < 1000; xxx++) // overload with spikes for testing purposes
@@ -555,12 +576,12 @@ void SpikeDetector::process (AudioSampleBuffer& buffer, MidiBuffer& events)
         {
             for (int j = 0; j < electrode->numChannels; ++j)
             {
-                overflowBuffer.copyFrom (*electrode->channels+j,
-                                         0,
-                                         buffer,
-                                         *electrode->channels + j,
-                                         nSamples-overflowBufferSize,
-                                         overflowBufferSize);
+                electrode->overflowBuffer.copyFrom (j,
+                                                    0,
+                                                    buffer,
+                                                    *(electrode->channels + j),
+                                                    nSamples-overflowBufferSize,
+                                                    overflowBufferSize);
             }
 
             useOverflowBuffer.set (i, true);
@@ -575,14 +596,14 @@ void SpikeDetector::process (AudioSampleBuffer& buffer, MidiBuffer& events)
 }
 
 
-float SpikeDetector::getNextSample (int& chan)
+float SpikeDetector::getNextSample (const SimpleElectrode* electrode, int chan, int sampleIndex) const
 {
     if (sampleIndex < 0)
     {
         const int ind = overflowBufferSize + sampleIndex;
 
-        if (ind < overflowBuffer.getNumSamples())
-            return *overflowBuffer.getWritePointer (chan, ind);
+        if (ind < electrode->overflowBuffer.getNumSamples())
+            return *electrode->overflowBuffer.getReadPointer (chan, ind);
         else
             return 0;
 
@@ -590,27 +611,27 @@ float SpikeDetector::getNextSample (int& chan)
     else
     {
         if (sampleIndex < dataBuffer->getNumSamples())
-            return *dataBuffer->getWritePointer (chan, sampleIndex);
+            return *dataBuffer->getReadPointer (*(electrode->channels + chan), sampleIndex);
         else
             return 0;
     }
 }
 
 
-float SpikeDetector::getCurrentSample (int& chan)
+float SpikeDetector::getCurrentSample (const SimpleElectrode* electrode, int chan, int sampleIndex) const
 {
     if (sampleIndex < 1)
     {
-        return *overflowBuffer.getWritePointer (chan, overflowBufferSize + sampleIndex - 1);
+        return *electrode->overflowBuffer.getReadPointer (chan, overflowBufferSize + sampleIndex - 1);
     }
     else
     {
-        return *dataBuffer->getWritePointer (chan, sampleIndex - 1);
+        return *dataBuffer->getReadPointer (*(electrode->channels + chan), sampleIndex - 1);
     }
 }
 
 
-bool SpikeDetector::samplesAvailable (int nSamples)
+bool SpikeDetector::samplesAvailable (int nSamples, int sampleIndex) const
 {
     if (sampleIndex > nSamples - overflowBufferSize/2)
     {
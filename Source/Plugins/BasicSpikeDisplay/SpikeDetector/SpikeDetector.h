@@ -46,6 +46,10 @@ struct SimpleElectrode
     HeapBlock<int> channels;
     HeapBlock<double> thresholds;
     HeapBlock<bool> isActive;
+
+    /** The last samples of the previous buffer, one row per electrode channel. Kept per electrode,
+        since electrodes that share input channels can be processed on different threads. */
+    AudioSampleBuffer overflowBuffer;
 };
 
 
@@ -75,6 +79,9 @@ public:
     /** Called after acquisition is finished. */
     bool disable() override;
 
+    /** Room for every electrode to spike as often as its waveform length allows. */
+    int getEventBufferReserve (int maxBlockSamples) const override;
+
     /** Creates the SpikeDetectorEditor. */
     AudioProcessorEditor* createEditor() override;
 
@@ -82,14 +89,6 @@ public:
     void loadCustomParametersFromXml()                          override;
 
 
-    // INTERNAL BUFFERS
-    // =====================================================================
-    /** Extra samples are placed in this buffer to allow seamless
-        transitions between callbacks. */
-    AudioSampleBuffer overflowBuffer;
-    // =====================================================================
-
-
     // CREATE AND DELETE ELECTRODES
     // =====================================================================
     /** Adds an electrode with n channels to be processed. */
@@ -149,15 +148,19 @@ private:
 
     float getDefaultThreshold() const;
 
-    float getNextSample (int& chan);
-    float getCurrentSample (int& chan);
-    bool samplesAvailable (int nSamples);
+    void processChannelRange (int firstElectrode, int lastElectrode, AudioSampleBuffer& buffer, MidiBuffer& events) override;
+
+    float getNextSample (const SimpleElectrode* electrode, int chan, int sampleIndex) const;
+    float getCurrentSample (const SimpleElectrode* electrode, int chan, int sampleIndex) const;
+    bool samplesAvailable (int nSamples, int sampleIndex) const;
 
     void addSpikeEvent (SpikeObject* s, MidiBuffer& eventBuffer, int peakIndex);
     void addWaveformToSpikeObject (SpikeObject* s,
                                    int& peakIndex,
                                    int& electrodeNumber,
-                                   int& currentChannel);
+                                   int& currentChannel,
+                                   int sampleIndex,
+                                   int& currentIndex);
 
     void resetElectrode (SimpleElectrode*);
 
@@ -165,7 +168,6 @@ private:
     AudioSampleBuffer* dataBuffer;
 
     int overflowBufferSize;
-    int sampleIndex;
 
     Array<int> electrodeCounter;
 
@@ -173,10 +175,7 @@ private:
 
     int currentElectrode;
     int currentChannelIndex;
-    int currentIndex;
 
-    // uint8_t* spikeBuffer;///[256];
-    HeapBlock<uint8_t> spikeBuffer;
     int64 timestamp;
 
     OwnedArray<SimpleElectrode> electrodes;
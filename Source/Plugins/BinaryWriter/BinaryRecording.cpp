@@ -27,10 +27,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 using namespace BinaryRecordingEngine;
 
-BinaryRecording::BinaryRecording()
+BinaryRecording::BinaryRecording() :
+m_packGaps(false),
+m_asyncDirect(false),
+m_writesInFlight(4),
+m_compress(false)
 {
-	m_scaledBuffer.malloc(MAX_BUFFER_SIZE);
-	m_intBuffer.malloc(MAX_BUFFER_SIZE);
 }
 
 BinaryRecording::~BinaryRecording()
@@ -48,20 +50,73 @@ void BinaryRecording::openFiles(File rootFolder, int experimentNumber, int recor
 	String basepath = rootFolder.getFullPathName() + rootFolder.separatorString + "experiment" + String(experimentNumber);
 	//Open channel files
 	int nProcessors = getNumRecordedProcessors();
+	int nChans = getNumRecordedChannels();
+	//Samples go at their distance from the first timestamp, so gaps are left as zeros. Gated
+	//recordings are mostly gaps, so they write their stretches back to back instead
+	m_packGaps = isRecordingGated();
+	for (int i = 0; i < nChans; i++)
+	{
+		m_startTS.add(getTimestamp(i));
+	}
+	m_nextTS.insertMultiple(0, -1, nChans);
+	m_nextPos.insertMultiple(0, 0, nChans);
 
 	for (int i = 0; i < nProcessors; i++)
 	{
 		const RecordProcessorInfo& pInfo = getProcessorInfo(i);
-		File datFile(basepath + "_" + String(pInfo.processorId) + "_" + String(recordingNumber) + ".dat");
-		ScopedPointer<SequentialBlockFile> bFile = new SequentialBlockFile(pInfo.recordedChannels.size(), samplesPerBlock);
+		int nProcChans = pInfo.recordedChannels.size();
+		ScopedPointer<DataBlockFile> bFile;
+		File datFile;
+		int laneChannels;
+		//Decimated groups of a processor get a file of their own
+		String procName = String(pInfo.processorId) + ((pInfo.decimation > 1) ? "_ds" + String(pInfo.decimation) : String::empty);
+		if (m_compress)
+		{
+			Array<float> bitVolts;
+			for (int c = 0; c < nProcChans; c++)
+				bitVolts.add(getChannel(getRealChannel(pInfo.recordedChannels[c]))->bitVolts);
+			float sampleRate = (nProcChans > 0) ? getChannel(getRealChannel(pInfo.recordedChannels[0]))->getRecordSampleRate() : 0;
+			int64 firstTS = (nProcChans > 0) ? getTimestamp(pInfo.recordedChannels[0]) : 0;
+
+			datFile = File(basepath + "_" + procName + "_" + String(recordingNumber) + ".cdat");
+			bFile = new CompressedBlockFile(nProcChans, samplesPerBlock, sampleRate, firstTS, bitVolts);
+			//Channels are encoded independently, so big processors are split across lanes
+			laneChannels = compressedLaneChannels;
+		}
+		else
+		{
+			datFile = File(basepath + "_" + procName + "_" + String(recordingNumber) + ".dat");
+			bFile = new SequentialBlockFile(nProcChans, samplesPerBlock, m_asyncDirect, m_writesInFlight);
+			laneChannels = jmax(nProcChans, 1);
+		}
 		if (bFile->openFile(datFile))
 			m_DataFiles.add(bFile.release());
-	}
-	int nChans = getNumRecordedChannels();
-	//Origin Timestamp
-	for (int i = 0; i < nChans; i++)
-	{
-		m_startTS.add(getTimestamp(i));
+
+		//Pairs of int64: sample index in the data file and timestamp of each contiguous stretch
+		FILE* tsHandle = nullptr;
+		if (m_packGaps)
+		{
+			File tsFile(basepath + "_" + procName + "_" + String(recordingNumber) + ".timestamps");
+			diskWriteLock.enter();
+			tsHandle = fopen(tsFile.getFullPathName().toUTF8(), "wb");
+			diskWriteLock.exit();
+			if (tsHandle == nullptr)
+				std::cerr << "Error opening file " << tsFile.getFullPathName() << std::endl;
+		}
+		m_timestampFiles.add(tsHandle);
+
+		m_firstLane.add(m_writeBuffers.size());
+		m_laneChannels.add(laneChannels);
+		for (int c = 0; c < nProcChans || c == 0; c += laneChannels)
+		{
+			WriteBuffer* wBuffer = new WriteBuffer();
+			wBuffer->ints.malloc(MAX_BUFFER_SIZE);
+			wBuffer->size = MAX_BUFFER_SIZE;
+			wBuffer->numChannels = jmin(laneChannels, nProcChans - c);
+			wBuffer->channels.malloc(jmax(wBuffer->numChannels, 1));
+			wBuffer->positions.malloc(jmax(wBuffer->numChannels, 1));
+			m_writeBuffers.add(wBuffer);
+		}
 	}
 
 	//Other files, using OriginalRecording code
@@ -101,36 +156,140 @@ void BinaryRecording::closeFiles()
 		messageFile = nullptr;
 		diskWriteLock.exit();
 	}
-	m_scaledBuffer.malloc(MAX_BUFFER_SIZE);
-	m_intBuffer.malloc(MAX_BUFFER_SIZE);
-	m_bufferSize = MAX_BUFFER_SIZE;
+	for (int i = 0; i < m_timestampFiles.size(); i++)
+	{
+		if (m_timestampFiles[i] != nullptr)
+		{
+			diskWriteLock.enter();
+			fclose(m_timestampFiles[i]);
+			diskWriteLock.exit();
+		}
+	}
+	m_timestampFiles.clear();
+	m_writeBuffers.clear();
+	m_firstLane.clear();
+	m_laneChannels.clear();
 	m_startTS.clear();
+	m_nextTS.clear();
+	m_nextPos.clear();
 }
 
 void BinaryRecording::resetChannels()
 {
-	m_scaledBuffer.malloc(MAX_BUFFER_SIZE);
-	m_intBuffer.malloc(MAX_BUFFER_SIZE);
-	m_bufferSize = MAX_BUFFER_SIZE;
+	m_writeBuffers.clear();
+	m_firstLane.clear();
+	m_laneChannels.clear();
 	m_DataFiles.clear();
 	spikeFileArray.clear();
+	m_timestampFiles.clear();
 	m_startTS.clear();
+	m_nextTS.clear();
+	m_nextPos.clear();
+}
+
+int BinaryRecording::getNumWriteLanes() const
+{
+	//Each processor has its own file, split in channel groups when compressing
+	return m_writeBuffers.size();
+}
+
+int BinaryRecording::getWriteLane(int writeChannel) const
+{
+	int proc = getProcessorFromChannel(writeChannel);
+	return m_firstLane[proc] + getChannelNumInProc(writeChannel) / m_laneChannels[proc];
+}
+
+bool BinaryRecording::supportsBlockWrites() const
+{
+	return true;
+}
+
+bool BinaryRecording::acceptsIntegerData() const
+{
+	return true;
+}
+
+void BinaryRecording::writeIntegerBlock(const Array<int>& writeChannels, const Array<int>& realChannels, const int16* const* data, int size)
+{
+	int nChans = writeChannels.size();
+	int proc = getProcessorFromChannel(writeChannels[0]);
+	WriteBuffer* wBuffer = m_writeBuffers[getWriteLane(writeChannels[0])];
+
+	for (int i = 0; i < nChans; i++)
+	{
+		if ((i >= wBuffer->numChannels) || (getProcessorFromChannel(writeChannels[i]) != proc))
+		{
+			RecordEngine::writeIntegerBlock(writeChannels, realChannels, data, size);
+			return;
+		}
+	}
+
+	bool aligned = true;
+	for (int i = 0; i < nChans; i++)
+	{
+		wBuffer->channels[i] = getChannelNumInProc(writeChannels[i]);
+		wBuffer->positions[i] = getWritePosition(writeChannels[i], size);
+		aligned = aligned && (wBuffer->positions[i] == wBuffer->positions[0]);
+	}
+
+	if (aligned)
+		m_DataFiles[proc]->writeBlock(wBuffer->positions[0], wBuffer->channels, nChans, data, size);
+	else
+	{
+		//Channels that didn't start together can't share a block write
+		for (int i = 0; i < nChans; i++)
+			m_DataFiles[proc]->writeChannel(wBuffer->positions[i], wBuffer->channels[i], data[i], size);
+	}
+}
+
+void BinaryRecording::endChannelBlock(bool lastBlock)
+{
+	//Compressed files write out the blocks every lane has finished encoding
+	for (int i = 0; i < m_DataFiles.size(); i++)
+		m_DataFiles[i]->flush();
 }
 
 void BinaryRecording::writeData(int writeChannel, int realChannel, const float* buffer, int size)
 {
-	if (size > m_bufferSize) //Shouldn't happen, and if it happens it'll be slow, but better this than crashing. Will be reset on file close and reset.
+	WriteBuffer* wBuffer = m_writeBuffers[getWriteLane(writeChannel)];
+	if (size > wBuffer->size) //Shouldn't happen, and if it happens it'll be slow, but better this than crashing. Will be reset on file close and reset.
 	{
 		std::cerr << "Write buffer overrun, resizing to" << size << std::endl;
-		m_bufferSize = size;
-		m_scaledBuffer.malloc(size);
-		m_intBuffer.malloc(size);
+		wBuffer->size = size;
+		wBuffer->ints.malloc(size);
 	}
-	double multFactor = 1 / (float(0x7fff) * getChannel(realChannel)->bitVolts);
-	FloatVectorOperations::copyWithMultiply(m_scaledBuffer.getData(), buffer, multFactor, size);
-	AudioDataConverters::convertFloatToInt16LE(m_scaledBuffer.getData(), m_intBuffer.getData(), size);
+	convertToInt16(wBuffer->ints.getData(), buffer, 1 / (float(0x7fff) * getChannel(realChannel)->bitVolts), size);
+	writeIntegerData(writeChannel, realChannel, wBuffer->ints.getData(), size);
+}
 
-	m_DataFiles[getProcessorFromChannel(writeChannel)]->writeChannel(getTimestamp(writeChannel)-m_startTS[writeChannel],getChannelNumInProc(writeChannel),m_intBuffer.getData(),size);
+void BinaryRecording::writeIntegerData(int writeChannel, int realChannel, const int16* buffer, int size)
+{
+	int proc = getProcessorFromChannel(writeChannel);
+	m_DataFiles[proc]->writeChannel(getWritePosition(writeChannel, size),getChannelNumInProc(writeChannel),buffer,size);
+}
+
+uint64 BinaryRecording::getWritePosition(int writeChannel, int size)
+{
+	int64 timestamp = getTimestamp(writeChannel);
+	if (!m_packGaps)
+		return timestamp - m_startTS[writeChannel];
+
+	uint64 position = m_nextPos[writeChannel];
+
+	//Gaps (gated recording, dropped blocks) aren't filled, the next stretch goes right after the last one
+	if (timestamp != m_nextTS[writeChannel] && getChannelNumInProc(writeChannel) == 0)
+	{
+		FILE* tsFile = m_timestampFiles[getProcessorFromChannel(writeChannel)];
+		if (tsFile != nullptr)
+		{
+			int64 segment[2] = { int64(position), timestamp };
+			fwrite(segment, sizeof(int64), 2, tsFile);
+		}
+	}
+
+	m_nextTS.set(writeChannel, timestamp + size);
+	m_nextPos.set(writeChannel, position + size);
+	return position;
 }
 
 //Code below is copied from OriginalRecording, so it's not as clean as newer one
@@ -319,25 +478,31 @@ String BinaryRecording::generateSpikeHeader(SpikeRecordInfo* elec)
 }
 
 void BinaryRecording::writeEvent(int eventType, const MidiMessage& event, int64 timestamp)
+{
+	writeEventData(eventType, event.getRawData(), event.getRawDataSize(), timestamp);
+}
+
+void BinaryRecording::writeEventData(int eventType, const uint8* data, int size, int64 timestamp)
 {
 	if (isWritableEvent(eventType))
-		writeTTLEvent(event, timestamp);
+		writeTTLEvent(data, timestamp);
 	if (eventType == GenericProcessor::MESSAGE)
-		writeMessage(event, timestamp);
+		writeMessage(data, size, timestamp);
 }
 
-void BinaryRecording::writeMessage(const MidiMessage& event, int64 timestamp)
+void BinaryRecording::writeMessage(const uint8* data, int size, int64 timestamp)
 {
 	if (messageFile == nullptr)
 		return;
 
-	int msgLength = event.getRawDataSize() - 6;
-	const char* dataptr = (const char*)event.getRawData() + 6;
+	int msgLength = size - 6;
+	const char* dataptr = (const char*)data + 6;
 
-	String timestampText(timestamp);
+	char timestampText[24];
+	int textLength = snprintf(timestampText, sizeof(timestampText), "%lld", (long long)timestamp);
 
 	diskWriteLock.enter();
-	fwrite(timestampText.toUTF8(), 1, timestampText.length(), messageFile);
+	fwrite(timestampText, 1, textLength, messageFile);
 	fwrite(" ", 1, 1, messageFile);
 	fwrite(dataptr, 1, msgLength-1, messageFile);
 	fwrite("\n", 1, 1, messageFile);
@@ -345,7 +510,7 @@ void BinaryRecording::writeMessage(const MidiMessage& event, int64 timestamp)
 
 }
 
-void BinaryRecording::writeTTLEvent(const MidiMessage& event, int64 timestamp)
+void BinaryRecording::writeTTLEvent(const uint8* dataptr, int64 timestamp)
 {
 	// find file and write samples to disk
 	// std::cout << "Received event!" << std::endl;
@@ -353,8 +518,6 @@ void BinaryRecording::writeTTLEvent(const MidiMessage& event, int64 timestamp)
 	if (eventFile == nullptr)
 		return;
 
-	const uint8* dataptr = event.getRawData();
-
 	//With the new external recording thread, this field has no sense.
 	int16 samplePos = 0;
 
@@ -410,8 +573,22 @@ void BinaryRecording::writeSpike(int electrodeIndex, const SpikeObject& spike, i
 	diskWriteLock.exit();
 }
 
+void BinaryRecording::setParameter(EngineParameter& parameter)
+{
+	boolParameter(0, m_asyncDirect);
+	intParameter(1, m_writesInFlight);
+	boolParameter(2, m_compress);
+}
+
 RecordEngineManager* BinaryRecording::getEngineManager()
 {
 	RecordEngineManager* man = new RecordEngineManager("RAWBINARY", "Binary", &(engineFactory<BinaryRecording>));
+	EngineParameter* param;
+	param = new EngineParameter(EngineParameter::BOOL, 0, "Asynchronous direct writes (Linux)", false);
+	man->addParameter(param);
+	param = new EngineParameter(EngineParameter::INT, 1, "Writes in flight per file", 4, 1, 16);
+	man->addParameter(param);
+	param = new EngineParameter(EngineParameter::BOOL, 2, "Lossless compression", false);
+	man->addParameter(param);
 	return man;
 }
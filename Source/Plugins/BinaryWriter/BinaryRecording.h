@@ -25,6 +25,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <RecordingLib.h>
 #include "SequentialBlockFile.h"
+#include "CompressedBlockFile.h"
 
 //Defines for the old-stype original recording spikes and event files
 #define HEADER_SIZE 1024
@@ -47,10 +48,19 @@ namespace BinaryRecordingEngine
 		void openFiles(File rootFolder, int experimentNumber, int recordingNumber) override;
 		void closeFiles() override;
 		void writeData(int writeChannel, int realChannel, const float* buffer, int size) override;
+		int getNumWriteLanes() const override;
+		int getWriteLane(int writeChannel) const override;
+		bool supportsBlockWrites() const override;
+		bool acceptsIntegerData() const override;
+		void writeIntegerData(int writeChannel, int realChannel, const int16* buffer, int size) override;
+		void writeIntegerBlock(const Array<int>& writeChannels, const Array<int>& realChannels, const int16* const* data, int size) override;
+		void endChannelBlock(bool lastBlock) override;
 		void writeEvent(int eventType, const MidiMessage& event, int64 timestamp) override;
+		void writeEventData(int eventType, const uint8* data, int size, int64 timestamp) override;
 		void resetChannels() override;
 		void addSpikeElectrode(int index, const SpikeRecordInfo* elec) override;
 		void writeSpike(int electrodeIndex, const SpikeObject& spike, int64 timestamp) override;
+		void setParameter(EngineParameter& parameter) override;
 
 		static RecordEngineManager* getEngineManager();
 
@@ -62,25 +72,56 @@ namespace BinaryRecordingEngine
 
 		void openMessageFile(String basepath, int recordingNumber);
 		void openEventFile(String basepath, int recordingNumber);
-		void writeTTLEvent(const MidiMessage& event, int64 timestamp);
-		void writeMessage(const MidiMessage& event, int64 timestamp);
-
-		HeapBlock<float> m_scaledBuffer;
-		HeapBlock<int16> m_intBuffer;
-		int m_bufferSize;
-
-		OwnedArray<SequentialBlockFile>  m_DataFiles;
+		void writeTTLEvent(const uint8* data, int64 timestamp);
+		void writeMessage(const uint8* data, int size, int64 timestamp);
+		/** Where the next write of a channel goes in its file. Normally that is the distance from the
+		channel's first timestamp, with gaps left as zeros. In gated recordings stretches of data are
+		written back to back, and the first channel of each file logs where each one starts in the
+		file's .timestamps file */
+		uint64 getWritePosition(int writeChannel, int size);
+
+		/** Conversion scratch space. One per write lane, so the lanes don't share it */
+		struct WriteBuffer
+		{
+			HeapBlock<int16> ints;
+			int size;
+			HeapBlock<int> channels;
+			HeapBlock<uint64> positions;
+			int numChannels;
+		};
+
+		OwnedArray<WriteBuffer> m_writeBuffers;
+
+		OwnedArray<DataBlockFile>  m_DataFiles;
+		Array<int> m_firstLane;
+		Array<int> m_laneChannels;
 
 		FILE* eventFile;
 		FILE* messageFile;
 		Array<FILE*> spikeFileArray;
 		int m_recordingNum;
-		Array<uint64> m_startTS;
+		/** Set for gated recordings, see getWritePosition() */
+		bool m_packGaps;
+		/** Per channel, the timestamp of the first sample */
+		Array<int64> m_startTS;
+		/** Per channel, the timestamp the next sample is expected at (-1 before the first one)
+		and its position in the file */
+		Array<int64> m_nextTS;
+		Array<uint64> m_nextPos;
+		/** Per file, in gated recordings only: the <name>.timestamps file next to the .dat or .cdat file.
+		It holds one (int64 sample index in the data file, int64 timestamp) pair for the
+		start of every contiguous stretch, so sample i of a stretch has timestamp + (i - index) */
+		Array<FILE*> m_timestampFiles;
 
 		CriticalSection diskWriteLock;
 
+		bool m_asyncDirect;
+		int m_writesInFlight;
+		bool m_compress;
+
 		//Compile-time constants
 		const int samplesPerBlock{ 4096 };
+		const int compressedLaneChannels{ 64 };
 
 	};
 
@@ -0,0 +1,249 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2016 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CompressedBlockFile.h"
+#include "LosslessCodec.h"
+
+using namespace BinaryRecordingEngine;
+
+//Zero samples appended at a time when filling a gap
+#define GAP_CHUNK 256
+
+CompressedBlockFile::CompressedBlockFile(int nChannels, int samplesPerBlock, float sampleRate, int64 firstTimestamp, const Array<float>& bitVolts) :
+m_nChannels(nChannels),
+m_samplesPerBlock(samplesPerBlock),
+m_sampleRate(sampleRate),
+m_firstTimestamp(firstTimestamp),
+m_bitVolts(bitVolts),
+m_nextSample(0)
+{
+	int maxBytes = LosslessCodec::getMaxEncodedBytes(samplesPerBlock);
+	for (int i = 0; i < nChannels; i++)
+	{
+		ChannelState* ch = new ChannelState();
+		ch->samples.malloc(samplesPerBlock);
+		ch->numSamples = 0;
+		ch->written = 0;
+		ch->encoded.malloc(maxBytes);
+		ch->encodedBytes = 0;
+		ch->encodedCapacity = maxBytes;
+		m_channels.add(ch);
+	}
+}
+
+CompressedBlockFile::~CompressedBlockFile()
+{
+	if (m_file)
+		finish();
+}
+
+bool CompressedBlockFile::openFile(File file)
+{
+	m_file = file.createOutputStream(streamBufferSize);
+	if (!m_file)
+		return false;
+
+	//Compressed files are always written from scratch
+	m_file->setPosition(0);
+	m_file->truncate();
+
+	int headerBytes = COMPRESSED_HEADER_FIXED_BYTES + 4 * m_nChannels;
+	m_file->write(COMPRESSED_FILE_MAGIC, 8);
+	m_file->writeInt(headerBytes);
+	m_file->writeInt(m_nChannels);
+	m_file->writeInt(m_samplesPerBlock);
+	m_file->writeFloat(m_sampleRate);
+	m_file->writeInt64(m_firstTimestamp);
+	for (int i = 0; i < m_nChannels; i++)
+		m_file->writeFloat(m_bitVolts[i]);
+
+	return true;
+}
+
+int CompressedBlockFile::alignChannel(ChannelState& ch, uint64 startPos, int nSamples)
+{
+	if (startPos < ch.written)
+		return (int)jmin(uint64(nSamples), ch.written - startPos);
+
+	//Outside gated recording, samples are placed by timestamp and a gap (dropped blocks) is stored
+	//as zeros, as in a .dat file. Gated recordings write their stretches back to back, without gaps
+	int16 zeros[GAP_CHUNK] = { 0 };
+	while (ch.written < startPos)
+		appendSamples(ch, zeros, (int)jmin(uint64(GAP_CHUNK), startPos - ch.written));
+	return 0;
+}
+
+void CompressedBlockFile::appendSamples(ChannelState& ch, const int16* data, int nSamples)
+{
+	while (nSamples > 0)
+	{
+		int n = jmin(nSamples, m_samplesPerBlock - ch.numSamples);
+		memcpy(ch.samples + ch.numSamples, data, n * sizeof(int16));
+		ch.numSamples += n;
+		ch.written += n;
+		data += n;
+		nSamples -= n;
+
+		if (ch.numSamples == m_samplesPerBlock)
+			encodeBlock(ch, m_samplesPerBlock);
+	}
+}
+
+void CompressedBlockFile::encodeBlock(ChannelState& ch, int numSamples)
+{
+	int maxBytes = LosslessCodec::getMaxEncodedBytes(numSamples);
+	if (ch.encodedBytes + maxBytes > ch.encodedCapacity)
+	{
+		ch.encodedCapacity = ch.encodedBytes + 2 * maxBytes;
+		ch.encoded.realloc(ch.encodedCapacity);
+	}
+	int size = LosslessCodec::encode(ch.samples, numSamples, ch.encoded + ch.encodedBytes);
+	ch.encodedBytes += size;
+	ch.blockSizes.add(size);
+	ch.numSamples = 0;
+}
+
+bool CompressedBlockFile::writeChannel(uint64 startPos, int channel, const int16* data, int nSamples)
+{
+	if (!m_file)
+		return false;
+
+	ChannelState& ch = *m_channels[channel];
+	int skip = alignChannel(ch, startPos, nSamples);
+	appendSamples(ch, data + skip, nSamples - skip);
+	return true;
+}
+
+bool CompressedBlockFile::writeBlock(uint64 startPos, const int* channels, int nChans, const int16* const* data, int nSamples)
+{
+	if (!m_file)
+		return false;
+
+	for (int c = 0; c < nChans; c++)
+	{
+		ChannelState& ch = *m_channels[channels[c]];
+		int skip = alignChannel(ch, startPos, nSamples);
+		appendSamples(ch, data[c] + skip, nSamples - skip);
+	}
+	return true;
+}
+
+void CompressedBlockFile::writeBlockRecord(int numSamples, const int* channelOffsets, int blockNum)
+{
+	int payload = 0;
+	for (int i = 0; i < m_nChannels; i++)
+		payload += m_channels[i]->blockSizes[blockNum];
+
+	m_indexSamples.add(m_nextSample);
+	m_indexOffsets.add(m_file->getPosition());
+
+	m_file->writeInt(COMPRESSED_BLOCK_MAGIC);
+	m_file->writeInt(numSamples);
+	m_file->writeInt64(m_nextSample);
+	m_file->writeInt(payload);
+	for (int i = 0; i < m_nChannels; i++)
+		m_file->writeInt(m_channels[i]->blockSizes[blockNum]);
+	for (int i = 0; i < m_nChannels; i++)
+		m_file->write(m_channels[i]->encoded + channelOffsets[i], m_channels[i]->blockSizes[blockNum]);
+
+	m_nextSample += numSamples;
+}
+
+void CompressedBlockFile::flush()
+{
+	if (m_file)
+		writeReadyBlocks(m_samplesPerBlock);
+}
+
+void CompressedBlockFile::writeReadyBlocks(int lastBlockSamples)
+{
+	if (m_nChannels == 0)
+		return;
+
+	int ready = m_channels[0]->blockSizes.size();
+	for (int i = 1; i < m_nChannels; i++)
+		ready = jmin(ready, m_channels[i]->blockSizes.size());
+	if (ready == 0)
+		return;
+
+	HeapBlock<int> offsets(m_nChannels, true);
+	for (int b = 0; b < ready; b++)
+	{
+		writeBlockRecord((b == ready - 1) ? lastBlockSamples : m_samplesPerBlock, offsets, b);
+		for (int i = 0; i < m_nChannels; i++)
+			offsets[i] += m_channels[i]->blockSizes[b];
+	}
+
+	//Move whatever is left (channels ahead of the others) to the front
+	for (int i = 0; i < m_nChannels; i++)
+	{
+		ChannelState& ch = *m_channels[i];
+		ch.encodedBytes -= offsets[i];
+		memmove(ch.encoded, ch.encoded + offsets[i], ch.encodedBytes);
+		ch.blockSizes.removeRange(0, ready);
+	}
+}
+
+void CompressedBlockFile::finish()
+{
+	writeReadyBlocks(m_samplesPerBlock);
+
+	//Complete blocks are out, now the partial one. Shorter channels are padded with zeros.
+	int lastSamples = 0;
+	for (int i = 0; i < m_nChannels; i++)
+		lastSamples = jmax(lastSamples, m_channels[i]->numSamples + m_channels[i]->blockSizes.size() * m_samplesPerBlock);
+
+	if (lastSamples > 0)
+	{
+		//Only channels that got ahead can have whole blocks left; pad everybody else to match
+		int fullBlocks = lastSamples / m_samplesPerBlock;
+		int tail = lastSamples % m_samplesPerBlock;
+		for (int i = 0; i < m_nChannels; i++)
+		{
+			ChannelState& ch = *m_channels[i];
+			while (ch.blockSizes.size() < fullBlocks)
+			{
+				zeromem(ch.samples + ch.numSamples, (m_samplesPerBlock - ch.numSamples) * sizeof(int16));
+				encodeBlock(ch, m_samplesPerBlock);
+			}
+			if (tail > 0)
+			{
+				zeromem(ch.samples + ch.numSamples, (tail - jmin(tail, ch.numSamples)) * sizeof(int16));
+				encodeBlock(ch, tail);
+			}
+		}
+		writeReadyBlocks((tail > 0) ? tail : m_samplesPerBlock);
+	}
+
+	int64 indexOffset = m_file->getPosition();
+	for (int i = 0; i < m_indexSamples.size(); i++)
+	{
+		m_file->writeInt64(m_indexSamples[i]);
+		m_file->writeInt64(m_indexOffsets[i]);
+	}
+	m_file->writeInt64(indexOffset);
+	m_file->writeInt(m_indexSamples.size());
+	m_file->write(COMPRESSED_INDEX_MAGIC, 8);
+	m_file->flush();
+	m_file = nullptr;
+}
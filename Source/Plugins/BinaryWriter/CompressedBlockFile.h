@@ -0,0 +1,125 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2016 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef COMPRESSEDBLOCKFILE_H
+#define COMPRESSEDBLOCKFILE_H
+
+#include "DataBlockFile.h"
+
+/*
+Compressed continuous file (.cdat) layout. All values are little endian.
+
+Header:
+	char[8]  "OECDAT01"
+	uint32   header size in bytes
+	uint32   number of channels (n)
+	uint32   samples per block
+	float    sample rate
+	int64    timestamp of the first sample
+	float[n] bitVolts of each channel
+
+Blocks, one after the other:
+	uint32   COMPRESSED_BLOCK_MAGIC
+	uint32   number of samples in the block
+	int64    position of the first sample, counted from the start of the file
+	uint32   payload size in bytes
+	uint32[n] encoded size of each channel
+	payload: the LosslessCodec stream of each channel, in channel order
+
+Index, written when the file is closed:
+	per block: int64 first sample, int64 file offset of the block
+	int64    file offset of the index
+	uint32   number of blocks
+	char[8]  "OECIDX01"
+
+A file without index (after a crash) can still be read by walking the block headers.
+*/
+#define COMPRESSED_FILE_MAGIC "OECDAT01"
+#define COMPRESSED_INDEX_MAGIC "OECIDX01"
+#define COMPRESSED_BLOCK_MAGIC 0x4B42454F
+#define COMPRESSED_HEADER_FIXED_BYTES 32
+#define COMPRESSED_BLOCK_HEADER_BYTES 20
+#define COMPRESSED_TRAILER_BYTES 20
+
+namespace BinaryRecordingEngine
+{
+
+	/**
+	Writes one processor's channels compressed with LosslessCodec.
+
+	Each channel is collected into blocks of samplesPerBlock and encoded as soon as its block
+	is full, on whichever write lane owns the channel, so channels can be split across lanes.
+	flush() then writes every block that all channels have finished, from the record thread.
+	*/
+	class CompressedBlockFile : public DataBlockFile
+	{
+	public:
+		CompressedBlockFile(int nChannels, int samplesPerBlock, float sampleRate, int64 firstTimestamp, const Array<float>& bitVolts);
+		~CompressedBlockFile();
+
+		bool openFile(File file) override;
+		bool writeChannel(uint64 startPos, int channel, const int16* data, int nSamples) override;
+		bool writeBlock(uint64 startPos, const int* channels, int nChans, const int16* const* data, int nSamples) override;
+		void flush() override;
+
+	private:
+		struct ChannelState
+		{
+			HeapBlock<int16> samples;
+			int numSamples;
+			uint64 written;
+			HeapBlock<uint8> encoded;
+			int encodedBytes;
+			int encodedCapacity;
+			Array<int> blockSizes;
+		};
+
+		/** Skips overlaps and zero-fills gaps so the channel stays contiguous. Returns the samples to skip from data */
+		int alignChannel(ChannelState& ch, uint64 startPos, int nSamples);
+		void appendSamples(ChannelState& ch, const int16* data, int nSamples);
+		void encodeBlock(ChannelState& ch, int numSamples);
+		void writeBlockRecord(int numSamples, const int* channelOffsets, int blockNum);
+		void writeReadyBlocks(int lastBlockSamples);
+		void finish();
+
+		ScopedPointer<FileOutputStream> m_file;
+		OwnedArray<ChannelState> m_channels;
+		const int m_nChannels;
+		const int m_samplesPerBlock;
+		const float m_sampleRate;
+		const int64 m_firstTimestamp;
+		Array<float> m_bitVolts;
+
+		int64 m_nextSample;
+		Array<int64> m_indexSamples;
+		Array<int64> m_indexOffsets;
+
+		//Compile-time parameters
+		const int streamBufferSize{ 1 << 20 };
+
+		JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CompressedBlockFile);
+	};
+
+}
+
+#endif
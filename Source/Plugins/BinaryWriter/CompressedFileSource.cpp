@@ -0,0 +1,266 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2016 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CompressedFileSource.h"
+#include "CompressedBlockFile.h"
+#include "LosslessCodec.h"
+
+using namespace BinaryRecordingEngine;
+
+CompressedFileSource::CompressedFileSource() :
+m_nChannels(0),
+m_samplesPerBlock(0),
+m_sampleRate(0),
+m_dataStart(0),
+m_numSamples(0),
+m_decodedBlock(-1),
+m_decodedSamples(0),
+m_samplePos(0)
+{
+}
+
+CompressedFileSource::~CompressedFileSource()
+{
+}
+
+bool CompressedFileSource::Open(File file)
+{
+	ScopedPointer<FileInputStream> tmpFile = file.createInputStream();
+	if (!tmpFile)
+		return false;
+
+	char magic[8];
+	if (tmpFile->read(magic, 8) != 8 || memcmp(magic, COMPRESSED_FILE_MAGIC, 8) != 0)
+	{
+		std::cerr << "Compressed file source: " << file.getFullPathName() << " is not a compressed data file" << std::endl;
+		return false;
+	}
+
+	int headerBytes = tmpFile->readInt();
+	m_nChannels = tmpFile->readInt();
+	m_samplesPerBlock = tmpFile->readInt();
+	m_sampleRate = tmpFile->readFloat();
+	tmpFile->readInt64(); //first timestamp
+	if (m_nChannels <= 0 || m_samplesPerBlock <= 0 || headerBytes != COMPRESSED_HEADER_FIXED_BYTES + 4 * m_nChannels)
+	{
+		std::cerr << "Compressed file source: invalid header" << std::endl;
+		return false;
+	}
+
+	m_bitVolts.clear();
+	for (int i = 0; i < m_nChannels; i++)
+		m_bitVolts.add(tmpFile->readFloat());
+	m_dataStart = headerBytes;
+
+	m_file = tmpFile;
+	if (!readIndex())
+	{
+		std::cout << "Compressed file source: no index found, scanning blocks" << std::endl;
+		scanBlocks();
+	}
+
+	m_decoded.malloc(m_nChannels * m_samplesPerBlock);
+	m_decodedBlock = -1;
+	return true;
+}
+
+bool CompressedFileSource::readIndex()
+{
+	int64 size = m_file->getTotalLength();
+	if (size < m_dataStart + COMPRESSED_TRAILER_BYTES)
+		return false;
+
+	m_file->setPosition(size - COMPRESSED_TRAILER_BYTES);
+	int64 indexOffset = m_file->readInt64();
+	int numBlocks = m_file->readInt();
+	char magic[8];
+	if (m_file->read(magic, 8) != 8 || memcmp(magic, COMPRESSED_INDEX_MAGIC, 8) != 0)
+		return false;
+	if (indexOffset < m_dataStart || indexOffset + int64(numBlocks) * 16 + COMPRESSED_TRAILER_BYTES != size)
+		return false;
+
+	m_blockSamples.clear();
+	m_blockOffsets.clear();
+	m_file->setPosition(indexOffset);
+	for (int i = 0; i < numBlocks; i++)
+	{
+		m_blockSamples.add(m_file->readInt64());
+		m_blockOffsets.add(m_file->readInt64());
+	}
+
+	//The index doesn't store the size of the last block
+	m_numSamples = 0;
+	if (numBlocks > 0)
+	{
+		m_file->setPosition(m_blockOffsets.getLast() + 4);
+		m_numSamples = m_blockSamples.getLast() + m_file->readInt();
+	}
+	return true;
+}
+
+void CompressedFileSource::scanBlocks()
+{
+	m_blockSamples.clear();
+	m_blockOffsets.clear();
+	m_numSamples = 0;
+
+	int64 size = m_file->getTotalLength();
+	int64 pos = m_dataStart;
+	while (pos + COMPRESSED_BLOCK_HEADER_BYTES + 4 * m_nChannels <= size)
+	{
+		m_file->setPosition(pos);
+		if ((uint32)m_file->readInt() != COMPRESSED_BLOCK_MAGIC)
+			break;
+
+		int numSamples = m_file->readInt();
+		int64 firstSample = m_file->readInt64();
+		int payload = m_file->readInt();
+		int64 next = pos + COMPRESSED_BLOCK_HEADER_BYTES + 4 * m_nChannels + payload;
+		//A block cut short by a crash is dropped
+		if (next > size || numSamples <= 0 || numSamples > m_samplesPerBlock)
+			break;
+
+		m_blockSamples.add(firstSample);
+		m_blockOffsets.add(pos);
+		m_numSamples = firstSample + numSamples;
+		pos = next;
+	}
+}
+
+void CompressedFileSource::fillRecordInfo()
+{
+	RecordInfo info;
+	info.name = "Record 0";
+	info.numSamples = m_numSamples;
+	info.sampleRate = m_sampleRate;
+
+	for (int i = 0; i < m_nChannels; i++)
+	{
+		RecordedChannelInfo c;
+		c.name = "CH" + String(i);
+		c.bitVolts = m_bitVolts[i];
+		info.channels.add(c);
+	}
+	infoArray.add(info);
+	numRecords++;
+}
+
+void CompressedFileSource::updateActiveRecord()
+{
+	m_samplePos = 0;
+	m_decodedBlock = -1;
+}
+
+void CompressedFileSource::seekTo(int64 sample)
+{
+	m_samplePos = (m_numSamples > 0) ? sample % m_numSamples : 0;
+}
+
+int CompressedFileSource::findBlock(int64 sample) const
+{
+	int lo = 0;
+	int hi = m_blockSamples.size() - 1;
+	while (lo < hi)
+	{
+		int mid = (lo + hi + 1) / 2;
+		if (m_blockSamples[mid] <= sample)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return lo;
+}
+
+bool CompressedFileSource::decodeBlock(int block)
+{
+	m_decodedBlock = block;
+	m_file->setPosition(m_blockOffsets[block]);
+
+	m_file->readInt(); //magic
+	m_decodedSamples = m_file->readInt();
+	m_file->readInt64(); //first sample
+	int payload = m_file->readInt();
+
+	HeapBlock<int> sizes(m_nChannels);
+	for (int i = 0; i < m_nChannels; i++)
+		sizes[i] = m_file->readInt();
+
+	m_readBuffer.ensureSize(payload);
+	bool ok = (m_decodedSamples > 0) && (m_decodedSamples <= m_samplesPerBlock)
+		&& (m_file->read(m_readBuffer.getData(), payload) == payload);
+
+	const uint8* data = static_cast<const uint8*>(m_readBuffer.getData());
+	int offset = 0;
+	for (int i = 0; ok && i < m_nChannels; i++)
+	{
+		ok = (sizes[i] >= 0) && (offset + sizes[i] <= payload)
+			&& LosslessCodec::decode(data + offset, sizes[i], m_decoded + i * m_samplesPerBlock, m_decodedSamples);
+		offset += sizes[i];
+	}
+
+	if (!ok)
+	{
+		std::cerr << "Compressed file source: corrupt block " << block << ", playing silence" << std::endl;
+		m_decodedSamples = jlimit(0, m_samplesPerBlock, m_decodedSamples);
+		zeromem(m_decoded, m_nChannels * m_samplesPerBlock * sizeof(int16));
+	}
+	return ok;
+}
+
+int CompressedFileSource::readData(int16* buffer, int nSamples)
+{
+	int samplesRead = 0;
+	while (samplesRead < nSamples && m_samplePos < m_numSamples)
+	{
+		int block = findBlock(m_samplePos);
+		if (block != m_decodedBlock)
+			decodeBlock(block);
+
+		int start = int(m_samplePos - m_blockSamples[block]);
+		int n = jmin(nSamples - samplesRead, m_decodedSamples - start);
+		if (n <= 0)
+			break;
+
+		//Back to the interleaved layout FileReader expects
+		for (int i = 0; i < n; i++)
+		{
+			int16* frame = buffer + (samplesRead + i) * m_nChannels;
+			for (int c = 0; c < m_nChannels; c++)
+				frame[c] = m_decoded[c * m_samplesPerBlock + start + i];
+		}
+		samplesRead += n;
+		m_samplePos += n;
+	}
+	return samplesRead;
+}
+
+void CompressedFileSource::processChannelData(int16* inBuffer, float* outBuffer, int channel, int64 numSamples)
+{
+	int n = m_nChannels;
+	float bitVolts = getChannelInfo(channel).bitVolts;
+
+	for (int i = 0; i < numSamples; i++)
+	{
+		*(outBuffer + i) = *(inBuffer + (n*i) + channel) * bitVolts;
+	}
+}
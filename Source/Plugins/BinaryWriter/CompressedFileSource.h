@@ -0,0 +1,76 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2016 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef COMPRESSEDFILESOURCE_H
+#define COMPRESSEDFILESOURCE_H
+
+#include <FileSourceHeaders.h>
+
+namespace BinaryRecordingEngine
+{
+
+	/** Reads the .cdat files written by the Binary engine with compression enabled */
+	class CompressedFileSource : public FileSource
+	{
+	public:
+		CompressedFileSource();
+		~CompressedFileSource();
+
+		int readData(int16* buffer, int nSamples) override;
+		void seekTo(int64 sample) override;
+		void processChannelData(int16* inBuffer, float* outBuffer, int channel, int64 numSamples) override;
+
+	private:
+		bool Open(File file) override;
+		void fillRecordInfo() override;
+		void updateActiveRecord() override;
+
+		bool readIndex();
+		void scanBlocks();
+		int findBlock(int64 sample) const;
+		bool decodeBlock(int block);
+
+		ScopedPointer<FileInputStream> m_file;
+		int m_nChannels;
+		int m_samplesPerBlock;
+		float m_sampleRate;
+		Array<float> m_bitVolts;
+		int64 m_dataStart;
+
+		Array<int64> m_blockSamples;
+		Array<int64> m_blockOffsets;
+		int64 m_numSamples;
+
+		int m_decodedBlock;
+		int m_decodedSamples;
+		HeapBlock<int16> m_decoded;
+		MemoryBlock m_readBuffer;
+
+		int64 m_samplePos;
+
+		JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CompressedFileSource);
+	};
+
+}
+
+#endif
@@ -0,0 +1,50 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2016 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DATABLOCKFILE_H
+#define DATABLOCKFILE_H
+
+#include <BasicJuceHeader.h>
+
+namespace BinaryRecordingEngine
+{
+
+	/** Continuous data file of one processor, written a channel or a group of channels at a time */
+	class DataBlockFile
+	{
+	public:
+		virtual ~DataBlockFile() {}
+
+		virtual bool openFile(File file) = 0;
+		virtual bool writeChannel(uint64 startPos, int channel, const int16* data, int nSamples) = 0;
+
+		/** Writes several channels at once. data[i] holds nSamples samples for channel channels[i] */
+		virtual bool writeBlock(uint64 startPos, const int* channels, int nChans, const int16* const* data, int nSamples) = 0;
+
+		/** Called from the record thread after every write lane is done with the current window */
+		virtual void flush() {}
+	};
+
+}
+
+#endif
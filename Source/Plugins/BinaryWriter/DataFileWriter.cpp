@@ -0,0 +1,314 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2016 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "DataFileWriter.h"
+
+#if JUCE_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#endif
+
+//O_DIRECT needs buffers, offsets and sizes aligned to the logical block size of the device
+#define DIRECT_IO_ALIGNMENT 4096
+//How far ahead of the write position the file is preallocated
+#define PREALLOCATE_STEP (64*1024*1024)
+
+using namespace BinaryRecordingEngine;
+
+DataFileWriter* DataFileWriter::createWriter(int blockBytes, bool asyncDirect, int writesInFlight)
+{
+#if JUCE_LINUX
+	if (asyncDirect)
+		return new AsyncDirectFileWriter(blockBytes, writesInFlight);
+#else
+	if (asyncDirect)
+		std::cout << "BINARY WRITER: asynchronous direct writes are only available on Linux, using buffered writes" << std::endl;
+#endif
+	return new StreamFileWriter(blockBytes);
+}
+
+StreamFileWriter::StreamFileWriter(int blockBytes) :
+DataFileWriter(blockBytes)
+{
+}
+
+StreamFileWriter::~StreamFileWriter()
+{
+	for (int i = 0; i < m_freeBlocks.size(); i++)
+		free(m_freeBlocks[i]);
+}
+
+bool StreamFileWriter::openFile(const File& file)
+{
+	m_file = file.createOutputStream(streamBufferSize);
+	return m_file != nullptr;
+}
+
+char* StreamFileWriter::getBlock()
+{
+	char* block;
+	if (m_freeBlocks.size() > 0)
+		block = m_freeBlocks.remove(m_freeBlocks.size() - 1);
+	else
+		block = static_cast<char*>(malloc(m_blockBytes));
+
+	zeromem(block, m_blockBytes);
+	return block;
+}
+
+void StreamFileWriter::writeBlock(char* block)
+{
+	m_file->write(block, m_blockBytes);
+	m_freeBlocks.add(block);
+}
+
+#if JUCE_LINUX
+
+AsyncDirectFileWriter::AsyncDirectFileWriter(int blockBytes, int writesInFlight) :
+DataFileWriter(blockBytes),
+m_fd(-1),
+m_direct(false),
+m_canPreallocate(true),
+m_writePos(0),
+m_allocatedEnd(0),
+m_failed(false),
+m_numThreads(jlimit(1, 16, writesInFlight)),
+m_maxQueued(jlimit(1, 16, writesInFlight) * 4),
+m_activeWrites(0)
+{
+}
+
+AsyncDirectFileWriter::~AsyncDirectFileWriter()
+{
+	if (m_fd >= 0)
+		waitForPendingWrites();
+
+	for (int i = 0; i < m_threads.size(); i++)
+		m_threads[i]->signalThreadShouldExit();
+
+	for (int i = 0; i < m_threads.size(); i++)
+	{
+		m_writeQueued.signal();
+		m_threads[i]->stopThread(1000);
+	}
+	m_threads.clear();
+
+	if (m_fd >= 0)
+		close(m_fd);
+
+	for (int i = 0; i < m_allBlocks.size(); i++)
+		free(m_allBlocks[i]);
+}
+
+bool AsyncDirectFileWriter::openDescriptor(const File& file, bool direct)
+{
+	int flags = O_WRONLY | O_CREAT;
+	if (direct)
+		flags |= O_DIRECT;
+
+	m_fd = open(file.getFullPathName().toUTF8(), flags, 0644);
+	return m_fd >= 0;
+}
+
+bool AsyncDirectFileWriter::openFile(const File& file)
+{
+	//Some file systems (tmpfs, some network mounts) refuse O_DIRECT, so fall back to the page cache
+	m_direct = ((m_blockBytes % DIRECT_IO_ALIGNMENT) == 0) && openDescriptor(file, true);
+	if (!m_direct && !openDescriptor(file, false))
+	{
+		std::cerr << "BINARY WRITER: could not open " << file.getFullPathName() << ": " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	//Like FileOutputStream, append to an existing file
+	struct stat st;
+	m_writePos = (fstat(m_fd, &st) == 0) ? st.st_size : 0;
+	if (m_direct && (m_writePos % DIRECT_IO_ALIGNMENT) != 0)
+	{
+		close(m_fd);
+		m_direct = false;
+		if (!openDescriptor(file, false))
+			return false;
+	}
+	m_allocatedEnd = m_writePos;
+
+	for (int i = 0; i < m_numThreads; i++)
+	{
+		WriterThread* t = new WriterThread(*this, i);
+		m_threads.add(t);
+		t->startThread();
+	}
+
+	std::cout << "BINARY WRITER: " << file.getFileName() << " opened for asynchronous writes, direct I/O "
+		<< (m_direct ? "on, " : "off, ") << m_numThreads << " writes in flight" << std::endl;
+	return true;
+}
+
+char* AsyncDirectFileWriter::getBlock()
+{
+	char* block = nullptr;
+	{
+		const ScopedLock sl(m_poolLock);
+		if (m_freeBlocks.size() > 0)
+			block = m_freeBlocks.remove(m_freeBlocks.size() - 1);
+	}
+
+	if (block == nullptr)
+	{
+		void* ptr = nullptr;
+		if (posix_memalign(&ptr, DIRECT_IO_ALIGNMENT, m_blockBytes) != 0)
+			ptr = malloc(m_blockBytes);
+		block = static_cast<char*>(ptr);
+
+		const ScopedLock sl(m_poolLock);
+		m_allBlocks.add(block);
+	}
+
+	zeromem(block, m_blockBytes);
+	return block;
+}
+
+void AsyncDirectFileWriter::releaseBlock(char* block)
+{
+	const ScopedLock sl(m_poolLock);
+	m_freeBlocks.add(block);
+}
+
+void AsyncDirectFileWriter::preallocate(int64 end)
+{
+	if (!m_canPreallocate || end <= m_allocatedEnd)
+		return;
+
+	int64 newEnd = jmax(end, m_allocatedEnd + PREALLOCATE_STEP);
+	//KEEP_SIZE reserves the extents without changing the file size, so nothing needs trimming on close
+	if (fallocate(m_fd, FALLOC_FL_KEEP_SIZE, m_allocatedEnd, newEnd - m_allocatedEnd) == 0)
+		m_allocatedEnd = newEnd;
+	else
+		m_canPreallocate = false;
+}
+
+void AsyncDirectFileWriter::writeBlock(char* block)
+{
+	if (m_failed)
+	{
+		releaseBlock(block);
+		return;
+	}
+
+	preallocate(m_writePos + m_blockBytes);
+
+	PendingWrite write;
+	write.block = block;
+	write.offset = m_writePos;
+	m_writePos += m_blockBytes;
+
+	//Only wait if the disk has fallen behind by more than a few blocks per thread
+	while (true)
+	{
+		{
+			const ScopedLock sl(m_queueLock);
+			if (m_queue.size() + m_activeWrites < m_maxQueued)
+			{
+				m_queue.add(write);
+				break;
+			}
+		}
+		m_writeDone.wait(10);
+	}
+	m_writeQueued.signal();
+}
+
+bool AsyncDirectFileWriter::writeNext()
+{
+	PendingWrite write;
+	{
+		const ScopedLock sl(m_queueLock);
+		if (m_queue.size() == 0)
+			return false;
+
+		write = m_queue.remove(0);
+		m_activeWrites++;
+
+		//Wake up another thread for the rest
+		if (m_queue.size() > 0)
+			m_writeQueued.signal();
+	}
+
+	int64 written = 0;
+	while (written < m_blockBytes)
+	{
+		ssize_t n = pwrite(m_fd, write.block + written, m_blockBytes - written, write.offset + written);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			if (!m_failed.exchange(true))
+				std::cerr << "BINARY WRITER: write error at offset " << write.offset << ": " << strerror(errno) << std::endl;
+			break;
+		}
+		written += n;
+	}
+
+	releaseBlock(write.block);
+	{
+		const ScopedLock sl(m_queueLock);
+		m_activeWrites--;
+	}
+	m_writeDone.signal();
+	return true;
+}
+
+void AsyncDirectFileWriter::waitForPendingWrites()
+{
+	while (true)
+	{
+		{
+			const ScopedLock sl(m_queueLock);
+			if (m_queue.size() + m_activeWrites == 0)
+				return;
+		}
+		m_writeDone.wait(10);
+	}
+}
+
+AsyncDirectFileWriter::WriterThread::WriterThread(AsyncDirectFileWriter& owner, int index) :
+Thread("Binary Writer " + String(index)),
+m_owner(owner)
+{
+}
+
+void AsyncDirectFileWriter::WriterThread::run()
+{
+	while (!threadShouldExit())
+	{
+		if (!m_owner.writeNext())
+			m_owner.m_writeQueued.wait(50);
+	}
+}
+
+#endif
@@ -0,0 +1,157 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2016 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DATAFILEWRITER_H
+#define DATAFILEWRITER_H
+
+#include <BasicJuceHeader.h>
+#include <atomic>
+
+namespace BinaryRecordingEngine
+{
+
+	/**
+	Sink for the fixed-size blocks of a SequentialBlockFile.
+
+	Blocks are taken with getBlock(), filled and handed back with writeBlock(),
+	which appends them to the file in the order they are given. After writeBlock()
+	the block belongs to the writer again and must not be touched.
+	*/
+	class DataFileWriter
+	{
+	public:
+		virtual ~DataFileWriter() {}
+
+		virtual bool openFile(const File& file) = 0;
+
+		/** Returns a zeroed buffer of getBlockBytes() bytes */
+		virtual char* getBlock() = 0;
+
+		/** Appends a block obtained from getBlock() to the file */
+		virtual void writeBlock(char* block) = 0;
+
+		int getBlockBytes() const { return m_blockBytes; }
+
+		/** Creates the asynchronous direct I/O writer when requested and available,
+		the plain synchronous one otherwise */
+		static DataFileWriter* createWriter(int blockBytes, bool asyncDirect, int writesInFlight);
+
+	protected:
+		DataFileWriter(int blockBytes) : m_blockBytes(blockBytes) {}
+
+		const int m_blockBytes;
+	};
+
+	/** Writes every block synchronously through a FileOutputStream */
+	class StreamFileWriter : public DataFileWriter
+	{
+	public:
+		StreamFileWriter(int blockBytes);
+		~StreamFileWriter();
+
+		bool openFile(const File& file) override;
+		char* getBlock() override;
+		void writeBlock(char* block) override;
+
+	private:
+		ScopedPointer<FileOutputStream> m_file;
+		Array<char*> m_freeBlocks;
+
+		//Compile-time parameters
+		const int streamBufferSize{ 0 };
+
+		JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StreamFileWriter);
+	};
+
+#if JUCE_LINUX
+	/**
+	Linux backend that keeps the disk off the record thread.
+
+	The file is opened with O_DIRECT (when the file system accepts it and the blocks
+	are page aligned) and preallocated ahead of the write position with fallocate.
+	Blocks come from a pool of aligned buffers and are written with pwrite by a few
+	threads, so several writes are in flight at once and page cache writeback no longer
+	stalls the caller. writeBlock() only waits if the disk falls behind by more than
+	a few blocks per thread.
+	*/
+	class AsyncDirectFileWriter : public DataFileWriter
+	{
+	public:
+		AsyncDirectFileWriter(int blockBytes, int writesInFlight);
+		~AsyncDirectFileWriter();
+
+		bool openFile(const File& file) override;
+		char* getBlock() override;
+		void writeBlock(char* block) override;
+
+	private:
+		struct PendingWrite
+		{
+			char* block;
+			int64 offset;
+		};
+
+		class WriterThread : public Thread
+		{
+		public:
+			WriterThread(AsyncDirectFileWriter& owner, int index);
+			void run() override;
+
+		private:
+			AsyncDirectFileWriter& m_owner;
+		};
+
+		bool openDescriptor(const File& file, bool direct);
+		void preallocate(int64 end);
+		bool writeNext();
+		void waitForPendingWrites();
+		void releaseBlock(char* block);
+
+		int m_fd;
+		bool m_direct;
+		bool m_canPreallocate;
+		int64 m_writePos;
+		int64 m_allocatedEnd;
+		std::atomic<bool> m_failed;
+
+		const int m_numThreads;
+		const int m_maxQueued;
+		OwnedArray<WriterThread> m_threads;
+
+		Array<PendingWrite> m_queue;
+		int m_activeWrites;
+		CriticalSection m_queueLock;
+		WaitableEvent m_writeQueued;
+		WaitableEvent m_writeDone;
+
+		Array<char*> m_freeBlocks;
+		Array<char*> m_allBlocks;
+		CriticalSection m_poolLock;
+
+		JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AsyncDirectFileWriter);
+	};
+#endif
+
+}
+
+#endif
@@ -24,7 +24,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef FILEMEMORYBLOCK_H
 #define FILEMEMORYBLOCK_H
 
-#include <BasicJuceHeader.h>
+#include "DataFileWriter.h"
 
 namespace BinaryRecordingEngine
 {
@@ -33,22 +33,25 @@ namespace BinaryRecordingEngine
 	class FileMemoryBlock
 	{
 	public:
-		FileMemoryBlock(FileOutputStream* file, int blockSize, uint64 offset) :
-			m_data(blockSize, true),
+		FileMemoryBlock(DataFileWriter* file, int blockSize, uint64 offset) :
+			m_data(reinterpret_cast<StorageType*>(file->getBlock())),
 			m_file(file),
 			m_blockSize(blockSize),
 			m_offset(offset)
-		{};
+		{
+			jassert(file->getBlockBytes() == int(blockSize*sizeof(StorageType)));
+		};
 		~FileMemoryBlock() {
-			m_file->write(m_data, m_blockSize*sizeof(StorageType));
+			//Hands the buffer back to the writer, which owns it from now on
+			m_file->writeBlock(reinterpret_cast<char*>(m_data));
 		};
 
 		inline uint64 getOffset() { return m_offset; }
-		inline StorageType* getData() { return m_data.getData(); }
+		inline StorageType* getData() { return m_data; }
 
 	private:
-		HeapBlock<StorageType> m_data;
-		FileOutputStream* const m_file;
+		StorageType* const m_data;
+		DataFileWriter* const m_file;
 		const int m_blockSize;
 		const uint64 m_offset;
 		JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FileMemoryBlock);
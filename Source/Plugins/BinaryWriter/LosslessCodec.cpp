@@ -0,0 +1,288 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2016 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "LosslessCodec.h"
+
+using namespace BinaryRecordingEngine;
+
+//Residuals per Rice partition
+#define CODEC_PARTITION 256
+//Bits of the partition header, and the value that marks an all-zero partition
+#define CODEC_PARAM_BITS 5
+#define CODEC_ZERO_PARTITION 31
+#define CODEC_MAX_PARAM 20
+//Quotients from here on are escaped and stored raw. An order 2 residual of int16 data fits in 19 bits zigzagged
+#define CODEC_ESCAPE 24
+#define CODEC_RAW_BITS 20
+
+namespace
+{
+	class BitWriter
+	{
+	public:
+		BitWriter(uint8* dest) : m_dest(dest), m_pos(0), m_acc(0), m_bits(0) {}
+
+		/** Appends the nBits (up to 32) low bits of value, MSB first */
+		inline void write(uint32 value, int nBits)
+		{
+			m_acc = (m_acc << nBits) | value;
+			m_bits += nBits;
+			while (m_bits >= 8)
+			{
+				m_bits -= 8;
+				m_dest[m_pos++] = uint8(m_acc >> m_bits);
+			}
+		}
+
+		int finish()
+		{
+			if (m_bits > 0)
+				m_dest[m_pos++] = uint8(m_acc << (8 - m_bits));
+			m_bits = 0;
+			return m_pos;
+		}
+
+	private:
+		uint8* m_dest;
+		int m_pos;
+		uint64 m_acc;
+		int m_bits;
+	};
+
+	class BitReader
+	{
+	public:
+		BitReader(const uint8* source, int numBytes) : m_source(source), m_size(numBytes), m_pos(0), m_acc(0), m_bits(0) {}
+
+		inline uint32 read(int nBits)
+		{
+			if (nBits == 0)
+				return 0;
+			if (m_bits < nBits)
+				refill();
+			uint32 v = uint32(m_acc >> (64 - nBits));
+			m_acc <<= nBits;
+			m_bits -= nBits;
+			return v;
+		}
+
+		/** Counts and consumes zeros up to the terminating one. Returns -1 past CODEC_ESCAPE */
+		inline int readUnary()
+		{
+			if (m_bits < CODEC_ESCAPE + 1)
+				refill();
+			int zeros = 0;
+			while (!(m_acc & (uint64(1) << 63)))
+			{
+				if (++zeros > CODEC_ESCAPE)
+					return -1;
+				m_acc <<= 1;
+			}
+			m_acc <<= 1;
+			m_bits -= zeros + 1;
+			return zeros;
+		}
+
+		/** True if more bytes were consumed than there were */
+		bool isOverrun() const { return (m_pos - m_bits / 8) > m_size; }
+
+	private:
+		inline void refill()
+		{
+			while (m_bits <= 56)
+			{
+				uint64 b = (m_pos < m_size) ? m_source[m_pos] : 0;
+				m_pos++;
+				m_acc |= b << (56 - m_bits);
+				m_bits += 8;
+			}
+		}
+
+		const uint8* m_source;
+		const int m_size;
+		int m_pos;
+		uint64 m_acc;
+		int m_bits;
+	};
+
+	inline int32 predict(int order, const int16* x, int i)
+	{
+		switch (order)
+		{
+		case 0: return 0;
+		case 1: return x[i - 1];
+		default: return 2 * int32(x[i - 1]) - int32(x[i - 2]);
+		}
+	}
+
+	inline uint32 zigzag(int32 r)
+	{
+		return (uint32(r) << 1) ^ uint32(r >> 31);
+	}
+
+	int selectOrder(const int16* x, int n)
+	{
+		int64 sum[3] = { 0, 0, 0 };
+		for (int i = 2; i < n; i++)
+		{
+			int32 d1 = int32(x[i]) - x[i - 1];
+			int32 d2 = d1 - (int32(x[i - 1]) - x[i - 2]);
+			sum[0] += std::abs(int32(x[i]));
+			sum[1] += std::abs(d1);
+			sum[2] += std::abs(d2);
+		}
+		int order = 0;
+		for (int o = 1; o < 3; o++)
+		{
+			if (sum[o] < sum[order])
+				order = o;
+		}
+		return order;
+	}
+
+	int64 riceCost(const uint32* u, int n, int k)
+	{
+		int64 bits = int64(n) * (k + 1);
+		for (int i = 0; i < n; i++)
+		{
+			uint32 q = u[i] >> k;
+			bits += (q < CODEC_ESCAPE) ? q : CODEC_ESCAPE + CODEC_RAW_BITS - k;
+		}
+		return bits;
+	}
+}
+
+int LosslessCodec::getMaxEncodedBytes(int numSamples)
+{
+	int partitions = numSamples / CODEC_PARTITION + 1;
+	int64 bits = int64(partitions) * CODEC_PARAM_BITS + int64(numSamples) * (CODEC_ESCAPE + 1 + CODEC_RAW_BITS);
+	return 1 + 2 * 2 + int(bits / 8) + 8;
+}
+
+int LosslessCodec::encode(const int16* source, int numSamples, uint8* dest)
+{
+	int order = jmin(selectOrder(source, numSamples), numSamples);
+	dest[0] = uint8(order);
+
+	BitWriter writer(dest + 1);
+	for (int i = 0; i < order; i++)
+		writer.write(uint16(source[i]), 16);
+
+	uint32 u[CODEC_PARTITION];
+	for (int start = order; start < numSamples; start += CODEC_PARTITION)
+	{
+		int n = jmin(CODEC_PARTITION, numSamples - start);
+		uint64 total = 0;
+		for (int i = 0; i < n; i++)
+		{
+			u[i] = zigzag(int32(source[start + i]) - predict(order, source, start + i));
+			total += u[i];
+		}
+
+		if (total == 0)
+		{
+			writer.write(CODEC_ZERO_PARTITION, CODEC_PARAM_BITS);
+			continue;
+		}
+
+		//The optimal parameter is close to log2 of the mean, try its neighbours too
+		int k = 0;
+		uint64 mean = total / n;
+		while (k < CODEC_MAX_PARAM && (uint64(1) << (k + 1)) <= mean)
+			k++;
+		int best = k;
+		int64 bestCost = riceCost(u, n, k);
+		for (int c = jmax(0, k - 1); c <= jmin(CODEC_MAX_PARAM, k + 1); c++)
+		{
+			int64 cost = riceCost(u, n, c);
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				best = c;
+			}
+		}
+
+		writer.write(best, CODEC_PARAM_BITS);
+		uint32 mask = (uint32(1) << best) - 1;
+		for (int i = 0; i < n; i++)
+		{
+			uint32 q = u[i] >> best;
+			if (q < CODEC_ESCAPE)
+			{
+				writer.write(1, q + 1);
+				writer.write(u[i] & mask, best);
+			}
+			else
+			{
+				writer.write(1, CODEC_ESCAPE + 1);
+				writer.write(u[i], CODEC_RAW_BITS);
+			}
+		}
+	}
+	return 1 + writer.finish();
+}
+
+bool LosslessCodec::decode(const uint8* source, int numBytes, int16* dest, int numSamples)
+{
+	if (numBytes < 1)
+		return false;
+
+	int order = source[0];
+	if (order > 2 || order > numSamples)
+		return false;
+
+	BitReader reader(source + 1, numBytes - 1);
+	for (int i = 0; i < order; i++)
+		dest[i] = int16(reader.read(16));
+
+	for (int start = order; start < numSamples; start += CODEC_PARTITION)
+	{
+		int n = jmin(CODEC_PARTITION, numSamples - start);
+		int k = reader.read(CODEC_PARAM_BITS);
+
+		if (k == CODEC_ZERO_PARTITION)
+		{
+			for (int i = start; i < start + n; i++)
+				dest[i] = int16(predict(order, dest, i));
+			continue;
+		}
+		if (k > CODEC_MAX_PARAM)
+			return false;
+
+		for (int i = start; i < start + n; i++)
+		{
+			int q = reader.readUnary();
+			uint32 u;
+			if (q < 0)
+				return false;
+			else if (q == CODEC_ESCAPE)
+				u = reader.read(CODEC_RAW_BITS);
+			else
+				u = (uint32(q) << k) | reader.read(k);
+
+			int32 r = int32(u >> 1) ^ -int32(u & 1);
+			dest[i] = int16(predict(order, dest, i) + r);
+		}
+	}
+	return !reader.isOverrun();
+}
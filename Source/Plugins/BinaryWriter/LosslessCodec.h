@@ -0,0 +1,57 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2016 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef LOSSLESSCODEC_H
+#define LOSSLESSCODEC_H
+
+#include <BasicJuceHeader.h>
+
+namespace BinaryRecordingEngine
+{
+
+	/**
+	Lossless codec for one block of one int16 channel.
+
+	Each block picks the fixed polynomial predictor (order 0, 1 or 2) with the smallest
+	residuals, stores the first samples verbatim and Rice-codes the zigzagged residuals in
+	partitions of 256 samples, each with its own Rice parameter. Silent partitions take
+	five bits and spikes too large for the Rice code are escaped, so no input can expand
+	by much. Blocks are independent, so any block can be decoded on its own.
+	*/
+	class LosslessCodec
+	{
+	public:
+		/** Worst-case size of an encoded block of numSamples */
+		static int getMaxEncodedBytes(int numSamples);
+
+		/** Encodes numSamples samples into dest, which must hold getMaxEncodedBytes(numSamples).
+		Returns the number of bytes written. */
+		static int encode(const int16* source, int numSamples, uint8* dest);
+
+		/** Decodes a block produced by encode. Returns false if the data is corrupt. */
+		static bool decode(const uint8* source, int numBytes, int16* dest, int numSamples);
+	};
+
+}
+
+#endif
@@ -23,6 +23,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <PluginInfo.h>
 #include "BinaryRecording.h"
+#include "CompressedFileSource.h"
 #include <string>
 #ifdef WIN32
 #include <Windows.h>
@@ -33,7 +34,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
 using namespace Plugin;
-#define NUM_PLUGINS 1
+#define NUM_PLUGINS 2
 
 extern "C" EXPORT void getLibInfo(Plugin::LibraryInfo* info)
 {
@@ -52,6 +53,12 @@ extern "C" EXPORT int getPluginInfo(int index, Plugin::PluginInfo* info)
 		info->recordEngine.name = "Binary";
 		info->recordEngine.creator = &(Plugin::createRecordEngine<BinaryRecordingEngine::BinaryRecording>);
 		break;
+	case 1:
+		info->type = Plugin::PLUGIN_TYPE_FILE_SOURCE;
+		info->fileSource.name = "Compressed binary";
+		info->fileSource.extensions = "cdat";
+		info->fileSource.creator = &(Plugin::createFileSource<BinaryRecordingEngine::CompressedFileSource>);
+		break;
 	default:
 		return -1;
 	}
@@ -25,8 +25,40 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 using namespace BinaryRecordingEngine;
 
-SequentialBlockFile::SequentialBlockFile(int nChannels, int samplesPerBlock) :
-m_file(nullptr),
+namespace
+{
+	//Tile dimensions for the interleave. The source rows of a tile (4KB) and the block rows
+	//it lands in stay in L1 while they're being transposed
+	const int tileSamples = 64;
+	const int tileChannels = 32;
+
+	/** Writes numSamples rows of the interleaved block at dest, one tile at a time instead of
+	a full stride-nChannels pass per channel */
+	void interleave(int16* dest, int stride, const int* channels, int nChans,
+		const int16* const* data, int dataOffset, int numSamples)
+	{
+		for (int s0 = 0; s0 < numSamples; s0 += tileSamples)
+		{
+			int ns = jmin(tileSamples, numSamples - s0);
+			for (int c0 = 0; c0 < nChans; c0 += tileChannels)
+			{
+				int nc = jmin(tileChannels, nChans - c0);
+				const int* tileChans = channels + c0;
+				const int16* const* tileData = data + c0;
+				for (int i = 0; i < ns; i++)
+				{
+					int16* row = dest + (s0 + i)*stride;
+					int src = dataOffset + s0 + i;
+					for (int c = 0; c < nc; c++)
+						row[tileChans[c]] = tileData[c][src];
+				}
+			}
+		}
+	}
+}
+
+SequentialBlockFile::SequentialBlockFile(int nChannels, int samplesPerBlock, bool asyncDirect, int writesInFlight) :
+m_file(DataFileWriter::createWriter(nChannels*samplesPerBlock*sizeof(int16), asyncDirect, writesInFlight)),
 m_nChannels(nChannels),
 m_samplesPerBlock(samplesPerBlock),
 m_blockSize(nChannels*samplesPerBlock)
@@ -46,19 +78,18 @@ SequentialBlockFile::~SequentialBlockFile()
 
 bool SequentialBlockFile::openFile(File file)
 {
-	m_file = file.createOutputStream(streamBufferSize);
-	if (!m_file)
+	if (!m_file->openFile(file))
+	{
+		m_file = nullptr;
 		return false;
+	}
 
 	m_memBlocks.add(new FileBlock(m_file, m_blockSize, 0));
 	return true;
 }
 
-bool SequentialBlockFile::writeChannel(uint64 startPos, int channel, int16* data, int nSamples)
+int SequentialBlockFile::getBlockIndex(uint64 startPos, int nSamples)
 {
-	if (!m_file)
-		return false;
-	
 	int bIndex = m_memBlocks.size() - 1;
 	if ((bIndex < 0) || (m_memBlocks[bIndex]->getOffset() + m_samplesPerBlock) < (startPos + nSamples))
 		allocateBlocks(startPos, nSamples);
@@ -68,6 +99,15 @@ bool SequentialBlockFile::writeChannel(uint64 startPos, int channel, int16* data
 		if (m_memBlocks[bIndex]->getOffset() <= startPos)
 			break;
 	}
+	return bIndex;
+}
+
+bool SequentialBlockFile::writeChannel(uint64 startPos, int channel, const int16* data, int nSamples)
+{
+	if (!m_file)
+		return false;
+	
+	int bIndex = getBlockIndex(startPos, nSamples);
 	if (bIndex < 0)
 	{
 		std::cerr << "BINARY WRITER: Memory block unloaded ahead of time for chan " << channel << " start " << startPos << " ns " << nSamples << " first " << m_memBlocks[0]->getOffset() <<std::endl;
@@ -97,6 +137,33 @@ bool SequentialBlockFile::writeChannel(uint64 startPos, int channel, int16* data
 	return true;
 }
 
+bool SequentialBlockFile::writeBlock(uint64 startPos, const int* channels, int nChans, const int16* const* data, int nSamples)
+{
+	if (!m_file)
+		return false;
+
+	int bIndex = getBlockIndex(startPos, nSamples);
+	if (bIndex < 0)
+	{
+		std::cerr << "BINARY WRITER: Memory block unloaded ahead of time for block write start " << startPos << " ns " << nSamples << " first " << m_memBlocks[0]->getOffset() << std::endl;
+		return false;
+	}
+	int writtenSamples = 0;
+	int startIdx = startPos - m_memBlocks[bIndex]->getOffset();
+	while (writtenSamples < nSamples)
+	{
+		int16* blockPtr = m_memBlocks[bIndex]->getData() + startIdx*m_nChannels;
+		int samplesToWrite = jmin((nSamples - writtenSamples), (m_samplesPerBlock - startIdx));
+		interleave(blockPtr, m_nChannels, channels, nChans, data, writtenSamples, samplesToWrite);
+		writtenSamples += samplesToWrite;
+		startIdx = 0;
+		bIndex++;
+	}
+	for (int i = 0; i < nChans; i++)
+		m_currentBlock.set(channels[i], bIndex - 1);
+	return true;
+}
+
 void SequentialBlockFile::allocateBlocks(uint64 startIndex, int numSamples)
 {
 	//First deallocate full blocks
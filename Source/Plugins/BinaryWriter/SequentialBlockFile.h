@@ -24,6 +24,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef SEQUENTIALBLOCKFILE_H
 #define SEQUENTIALBLOCKFILE_H
 
+#include "DataBlockFile.h"
 #include "FileMemoryBlock.h"
 
 namespace BinaryRecordingEngine
@@ -31,17 +32,18 @@ namespace BinaryRecordingEngine
 
 	typedef FileMemoryBlock<int16> FileBlock;
 
-	class SequentialBlockFile
+	class SequentialBlockFile : public DataBlockFile
 	{
 	public:
-		SequentialBlockFile(int nChannels, int samplesPerBlock);
+		SequentialBlockFile(int nChannels, int samplesPerBlock, bool asyncDirect = false, int writesInFlight = 4);
 		~SequentialBlockFile();
 
-		bool openFile(File file);
-		bool writeChannel(uint64 startPos, int channel, int16* data, int nSamples);
+		bool openFile(File file) override;
+		bool writeChannel(uint64 startPos, int channel, const int16* data, int nSamples) override;
+		bool writeBlock(uint64 startPos, const int* channels, int nChans, const int16* const* data, int nSamples) override;
 
 	private:
-		ScopedPointer<FileOutputStream> m_file;
+		ScopedPointer<DataFileWriter> m_file;
 		const int m_nChannels;
 		const int m_samplesPerBlock;
 		const int m_blockSize;
@@ -49,9 +51,9 @@ namespace BinaryRecordingEngine
 		Array<int> m_currentBlock;
 
 		void allocateBlocks(uint64 startIndex, int numSamples);
+		int getBlockIndex(uint64 startPos, int nSamples);
 
 		//Compile-time parameters
-		const int streamBufferSize{ 0 };
 		const int blockArrayInitSize{ 128 };
 
 	};
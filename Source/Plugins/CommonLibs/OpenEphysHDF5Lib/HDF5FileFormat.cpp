@@ -28,6 +28,18 @@
 using namespace H5;
 using namespace OpenEphysHDF5;
 
+namespace
+{
+    template <typename T>
+    void copyToColumn(char* dst, const void* src, int nSamples, int stride)
+    {
+        const T* in = static_cast<const T*>(src);
+        T* out = reinterpret_cast<T*>(dst);
+        for (int i = 0; i < nSamples; i++)
+            out[i * stride] = in[i];
+    }
+}
+
 //HDF5FileBase
 
 HDF5FileBase::HDF5FileBase() : readyToOpen(false), opened(false)
@@ -76,7 +88,10 @@ int HDF5FileBase::open(bool newfile, int nChans)
 		FileAccPropList props = FileAccPropList::DEFAULT;
 		if (nChans > 0)
 		{
-			props.setCache(0, 1667, 2 * 8 * 2 * CHUNK_XSIZE * nChans, 1);
+			//Row data reaches the file as whole chunks, so the cache is kept below the size of a data chunk
+			//to let those go straight to disk, while still holding the smaller timestamp and event chunks
+			size_t dataChunkBytes = 2 * CHUNK_XSIZE * nChans;
+			props.setCache(0, 10007, jmax<size_t>(1 << 20, dataChunkBytes / 2), 1);
 			//std::cout << "opening HDF5 " << getFileName() << " with nchans: " << nChans << std::endl;
 		}
 
@@ -536,13 +551,164 @@ HDF5RecordingData::HDF5RecordingData(DataSet* data)
     this->dSet = dataSet;
     this->rowXPos.clear();
     this->rowXPos.insertMultiple(0,0,this->size[1]);
+
+    this->stageStart = 0;
+    this->stageCapacity = 0;
+    this->stageElementSize = 0;
+    this->stageType = -1;
+
+    this->appendRows = 0;
+    this->appendBytes = 0;
+    this->appendYSize = 0;
+    this->appendElementSize = 0;
+    this->appendType = -1;
 }
 
 HDF5RecordingData::~HDF5RecordingData()
 {
+    flushAppends();
+    flushRows();
 	//Safety
 	dSet->flush(H5F_SCOPE_GLOBAL);
 }
+
+int HDF5RecordingData::extendTo(int xSize)
+{
+    hsize_t dim[3];
+    DataSpace fSpace;
+
+    if (xSize <= size[0]) return 0;
+
+    //Grow geometrically so extends don't happen on every write
+    int newSize = jmax(xSize, size[0] + size[0] / 2);
+    newSize = ((newSize + xChunkSize - 1) / xChunkSize) * xChunkSize;
+
+    dim[0] = newSize;
+    dim[1] = size[1];
+    dim[2] = size[2];
+    try
+    {
+        dSet->extend(dim);
+        fSpace = dSet->getSpace();
+        fSpace.getSimpleExtentDims(dim);
+        size[0] = (int) dim[0];
+    }
+    catch (DataSetIException error)
+    {
+        PROCESS_ERROR;
+    }
+    catch (DataSpaceIException error)
+    {
+        PROCESS_ERROR;
+    }
+    return 0;
+}
+
+int HDF5RecordingData::writeStagedRows(bool all)
+{
+    hsize_t dim[2],offset[2];
+    DataSpace fSpace;
+
+    if (stageType < 0) return 0;
+
+    int nRows = size[1];
+    int end = xPos;
+    if (!all)
+    {
+        for (int i = 0; i < nRows; i++)
+            end = jmin(end, (int) rowXPos[i]);
+        end = stageStart + ((end - stageStart) / xChunkSize) * xChunkSize;
+    }
+    int nSamples = end - stageStart;
+    if (nSamples <= 0) return 0;
+
+    if (extendTo(end)) return -1;
+
+    try
+    {
+        dim[0] = nSamples;
+        dim[1] = nRows;
+        DataSpace mSpace(dimension,dim);
+
+        fSpace = dSet->getSpace();
+        offset[0] = stageStart;
+        offset[1] = 0;
+        fSpace.selectHyperslab(H5S_SELECT_SET, dim, offset);
+
+        dSet->write(stage.getData(),HDF5FileBase::getNativeType((HDF5FileBase::DataTypes) stageType),mSpace,fSpace);
+    }
+    catch (DataSetIException error)
+    {
+        PROCESS_ERROR;
+    }
+    catch (DataSpaceIException error)
+    {
+        PROCESS_ERROR;
+    }
+
+    //Keep the samples past the written ones, and clear the rest so rows that fall behind write zeros
+    int rowBytes = nRows * stageElementSize;
+    int used = xPos - stageStart;
+    int keep = used - nSamples;
+    memmove(stage.getData(), stage.getData() + nSamples * rowBytes, keep * rowBytes);
+    zeromem(stage.getData() + keep * rowBytes, (used - keep) * rowBytes);
+    stageStart = end;
+    return 0;
+}
+
+int HDF5RecordingData::writeRowDirect(int yPos, int xDataSize, HDF5FileBase::DataTypes type, const void* data)
+{
+    hsize_t dim[2],offset[2];
+    DataSpace fSpace;
+
+    if (extendTo(rowXPos[yPos] + xDataSize)) return -1;
+
+    try
+    {
+        dim[0] = xDataSize;
+        dim[1] = 1;
+        DataSpace mSpace(dimension,dim);
+
+        fSpace = dSet->getSpace();
+        offset[0] = rowXPos[yPos];
+        offset[1] = yPos;
+        fSpace.selectHyperslab(H5S_SELECT_SET, dim, offset);
+
+        dSet->write(data,HDF5FileBase::getNativeType(type),mSpace,fSpace);
+    }
+    catch (DataSetIException error)
+    {
+        PROCESS_ERROR;
+    }
+    catch (DataSpaceIException error)
+    {
+        PROCESS_ERROR;
+    }
+    catch (DataTypeIException error)
+    {
+        PROCESS_ERROR;
+    }
+    rowXPos.set(yPos,rowXPos[yPos] + xDataSize);
+    return 0;
+}
+
+int HDF5RecordingData::flushRows()
+{
+    int ret = writeStagedRows(true);
+
+    //Trim the extra space left by the geometric extends
+    if (stageType >= 0 && size[0] > xPos)
+    {
+        hsize_t dim[3];
+        dim[0] = xPos;
+        dim[1] = size[1];
+        dim[2] = size[2];
+        if (H5Dset_extent(dSet->getId(), dim) < 0)
+            return -1;
+        size[0] = xPos;
+    }
+    return ret;
+}
 int HDF5RecordingData::writeDataBlock(int xDataSize, HDF5FileBase::DataTypes type, const void* data)
 {
     return writeDataBlock(xDataSize,size[1],type,data);
@@ -554,6 +720,9 @@ int HDF5RecordingData::writeDataBlock(int xDataSize, int yDataSize, HDF5FileBase
     DataSpace fSpace;
     DataType nativeType;
 
+    if (flushRows()) return -1;
+    if (appendRows > 0 && flushAppends()) return -1;
+
     dim[2] = size[2];
     //only modify y size if new required size is larger than what we had.
     if (yDataSize > size[1])
@@ -602,59 +771,140 @@ int HDF5RecordingData::writeDataBlock(int xDataSize, int yDataSize, HDF5FileBase
 }
 
 
-int HDF5RecordingData::writeDataRow(int yPos, int xDataSize, HDF5FileBase::DataTypes type, const void* data)
+int HDF5RecordingData::appendDataBlock(int xDataSize, HDF5FileBase::DataTypes type, const void* data)
 {
-    hsize_t dim[2],offset[2];
-    DataSpace fSpace;
-    DataType nativeType;
-    if (dimension > 2) return -4; //We're not going to write rows in datasets bigger than 2d.
-    //    if (xDataSize != rowDataSize) return -2;
-    if ((yPos < 0) || (yPos >= size[1])) return -2;
+    return appendDataBlock(xDataSize,size[1],type,data);
+}
 
-    try
+int HDF5RecordingData::appendDataBlock(int xDataSize, int yDataSize, HDF5FileBase::DataTypes type, const void* data)
+{
+    if ((appendRows > 0) && ((type != appendType) || (yDataSize != appendYSize)))
     {
-        if (rowXPos[yPos]+xDataSize > size[0])
+        if (flushAppends()) return -1;
+    }
+    if (type != appendType)
+    {
+        try
         {
-            dim[1] = size[1];
-            dim[0] = rowXPos[yPos] + xDataSize;
-            dSet->extend(dim);
-
-            fSpace = dSet->getSpace();
-            fSpace.getSimpleExtentDims(dim);
-            size[0] = (int) dim[0];
+            appendElementSize = (int) HDF5FileBase::getNativeType(type).getSize();
         }
-        if (rowXPos[yPos]+xDataSize > xPos)
+        catch (DataTypeIException error)
         {
-            xPos = rowXPos[yPos]+xDataSize;
+            PROCESS_ERROR;
         }
+        appendType = type;
+    }
+    appendYSize = yDataSize;
 
-        dim[0] = xDataSize;
-        dim[1] = 1;
-        DataSpace mSpace(dimension,dim);
+    int rowBytes = xDataSize * yDataSize * ((dimension > 2) ? size[2] : 1) * appendElementSize;
+    if (appendBuffer.getSize() < (size_t)(appendBytes + rowBytes))
+        appendBuffer.setSize(jmax<size_t>(appendBytes + rowBytes, 2 * appendBuffer.getSize()));
+    memcpy(static_cast<char*>(appendBuffer.getData()) + appendBytes, data, rowBytes);
+    appendRows += xDataSize;
+    appendBytes += rowBytes;
 
-        fSpace = dSet->getSpace();
-        offset[0] = rowXPos[yPos];
-        offset[1] = yPos;
-        fSpace.selectHyperslab(H5S_SELECT_SET, dim, offset);
+    if (appendBytes >= APPEND_FLUSH_BYTES)
+        return flushAppends();
+    return 0;
+}
 
-        nativeType = HDF5FileBase::getNativeType(type);
+int HDF5RecordingData::flushAppends()
+{
+    if (appendRows == 0) return 0;
 
+    int nRows = appendRows;
+    appendRows = 0;
+    appendBytes = 0;
+    return writeDataBlock(nRows,appendYSize,(HDF5FileBase::DataTypes) appendType,appendBuffer.getData());
+}
 
-        dSet->write(data,nativeType,mSpace,fSpace);
+int HDF5RecordingData::writeDataRow(int yPos, int xDataSize, HDF5FileBase::DataTypes type, const void* data)
+{
+    if (dimension > 2) return -4; //We're not going to write rows in datasets bigger than 2d.
+    //    if (xDataSize != rowDataSize) return -2;
+    if ((yPos < 0) || (yPos >= size[1])) return -2;
 
-        rowXPos.set(yPos,rowXPos[yPos] + xDataSize);
-    }
-    catch (DataSetIException error)
+    /* Rows are copied into an interleaved staging area and reach the file as whole chunks once
+       every row has filled them, instead of as one single-column hyperslab per row and block */
+    try
     {
-        PROCESS_ERROR;
+        if (stageType != type)
+        {
+            if (flushRows()) return -1;
+            stageType = type;
+            stageElementSize = (int) HDF5FileBase::getNativeType(type).getSize();
+            stageCapacity = 0;
+        }
     }
-    catch (DataSpaceIException error)
+    catch (DataTypeIException error)
     {
         PROCESS_ERROR;
     }
-    catch (FileIException error)
+
+    const char* src = static_cast<const char*>(data);
+    const int nRows = size[1];
+    const int rowBytes = nRows * stageElementSize;
+    const int maxCapacity = ROW_STAGE_MAX_CHUNKS * xChunkSize;
+
+    while (xDataSize > 0)
     {
-        PROCESS_ERROR;
+        //Samples before the stage were already written, with zeros for this row, when the stage was flushed
+        if ((int) rowXPos[yPos] < stageStart)
+        {
+            int nSamples = jmin(xDataSize, stageStart - (int) rowXPos[yPos]);
+            if (writeRowDirect(yPos, nSamples, type, src)) return -1;
+            src += nSamples * stageElementSize;
+            xDataSize -= nSamples;
+            continue;
+        }
+
+        int end = rowXPos[yPos] + xDataSize;
+        if (end - stageStart > stageCapacity)
+        {
+            if (writeStagedRows(false)) return -1;
+        }
+        if (end - stageStart > stageCapacity && stageCapacity < maxCapacity)
+        {
+            //A row is running ahead of the others, or the block is larger than the stage
+            int newCapacity = jmax(ROW_STAGE_CHUNKS * xChunkSize, 2 * stageCapacity);
+            while (end - stageStart > newCapacity && newCapacity < maxCapacity)
+                newCapacity *= 2;
+            newCapacity = jmin(newCapacity, maxCapacity);
+            HeapBlock<char> newStage(newCapacity * rowBytes, true);
+            if (stageCapacity > 0)
+                memcpy(newStage.getData(), stage.getData(), stageCapacity * rowBytes);
+            stage.swapWith(newStage);
+            stageCapacity = newCapacity;
+        }
+        if ((int) rowXPos[yPos] - stageStart >= stageCapacity)
+        {
+            /* The stage is full and a row is lagging too far behind to free it. Write it out with
+               zeros for the lagging rows, which then catch up with direct writes */
+            if (writeStagedRows(true)) return -1;
+            continue;
+        }
+
+        int nSamples = jmin(xDataSize, stageStart + stageCapacity - (int) rowXPos[yPos]);
+        char* dst = stage.getData() + ((rowXPos[yPos] - stageStart) * nRows + yPos) * stageElementSize;
+        switch (stageElementSize)
+        {
+            case 1: copyToColumn<uint8>(dst, src, nSamples, nRows); break;
+            case 2: copyToColumn<uint16>(dst, src, nSamples, nRows); break;
+            case 4: copyToColumn<uint32>(dst, src, nSamples, nRows); break;
+            case 8: copyToColumn<uint64>(dst, src, nSamples, nRows); break;
+            default:
+                for (int i = 0; i < nSamples; i++)
+                    memcpy(dst + i * rowBytes, src + i * stageElementSize, stageElementSize);
+        }
+
+        end = rowXPos[yPos] + nSamples;
+        if (end > xPos)
+        {
+            xPos = end;
+        }
+        rowXPos.set(yPos,end);
+        src += nSamples * stageElementSize;
+        xDataSize -= nSamples;
     }
     return 0;
 }
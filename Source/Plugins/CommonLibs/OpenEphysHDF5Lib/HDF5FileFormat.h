@@ -35,6 +35,21 @@
 
 #define MAX_STR_SIZE 256
 
+//Row writes are staged in memory for this many chunks before being written as whole chunks
+#ifndef ROW_STAGE_CHUNKS
+#define ROW_STAGE_CHUNKS 2
+#endif
+
+//The row staging area never grows past this many chunks; rows that can't fit are written directly
+#ifndef ROW_STAGE_MAX_CHUNKS
+#define ROW_STAGE_MAX_CHUNKS 64
+#endif
+
+//Appended blocks are written once this many bytes are pending, if they aren't flushed earlier
+#ifndef APPEND_FLUSH_BYTES
+#define APPEND_FLUSH_BYTES 262144
+#endif
+
 namespace H5
 {
 class DataSet;
@@ -108,9 +123,24 @@ public:
 
     int writeDataRow(int yPos, int xDataSize, HDF5FileBase::DataTypes type, const void* data);
 
+    /** Same as writeDataBlock, but the data is kept in memory and written together with the
+        following appends by a single write when flushAppends is called or enough data is pending */
+    int appendDataBlock(int xDataSize, HDF5FileBase::DataTypes type, const void* data);
+    int appendDataBlock(int xDataSize, int yDataSize, HDF5FileBase::DataTypes type, const void* data);
+    int flushAppends();
+
     void getRowXPositions(Array<uint32>& rows);
 
+    /** Writes out every staged row sample, including incomplete chunks */
+    int flushRows();
+
 private:
+    /** Writes the staged samples that all rows have reached, in whole chunks unless flushing everything */
+    int writeStagedRows(bool all);
+    /** Writes part of a row straight to the file, as a single-column hyperslab */
+    int writeRowDirect(int yPos, int xDataSize, HDF5FileBase::DataTypes type, const void* data);
+    int extendTo(int xSize);
+
     int xPos;
     int xChunkSize;
     int size[3];
@@ -118,6 +148,21 @@ private:
     Array<uint32> rowXPos;
     ScopedPointer<H5::DataSet> dSet;
 
+    //Interleaved samples x rows staging area for writeDataRow
+    HeapBlock<char> stage;
+    int stageStart;
+    int stageCapacity;
+    int stageElementSize;
+    int stageType;
+
+    //Pending appendDataBlock data
+    MemoryBlock appendBuffer;
+    int appendRows;
+    int appendBytes;
+    int appendYSize;
+    int appendElementSize;
+    int appendType;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(HDF5RecordingData);
 };
 
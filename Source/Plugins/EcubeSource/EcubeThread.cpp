@@ -51,6 +51,7 @@ public:
     IEcubeDigitalInputStreamingPtr pStrmD;
     HeapBlock<float, true> interleaving_buffer;
     HeapBlock<uint64_t, true> event_buffer;
+    HeapBlock<int64, true> timestamp_buffer;
     HeapBlock<uint32_t, true> bit_conversion_tables;
     bool buf_timestamp_locked;
     unsigned long buf_timestamp;
@@ -230,6 +231,7 @@ EcubeThread::EcubeThread(SourceNode* sn) : DataThread(sn), numberingScheme(1), a
                 dataBuffer = new DataBuffer(pDevInt->n_channel_objects, 10000);
                 // Create the interleaving buffer based on the number of channels
                 pDevInt->interleaving_buffer.malloc(sizeof(float)* 1500 * pDevInt->n_channel_objects);
+                pDevInt->timestamp_buffer.malloc(1500);
             }
             else if (selmod == "Panel Analog Input")
             {
@@ -259,6 +261,7 @@ EcubeThread::EcubeThread(SourceNode* sn) : DataThread(sn), numberingScheme(1), a
                 dataBuffer = new DataBuffer(32, 10000);
                 // The interleaving buffer is there just for short->float conversion
                 pDevInt->interleaving_buffer.malloc(sizeof(float)* 1500);
+                pDevInt->timestamp_buffer.malloc(1500);
             }
             else if (selmod == "Panel Digital Input")
             {
@@ -286,6 +289,7 @@ EcubeThread::EcubeThread(SourceNode* sn) : DataThread(sn), numberingScheme(1), a
                 dataBuffer = new DataBuffer(64, 10000);
                 // Create the interleaving buffer based on the number of digital ports
                 pDevInt->interleaving_buffer.malloc(sizeof(float)* 1500 * 64);
+                pDevInt->timestamp_buffer.malloc(1500);
                 // Create the analog of interleaving buffer in packed format (int64)
                 pDevInt->event_buffer.malloc(sizeof(uint64_t)* 1500);
                 pDevInt->bit_conversion_tables.malloc(sizeof(uint32_t)* 0x600);
@@ -476,10 +480,9 @@ bool EcubeThread::updateBuffer()
                             // Send its contents out to the application
                             int64 cts = pDevInt->buf_timestamp64 / pDevInt->sampletime_80mhz; // Convert eCube 80MHz timestamp into a 25kHz timestamp
                             for (unsigned long j = 0; j < pDevInt->int_buf_size; j++)
-                            {
-                                dataBuffer->addToBuffer(pDevInt->interleaving_buffer + j*nchan, &cts, &eventCode, 1);
-                                cts++;
-                            }
+                                pDevInt->timestamp_buffer[j] = cts + j;
+                            // Send the whole interleaving buffer in one go
+                            dataBuffer->addToBufferSampleMajor(pDevInt->interleaving_buffer, pDevInt->timestamp_buffer, nullptr, pDevInt->int_buf_size);
                             // Update the 64-bit timestamp, take account of its wrap-around
                             unsigned tsdif = bts - pDevInt->buf_timestamp;
                             pDevInt->buf_timestamp64 += tsdif;
@@ -526,10 +529,8 @@ bool EcubeThread::updateBuffer()
                     unsigned long datasam = datasize / 32;
                     int64 cts = pDevInt->buf_timestamp64 / pDevInt->sampletime_80mhz; // Convert eCube's 80MHz timestamps into number of samples on the Panel Analog input (orig sample rate 1144)
                     for (unsigned long j = 0; j < datasam; j++)
-                    {
-                        dataBuffer->addToBuffer(pDevInt->interleaving_buffer+j*32, &cts, &eventCode, 1);
-                        cts++;
-                    }
+                        pDevInt->timestamp_buffer[j] = cts + j;
+                    dataBuffer->addToBufferSampleMajor(pDevInt->interleaving_buffer, pDevInt->timestamp_buffer, nullptr, datasam);
                 }
                 else // Digital data
                 {
@@ -544,10 +545,8 @@ bool EcubeThread::updateBuffer()
                             // Send its contents out to the application
                             int64 cts = pDevInt->buf_timestamp64 / pDevInt->sampletime_80mhz; // Convert eCube 80MHz timestamp into a 25kHz timestamp
                             for (unsigned long j = 0; j < pDevInt->int_buf_size; j++)
-                            {
-                                dataBuffer->addToBuffer(pDevInt->interleaving_buffer + j*64, &cts, pDevInt->event_buffer+j, 1);
-                                cts++;
-                            }
+                                pDevInt->timestamp_buffer[j] = cts + j;
+                            dataBuffer->addToBufferSampleMajor(pDevInt->interleaving_buffer, pDevInt->timestamp_buffer, (const uint64*)pDevInt->event_buffer.getData(), pDevInt->int_buf_size);
                             // Update the 64-bit timestamp, take account of its wrap-around
                             pDevInt->buf_timestamp64 += tsdif;
                         }
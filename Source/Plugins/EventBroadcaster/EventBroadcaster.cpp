@@ -99,7 +99,7 @@ void EventBroadcaster::handleEvent(int eventType, MidiMessage& event, int sample
         case TTL:
         case MESSAGE:
         case BINARY_MSG: {
-            uint8_t nodeID = buffer[1];
+            int nodeID = getBlockContext().getNodeIdForEvent(buffer[1]);
             timestamp = timestamps.at(nodeID) + samplePosition;
             break;
         }
@@ -259,7 +259,14 @@ void FilterNode::setParameter (int parameterIndex, float newValue)
 
 void FilterNode::process (AudioSampleBuffer& buffer, MidiBuffer& midiMessages)
 {
-    for (int n = 0; n < getNumOutputs(); ++n)
+    // every channel has its own filter, so channels can be filtered on separate threads
+    processChannelsInParallel (getNumOutputs(), buffer, midiMessages);
+}
+
+
+void FilterNode::processChannelRange (int firstChannel, int lastChannel, AudioSampleBuffer& buffer, MidiBuffer&)
+{
+    for (int n = firstChannel; n < lastChannel; ++n)
     {
         if (shouldFilterChannel[n])
         {
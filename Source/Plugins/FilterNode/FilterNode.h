@@ -62,6 +62,8 @@ public:
 
 
 private:
+    void processChannelRange (int firstChannel, int lastChannel, AudioSampleBuffer& buffer, MidiBuffer& events) override;
+
     void setFilterParameters (double, double, int);
 
     Array<double> lowCuts;
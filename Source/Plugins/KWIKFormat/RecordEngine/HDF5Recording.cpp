@@ -30,7 +30,6 @@
 HDF5Recording::HDF5Recording() : processorIndex(-1), bufferSize(MAX_BUFFER_SIZE), hasAcquired(false)
 {
     //timestamp = 0;
-    scaledBuffer.malloc(MAX_BUFFER_SIZE);
     intBuffer.malloc(MAX_BUFFER_SIZE);
 }
 
@@ -65,7 +64,6 @@ void HDF5Recording::registerProcessor(const GenericProcessor* proc)
 
 void HDF5Recording::resetChannels()
 {
-	scaledBuffer.malloc(MAX_BUFFER_SIZE);
 	intBuffer.malloc(MAX_BUFFER_SIZE);
 	bufferSize = MAX_BUFFER_SIZE;
     processorIndex = -1;
@@ -126,8 +124,9 @@ void HDF5Recording::openFiles(File rootFolder, int experimentNumber, int recordi
 
 		channelsPerProcessor.set(index, channelsPerProcessor[index] + 1);
 		bitVoltsArray[index]->add(getChannel(getRealChannel(i))->bitVolts);
-		sampleRatesArray[index]->add(getChannel(getRealChannel(i))->sampleRate);
-		if (getChannel(getRealChannel(i))->sampleRate != infoArray[index]->sample_rate)
+		//Decimated channels share the file of their processor, with the per channel rates and timestamps
+		sampleRatesArray[index]->add(getChannel(getRealChannel(i))->getRecordSampleRate());
+		if (getChannel(getRealChannel(i))->getRecordSampleRate() != infoArray[index]->sample_rate)
 		{
 			infoArray[index]->multiSample = true;
 		}
@@ -185,7 +184,6 @@ void HDF5Recording::closeFiles()
 	recordedChanToKWDChan.clear();
 	channelTimestampArray.clear();
 	channelLeftOverSamples.clear();
-	scaledBuffer.malloc(MAX_BUFFER_SIZE);
 	intBuffer.malloc(MAX_BUFFER_SIZE);
 	bufferSize = MAX_BUFFER_SIZE;
 }
@@ -196,14 +194,21 @@ void HDF5Recording::writeData(int writeChannel, int realChannel, const float* bu
 	{
 		std::cerr << "Write buffer overrun, resizing to" << size << std::endl;
 		bufferSize = size;
-		scaledBuffer.malloc(size);
 		intBuffer.malloc(size);
 	}
-	double multFactor = 1 / (float(0x7fff) * getChannel(realChannel)->bitVolts);
+	convertToInt16(intBuffer.getData(), buffer, 1 / (float(0x7fff) * getChannel(realChannel)->bitVolts), size);
+	writeIntegerData(writeChannel, realChannel, intBuffer.getData(), size);
+}
+
+bool HDF5Recording::acceptsIntegerData() const
+{
+	return true;
+}
+
+void HDF5Recording::writeIntegerData(int writeChannel, int realChannel, const int16* buffer, int size)
+{
 	int index = processorMap[getChannel(realChannel)->recordIndex];
-	FloatVectorOperations::copyWithMultiply(scaledBuffer.getData(), buffer, multFactor, size);
-	AudioDataConverters::convertFloatToInt16LE(scaledBuffer.getData(), intBuffer.getData(), size);
-	fileArray[index]->writeRowData(intBuffer.getData(), size, recordedChanToKWDChan[writeChannel]);
+	fileArray[index]->writeRowData(buffer, size, recordedChanToKWDChan[writeChannel]);
 
 	int sampleOffset = channelLeftOverSamples[writeChannel];
 	int blockStart = sampleOffset;
@@ -240,11 +245,18 @@ void HDF5Recording::endChannelBlock(bool lastBlock)
 			channelTimestampArray[ch]->clearQuick();
 		}
 	}
+	//Events and spikes from the previous block go out in one write per dataset
+	eventFile->flushEvents();
+	spikesFile->flushSpikes();
 }
 
 void HDF5Recording::writeEvent(int eventType, const MidiMessage& event, int64 timestamp)
 {
-    const uint8* dataptr = event.getRawData();
+    writeEventData(eventType, event.getRawData(), event.getRawDataSize(), timestamp);
+}
+
+void HDF5Recording::writeEventData(int eventType, const uint8* dataptr, int size, int64 timestamp)
+{
     if (eventType == GenericProcessor::TTL)
         eventFile->writeEvent(0,*(dataptr+2),*(dataptr+1),(void*)(dataptr+3),timestamp);
     else if (eventType == GenericProcessor::MESSAGE)
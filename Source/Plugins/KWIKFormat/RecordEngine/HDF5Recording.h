@@ -36,7 +36,10 @@ public:
     void openFiles(File rootFolder, int experimentNumber, int recordingNumber) override;
 	void closeFiles() override;
 	void writeData(int writeChannel, int realChannel, const float* buffer, int size) override;
+	bool acceptsIntegerData() const override;
+	void writeIntegerData(int writeChannel, int realChannel, const int16* buffer, int size) override;
 	void writeEvent(int eventType, const MidiMessage& event, int64 timestamp) override;
+	void writeEventData(int eventType, const uint8* data, int size, int64 timestamp) override;
 	void addChannel(int index, const Channel* chan) override;
 	void addSpikeElectrode(int index,const  SpikeRecordInfo* elec) override;
 	void writeSpike(int electrodeIndex, const SpikeObject& spike, int64 timestamp) override;
@@ -61,7 +64,6 @@ private:
     OwnedArray<KWIKRecordingInfo> infoArray;
     ScopedPointer<KWEFile> eventFile;
     ScopedPointer<KWXFile> spikesFile;
-	HeapBlock<float> scaledBuffer;
 	HeapBlock<int16> intBuffer;
 	int bufferSize;
     //float* scaledBuffer;
@@ -125,7 +125,7 @@ void KWDFile::writeBlockData(int16* data, int nSamples)
     CHECK_ERROR(recdata->writeDataBlock(nSamples,I16,data));
 }
 
-void KWDFile::writeRowData(int16* data, int nSamples)
+void KWDFile::writeRowData(const int16* data, int nSamples)
 {
     if (curChan >= nChannels)
     {
@@ -135,7 +135,7 @@ void KWDFile::writeRowData(int16* data, int nSamples)
     curChan++;
 }
 
-void KWDFile::writeRowData(int16* data, int nSamples, int channel)
+void KWDFile::writeRowData(const int16* data, int nSamples, int channel)
 {
 	if (channel >= 0 && channel < nChannels)
 	{
@@ -264,11 +264,23 @@ void KWEFile::writeEvent(int type, uint8 id, uint8 processor, void* data, uint64
         std::cerr << "HDF5::writeEvent Invalid event type " << type << std::endl;
         return;
     }
-    CHECK_ERROR(timeStamps[type]->writeDataBlock(1,U64,&timestamp));
-    CHECK_ERROR(recordings[type]->writeDataBlock(1,I32,&recordingNumber));
-    CHECK_ERROR(eventID[type]->writeDataBlock(1,U8,&id));
-    CHECK_ERROR(nodeID[type]->writeDataBlock(1,U8,&processor));
-    CHECK_ERROR(eventData[type]->writeDataBlock(1,eventTypes[type],data));
+    CHECK_ERROR(timeStamps[type]->appendDataBlock(1,U64,&timestamp));
+    CHECK_ERROR(recordings[type]->appendDataBlock(1,I32,&recordingNumber));
+    CHECK_ERROR(eventID[type]->appendDataBlock(1,U8,&id));
+    CHECK_ERROR(nodeID[type]->appendDataBlock(1,U8,&processor));
+    CHECK_ERROR(eventData[type]->appendDataBlock(1,eventTypes[type],data));
+}
+
+void KWEFile::flushEvents()
+{
+    for (int i = 0; i < timeStamps.size(); i++)
+    {
+        CHECK_ERROR(timeStamps[i]->flushAppends());
+        CHECK_ERROR(recordings[i]->flushAppends());
+        CHECK_ERROR(eventID[i]->flushAppends());
+        CHECK_ERROR(nodeID[i]->flushAppends());
+        CHECK_ERROR(eventData[i]->flushAppends());
+    }
 }
 
 /*void KWEFile::addKwdFile(String filename)
@@ -412,7 +424,17 @@ void KWXFile::writeSpike(int groupIndex, int nSamples, const uint16* data, uint6
         }
     }
 
-    CHECK_ERROR(spikeArray[groupIndex]->writeDataBlock(1,nSamples,I16,transformVector));
-    CHECK_ERROR(recordingArray[groupIndex]->writeDataBlock(1,I32,&recordingNumber));
-    CHECK_ERROR(timeStamps[groupIndex]->writeDataBlock(1,U64,&timestamp));
+    CHECK_ERROR(spikeArray[groupIndex]->appendDataBlock(1,nSamples,I16,transformVector));
+    CHECK_ERROR(recordingArray[groupIndex]->appendDataBlock(1,I32,&recordingNumber));
+    CHECK_ERROR(timeStamps[groupIndex]->appendDataBlock(1,U64,&timestamp));
+}
+
+void KWXFile::flushSpikes()
+{
+    for (int i = 0; i < spikeArray.size(); i++)
+    {
+        CHECK_ERROR(spikeArray[i]->flushAppends());
+        CHECK_ERROR(recordingArray[i]->flushAppends());
+        CHECK_ERROR(timeStamps[i]->flushAppends());
+    }
 }
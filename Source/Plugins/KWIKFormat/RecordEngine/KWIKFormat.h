@@ -49,8 +49,8 @@ public:
     void startNewRecording(int recordingNumber, int nChannels, KWIKRecordingInfo* info);
     void stopRecording();
     void writeBlockData(int16* data, int nSamples);
-    void writeRowData(int16* data, int nSamples);
-	void writeRowData(int16* data, int nSamples, int channel);
+    void writeRowData(const int16* data, int nSamples);
+	void writeRowData(const int16* data, int nSamples, int channel);
 	void writeTimestamps(int64* ts, int nTs, int channel);
     String getFileName();
 
@@ -79,6 +79,7 @@ public:
     void startNewRecording(int recordingNumber, KWIKRecordingInfo* info);
     void stopRecording();
     void writeEvent(int type, uint8 id, uint8 processor, void* data, uint64 timestamp);
+    void flushEvents();
   //  void addKwdFile(String filename);
     void addEventType(String name, DataTypes type, String dataName);
     String getFileName();
@@ -114,6 +115,7 @@ public:
     void addChannelGroup(int nChannels);
     void resetChannels();
     void writeSpike(int groupIndex, int nSamples, const uint16* data, uint64 timestamp);
+    void flushSpikes();
     String getFileName();
 
 protected:
@@ -167,7 +167,7 @@ void LfpDisplayNode::handleEvent (int eventType, MidiMessage& event, int sampleN
         const int eventId             = *(dataptr + 2);
         const int eventChannel        = *(dataptr + 3);
         const int eventTime           = event.getTimeStamp();
-        const int eventSourceNodeId   = *(dataptr + 5);
+        const int eventSourceNodeId   = getBlockContext().getNodeIdForEvent (*(dataptr + 5));
         const int nSamples            = numSamples.at (eventSourceNodeId);
         const int samplesToFill       = nSamples - eventTime;
 
@@ -98,11 +98,13 @@ int NWBFile::createFileStructure()
 	 {
 		 basePath = "/acquisition/timeseries/continuous";
 		 basePath = basePath + "/processor" + String(continuousInfo[i].processorId) + "_" + String(continuousInfo[i].sourceId);
+		 if (continuousInfo[i].decimation > 1)
+			 basePath = basePath + "_ds" + String(continuousInfo[i].decimation);
 		 if (createGroupIfDoesNotExist(basePath)) return false;
 		 basePath = basePath + "/recording" + String(recordingNumber);
 		 if (createGroup(basePath)) return false;
-		 dSet = createRecordingStructures(basePath, continuousInfo[i], "Stores acquired voltage data from extracellular recordings", CHUNK_XSIZE, "ElectricalSeries");
-		 continuousDataSetsTS.add(dSet);
+		 createRecordingStructures(basePath, continuousInfo[i], "Stores acquired voltage data from extracellular recordings", CHUNK_XSIZE, "ElectricalSeries", false);
+		 createSegmentStructures(basePath, continuousInfo[i]);
 		 basePath += "/data";
 		 continuousBasePaths.add(basePath);
 		 dSet = createDataSet(I16, 0, continuousInfo[i].nChannels, CHUNK_XSIZE, basePath);
@@ -128,7 +130,7 @@ int NWBFile::createFileStructure()
 		 if (createGroupIfDoesNotExist(basePath)) return false;
 		 basePath = basePath + "/recording" + String(recordingNumber);
 		 if (createGroup(basePath)) return false;
-		 dSet = createRecordingStructures(basePath, spikeInfo[i], "Snapshorts of spike events from data", SPIKE_CHUNK_XSIZE, "SpikeEventSeries");
+		 dSet = createRecordingStructures(basePath, spikeInfo[i], "Snapshorts of spike events from data", SPIKE_CHUNK_XSIZE, "SpikeEventSeries", true);
 		 spikeDataSetsTS.add(dSet);
 		 basePath += "/data";
 		 spikeBasePaths.add(basePath);
@@ -159,6 +161,7 @@ int NWBFile::createFileStructure()
 	 singleInfo.nSamplesPerSpike = 0;
 	 singleInfo.processorId = 0;
 	 singleInfo.sampleRate = 0;
+	 singleInfo.decimation = 1;
 	 singleInfo.sourceId = 0;
 	 singleInfo.spikeElectrodeName = " ";
 	 singleInfo.sourceName = "All processors";
@@ -166,7 +169,7 @@ int NWBFile::createFileStructure()
 	 basePath = "/acquisition/timeseries/events";
 	 basePath = basePath + "/recording" + String(recordingNumber);
 	 if (createGroup(basePath)) return false;
-	 dSet = createRecordingStructures(basePath, singleInfo, "Stores the start and stop times for events",EVENT_CHUNK_SIZE, "IntervalSeries");
+	 dSet = createRecordingStructures(basePath, singleInfo, "Stores the start and stop times for events",EVENT_CHUNK_SIZE, "IntervalSeries", true);
 	 eventsDataSetTS = dSet;
 	 eventsControlDataSet = createDataSet(U8, 0, EVENT_CHUNK_SIZE, basePath + "/control");
 	 if (!eventsControlDataSet)
@@ -190,7 +193,7 @@ int NWBFile::createFileStructure()
 	 basePath = "/acquisition/timeseries/messages";
 	 basePath = basePath + "/recording" + String(recordingNumber);
 	 if (createGroup(basePath)) return false;
-	 dSet = createRecordingStructures(basePath, singleInfo, "Time-stamped annotations about an experiment", EVENT_CHUNK_SIZE, "AnnotationSeries");
+	 dSet = createRecordingStructures(basePath, singleInfo, "Time-stamped annotations about an experiment", EVENT_CHUNK_SIZE, "AnnotationSeries", true);
 	 messagesDataSetTS = dSet;
 	 basePath += "/data";
 	 messagesBasePath = basePath;
@@ -228,7 +231,9 @@ int NWBFile::createFileStructure()
 	 CHECK_ERROR(setAttribute(I32, &numMessages, messagesBasePath, "num_samples"));
 
 	 continuousDataSets.clear();
-	 continuousDataSetsTS.clear();
+	 continuousStartTimes.clear();
+	 continuousSegmentIndexes.clear();
+	 continuousSegmentTimes.clear();
 	 continuousBasePaths.clear();
 	 numContinuousSamples.clear();
 
@@ -263,12 +268,16 @@ int NWBFile::createFileStructure()
 		 numContinuousSamples.set(datasetID, numContinuousSamples[datasetID] + nSamples);
  }
 
- void NWBFile::writeTimestamps(int datasetID, int nSamples, const double* data)
+ void NWBFile::writeSegmentStart(int datasetID, double startTime)
  {
-	 if (!continuousDataSetsTS[datasetID])
+	 if (!continuousSegmentIndexes[datasetID] || !continuousSegmentTimes[datasetID])
 		 return;
 
-	 CHECK_ERROR(continuousDataSetsTS[datasetID]->writeDataBlock(nSamples, F64, data));
+	 uint64 index = numContinuousSamples[datasetID];
+	 if (index == 0 && continuousStartTimes[datasetID])
+		 CHECK_ERROR(continuousStartTimes[datasetID]->writeDataBlock(1, F64, &startTime));
+	 CHECK_ERROR(continuousSegmentIndexes[datasetID]->writeDataBlock(1, U64, &index));
+	 CHECK_ERROR(continuousSegmentTimes[datasetID]->writeDataBlock(1, F64, &startTime));
  }
 
  void NWBFile::writeSpike(int electrodeId, const uint16* data, uint64 timestamp)
@@ -278,9 +287,9 @@ int NWBFile::createFileStructure()
 	 int totValues = spikeInfoStructs[electrodeId].nChannels * spikeInfoStructs[electrodeId].nSamplesPerSpike;
 	 for (int i = 0; i < totValues; i++)
 		 transformBlock[i] = data[i] - 32768;
-	 CHECK_ERROR(spikeDataSets[electrodeId]->writeDataBlock(1, I16, transformBlock));
+	 CHECK_ERROR(spikeDataSets[electrodeId]->appendDataBlock(1, I16, transformBlock));
 	 double timestampSec = timestamp / spikeInfoStructs[electrodeId].sampleRate;
-	 CHECK_ERROR(spikeDataSetsTS[electrodeId]->writeDataBlock(1, U64, &timestampSec));
+	 CHECK_ERROR(spikeDataSetsTS[electrodeId]->appendDataBlock(1, U64, &timestampSec));
 	 numSpikes.set(electrodeId, numSpikes[electrodeId] + 1);
 
  }
@@ -288,12 +297,30 @@ int NWBFile::createFileStructure()
  void NWBFile::writeTTLEvent(int channel, int id, uint8 source, uint64 timestamp)
  {
 	 int8 data = id != 0 ? channel : -channel;
-	 CHECK_ERROR(eventsDataSet->writeDataBlock(1, I8, &data));
-	 CHECK_ERROR(eventsDataSetTS->writeDataBlock(1, U64, &timestamp));
-	 CHECK_ERROR(eventsControlDataSet->writeDataBlock(1, U8, &source));
+	 CHECK_ERROR(eventsDataSet->appendDataBlock(1, I8, &data));
+	 CHECK_ERROR(eventsDataSetTS->appendDataBlock(1, U64, &timestamp));
+	 CHECK_ERROR(eventsControlDataSet->appendDataBlock(1, U8, &source));
 	 numEvents += 1;
  }
 
+ void NWBFile::flushEventsAndSpikes()
+ {
+	 int nObjs = spikeDataSets.size();
+	 for (int i = 0; i < nObjs; i++)
+	 {
+		 if (!spikeDataSets[i])
+			 continue;
+		 CHECK_ERROR(spikeDataSets[i]->flushAppends());
+		 CHECK_ERROR(spikeDataSetsTS[i]->flushAppends());
+	 }
+	 if (eventsDataSet)
+	 {
+		 CHECK_ERROR(eventsDataSet->flushAppends());
+		 CHECK_ERROR(eventsDataSetTS->flushAppends());
+		 CHECK_ERROR(eventsControlDataSet->flushAppends());
+	 }
+ }
+
  void NWBFile::writeMessage(const char* msg, uint64 timestamp)
  {
 	 CHECK_ERROR(messagesDataSet->writeDataBlock(1, STR, msg));
@@ -306,7 +333,7 @@ int NWBFile::createFileStructure()
 	 return filename;
  }
 
-  HDF5RecordingData* NWBFile::createRecordingStructures(String basePath, const NWBRecordingInfo& info, String helpText, int chunk_size, String ancestry)
+  HDF5RecordingData* NWBFile::createRecordingStructures(String basePath, const NWBRecordingInfo& info, String helpText, int chunk_size, String ancestry, bool perSampleTimestamps)
  {
 	 StringArray ancestryStrings;
 	 ancestryStrings.add("TimeSeries");
@@ -317,6 +344,8 @@ int NWBFile::createFileStructure()
 	 CHECK_ERROR(setAttributeStr("TimeSeries", basePath, "neurodata_type"));
 	 CHECK_ERROR(setAttributeStr(info.sourceName, basePath, "source"));
 	 CHECK_ERROR(setAttributeStr(helpText, basePath, "help"));
+	 if (!perSampleTimestamps) //continuous timing is stored as starting_time and segments instead
+		 return nullptr;
 	 HDF5RecordingData* tsSet = createDataSet(HDF5FileBase::F64, 0, chunk_size, basePath + "/timestamps");
 	 if (!tsSet)
 		 std::cerr << "Error creating timestamp dataset for " << info.processorId << std::endl;
@@ -330,6 +359,44 @@ int NWBFile::createFileStructure()
 
  }
  
+  void NWBFile::createSegmentStructures(String basePath, const NWBRecordingInfo& info)
+  {
+	  /* Continuous data is sampled at a fixed rate, so instead of one timestamp per sample we store
+	     starting_time and rate, plus the first sample index and time of every contiguous segment.
+	     A new segment only starts when there is a gap in the timestamps, such as dropped blocks */
+	  HDF5RecordingData* dSet;
+	  String path = basePath + "/starting_time";
+	  dSet = createDataSet(F64, 1, 0, path);
+	  continuousStartTimes.add(dSet);
+	  if (!dSet)
+		  std::cerr << "Error creating starting time dataset for " << info.processorId << std::endl;
+	  else
+	  {
+		  float rate = info.sampleRate;
+		  CHECK_ERROR(setAttribute(F32, &rate, path, "rate"));
+		  CHECK_ERROR(setAttributeStr("Seconds", path, "unit"));
+	  }
+
+	  path = basePath + "/segment_start_index";
+	  dSet = createDataSet(U64, 0, EVENT_CHUNK_SIZE, path);
+	  continuousSegmentIndexes.add(dSet);
+	  if (!dSet)
+		  std::cerr << "Error creating segment index dataset for " << info.processorId << std::endl;
+	  else
+		  CHECK_ERROR(setAttributeStr("Index in data of the first sample of each contiguous segment", path, "description"));
+
+	  path = basePath + "/segment_start_time";
+	  dSet = createDataSet(F64, 0, EVENT_CHUNK_SIZE, path);
+	  continuousSegmentTimes.add(dSet);
+	  if (!dSet)
+		  std::cerr << "Error creating segment time dataset for " << info.processorId << std::endl;
+	  else
+	  {
+		  CHECK_ERROR(setAttributeStr("Time of the first sample of each contiguous segment", path, "description"));
+		  CHECK_ERROR(setAttributeStr("Seconds", path, "unit"));
+	  }
+  }
+
   void NWBFile::createTextDataSet(String path, String name, String text)
   {
 	  ScopedPointer<HDF5RecordingData> dSet;
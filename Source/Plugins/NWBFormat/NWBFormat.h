@@ -39,6 +39,7 @@ namespace NWBRecording
 		int nChannels;
 		int nSamplesPerSpike;
 		float sampleRate;
+		int decimation;
 		String spikeElectrodeName;
 	};
 
@@ -50,9 +51,12 @@ namespace NWBRecording
 		bool startNewRecording(int recordingNumber, const Array<NWBRecordingInfo>& continuousArray, const Array<NWBRecordingInfo>& electrodeArray);
 		void stopRecording();
 		void writeData(int datasetID, int channel, int nSamples, const int16* data);
-		void writeTimestamps(int datasetID, int nSamples, const double* data);
+		/** Starts a contiguous segment at the next sample of a continuous dataset */
+		void writeSegmentStart(int datasetID, double startTime);
 		void writeSpike(int electrodeId, const uint16* data, uint64 timestamp);
 		void writeTTLEvent(int channel, int id, uint8 source, uint64 timestamp);
+		/** TTL events and spikes are buffered per dataset until this is called */
+		void flushEventsAndSpikes();
 		void writeMessage(const char* msg, uint64 timestamp);
 		String getFileName() override;
 		void setXmlText(const String& xmlText);
@@ -61,14 +65,19 @@ namespace NWBRecording
 		int createFileStructure() override;
 
 	private:
-		HDF5RecordingData* createRecordingStructures(String basePath, const NWBRecordingInfo& info, String helpText, int chunk_size, String ancestry);
+		/** Sets the TimeSeries attributes of basePath. If perSampleTimestamps is set, also creates
+		and returns its timestamps dataset, chunked by chunk_size; otherwise returns nullptr. */
+		HDF5RecordingData* createRecordingStructures(String basePath, const NWBRecordingInfo& info, String helpText, int chunk_size, String ancestry, bool perSampleTimestamps);
+		void createSegmentStructures(String basePath, const NWBRecordingInfo& info);
 		void createTextDataSet(String path, String name, String text);
 
 		const String filename;
 		const String GUIVersion;
 
 		OwnedArray<HDF5RecordingData> continuousDataSets;
-		OwnedArray<HDF5RecordingData> continuousDataSetsTS;
+		OwnedArray<HDF5RecordingData> continuousStartTimes;
+		OwnedArray<HDF5RecordingData> continuousSegmentIndexes;
+		OwnedArray<HDF5RecordingData> continuousSegmentTimes;
 		StringArray continuousBasePaths;
 		Array<uint64> numContinuousSamples;
 		Array<NWBRecordingInfo> continuousInfoStructs;
@@ -28,9 +28,7 @@
  
  NWBRecordEngine::NWBRecordEngine() : bufferSize(MAX_BUFFER_SIZE)
  {
-	 scaledBuffer.malloc(MAX_BUFFER_SIZE);
 	 intBuffer.malloc(MAX_BUFFER_SIZE);
-	 tsBuffer.malloc(MAX_BUFFER_SIZE);
  }
  
  NWBRecordEngine::~NWBRecordEngine()
@@ -56,7 +54,8 @@
 	 datasetIndexes.insertMultiple(0, 0, getNumRecordedChannels());
 	 writeChannelIndexes.insertMultiple(0, 0, getNumRecordedChannels());
 	 
-	 //Generate the continuous datasets info array, seeking for different combinations of recorded processor and source processor
+	 //Generate the continuous datasets info array, seeking for different combinations of recorded processor and source processor.
+	 //Each record rate of a processor has its own entry in the processor info, and so its own datasets
 	 int lastId = 0;
 	 for (int proc = 0; proc < recProcs; proc++)
 	 {
@@ -88,7 +87,8 @@
 				 recInfo.bitVolts = channelInfo->bitVolts;
 				 recInfo.nChannels = 1;
 				 recInfo.processorId = procInfo.processorId;
-				 recInfo.sampleRate = channelInfo->sampleRate;
+				 recInfo.sampleRate = channelInfo->getRecordSampleRate();
+				 recInfo.decimation = procInfo.decimation;
 				 recInfo.sourceName = "processor_(" + String(sourceId) + ")"; //TODO: add a way to get the actual processor name
 				 recInfo.sourceId = sourceId;
 				 recInfo.spikeElectrodeName = " ";
@@ -101,9 +101,10 @@
 		 }
 		 lastId = continuousInfo.size();
 	 }
+	 expectedTimestamps.insertMultiple(0, -1, continuousInfo.size());
 
 	 //open the file
-	 recordFile->open(getNumRecordedChannels() + continuousInfo.size()); //total channels + timestamp arrays, to create a big enough buffer
+	 recordFile->open(getNumRecordedChannels()); //total channels, to size the chunk cache for the continuous data
 
 	 //create the recording
 	 recordFile->startNewRecording(recordingNumber, continuousInfo, spikeInfo);
@@ -134,9 +135,8 @@
 	 continuousInfo.clear();
 	 datasetIndexes.clear();
 	 writeChannelIndexes.clear();
-	 scaledBuffer.malloc(MAX_BUFFER_SIZE);
+	 expectedTimestamps.clear();
 	 intBuffer.malloc(MAX_BUFFER_SIZE);
-	 tsBuffer.malloc(MAX_BUFFER_SIZE);
 	 bufferSize = MAX_BUFFER_SIZE;
  }
  
@@ -146,37 +146,53 @@
 	 {
 		 std::cerr << "Write buffer overrun, resizing to" << size << std::endl;
 		 bufferSize = size;
-		 scaledBuffer.malloc(size);
 		 intBuffer.malloc(size);
-		 tsBuffer.malloc(size);
 	 }
 
-	 double multFactor = 1 / (float(0x7fff) * getChannel(realChannel)->bitVolts);
-	 FloatVectorOperations::copyWithMultiply(scaledBuffer.getData(), buffer, multFactor, size);
-	 AudioDataConverters::convertFloatToInt16LE(scaledBuffer.getData(), intBuffer.getData(), size);
+	 convertToInt16(intBuffer.getData(), buffer, 1 / (float(0x7fff) * getChannel(realChannel)->bitVolts), size);
+	 writeIntegerData(writeChannel, realChannel, intBuffer.getData(), size);
+ }
 
-	 recordFile->writeData(datasetIndexes[writeChannel], writeChannelIndexes[writeChannel], size, intBuffer.getData());
+ bool NWBRecordEngine::acceptsIntegerData() const
+ {
+	 return true;
+ }
 
+ void NWBRecordEngine::writeIntegerData(int writeChannel, int realChannel, const int16* buffer, int size)
+ {
 	 /* All channels in a dataset have the same number of samples and share timestamps. But since this method is called 
-		asynchronously, the timestamps might not be in sync during acquisition, so we chose a channel and write the
-		timestamps when writing that channel's data */
+		asynchronously, the timestamps might not be in sync during acquisition, so we chose a channel and check the
+		timestamps when writing that channel's data. Only the start of each contiguous segment is stored */
+	 int datasetID = datasetIndexes[writeChannel];
 	 if (writeChannelIndexes[writeChannel] == 0)
 	 {
 		 int64 baseTS = getTimestamp(writeChannel);
-		 double fs = getChannel(realChannel)->sampleRate;
-		 //Let's hope that the compiler is smart enough to vectorize this. 
-		 for (int i = 0; i < size; i++)
+		 if (baseTS != expectedTimestamps[datasetID])
 		 {
-			 tsBuffer[i] = (baseTS + i) / fs;
+			 double fs = getChannel(realChannel)->getRecordSampleRate();
+			 recordFile->writeSegmentStart(datasetID, baseTS / fs);
 		 }
-		 recordFile->writeTimestamps(datasetIndexes[writeChannel], size, tsBuffer);
+		 expectedTimestamps.set(datasetID, baseTS + size);
 	 }
-		 
+
+	 recordFile->writeData(datasetID, writeChannelIndexes[writeChannel], size, buffer);
+
  }
  
+void NWBRecordEngine::endChannelBlock(bool lastBlock)
+{
+	//Events and spikes from the previous block go out in one write per dataset
+	if (recordFile)
+		recordFile->flushEventsAndSpikes();
+}
+
 void NWBRecordEngine::writeEvent(int eventType, const MidiMessage& event, int64 timestamp) 
 {
-	const uint8* dataptr = event.getRawData();
+	writeEventData(eventType, event.getRawData(), event.getRawDataSize(), timestamp);
+}
+
+void NWBRecordEngine::writeEventData(int eventType, const uint8* dataptr, int size, int64 timestamp)
+{
 	if (eventType == GenericProcessor::TTL)
 	{
 		recordFile->writeTTLEvent(*(dataptr + 3), *(dataptr + 2), *(dataptr + 1), timestamp);
@@ -204,6 +220,7 @@ void NWBRecordEngine::addSpikeElectrode(int index,const  SpikeRecordInfo* elec)
 	info.processorId = currentSpikeProc;
 	info.sourceId = currentSpikeProc;
 	info.sampleRate = elec->sampleRate;
+	info.decimation = 1;
 	info.sourceName = currentSpikeProcName + "_(" + String(currentSpikeProc) + ")";
 	info.spikeElectrodeName = elec->name;
 	spikeInfo.add(info);
@@ -38,7 +38,11 @@
 			void openFiles(File rootFolder, int experimentNumber, int recordingNumber) override;
 			void closeFiles() override;
 			void writeData(int writeChannel, int realChannel, const float* buffer, int size) override;
+			bool acceptsIntegerData() const override;
+			void writeIntegerData(int writeChannel, int realChannel, const int16* buffer, int size) override;
+			void endChannelBlock(bool lastBlock) override;
 			void writeEvent(int eventType, const MidiMessage& event, int64 timestamp) override;
+			void writeEventData(int eventType, const uint8* data, int size, int64 timestamp) override;
 			void registerSpikeSource(GenericProcessor* proc) override;
 			void addSpikeElectrode(int index,const  SpikeRecordInfo* elec) override;
 			void writeSpike(int electrodeIndex, const SpikeObject& spike, int64 timestamp) override;
@@ -58,9 +62,8 @@
 			Array<int> datasetIndexes;
 			Array<int> writeChannelIndexes;
 
-			HeapBlock<float> scaledBuffer;
 			HeapBlock<int16> intBuffer;
-			HeapBlock<double> tsBuffer;
+			Array<int64> expectedTimestamps;
 			int bufferSize;
 
 			String identifierText;
@@ -178,8 +178,15 @@ void PhaseDetector::process (AudioSampleBuffer& buffer, MidiBuffer& events)
 {
     checkForEvents (events);
 
+    // modules don't share any state, so they can run on separate threads
+    processChannelsInParallel (modules.size(), buffer, events);
+}
+
+
+void PhaseDetector::processChannelRange (int firstModule, int lastModule, AudioSampleBuffer& buffer, MidiBuffer& events)
+{
     // loop through the modules
-    for (int i = 0; i < modules.size(); ++i)
+    for (int i = firstModule; i < lastModule; ++i)
     {
         DetectorModule& module = modules.getReference (i);
 
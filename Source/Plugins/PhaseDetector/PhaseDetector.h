@@ -60,6 +60,8 @@ public:
 private:
     void handleEvent (int eventType, MidiMessage& event, int sampleNum) override;
 
+    void processChannelRange (int firstModule, int lastModule, AudioSampleBuffer& buffer, MidiBuffer& events) override;
+
     void estimateFrequency();
 
     enum ModuleType
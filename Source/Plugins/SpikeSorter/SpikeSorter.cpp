@@ -638,6 +638,21 @@ void SpikeSorter::setParameter(int parameterIndex, float newValue)
 }
 
 
+int SpikeSorter::getEventBufferReserve(int maxBlockSamples) const
+{
+    int numBytes = GenericProcessor::getEventBufferReserve(maxBlockSamples);
+
+    // detection resumes postPeakSamples after each peak
+    for (int i = 0; i < electrodes.size(); i++)
+    {
+        const int maxSpikes = maxBlockSamples / (electrodes[i]->postPeakSamples + 1) + 1;
+        numBytes += maxSpikes * (MAX_SPIKE_BUFFER_LEN + 6);
+    }
+
+    return numBytes;
+}
+
+
 bool SpikeSorter::enable()
 {
 
@@ -693,7 +708,7 @@ void SpikeSorter::addSpikeEvent(SpikeObject* s, MidiBuffer& eventBuffer, int pea
                              MAX_SPIKE_BUFFER_LEN);    // int
 
     if (numBytes > 0)
-        eventBuffer.addEvent(spikeBuffer, numBytes, peakIndex);
+        addEventData(eventBuffer, spikeBuffer, numBytes, peakIndex);
 
     //std::cout << "Adding spike" << std::endl;
 }
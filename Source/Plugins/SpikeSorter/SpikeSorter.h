@@ -242,6 +242,9 @@ public:
     /** Called after acquisition is finished. */
     bool disable();
 
+    /** Room for every electrode to spike as often as its waveform length allows. */
+    int getEventBufferReserve(int maxBlockSamples) const override;
+
 
     bool isReady();
     /** Creates the SpikeSorterEditor. */
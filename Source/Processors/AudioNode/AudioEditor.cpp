@@ -222,6 +222,7 @@ void AudioEditor::buttonClicked (Button* button)
             }
 
             AccessClass::getAudioComponent()->restartDevice();
+            static_cast<AudioSettingsComponent*> (audioConfigurationWindow->getContentComponent())->updateControls();
             audioConfigurationWindow->setVisible (true);
         }
         else
@@ -279,20 +280,33 @@ void AudioEditor::loadStateFromXml (XmlElement* xml)
 }
 
 
-AudioConfigurationWindow::AudioConfigurationWindow (AudioDeviceManager& adm, AudioWindowButton* cButton)
-    : DocumentWindow ("Audio Settings",
-                      Colours::red,
-                      DocumentWindow::closeButton)
-    , controlButton (cButton)
-
+AudioSettingsComponent::AudioSettingsComponent (AudioDeviceManager& adm)
 {
-    centreWithSize (360,500);
-    setUsingNativeTitleBar (true);
-    setResizable (false,false);
+    internalClockButton = new ToggleButton ("Use internal processing clock");
+    internalClockButton->setTooltip ("Process data as soon as the source delivers it, instead of on audio device callbacks");
+    internalClockButton->addListener (this);
+    addAndMakeVisible (internalClockButton);
+
+    monitorButton = new ToggleButton ("Send output to the audio device");
+    monitorButton->setTooltip ("Keep audio monitoring while the internal clock drives processing");
+    monitorButton->addListener (this);
+    addAndMakeVisible (monitorButton);
+
+    blockSizeLabel = new Label ("Block size label", "Block size (samples):");
+    addAndMakeVisible (blockSizeLabel);
+
+    blockSizeSelector = new ComboBox ("Block size");
+    blockSizeSelector->setEditableText (true);
+
+    for (int size = 64; size <= 4096; size *= 2)
+        blockSizeSelector->addItem (String (size), size);
+
+    blockSizeSelector->addListener (this);
+    addAndMakeVisible (blockSizeSelector);
 
     //std::cout << "Audio CPU usage:" << adm.getCpuUsage() << std::endl;
 
-    AudioDeviceSelectorComponent* adsc = new AudioDeviceSelectorComponent
+    deviceSelector = new AudioDeviceSelectorComponent
         (adm,
          0, // minAudioInputChannels
          2, // maxAudioInputChannels
@@ -302,10 +316,82 @@ AudioConfigurationWindow::AudioConfigurationWindow (AudioDeviceManager& adm, Aud
          false, // showMidiOutputSelector
          false, // showChannelsAsStereoPairs
          false); // hideAdvancedOptionsWithButton
+    addAndMakeVisible (deviceSelector);
+
+    updateControls();
+}
+
+
+AudioSettingsComponent::~AudioSettingsComponent()
+{
+}
+
+
+void AudioSettingsComponent::resized()
+{
+    internalClockButton->setBounds  (15, 10, getWidth() - 30, 22);
+    monitorButton->setBounds        (35, 35, getWidth() - 50, 22);
+    blockSizeLabel->setBounds       (35, 62, 140, 22);
+    blockSizeSelector->setBounds    (175, 62, 90, 22);
+    deviceSelector->setBounds       (0, 95, getWidth(), getHeight() - 95);
+}
+
+
+void AudioSettingsComponent::updateControls()
+{
+    AudioComponent* audio = AccessClass::getAudioComponent();
+    const bool internalClock = ! audio->isUsingAudioDevice();
+
+    internalClockButton->setToggleState (internalClock, dontSendNotification);
+    monitorButton->setToggleState (audio->isAudioMonitoringEnabled(), dontSendNotification);
+    blockSizeSelector->setText (String (audio->getBufferSize()), dontSendNotification);
+
+    // with the audio device as the clock, its own buffer size below is used instead
+    monitorButton->setEnabled (internalClock);
+    blockSizeLabel->setEnabled (internalClock);
+    blockSizeSelector->setEnabled (internalClock);
+}
+
+
+void AudioSettingsComponent::buttonClicked (Button* button)
+{
+    AudioComponent* audio = AccessClass::getAudioComponent();
+
+    if (button == internalClockButton)
+        audio->setUseAudioDevice (! internalClockButton->getToggleState());
+    else if (button == monitorButton)
+        audio->setAudioMonitoring (monitorButton->getToggleState());
+
+    // the settings can be refused, e.g. without an audio device
+    updateControls();
+}
+
+
+void AudioSettingsComponent::comboBoxChanged (ComboBox* comboBox)
+{
+    if (comboBox == blockSizeSelector)
+    {
+        AccessClass::getAudioComponent()->setBufferSize (blockSizeSelector->getText().getIntValue());
+        updateControls();
+    }
+}
+
+
+AudioConfigurationWindow::AudioConfigurationWindow (AudioDeviceManager& adm, AudioWindowButton* cButton)
+    : DocumentWindow ("Audio Settings",
+                      Colours::red,
+                      DocumentWindow::closeButton)
+    , controlButton (cButton)
+
+{
+    centreWithSize (360,595);
+    setUsingNativeTitleBar (true);
+    setResizable (false,false);
 
-    adsc->setBounds (0, 0, 450, 440);
+    AudioSettingsComponent* settings = new AudioSettingsComponent (adm);
+    settings->setBounds (0, 0, 450, 535);
 
-    setContentOwned (adsc, true);
+    setContentOwned (settings, true);
     setVisible (false);
 }
 
@@ -68,6 +68,43 @@ private:
 };
 
 
+/**
+  Selects what clocks the ProcessorGraph, and shows the audio device settings below.
+
+  With the internal clock, the block size and whether the output still reaches
+  the audio device can be changed here.
+
+  @see AudioComponent, AudioConfigurationWindow
+
+*/
+class AudioSettingsComponent : public Component
+                             , public Button::Listener
+                             , public ComboBox::Listener
+{
+public:
+    AudioSettingsComponent (AudioDeviceManager& adm);
+    ~AudioSettingsComponent();
+
+    void resized() override;
+
+    void buttonClicked (Button* button) override;
+    void comboBoxChanged (ComboBox* comboBox) override;
+
+    /** Updates the controls from the current AudioComponent settings. */
+    void updateControls();
+
+
+private:
+    ScopedPointer<ToggleButton> internalClockButton;
+    ScopedPointer<ToggleButton> monitorButton;
+    ScopedPointer<Label>        blockSizeLabel;
+    ScopedPointer<ComboBox>     blockSizeSelector;
+
+    ScopedPointer<AudioDeviceSelectorComponent> deviceSelector;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioSettingsComponent);
+};
+
 /**
   Allows the user to access audio output settings.
 
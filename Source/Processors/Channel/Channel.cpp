@@ -47,6 +47,7 @@ void Channel::reset()
     z = 0.0f;
     impedance = 0.0f;
     isRecording = false;
+    recordDecimation = 1;
 
 }
 
@@ -73,6 +74,7 @@ Channel::Channel(const Channel& ch)
 	extraData = ch.extraData;
 
     setRecordState(false);
+    recordDecimation = 1;
 }
 
 float Channel::getBitVolts()
@@ -154,6 +156,21 @@ bool Channel::getRecordState()
 	return isRecording;
 }
 
+void Channel::setRecordDecimation(int factor)
+{
+    recordDecimation = jmax(1, factor);
+}
+
+int Channel::getRecordDecimation() const
+{
+    return recordDecimation;
+}
+
+float Channel::getRecordSampleRate() const
+{
+    return sampleRate / float(recordDecimation);
+}
+
 ChannelExtraData::ChannelExtraData(void* ptr, int size)
 	: dataPtr(ptr), dataSize(size)
 {
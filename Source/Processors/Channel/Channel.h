@@ -91,6 +91,16 @@ public:
     /** Sets whether or not the channel will record. */
 	bool getRecordState();
 
+    /** Sets the factor the channel is decimated by when recorded, so it's written to disk
+        at sampleRate / factor. 1 (the default) records it at full rate. */
+    void setRecordDecimation(int factor);
+
+    /** Returns the factor the channel is decimated by when recorded. */
+    int getRecordDecimation() const;
+
+    /** Returns the sample rate the channel is written to disk at. */
+    float getRecordSampleRate() const;
+
     /** Sets the bitVolts value for this channel. */
     void setBitVolts(float bitVolts);
 
@@ -163,6 +173,9 @@ private:
     /** Stores whether or not the channel is being recorded. */
     bool isRecording;
 
+    /** Decimation factor applied when recording. */
+    int recordDecimation;
+
     /** Generates a default name, based on the channel number. */
     void createDefaultName();
 
@@ -22,11 +22,81 @@
 
 #include "DataBuffer.h"
 
+#if JUCE_INTEL
+ #include <xmmintrin.h>
+#endif
+
+
+namespace
+{
+    /** Copies numFrames interleaved frames of numChans values into per-channel rows,
+        starting at destStart. Works on tiles of frames so the destination rows stay in
+        cache, and transposes 4x4 blocks in registers where SSE is available. */
+    void transposeFrames (const float* src, int numChans, float* const* dest, int destStart, int numFrames)
+    {
+        const int tileSize = 64;
+
+        for (int tileStart = 0; tileStart < numFrames; tileStart += tileSize)
+        {
+            const int n = jmin (tileSize, numFrames - tileStart);
+            const float* tile = src + tileStart * numChans;
+            int chan = 0;
+
+           #if JUCE_INTEL
+            for (; chan + 4 <= numChans; chan += 4)
+            {
+                float* d0 = dest[chan]     + destStart + tileStart;
+                float* d1 = dest[chan + 1] + destStart + tileStart;
+                float* d2 = dest[chan + 2] + destStart + tileStart;
+                float* d3 = dest[chan + 3] + destStart + tileStart;
+                const float* s = tile + chan;
+                int i = 0;
+
+                for (; i + 4 <= n; i += 4)
+                {
+                    __m128 r0 = _mm_loadu_ps (s + (i)     * numChans);
+                    __m128 r1 = _mm_loadu_ps (s + (i + 1) * numChans);
+                    __m128 r2 = _mm_loadu_ps (s + (i + 2) * numChans);
+                    __m128 r3 = _mm_loadu_ps (s + (i + 3) * numChans);
+
+                    _MM_TRANSPOSE4_PS (r0, r1, r2, r3);
+
+                    _mm_storeu_ps (d0 + i, r0);
+                    _mm_storeu_ps (d1 + i, r1);
+                    _mm_storeu_ps (d2 + i, r2);
+                    _mm_storeu_ps (d3 + i, r3);
+                }
+
+                for (; i < n; ++i)
+                {
+                    const float* frame = s + i * numChans;
+                    d0[i] = frame[0];
+                    d1[i] = frame[1];
+                    d2[i] = frame[2];
+                    d3[i] = frame[3];
+                }
+            }
+           #endif
+
+            for (; chan < numChans; ++chan)
+            {
+                float* d = dest[chan] + destStart + tileStart;
+                const float* s = tile + chan;
+
+                for (int i = 0; i < n; ++i)
+                    d[i] = s[i * numChans];
+            }
+        }
+    }
+}
+
 
 DataBuffer::DataBuffer (int chans, int size)
     : abstractFifo  (size)
     , buffer        (chans, size)
     , numChans      (chans)
+    , highWaterMark (0)
+    , droppedSamples (0)
 {
     timestampBuffer.malloc (size);
     eventCodeBuffer.malloc (size);
@@ -40,6 +110,8 @@ void DataBuffer::clear()
 {
     buffer.clear();
     abstractFifo.reset();
+    highWaterMark = 0;
+    droppedSamples = 0;
 }
 
 
@@ -55,6 +127,9 @@ void DataBuffer::resize (int chans, int size)
 
 int DataBuffer::addToBuffer (float* data, int64* timestamps, uint64* eventCodes, int numItems, int chunkSize)
 {
+    if (chunkSize == 1)
+        return addToBufferSampleMajor (data, timestamps, eventCodes, numItems);
+
     int startIndex1, blockSize1, startIndex2, blockSize2;
 
     abstractFifo.prepareToWrite (numItems, startIndex1, blockSize1, startIndex2, blockSize2);
@@ -91,14 +166,125 @@ int DataBuffer::addToBuffer (float* data, int64* timestamps, uint64* eventCodes,
 
     // finish write
     abstractFifo.finishedWrite (idx);
+    updateStatistics (numItems, idx);
+
+    dataAvailable.signal();
 
     return idx;
 }
 
 
+int DataBuffer::addToBufferChannelMajor (const float* const* channelData, const int64* timestamps,
+                                         const uint64* eventCodes, int numItems)
+{
+    int startIndex1, blockSize1, startIndex2, blockSize2;
+
+    abstractFifo.prepareToWrite (numItems, startIndex1, blockSize1, startIndex2, blockSize2);
+
+    for (int chan = 0; chan < numChans; ++chan)
+    {
+        if (blockSize1 > 0)
+            FloatVectorOperations::copy (buffer.getWritePointer (chan, startIndex1), channelData[chan], blockSize1);
+
+        if (blockSize2 > 0)
+            FloatVectorOperations::copy (buffer.getWritePointer (chan, startIndex2), channelData[chan] + blockSize1, blockSize2);
+    }
+
+    copyTimestampsAndEvents (startIndex1, timestamps, eventCodes, blockSize1);
+    copyTimestampsAndEvents (startIndex2, timestamps + blockSize1,
+                             eventCodes != nullptr ? eventCodes + blockSize1 : nullptr, blockSize2);
+
+    abstractFifo.finishedWrite (blockSize1 + blockSize2);
+    updateStatistics (numItems, blockSize1 + blockSize2);
+
+    dataAvailable.signal();
+
+    return blockSize1 + blockSize2;
+}
+
+
+int DataBuffer::addToBufferSampleMajor (const float* data, const int64* timestamps,
+                                        const uint64* eventCodes, int numItems)
+{
+    int startIndex1, blockSize1, startIndex2, blockSize2;
+
+    abstractFifo.prepareToWrite (numItems, startIndex1, blockSize1, startIndex2, blockSize2);
+
+    float* const* dest = buffer.getArrayOfWritePointers();
+
+    if (blockSize1 > 0)
+        transposeFrames (data, numChans, dest, startIndex1, blockSize1);
+
+    if (blockSize2 > 0)
+        transposeFrames (data + blockSize1 * numChans, numChans, dest, startIndex2, blockSize2);
+
+    copyTimestampsAndEvents (startIndex1, timestamps, eventCodes, blockSize1);
+    copyTimestampsAndEvents (startIndex2, timestamps + blockSize1,
+                             eventCodes != nullptr ? eventCodes + blockSize1 : nullptr, blockSize2);
+
+    abstractFifo.finishedWrite (blockSize1 + blockSize2);
+    updateStatistics (numItems, blockSize1 + blockSize2);
+
+    dataAvailable.signal();
+
+    return blockSize1 + blockSize2;
+}
+
+
+void DataBuffer::copyTimestampsAndEvents (int destStart, const int64* timestamps, const uint64* eventCodes, int numItems)
+{
+    if (numItems <= 0)
+        return;
+
+    memcpy (timestampBuffer + destStart, timestamps, numItems * sizeof (int64));
+
+    if (eventCodes != nullptr)
+        memcpy (eventCodeBuffer + destStart, eventCodes, numItems * sizeof (uint64));
+    else
+        zeromem (eventCodeBuffer + destStart, numItems * sizeof (uint64));
+}
+
+
+void DataBuffer::updateStatistics (int numItems, int numWritten)
+{
+    if (numWritten < numItems)
+        droppedSamples.fetch_add (numItems - numWritten, std::memory_order_relaxed);
+
+    // only the data thread writes, so there's no need for a compare-exchange loop
+    const int fill = abstractFifo.getNumReady();
+    if (fill > highWaterMark.load (std::memory_order_relaxed))
+        highWaterMark.store (fill, std::memory_order_relaxed);
+}
+
+
 int DataBuffer::getNumSamples() const { return abstractFifo.getNumReady(); }
 
 
+int DataBuffer::getBufferSize() const { return abstractFifo.getTotalSize(); }
+
+
+int DataBuffer::getHighWaterMark() const { return highWaterMark.load (std::memory_order_relaxed); }
+
+
+int64 DataBuffer::getNumDroppedSamples() const { return droppedSamples.load (std::memory_order_relaxed); }
+
+
+bool DataBuffer::waitForSamples (int numSamples, int timeOutMs)
+{
+    const uint32 deadline = Time::getMillisecondCounter() + (uint32) timeOutMs;
+
+    while (abstractFifo.getNumReady() < numSamples)
+    {
+        const int remaining = (int) (deadline - Time::getMillisecondCounter());
+
+        if (remaining <= 0 || ! dataAvailable.wait (remaining))
+            return abstractFifo.getNumReady() >= numSamples;
+    }
+
+    return true;
+}
+
+
 int DataBuffer::readAllFromBuffer (AudioSampleBuffer& data, uint64* timestamp, uint64* eventCodes, int maxSize)
 {
     // check to see if the maximum size is smaller than the total number of available ints
@@ -152,3 +338,54 @@ int DataBuffer::readAllFromBuffer (AudioSampleBuffer& data, uint64* timestamp, u
 
     return numItems;
 }
+
+
+// ==================================================================
+
+FrameBlock::FrameBlock()
+    : numChans  (0)
+    , maxFrames (0)
+    , numFrames (0)
+{
+}
+
+
+void FrameBlock::setSize (int numChannels, int maxFrames_)
+{
+    numChans  = numChannels;
+    maxFrames = maxFrames_;
+    numFrames = 0;
+
+    frames.malloc (jmax (1, numChans * maxFrames));
+    timestamps.malloc (jmax (1, maxFrames));
+    eventCodes.malloc (jmax (1, maxFrames));
+}
+
+
+void FrameBlock::addFrame (int64 timestamp, uint64 eventCode) noexcept
+{
+    jassert (numFrames < maxFrames);
+
+    timestamps[numFrames] = timestamp;
+    eventCodes[numFrames] = eventCode;
+    ++numFrames;
+}
+
+
+void FrameBlock::addFrame (const float* frame, int64 timestamp, uint64 eventCode) noexcept
+{
+    memcpy (getNextFrame(), frame, numChans * sizeof (float));
+    addFrame (timestamp, eventCode);
+}
+
+
+int FrameBlock::writeTo (DataBuffer& buffer)
+{
+    if (numFrames == 0)
+        return 0;
+
+    const int numWritten = buffer.addToBufferSampleMajor (frames, timestamps, eventCodes, numFrames);
+    numFrames = 0;
+
+    return numWritten;
+}
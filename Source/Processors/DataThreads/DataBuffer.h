@@ -25,6 +25,7 @@
 
 #include "../../../JuceLibraryCode/JuceHeader.h"
 #include "../PluginManager/OpenEphysPlugin.h"
+#include <atomic>
 
 
 /**
@@ -55,27 +56,124 @@ public:
     */
     int addToBuffer (float* data, int64* timestamps, uint64* eventCodes, int numItems, int chunkSize=1);
 
+    /** Adds a block of samples stored one channel after another, in a single FIFO write.
+
+        @param channelData One pointer per channel, each to numItems consecutive samples.
+        @param timestamps Array of timestamps. Same length as numItems.
+        @param eventCodes Array of event codes. Same length as numItems, or nullptr for none.
+        @param numItems Number of samples per channel.
+
+        @return The number of samples actually written. May be less than numItems if
+        the buffer doesn't have space.
+    */
+    int addToBufferChannelMajor (const float* const* channelData, const int64* timestamps,
+                                 const uint64* eventCodes, int numItems);
+
+    /** Adds a block of sample frames (all channels of sample 0, then all channels of
+        sample 1, ...) in a single FIFO write, transposing it into the per-channel buffer.
+
+        This is the layout most devices deliver, and the one the old
+        addToBuffer (..., 1) calls were made with one frame at a time.
+
+        @return The number of samples actually written. May be less than numItems if
+        the buffer doesn't have space.
+    */
+    int addToBufferSampleMajor (const float* data, const int64* timestamps,
+                                const uint64* eventCodes, int numItems);
+
     /** Returns the number of samples currently available in the buffer.*/
     int getNumSamples() const;
 
+    /** Blocks until at least numSamples are available or the timeout expires.
+
+        @return true if the requested number of samples is available.
+    */
+    bool waitForSamples (int numSamples, int timeOutMs);
+
     /** Copies as many samples as possible from the DataBuffer to an AudioSampleBuffer.*/
     int readAllFromBuffer (AudioSampleBuffer& data, uint64* ts, uint64* eventCodes, int maxSize);
 
     /** Resizes the data buffer */
     void resize (int chans, int size);
 
+    /** Returns the number of samples per channel the buffer can hold.*/
+    int getBufferSize() const;
+
+    /** Returns the largest number of samples waiting to be read at once since the last clear().*/
+    int getHighWaterMark() const;
+
+    /** Returns the number of samples per channel that didn't fit in the buffer since the last clear().*/
+    int64 getNumDroppedSamples() const;
+
 
 private:
+    void copyTimestampsAndEvents (int destStart, const int64* timestamps, const uint64* eventCodes, int numItems);
+
+    /** Called by the writing thread after every add, with the requested and written sizes.*/
+    void updateStatistics (int numItems, int numWritten);
+
     AbstractFifo abstractFifo;
     AudioSampleBuffer buffer;
 
     HeapBlock<int64> timestampBuffer;
     HeapBlock<uint64> eventCodeBuffer;
 
+    WaitableEvent dataAvailable;
+
     int numChans;
 
+    std::atomic<int> highWaterMark;
+    std::atomic<int64> droppedSamples;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DataBuffer);
 };
 
 
+/**
+    Collects sample frames for data threads that decode their device stream one
+    frame at a time, so that each read ends in one DataBuffer write instead of one
+    per sample.
+
+    See @DataBuffer
+*/
+class PLUGIN_API FrameBlock
+{
+public:
+    FrameBlock();
+
+    /** Allocates room for maxFrames frames of numChannels values and clears the block.*/
+    void setSize (int numChannels, int maxFrames);
+
+    /** Storage for the next frame; fill it and then call addFrame (timestamp, eventCode).*/
+    float* getNextFrame() noexcept                      { return frames + numFrames * numChans; }
+
+    /** Commits the frame written through getNextFrame().*/
+    void addFrame (int64 timestamp, uint64 eventCode) noexcept;
+
+    /** Copies a frame of numChannels values into the block.*/
+    void addFrame (const float* frame, int64 timestamp, uint64 eventCode) noexcept;
+
+    int getNumFrames() const noexcept                   { return numFrames; }
+    bool isFull() const noexcept                        { return numFrames >= maxFrames; }
+
+    /** Writes the collected frames to the buffer and empties the block.
+
+        @return The number of frames the buffer accepted.
+    */
+    int writeTo (DataBuffer& buffer);
+
+
+private:
+    HeapBlock<float> frames;
+    HeapBlock<int64> timestamps;
+    HeapBlock<uint64> eventCodes;
+
+    int numChans;
+    int maxFrames;
+    int numFrames;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FrameBlock);
+};
+
+
 #endif  // __DATABUFFER_H_11C6C591__
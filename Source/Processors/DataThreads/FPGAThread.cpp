@@ -83,6 +83,9 @@ FPGAThread::FPGAThread (SourceNode* sn)
 
     dataBuffer = new DataBuffer (numchannels, 10000);
 
+    // enough for every frame a single read can hold
+    frameBlock.setSize (numchannels, sizeof (pBuffer) / (8 + 2 * Ndatabytes) + 1);
+
     eventCode = 0;
 
     //High-Pass filter
@@ -350,7 +353,10 @@ bool FPGAThread::updateBuffer()
 
             j -= 1; // step back in time
 
-            dataBuffer->addToBuffer (thisSample, &timestamp, &eventCode, 1);
+            if (frameBlock.isFull())
+                frameBlock.writeTo (*dataBuffer);
+
+            frameBlock.addFrame (thisSample, timestamp, eventCode);
 
             // samplesUsed += 200;
         }
@@ -358,6 +364,8 @@ bool FPGAThread::updateBuffer()
         j++; // keep scanning for timecodes
     }
 
+    frameBlock.writeTo (*dataBuffer);
+
     // if (startSample != 0 && bytesToRead > 10000)
     //    bytesToRead -= 2;
     //else
@@ -100,6 +100,7 @@ private:
     bool bufferWasAligned;
 
     float thisSample[256];
+    FrameBlock frameBlock;
 
     int numchannels;
     int Ndatabytes;
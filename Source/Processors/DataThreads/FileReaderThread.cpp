@@ -32,6 +32,7 @@ FileReaderThread::FileReaderThread (SourceNode* sn)
 {
     bufferSize = 1600;
     dataBuffer = new DataBuffer (16, bufferSize * 3);
+    frameBlock.setSize (16, bufferSize / 16);
 
     eventCode = 0;
 
@@ -144,7 +145,7 @@ bool FileReaderThread::updateBuffer()
                 //(4 << 32); // + (3 << 40) + (2 << 48) + (1 << 56);
 
                 //timestamp++; // = timer.getHighResolutionTicks();
-                dataBuffer->addToBuffer (thisSample, &timestamp, &eventCode, 1);
+                frameBlock.addFrame (thisSample, timestamp, eventCode);
                 chan = 0;
             }
             else
@@ -152,6 +153,8 @@ bool FileReaderThread::updateBuffer()
                 chan++;
             }
         }
+
+        frameBlock.writeTo (*dataBuffer);
     }
     else
     {
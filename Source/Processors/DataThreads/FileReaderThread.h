@@ -67,6 +67,7 @@ private:
     FILE* input;
 
     float thisSample[16];
+    FrameBlock frameBlock;
     int16 readBuffer[1600];
 
     int bufferSize;
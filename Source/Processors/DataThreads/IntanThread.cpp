@@ -35,6 +35,8 @@ IntanThread::IntanThread (SourceNode* sn)
     , ch             (-1)
 {
     dataBuffer = new DataBuffer (17,4096);
+    frameBlock.setSize (17, sizeof (buffer) / 3);
+    zeromem (thisSample, sizeof (thisSample));
 
     deviceFound = initializeUSB (true);
 
@@ -256,7 +258,10 @@ bool IntanThread::updateBuffer()
         {
             timestamp = timer.getHighResolutionTicks();
 
-            dataBuffer->addToBuffer (thisSample, &timestamp, &eventCode, 1);
+            if (frameBlock.isFull())
+                frameBlock.writeTo (*dataBuffer);
+
+            frameBlock.addFrame (thisSample, timestamp, eventCode);
 
             // reset values
             ch = -1;
@@ -264,6 +269,8 @@ bool IntanThread::updateBuffer()
         }
     }
 
+    frameBlock.writeTo (*dataBuffer);
+
     return true;
 }
 
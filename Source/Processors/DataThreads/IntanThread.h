@@ -74,6 +74,7 @@ private:
     unsigned char buffer[240]; // should be 5 samples per channel
 
     float thisSample[17]; // 17 continuous channels and one event channel
+    FrameBlock frameBlock;
 
     int ch;
 
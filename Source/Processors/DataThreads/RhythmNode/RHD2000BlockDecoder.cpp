@@ -0,0 +1,265 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "RHD2000BlockDecoder.h"
+#include "rhythm-api/rhd2000datablock.h"
+
+#if JUCE_INTEL
+ #include <emmintrin.h>
+#endif
+
+#if defined (__AVX2__)
+ #include <immintrin.h>
+#endif
+
+// byte offsets within a sample frame, see Rhd2000DataBlock::fillFromUsbBuffer
+#define FRAME_TIMESTAMP_OFFSET 8
+#define FRAME_AUX_OFFSET 12
+
+RHD2000BlockDecoder::RHD2000BlockDecoder()
+    : numStreams(0), numChannels(0), numAmplifierWords(0), numAuxStreams(0),
+      auxChannelStart(0), adcChannelStart(0), decodeAdc(false), frameBytes(0), maxSamples(0)
+{
+}
+
+RHD2000BlockDecoder::~RHD2000BlockDecoder()
+{
+}
+
+void RHD2000BlockDecoder::setLayout(const Array<StreamLayout>& streams, bool decodeAdcChannels, int maxSamplesPerBlock)
+{
+    numStreams = streams.size();
+    decodeAdc = decodeAdcChannels;
+    maxSamples = maxSamplesPerBlock;
+
+    // header, timestamp, 3 aux words, 32 amplifier words and 1 filler word per stream, 8 ADCs, TTL in/out
+    numAmplifierWords = 32 * numStreams;
+    frameBytes = 8 + 4 + 2 * (3 + 32 + 1) * numStreams + 16 + 4;
+
+    auxStreams.clear();
+
+    int amplifierChannels = 0;
+
+    for (int i = 0; i < numStreams; i++)
+    {
+        amplifierChannels += streams[i].numChannels;
+
+        if (streams[i].hasAux)
+            auxStreams.add(i);
+    }
+
+    numAuxStreams = auxStreams.size();
+    auxChannelStart = amplifierChannels;
+    adcChannelStart = auxChannelStart + 3 * numAuxStreams;
+    numChannels = adcChannelStart + (decodeAdc ? 8 : 0);
+
+    // one extra row soaks up the amplifier slots no channel uses
+    samples.calloc((numChannels + 1) * maxSamples);
+    float* const discardRow = samples + numChannels * maxSamples;
+
+    channelPointers.malloc(jmax(1, numChannels));
+
+    for (int ch = 0; ch < numChannels; ch++)
+        channelPointers[ch] = samples + ch * maxSamples;
+
+    wordDestinations.malloc(jmax(1, numAmplifierWords));
+
+    for (int w = 0; w < numAmplifierWords; w++)
+        wordDestinations[w] = discardRow;
+
+    // amplifier words arrive as channel 0 of every stream, then channel 1 of every stream, ...
+    int channel = 0;
+
+    for (int stream = 0; stream < numStreams; stream++)
+    {
+        for (int i = 0; i < streams[stream].numChannels; i++)
+        {
+            const int slot = streams[stream].firstChannel + i;
+
+            if (slot < 32)
+                wordDestinations[slot * numStreams + stream] = channelPointers[channel];
+
+            channel++;
+        }
+    }
+
+    tile.malloc(jmax(1, 4 * numAmplifierWords));
+    timestamps.calloc(maxSamples);
+    eventCodes.calloc(maxSamples);
+
+    auxSamples.calloc(jmax(1, 3 * numAuxStreams));
+    auxHeld.calloc(jmax(1, 3 * numAuxStreams));
+}
+
+int RHD2000BlockDecoder::countValidFrames(const unsigned char* block, int numSamples) const
+{
+    numSamples = jmin(numSamples, maxSamples);
+
+    for (int samp = 0; samp < numSamples; samp++)
+    {
+        if (ByteOrder::littleEndianInt64(block + samp * frameBytes) != RHD2000_HEADER_MAGIC_NUMBER)
+            return samp;
+    }
+
+    return numSamples;
+}
+
+void RHD2000BlockDecoder::decodeFrameExtras(const unsigned char* frame, int sample)
+{
+    timestamps[sample] = ByteOrder::littleEndianInt(frame + FRAME_TIMESTAMP_OFFSET);
+
+    // aux command results: 3 slots of one word per stream. Slot 1 carries the
+    // accelerometer sample that was requested three frames ago
+    const unsigned char* auxWords = frame + FRAME_AUX_OFFSET + 2 * numStreams;
+    const int auxNum = (sample + 3) % 4;
+
+    for (int i = 0; i < numAuxStreams; i++)
+    {
+        if (auxNum < 3)
+            auxSamples[i * 3 + auxNum] = float(ByteOrder::littleEndianShort(auxWords + 2 * auxStreams.getUnchecked(i)) - 32768)*0.0000374;
+
+        for (int chan = 0; chan < 3; chan++)
+        {
+            if (auxNum == 3)
+                auxHeld[i * 3 + chan] = auxSamples[i * 3 + chan];
+
+            channelPointers[auxChannelStart + i * 3 + chan][sample] = auxHeld[i * 3 + chan];
+        }
+    }
+
+    const unsigned char* adcWords = frame + FRAME_AUX_OFFSET + 2 * (3 + 32 + 1) * numStreams;
+
+    if (decodeAdc)
+    {
+        for (int adcChan = 0; adcChan < 8; adcChan++)
+        {
+            // ADC waveform units = volts; account for +/-5V input range and DC offset
+            channelPointers[adcChannelStart + adcChan][sample] =
+                0.00015258789 * float(ByteOrder::littleEndianShort(adcWords + 2 * adcChan)) - 5 - 0.4096;
+        }
+    }
+
+    eventCodes[sample] = ByteOrder::littleEndianShort(adcWords + 16);
+}
+
+void RHD2000BlockDecoder::convertAmplifierWords(const unsigned char* frame, float* dest) const
+{
+    const unsigned char* words = frame + FRAME_AUX_OFFSET + 2 * 3 * numStreams;
+
+    // (word - 32768) is exact in float, so every path rounds the same way as the scalar decoder
+#if defined (__AVX2__)
+    const __m256 offset = _mm256_set1_ps(32768.0f);
+    const __m256 scale = _mm256_set1_ps(0.195f);
+
+    for (int w = 0; w < numAmplifierWords; w += 8)
+    {
+        const __m256i values = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (words + 2 * w)));
+        _mm256_storeu_ps(dest + w, _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(values), offset), scale));
+    }
+#elif JUCE_INTEL
+    const __m128 offset = _mm_set1_ps(32768.0f);
+    const __m128 scale = _mm_set1_ps(0.195f);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (int w = 0; w < numAmplifierWords; w += 8)
+    {
+        const __m128i values = _mm_loadu_si128((const __m128i*) (words + 2 * w));
+        const __m128 lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(values, zero));
+        const __m128 hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(values, zero));
+
+        _mm_storeu_ps(dest + w, _mm_mul_ps(_mm_sub_ps(lo, offset), scale));
+        _mm_storeu_ps(dest + w + 4, _mm_mul_ps(_mm_sub_ps(hi, offset), scale));
+    }
+#else
+    for (int w = 0; w < numAmplifierWords; w++)
+        dest[w] = float(ByteOrder::littleEndianShort(words + 2 * w) - 32768)*0.195f;
+#endif
+}
+
+int RHD2000BlockDecoder::decodeBlock(const unsigned char* block, int numSamples)
+{
+    const int numFrames = countValidFrames(block, numSamples);
+    int samp = 0;
+
+#if JUCE_INTEL
+    // four frames at a time: convert each frame's amplifier words into a row of the
+    // tile, then transpose 4x4 blocks of the tile straight into the channel rows
+    const int W = numAmplifierWords;
+
+    for (; samp + 4 <= numFrames; samp += 4)
+    {
+        for (int t = 0; t < 4; t++)
+            convertAmplifierWords(block + (samp + t) * frameBytes, tile + t * W);
+
+        for (int w = 0; w < W; w += 4)
+        {
+            __m128 r0 = _mm_loadu_ps(tile + w);
+            __m128 r1 = _mm_loadu_ps(tile + W + w);
+            __m128 r2 = _mm_loadu_ps(tile + 2 * W + w);
+            __m128 r3 = _mm_loadu_ps(tile + 3 * W + w);
+
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+            _mm_storeu_ps(wordDestinations[w] + samp, r0);
+            _mm_storeu_ps(wordDestinations[w + 1] + samp, r1);
+            _mm_storeu_ps(wordDestinations[w + 2] + samp, r2);
+            _mm_storeu_ps(wordDestinations[w + 3] + samp, r3);
+        }
+
+        for (int t = 0; t < 4; t++)
+            decodeFrameExtras(block + (samp + t) * frameBytes, samp + t);
+    }
+#endif
+
+    for (; samp < numFrames; samp++)
+    {
+        const unsigned char* frame = block + samp * frameBytes;
+
+        convertAmplifierWords(frame, tile);
+
+        for (int w = 0; w < numAmplifierWords; w++)
+            wordDestinations[w][samp] = tile[w];
+
+        decodeFrameExtras(frame, samp);
+    }
+
+    return numFrames;
+}
+
+int RHD2000BlockDecoder::decodeBlockScalar(const unsigned char* block, int numSamples)
+{
+    const int numFrames = countValidFrames(block, numSamples);
+
+    for (int samp = 0; samp < numFrames; samp++)
+    {
+        const unsigned char* frame = block + samp * frameBytes;
+        const unsigned char* words = frame + FRAME_AUX_OFFSET + 2 * 3 * numStreams;
+
+        for (int w = 0; w < numAmplifierWords; w++)
+            wordDestinations[w][samp] = float(ByteOrder::littleEndianShort(words + 2 * w) - 32768)*0.195f;
+
+        decodeFrameExtras(frame, samp);
+    }
+
+    return numFrames;
+}
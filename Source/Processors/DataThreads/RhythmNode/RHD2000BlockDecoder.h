@@ -0,0 +1,113 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __RHD2000BLOCKDECODER_H_7A1E53C2__
+#define __RHD2000BLOCKDECODER_H_7A1E53C2__
+
+#include "../../../../JuceLibraryCode/JuceHeader.h"
+
+/**
+    Turns the raw USB blocks returned by Rhd2000EvalBoard::readRawDataBlock() into
+    channel-major float arrays, ready for DataBuffer::addToBufferChannelMajor().
+
+    Each sample frame on the wire holds a header, a timestamp, the auxiliary command
+    results, the amplifier words of all streams interleaved channel by channel, the
+    board ADCs and the TTL inputs. The amplifier words are converted several at a time
+    with SSE2 (or AVX2 when the build targets it) and transposed into per-channel rows
+    in small tiles; everything else is decoded per frame.
+
+    Output channels are ordered as the RHD2000Thread presents them: the amplifier
+    channels of every stream, then three aux channels for each stream that has them,
+    then the eight board ADCs if enabled.
+
+    decodeBlockScalar() is a straightforward per-sample decoder producing identical
+    output, kept as the reference for the vectorized path.
+
+    @see RHD2000Thread, DataBuffer
+*/
+class RHD2000BlockDecoder
+{
+public:
+    struct StreamLayout
+    {
+        int numChannels;    // amplifier channels used from this stream
+        int firstChannel;   // first of the 32 channel slots that holds data (8 for 16-ch RHD2132 headstages)
+        bool hasAux;        // false for the second half of an RHD2164
+    };
+
+    RHD2000BlockDecoder();
+    ~RHD2000BlockDecoder();
+
+    /** Sets the stream layout and allocates room for maxSamplesPerBlock samples.
+        Also clears the held aux values. */
+    void setLayout (const Array<StreamLayout>& streams, bool decodeAdcChannels, int maxSamplesPerBlock);
+
+    /** Decodes numSamples frames of a raw block.
+
+        @return The number of frames decoded. Decoding stops at the first frame
+        with a bad header, so this is less than numSamples if the block is corrupt.
+    */
+    int decodeBlock (const unsigned char* block, int numSamples);
+
+    /** Same as decodeBlock(), without any SIMD. */
+    int decodeBlockScalar (const unsigned char* block, int numSamples);
+
+    int getNumChannels() const                      { return numChannels; }
+    int getFrameSizeInBytes() const                 { return frameBytes; }
+
+    /** One pointer per output channel; each row holds the samples of the last decoded block. */
+    const float* const* getChannelPointers() const  { return channelPointers.getData(); }
+    const int64* getTimestamps() const              { return timestamps; }
+    const uint64* getEventCodes() const             { return eventCodes; }
+
+private:
+    int countValidFrames (const unsigned char* block, int numSamples) const;
+    void decodeFrameExtras (const unsigned char* frame, int sample);
+    void convertAmplifierWords (const unsigned char* frame, float* dest) const;
+
+    int numStreams;
+    int numChannels;
+    int numAmplifierWords;
+    int numAuxStreams;
+    int auxChannelStart;
+    int adcChannelStart;
+    bool decodeAdc;
+    int frameBytes;
+    int maxSamples;
+
+    HeapBlock<float> samples;           // numChannels rows of maxSamples, then a discard row
+    HeapBlock<float*> channelPointers;
+    HeapBlock<float*> wordDestinations; // row for each amplifier word, or the discard row
+    HeapBlock<float> tile;
+    HeapBlock<int64> timestamps;
+    HeapBlock<uint64> eventCodes;
+
+    Array<int> auxStreams;
+    HeapBlock<float> auxSamples;        // latest result of each aux command, per aux stream
+    HeapBlock<float> auxHeld;           // value presented on each aux channel until the next update
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RHD2000BlockDecoder);
+};
+
+
+#endif  // __RHD2000BLOCKDECODER_H_7A1E53C2__
@@ -95,8 +95,6 @@ RHD2000Thread::RHD2000Thread(SourceNode* sn) : DataThread(sn),
 	newScan(true), ledsEnabled(true)
 {
 	impedanceThread = new RHDImpedanceMeasure(this);
-	memset(auxBuffer, 0, sizeof(auxBuffer));
-	memset(auxSamples, 0, sizeof(auxSamples));
 
     for (int i=0; i < MAX_NUM_HEADSTAGES; i++)
         headstagesArray.add(new RHDHeadstage(static_cast<Rhd2000EvalBoard::BoardDataSource>(i)));
@@ -1411,6 +1409,17 @@ bool RHD2000Thread::startAcquisition()
 
     blockSize = dataBlock->calculateDataBlockSizeInWords(evalBoard->getNumEnabledDataStreams(), evalBoard->isUSB3());
 	std::cout << "Expecting blocksize of " << blockSize << " for " << evalBoard->getNumEnabledDataStreams() << " streams" << std::endl;
+
+	Array<RHD2000BlockDecoder::StreamLayout> streamLayouts;
+	for (int i = 0; i < enabledStreams.size(); i++)
+	{
+		RHD2000BlockDecoder::StreamLayout layout;
+		layout.numChannels = numChannelsPerDataStream[i];
+		layout.firstChannel = (chipId[i] == CHIP_ID_RHD2132 && numChannelsPerDataStream[i] == 16) ? RHD2132_16CH_OFFSET : 0;
+		layout.hasAux = (chipId[i] != CHIP_ID_RHD2164_B);
+		streamLayouts.add(layout);
+	}
+	blockDecoder.setLayout(streamLayouts, acquireAdcChannels, Rhd2000DataBlock::getSamplesPerDataBlock(evalBoard->isUSB3()));
 	//evalBoard->printFIFOmetrics();
     startThread();
 
@@ -1485,184 +1494,16 @@ bool RHD2000Thread::updateBuffer()
 
 		return_code = evalBoard->readRawDataBlock(&bufferPtr);
 
-		int index = 0;
-		int auxIndex, chanIndex;
-		int numStreams = enabledStreams.size();
 		int nSamps = Rhd2000DataBlock::getSamplesPerDataBlock(evalBoard->isUSB3());
-		
-		//evalBoard->printFIFOmetrics();
-        for (int samp = 0; samp < nSamps; samp++)
-        {
-            int channel = -1;
-
-			if (!Rhd2000DataBlock::checkUsbHeader(bufferPtr, index))
-			{
-				cerr << "Error in Rhd2000EvalBoard::readDataBlock: Incorrect header." << endl;
-				break;
-			}
-
-			index += 8;
-			timestamp = Rhd2000DataBlock::convertUsbTimeStamp(bufferPtr,index);
-			index += 4;
-			auxIndex = index;
-			//skip the aux channels
-			index += numStreams * 6;
-			// do the neural data channels first
-			for (int dataStream = 0; dataStream < numStreams; dataStream++)
-			{
-				int nChans = numChannelsPerDataStream[dataStream];
-				chanIndex = index + 2*dataStream;
-				if ((chipId[dataStream] == CHIP_ID_RHD2132) && (nChans == 16)) //RHD2132 16ch. headstage
-				{
-					chanIndex += 2 * RHD2132_16CH_OFFSET*numStreams;
-				}
-				for (int chan = 0; chan < nChans; chan++)
-				{
-					channel++;
-					thisSample[channel] = float(*(uint16*)(bufferPtr + chanIndex) - 32768)*0.195f;
-					chanIndex += 2*numStreams;
-				}
-			}
-			index += 64 * numStreams;
-			//now we can do the aux channels
-			auxIndex += 2*numStreams;
-			for (int dataStream = 0; dataStream < numStreams; dataStream++)
-			{
-				if (chipId[dataStream] != CHIP_ID_RHD2164_B)
-				{
-					int auxNum = (samp+3) % 4;
-					if (auxNum < 3)
-					{
-						auxSamples[dataStream][auxNum] = float(*(uint16*)(bufferPtr + auxIndex) - 32768)*0.0000374;
-					}
-					for (int chan = 0; chan < 3; chan++)
-					{
-						channel++;
-						if (auxNum == 3)
-						{
-							auxBuffer[channel] = auxSamples[dataStream][chan];
-						}
-						thisSample[channel] = auxBuffer[channel];
-					}
-				}
-				auxIndex += 2;
-
-			}
-			index += 2 * numStreams;
-			if (acquireAdcChannels)
-			{
-				for (int adcChan = 0; adcChan < 8; ++adcChan)
-				{
-
-					channel++;
-					// ADC waveform units = volts
-					thisSample[channel] =
-						//0.000050354 * float(dataBlock->boardAdcData[adcChan][samp]);
-						0.00015258789 * float(*(uint16*)(bufferPtr + index)) - 5 - 0.4096; // account for +/-5V input range and DC offset
-					index += 2;
-				}
-			}
-			else
-			{
-				index += 16;
-			}
-			eventCode = *(uint16*)(bufferPtr + index);
-			index += 4;
-			dataBuffer->addToBuffer(thisSample, &timestamp, &eventCode, 1);
-#if 0
-            // do the neural data channels first
-            for (int dataStream = 0; dataStream < enabledStreams.size(); dataStream++)
-            {
-				if ((chipId[dataStream] == CHIP_ID_RHD2132) && (numChannelsPerDataStream[dataStream] == 16)) //RHD2132 16ch. headstage
-					chOffset = RHD2132_16CH_OFFSET;
-				else
-					chOffset = 0;
-                for (int chan = 0; chan < numChannelsPerDataStream[dataStream]; chan++)
-                {
-
-                    //  std::cout << "reading sample stream " << streamNumber << " chan " << chan << " sample "<< samp << std::endl;
-
-                    channel++;
-
-                    int value = dataBlock->amplifierData[dataStream][chan+chOffset][samp];
-
-                    thisSample[channel] = float(value-32768)*0.195f;
-                }
-
-
-            }
-
-
-            // then do the Intan AUX channels
-            for (int dataStream = 0; dataStream < enabledStreams.size(); dataStream++)
-            {
-                if (chipId[dataStream] != CHIP_ID_RHD2164_B) //Channel B of 2164 shouldn't be copied
-                {
-                    if (samp % 4 == 1)   // every 4th sample should have auxiliary input data
-                    {
-
-                        // std::cout << "reading sample stream " << streamNumber << " aux ADCs " << std::endl;
-
-                        channel++;
-						thisSample[channel] = 0.0000374 *
-							float(dataBlock->auxiliaryData[dataStream][1][samp + 0] - 32768);
-                        // constant offset keeps the values visible in the LFP Viewer
-
-                        auxBuffer[channel] = thisSample[channel];
-
-                        channel++;
-						thisSample[channel] = 0.0000374 *
-							float(dataBlock->auxiliaryData[dataStream][1][samp + 1] - 32768);
-                        // constant offset keeps the values visible in the LFP Viewer
 
-                        auxBuffer[channel] = thisSample[channel];
+		// deinterleave the whole block into per-channel rows, then hand it over in one write
+		int numDecoded = blockDecoder.decodeBlock(bufferPtr, nSamps);
 
+		if (numDecoded < nSamps)
+			cerr << "Error in Rhd2000EvalBoard::readDataBlock: Incorrect header." << endl;
 
-                        channel++;
-						thisSample[channel] = 0.0000374 *
-							float(dataBlock->auxiliaryData[dataStream][1][samp + 2] - 32768);
-                        // constant offset keeps the values visible in the LFP Viewer
-
-                        auxBuffer[channel] = thisSample[channel];
-
-                    }
-                    else    // repeat last values from buffer
-                    {
-
-                        //std::cout << "reading sample stream " << streamNumber << " aux ADCs " << std::endl;
-
-                        channel++;
-                        thisSample[channel] = auxBuffer[channel];
-                        channel++;
-                        thisSample[channel] = auxBuffer[channel];
-                        channel++;
-                        thisSample[channel] = auxBuffer[channel];
-                    }
-                }
-
-            }
-
-            // finally, loop through acquisition board ADC channels if necessary
-            if (acquireAdcChannels)
-            {
-                for (int adcChan = 0; adcChan < 8; ++adcChan)
-                {
-
-                    channel++;
-                    // ADC waveform units = volts
-                    thisSample[channel] =
-                        //0.000050354 * float(dataBlock->boardAdcData[adcChan][samp]);
-                        0.00015258789 * float(dataBlock->boardAdcData[adcChan][samp]) - 5 - 0.4096; // account for +/-5V input range and DC offset
-                }
-            }
-            // std::cout << channel << std::endl;
-
-            timestamp = dataBlock->timeStamp[samp];
-            //timestamp = timestamp;
-            eventCode = dataBlock->ttlIn[samp];
-            dataBuffer->addToBuffer(thisSample, &timestamp, &eventCode, 1);
-#endif
-        }
+		dataBuffer->addToBufferChannelMajor(blockDecoder.getChannelPointers(),
+			blockDecoder.getTimestamps(), blockDecoder.getEventCodes(), numDecoded);
 
     }
 
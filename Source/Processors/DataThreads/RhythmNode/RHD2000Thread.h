@@ -33,6 +33,7 @@
 #include "rhythm-api/rhd2000registers.h"
 #include "rhythm-api/rhd2000datablock.h"
 #include "rhythm-api/okFrontPanelDLL.h"
+#include "RHD2000BlockDecoder.h"
 
 #include "../../DataThreads/DataThread.h"
 #include "../../GenericProcessor/GenericProcessor.h"
@@ -162,10 +163,8 @@ private:
     int numChannels;
     bool deviceFound;
 
-    float thisSample[MAX_NUM_CHANNELS];
-    // aux inputs are only sampled every 4th sample, so use this to buffer the samples so they can be handles just like the regular neural channels later
-    float auxBuffer[MAX_NUM_CHANNELS];
-    float auxSamples[MAX_NUM_DATA_STREAMS_USB3][3];
+    // turns each raw USB block into per-channel rows (and holds the aux values between updates)
+    RHD2000BlockDecoder blockDecoder;
 
     unsigned int blockSize;
 
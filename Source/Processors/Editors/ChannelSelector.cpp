@@ -80,6 +80,17 @@ ChannelSelector::ChannelSelector(bool createButtons, Font& titleFont_) :
     noneButton->addListener(this);
     addAndMakeVisible(noneButton);
 
+    recordRateSelector = new ComboBox("Record rate");
+    recordRateSelector->addItem("full", 1);
+    const int factors[] = { 2, 4, 5, 10, 20, 30, 60 };
+    for (int i = 0; i < 7; ++i)
+        recordRateSelector->addItem("1/" + String(factors[i]), factors[i]);
+    recordRateSelector->setTextWhenNothingSelected("mixed");
+    recordRateSelector->setSelectedId(1, dontSendNotification);
+    recordRateSelector->setTooltip("Sample rate the channels selected for recording are written at");
+    recordRateSelector->addListener(this);
+    addChildComponent(recordRateSelector);
+
     // Buttons managers
     // ====================================================================
     addAndMakeVisible (audioButtonsManager);
@@ -288,8 +299,17 @@ void ChannelSelector::refreshButtonBoundaries()
     /*
       All and None buttons
     */
-    allButton->setBounds (0, getHeight() - 15, getWidth() / 2, tabButtonHeight);
-    noneButton->setBounds (getWidth() / 2, getHeight() - 15, getWidth() / 2, tabButtonHeight);
+    if (recordRateSelector->isVisible())
+    {
+        allButton->setBounds (0, getHeight() - 15, getWidth() / 3, tabButtonHeight);
+        noneButton->setBounds (getWidth() / 3, getHeight() - 15, getWidth() / 3, tabButtonHeight);
+        recordRateSelector->setBounds (getWidth() * 2 / 3, getHeight() - 15, getWidth() - getWidth() * 2 / 3, tabButtonHeight);
+    }
+    else
+    {
+        allButton->setBounds (0, getHeight() - 15, getWidth() / 2, tabButtonHeight);
+        noneButton->setBounds (getWidth() / 2, getHeight() - 15, getWidth() / 2, tabButtonHeight);
+    }
 }
 
 void ChannelSelector::resized()
@@ -429,6 +449,7 @@ void ChannelSelector::activateButtons()
 void ChannelSelector::inactivateRecButtons()
 {
     recActive = false;
+    recordRateSelector->setEnabled (false);
 
     const int numButtons = recordButtonsManager.getNumButtons();
     for (int i = 0; i < numButtons; ++i)
@@ -442,6 +463,7 @@ void ChannelSelector::inactivateRecButtons()
 void ChannelSelector::activateRecButtons()
 {
     recActive = true;
+    recordRateSelector->setEnabled (true);
 
     const int numButtons = recordButtonsManager.getNumButtons();
     for (int i = 0; i < numButtons; ++i)
@@ -550,6 +572,7 @@ void ChannelSelector::buttonClicked(Button* button)
     {
         // make sure param buttons are visible
         allButton->setState(true);
+        recordRateSelector->setVisible(false);
         desiredOffset = parameterOffset;
         startTimer(20);
         return;
@@ -561,6 +584,7 @@ void ChannelSelector::buttonClicked(Button* button)
         if (audioButton->getState())
         {
             allButton->setState(false);
+            recordRateSelector->setVisible(false);
 
             desiredOffset = audioOffset;
             startTimer(20);
@@ -577,6 +601,8 @@ void ChannelSelector::buttonClicked(Button* button)
         if (recordButton->getState())
         {
             allButton->setState(true);
+            updateRecordRateSelector();
+            recordRateSelector->setVisible(isNotSink);
             desiredOffset = recordOffset;
             startTimer(20);
         }
@@ -709,6 +735,49 @@ void ChannelSelector::buttonClicked(Button* button)
 }
 
 
+void ChannelSelector::comboBoxChanged(ComboBox* comboBox)
+{
+    if (comboBox != recordRateSelector || comboBox->getSelectedId() <= 0)
+        return;
+
+    // applies to the channels of this processor that are selected for recording
+    GenericEditor* editor = (GenericEditor*)getParentComponent();
+    RecordNode* recordNode = AccessClass::getProcessorGraph()->getRecordNode();
+    for (int i = 0; i < recordButtonsManager.getNumButtons(); ++i)
+    {
+        if (recordButtonsManager.getButtonAt (i)->getToggleState())
+        {
+            if (!recordNode->setChannelDecimation (editor->getChannel (i), comboBox->getSelectedId()))
+            {
+                CoreServices::sendStatusMessage ("Record rates can't be changed while recording");
+                break;
+            }
+        }
+    }
+    updateRecordRateSelector();
+}
+
+void ChannelSelector::updateRecordRateSelector()
+{
+    GenericEditor* editor = (GenericEditor*)getParentComponent();
+    int factor = 0;
+    for (int i = 0; i < recordButtonsManager.getNumButtons(); ++i)
+    {
+        if (recordButtonsManager.getButtonAt (i)->getToggleState())
+        {
+            int channelFactor = editor->getChannel (i)->getRecordDecimation();
+            if (factor > 0 && channelFactor != factor)
+            {
+                // no single rate to show
+                recordRateSelector->setSelectedId (0, dontSendNotification);
+                return;
+            }
+            factor = channelFactor;
+        }
+    }
+    recordRateSelector->setSelectedId (jmax (1, factor), dontSendNotification);
+}
+
 void ChannelSelector::changeChannelsSelectionButtonClicked (SlicerChannelSelectorComponent* sender,
                                                             Button* buttonThatWasClicked,
                                                             bool isSelect)
@@ -129,6 +129,7 @@ class PLUGIN_API ChannelSelector : public Component
                                  , public Button::Listener
                                  , private SlicerChannelSelectorComponent::Listener
                                  , public Timer
+                                 , public ComboBox::Listener
 {
 public:
     /** constructor */
@@ -140,6 +141,9 @@ public:
     /** button callback */
     void buttonClicked(Button* button);
 
+    /** record rate callback */
+    void comboBoxChanged(ComboBox* comboBox);
+
     /** Return an array of selected channels. */
     Array<int> getActiveChannels();
 
@@ -217,6 +221,12 @@ private:
     EditorButton* allButton;
     EditorButton* noneButton;
 
+    /** Record rate of the channels selected for recording, shown in the "rec" tab */
+    ComboBox* recordRateSelector;
+
+    /** Shows the record rate the channels selected for recording share */
+    void updateRecordRateSelector();
+
     /** An array of ChannelSelectorButtons used to select the channels that
     will be updated when a parameter is changed.
     paramBox: TextBox where user input is taken for param tab.
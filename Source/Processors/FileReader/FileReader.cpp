@@ -37,6 +37,9 @@ FileReader::FileReader()
     , currentNumSamples     (0)
     , startSample           (0)
     , stopSample            (0)
+    , looping               (true)
+    , reachedEnd            (false)
+    , samplesSent           (0)
     , counter               (0)
 {
     setProcessorType (PROCESSOR_TYPE_SOURCE);
@@ -211,6 +214,39 @@ void FileReader::setActiveRecording (int index)
 }
 
 
+void FileReader::setLooping (bool shouldLoop)
+{
+    looping = shouldLoop;
+
+    if (! looping && input)
+    {
+        input->seekTo (startSample);
+        currentSample = startSample;
+    }
+
+    reachedEnd  = false;
+    samplesSent = 0;
+}
+
+
+bool FileReader::isLooping() const
+{
+    return looping;
+}
+
+
+bool FileReader::hasReachedEnd() const
+{
+    return reachedEnd;
+}
+
+
+int64 FileReader::getNumSamplesSent() const
+{
+    return samplesSent;
+}
+
+
 String FileReader::getFile() const
 {
     if (input)
@@ -242,7 +278,7 @@ void FileReader::process (AudioSampleBuffer& buffer, MidiBuffer& events)
 
     int samplesRead = 0;
 
-    while (samplesRead < samplesNeeded)
+    while (samplesRead < samplesNeeded && ! reachedEnd)
     {
         int samplesToRead = samplesNeeded - samplesRead;
         if ( (currentSample + samplesToRead) > stopSample)
@@ -251,8 +287,16 @@ void FileReader::process (AudioSampleBuffer& buffer, MidiBuffer& events)
             if (samplesToRead > 0)
                 input->readData (readBuffer + samplesRead, samplesToRead);
 
-            input->seekTo (startSample);
-            currentSample = startSample;
+            if (looping)
+            {
+                input->seekTo (startSample);
+                currentSample = startSample;
+            }
+            else
+            {
+                currentSample = stopSample;
+                reachedEnd = true;
+            }
         }
         else
         {
@@ -266,11 +310,12 @@ void FileReader::process (AudioSampleBuffer& buffer, MidiBuffer& events)
 
     for (int i = 0; i < currentNumChannels; ++i)
     {
-        input->processChannelData (readBuffer, buffer.getWritePointer (i, 0), i, samplesNeeded);
+        input->processChannelData (readBuffer, buffer.getWritePointer (i, 0), i, samplesRead);
     }
 
-    timestamp += samplesNeeded;
-    setNumSamples (events, samplesNeeded);
+    timestamp += samplesRead;
+    samplesSent += samplesRead;
+    setNumSamples (events, samplesRead);
 
     // code for testing events:
     // // // ===========================================================================
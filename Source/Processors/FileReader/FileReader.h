@@ -31,6 +31,8 @@
 #include "../GenericProcessor/GenericProcessor.h"
 #include "FileSource.h"
 
+#include <atomic>
+
 #define BUFFER_SIZE 1024
 
 
@@ -69,6 +71,19 @@ public:
     bool isFileSupported          (const String& filename) const;
     bool isFileExtensionSupported (const String& ext) const;
 
+    /** By default the reader starts over when it reaches the end of the selected range.
+        Disabling looping rewinds to the start of the range; the reader then stops at its
+        end and sends empty blocks from then on. */
+    void setLooping (bool shouldLoop);
+
+    bool isLooping() const;
+
+    /** Returns true once a reader that isn't looping has sent its last sample. */
+    bool hasReachedEnd() const;
+
+    /** Returns the number of samples per channel sent since looping was last changed. */
+    int64 getNumSamplesSent() const;
+
 
 private:
     void setActiveRecording (int index);
@@ -86,6 +101,10 @@ private:
     int64 stopSample;
     Array<RecordedChannelInfo> channelInfo;
 
+    bool looping;
+    std::atomic<bool> reachedEnd;
+    std::atomic<int64> samplesSent;
+
     // for testing purposes only
     int counter;
 
@@ -0,0 +1,208 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "ChannelProcessingPool.h"
+#include "GenericProcessor.h"
+
+/** Bytes reserved in each range's event buffer until the processor reserves its own worst case. */
+#define RANGE_EVENT_BUFFER_RESERVE 32768
+
+/** Most jobs expected to wait at once, i.e. processors running in parallel. */
+#define MAX_WAITING_JOBS 64
+
+
+ChannelProcessingJob::ChannelProcessingJob (GenericProcessor& owner, int maxRanges)
+    : processor     (owner)
+    , buffer        (nullptr)
+    , events        (nullptr)
+    , rangeCapacity (0)
+    , numRanges     (0)
+    , nextRange     (0)
+{
+    rangeStart.calloc (maxRanges + 1);
+
+    for (int i = 0; i < maxRanges; ++i)
+        rangeEvents.add (new MidiBuffer());
+
+    reserveEvents (RANGE_EVENT_BUFFER_RESERVE);
+}
+
+
+void ChannelProcessingJob::reserveEvents (int numBytes)
+{
+    for (int i = 0; i < rangeEvents.size(); ++i)
+        rangeEvents[i]->ensureSize (numBytes);
+
+    rangeCapacity = jmax (rangeCapacity, numBytes);
+}
+
+
+bool ChannelProcessingJob::isRangeBuffer (const MidiBuffer& buffer) const
+{
+    for (int i = 0; i < rangeEvents.size(); ++i)
+        if (rangeEvents[i] == &buffer)
+            return true;
+
+    return false;
+}
+
+
+class ChannelProcessingPool::Worker : public Thread
+{
+public:
+    explicit Worker (ChannelProcessingPool& p)
+        : Thread    ("Channel worker")
+        , pool      (p)
+    {
+    }
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            ChannelProcessingJob* job = nullptr;
+            int range;
+
+            if (pool.claimRange (job, range))
+                pool.runRange (*job, range);
+            else
+                wait (100);
+        }
+    }
+
+private:
+    ChannelProcessingPool& pool;
+};
+
+
+ChannelProcessingPool::ChannelProcessingPool (int numThreads)
+{
+    jobs.ensureStorageAllocated (MAX_WAITING_JOBS);
+
+    for (int i = 0; i < numThreads; ++i)
+    {
+        Worker* w = workers.add (new Worker (*this));
+        w->startThread (9);
+    }
+}
+
+
+ChannelProcessingPool::~ChannelProcessingPool()
+{
+    for (int i = 0; i < workers.size(); ++i)
+        workers[i]->signalThreadShouldExit();
+
+    for (int i = 0; i < workers.size(); ++i)
+    {
+        workers[i]->notify();
+        workers[i]->stopThread (1000);
+    }
+}
+
+
+void ChannelProcessingPool::process (ChannelProcessingJob& job, int numItems, int ranges, AudioSampleBuffer& buffer, MidiBuffer& eventBuffer)
+{
+    ranges = jmin (ranges, job.getMaxRanges(), getMaxRanges());
+
+    for (int r = 0; r <= ranges; ++r)
+        job.rangeStart[r] = (int) ((int64) numItems * r / ranges);
+
+    job.buffer = &buffer;
+    job.events = &eventBuffer;
+    job.rangesRemaining = ranges;
+    job.rangesDone.reset();
+
+    {
+        const SpinLock::ScopedLockType lock (jobLock);
+        job.numRanges = ranges;
+        job.nextRange = 0;
+        jobs.add (&job);
+    }
+
+    // workers that are busy with another job come to this one once they're done
+    for (int i = 1; i < ranges; ++i)
+    {
+        const int w = (nextWorker += 1) % workers.size();
+        workers[w < 0 ? w + workers.size() : w]->notify();
+    }
+
+    ChannelProcessingJob* ownJob = &job;
+    int range;
+
+    while (claimRange (ownJob, range))
+        runRange (job, range);
+
+    // barrier: every range must be done before the block can move on
+    while (job.rangesRemaining.get() > 0)
+        job.rangesDone.wait (1);
+
+    // through the processor, so the merged events respect the reserve of eventBuffer too
+    for (int r = 1; r < ranges; ++r)
+    {
+        MidiBuffer::Iterator it (*job.rangeEvents[r]);
+        const uint8* data;
+        int numBytes;
+        int samplePosition;
+
+        while (it.getNextEvent (data, numBytes, samplePosition))
+            job.processor.addEventData (eventBuffer, data, numBytes, samplePosition);
+
+        job.rangeEvents[r]->clear();
+    }
+}
+
+
+bool ChannelProcessingPool::claimRange (ChannelProcessingJob*& job, int& range)
+{
+    const SpinLock::ScopedLockType lock (jobLock);
+
+    if (job == nullptr)
+    {
+        if (jobs.size() == 0)
+            return false;
+
+        job = jobs.getFirst();
+    }
+
+    if (job->nextRange >= job->numRanges)
+        return false;
+
+    range = job->nextRange++;
+
+    // once every range is taken, the job no longer needs to be offered to the workers
+    if (job->nextRange == job->numRanges)
+        jobs.removeFirstMatchingValue (job);
+
+    return true;
+}
+
+
+void ChannelProcessingPool::runRange (ChannelProcessingJob& job, int range)
+{
+    MidiBuffer& events = (range == 0) ? *job.events : *job.rangeEvents[range];
+
+    job.processor.processChannelRange (job.rangeStart[range], job.rangeStart[range + 1], *job.buffer, events);
+
+    if (--job.rangesRemaining == 0)
+        job.rangesDone.signal();
+}
@@ -0,0 +1,119 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __CHANNELPROCESSINGPOOL_H_8E41C0B2__
+#define __CHANNELPROCESSINGPOOL_H_8E41C0B2__
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+
+class GenericProcessor;
+
+
+/**
+    One processor's split of a block into item ranges, kept by the processor
+    between blocks so that running it never allocates.
+
+    @see ChannelProcessingPool
+*/
+class ChannelProcessingJob
+{
+public:
+    ChannelProcessingJob (GenericProcessor& owner, int maxRanges);
+
+    int getMaxRanges() const    { return rangeEvents.size(); }
+
+    /** Reserves numBytes in the event buffer of every range. Not to be called while processing. */
+    void reserveEvents (int numBytes);
+
+    /** Returns the number of bytes reserved in each range's event buffer. */
+    int getRangeCapacity() const    { return rangeCapacity; }
+
+    /** Returns true if buffer is the event buffer of one of the ranges. */
+    bool isRangeBuffer (const MidiBuffer& buffer) const;
+
+private:
+    GenericProcessor& processor;
+
+    AudioSampleBuffer* buffer;
+    MidiBuffer* events;
+
+    /** Event buffers of ranges 1 and up; range 0 writes straight into the caller's buffer. */
+    OwnedArray<MidiBuffer> rangeEvents;
+    HeapBlock<int> rangeStart;
+    int rangeCapacity;
+
+    /** Protected by the pool's job lock. */
+    int numRanges;
+    int nextRange;
+
+    Atomic<int> rangesRemaining;
+    WaitableEvent rangesDone;
+
+    friend class ChannelProcessingPool;
+
+    JUCE_DECLARE_NON_COPYABLE (ChannelProcessingJob);
+};
+
+
+/**
+    Worker threads that run GenericProcessor::processChannelRange() for
+    processChannelsInParallel(), shared by every processor of a ProcessorGraph.
+
+    Processors on parallel branches of the graph can submit jobs at the same
+    time. Idle workers take ranges from the oldest job that still has some, and
+    the submitting thread works through the ranges of its own job, so a job
+    always completes even when every worker is busy elsewhere.
+
+    @see GenericProcessor, ProcessorGraph
+*/
+class ChannelProcessingPool
+{
+public:
+    explicit ChannelProcessingPool (int numThreads);
+    ~ChannelProcessingPool();
+
+    /** Returns the most ranges worth splitting a block into: one per worker, plus the calling thread. */
+    int getMaxRanges() const    { return workers.size() + 1; }
+
+    /** Splits items [0, numItems) into the given number of ranges, processes them and merges
+        their events into eventBuffer, in range order. Returns once every range is done. */
+    void process (ChannelProcessingJob& job, int numItems, int ranges, AudioSampleBuffer& buffer, MidiBuffer& eventBuffer);
+
+private:
+    class Worker;
+
+    /** Takes the next unprocessed range of a job, or of the oldest waiting job if job is nullptr. */
+    bool claimRange (ChannelProcessingJob*& job, int& range);
+    void runRange (ChannelProcessingJob& job, int range);
+
+    OwnedArray<Worker> workers;
+    Atomic<int> nextWorker;
+
+    SpinLock jobLock;
+    Array<ChannelProcessingJob*> jobs;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ChannelProcessingPool);
+};
+
+
+#endif  // __CHANNELPROCESSINGPOOL_H_8E41C0B2__
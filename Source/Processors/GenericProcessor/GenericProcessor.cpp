@@ -22,14 +22,29 @@
 */
 
 #include "GenericProcessor.h"
+#include "ChannelProcessingPool.h"
 #include "../../UI/UIComponent.h"
 #include "../../AccessClass.h"
+#include "../Visualization/SpikeObject.h"
 
 #include <exception>
 
 
 const String GenericProcessor::m_unusedNameString ("xxx-UNUSED-OPEN-EPHYS-xxx");
 
+/** Largest event addEvent() assembles: a full spike after the 6-byte event header. */
+#define MAX_EVENT_BYTES (MAX_SPIKE_BUFFER_LEN + 6)
+
+/** Bytes a MidiBuffer stores with every event besides its data (sample position and size). */
+#define MIDI_EVENT_OVERHEAD 6
+
+/** Default worst case of a processor's events in one block, see getEventBufferReserve(). */
+#define EVENT_BUFFER_RESERVE 32768
+
+/** Smallest number of items worth handing to a separate thread. */
+#define MIN_ITEMS_PER_RANGE 8
+
+
 GenericProcessor::GenericProcessor (const String& name)
     : sourceNode                    (0)
     , destNode                      (0)
@@ -42,11 +57,16 @@ GenericProcessor::GenericProcessor (const String& name)
     , editor                        (nullptr)
     , parametersAsXml               (nullptr)
     , sendSampleCount               (true)
+    , numSamples                    (*this)
+    , timestamps                    (*this)
     , m_processorType                   (PROCESSOR_TYPE_UTILITY)
     , m_name                            (name)
     , m_isParamsWereLoaded              (false)
     , m_isNeedsToSendTimestampMessage   (false)
     , m_isTimestampSet                  (false)
+    , m_blockContext                    (&m_ownBlockContext)
+    , m_eventBufferCapacity             (EVENT_BUFFER_RESERVE)
+    , m_channelPool                     (nullptr)
 {
     settings.numInputs = settings.numOutputs = settings.sampleRate = 0;
 }
@@ -291,11 +311,15 @@ void GenericProcessor::clearSettings()
     if (m_monitorStatus.size() < channels.size())
         m_monitorStatus.resize (channels.size());
 
+    if (m_recordDecimation.size() < channels.size())
+        m_recordDecimation.insertMultiple (m_recordDecimation.size(), 1, channels.size() - m_recordDecimation.size());
+
     for (int i = 0; i < channels.size(); ++i)
     {
         // std::cout << channels[i]->getRecordState() << std::endl;
         m_recordStatus.set    (i, channels[i]->getRecordState());
         m_monitorStatus.set   (i, channels[i]->isMonitored);
+        m_recordDecimation.set (i, channels[i]->getRecordDecimation());
     }
 
     channels.clear();
@@ -340,6 +364,7 @@ void GenericProcessor::update()
             {
                 ch->setRecordState (m_recordStatus[i]);
                 ch->isMonitored = m_monitorStatus[i];
+                ch->setRecordDecimation (m_recordDecimation[i]);
             }
 
             channels.add (ch);
@@ -374,6 +399,7 @@ void GenericProcessor::update()
             if (nidx < m_recordStatus.size())
             {
                 ch->setRecordState (m_recordStatus[nidx]);
+                ch->setRecordDecimation (m_recordDecimation[nidx]);
             }
             else
             {
@@ -398,6 +424,7 @@ void GenericProcessor::update()
             if (nidx < m_recordStatus.size())
             {
                 ch->setRecordState (m_recordStatus[nidx]);
+                ch->setRecordDecimation (m_recordDecimation[nidx]);
             }
             else
             {
@@ -422,6 +449,7 @@ void GenericProcessor::update()
             if (nidx < m_recordStatus.size())
             {
                 ch->setRecordState (m_recordStatus[nidx]);
+                ch->setRecordDecimation (m_recordDecimation[nidx]);
             }
             else
             {
@@ -517,36 +545,77 @@ void GenericProcessor::disableEditor()
 }
 
 
-/** Used to get the number of samples in a given buffer, for a given channel. */
-int GenericProcessor::getNumSamples (int channelNum) const
+BlockContext::BlockContext()
+    : numSources (0)
 {
-    int sourceNodeId = 0;
-    int nSamples     = 0;
+    zeromem (&unknownSource, sizeof (unknownSource));
+
+    for (int i = 0; i < 256; ++i)
+        eventNodeIds[i] = i;
+}
 
-    if (channelNum >= 0
-        && channelNum < channels.size())
-    {
-        sourceNodeId = channels[channelNum]->sourceNodeId;
-    }
-    else
-    {
-        return 0;
-    }
 
-    // std::cout << "Requesting samples for channel " << channelNum << " with source node " << sourceNodeId << std::endl;
+void BlockContext::addNode (int nodeId)
+{
+    if (nodeId < 0)
+        return;
 
-    try
+    if (nodeId >= numSources)
     {
-        nSamples = numSamples.at (sourceNodeId);
+        HeapBlock<SourceInfo> newSources ((size_t) nodeId + 1, true);
+
+        if (numSources > 0)
+            memcpy (newSources, sources, sizeof (SourceInfo) * numSources);
+
+        sources.swapWith (newSources);
+        numSources = nodeId + 1;
     }
-    catch (std::exception& e)
+
+    eventNodeIds[nodeId & 0xff] = nodeId;
+}
+
+
+/** Used to get the number of samples in a given buffer, for a given channel. */
+const BlockContext::SourceInfo& GenericProcessor::getBlockInfo (int channelNum) const
+{
+    static const BlockContext::SourceInfo noSource = { 0, 0, 0.0f };
+
+    if (channelNum < 0 || channelNum >= channels.size())
+        return noSource;
+
+    return getBlockContext()[channels.getUnchecked (channelNum)->sourceNodeId];
+}
+
+
+BlockContext& GenericProcessor::getBlockContext() const
+{
+    return *m_blockContext;
+}
+
+
+void GenericProcessor::setBlockContext (BlockContext* context)
+{
+    m_blockContext = (context != nullptr) ? context : &m_ownBlockContext;
+}
+
+
+void GenericProcessor::setChannelProcessingPool (ChannelProcessingPool* pool)
+{
+    if (pool != m_channelPool)
     {
-        return 0;
+        m_channelJob = nullptr;
+        m_channelPool = pool;
+
+        // created here, on the message thread, so processChannelsInParallel() never allocates
+        if (m_channelPool != nullptr && m_channelPool->getMaxRanges() > 1)
+            m_channelJob = new ChannelProcessingJob (*this, m_channelPool->getMaxRanges());
     }
+}
 
-    //std::cout << nSamples << " were found." << std::endl;
 
-    return nSamples;
+int GenericProcessor::getNumSamples (int channelNum) const
+{
+    return getBlockInfo (channelNum).numSamples;
 }
 
 
@@ -572,38 +641,21 @@ void GenericProcessor::setNumSamples (MidiBuffer& events, int sampleIndex)
     data[1] = nodeId;       // least-significant byte
     memcpy (data + 2, &si, 2);
 
-    events.addEvent (data,       // spike data
-                     4,          // total bytes
-                     0); // sample index
+    addEventData (events,   // MidiBuffer
+                  data,     // spike data
+                  4,        // total bytes
+                  0);       // sample index
+
+    BlockContext::SourceInfo& info = getBlockContext()[nodeId];
+    info.numSamples = sampleIndex;
+    info.sampleRate = getSampleRate();
 }
 
 
 /** Used to get the timestamp for a given buffer, for a given source node. */
 int64 GenericProcessor::getTimestamp (int channelNum) const
 {
-    int sourceNodeId = 0;
-    int64 ts         = 0;
-
-    if (channelNum >= 0 
-        && channelNum < channels.size())
-    {
-        sourceNodeId = channels[channelNum]->sourceNodeId;
-    }
-    else
-    {
-        return 0;
-    }
-
-    try
-    {
-        ts = timestamps.at (sourceNodeId);
-    }
-    catch (std::exception& e)
-    {
-        return 0;
-    }
-
-    return ts;
+    return getBlockInfo (channelNum).timestamp;
 }
 
 
@@ -655,18 +707,13 @@ void GenericProcessor::setTimestamp (MidiBuffer& events, int64 timestamp)
 }
 
 
-int GenericProcessor::processEventBuffer (MidiBuffer& events)
+void GenericProcessor::processEventBuffer (MidiBuffer& events)
 {
     //
-    // This loops through all events in the buffer, and uses the BUFFER_SIZE
-    // events to determine the number of samples in the current buffer. If
-    // there are multiple such events, the one with the highest number of
-    // samples will be used.
-    // This approach is not ideal, as it will become a problem if we allow
-    // the sample rate to change at different points in the signal chain.
+    // Sample counts and timestamps are read from the shared BlockContext, so the
+    // only thing left to do here is to make sure that events coming from upstream
+    // processors aren't saved twice.
     //
-    int numRead = 0;
-
     if (events.getNumEvents() > 0)
     {
         MidiBuffer::Iterator i (events);
@@ -678,45 +725,17 @@ int GenericProcessor::processEventBuffer (MidiBuffer& events)
 
         while (i.getNextEvent (dataptr, dataSize, samplePosition))
         {
-            if (*dataptr == BUFFER_SIZE)
-            {
-                int16 nr;
-                memcpy (&nr, dataptr + 2, 2);
-
-                numRead = nr;
-
-                uint8 sourceNodeId;
-                memcpy (&sourceNodeId, dataptr + 1, 1);
-
-                numSamples[sourceNodeId] = numRead;
-            }
-            else if (*dataptr == TIMESTAMP)
+            if (isWritableEvent (*dataptr)  // a TTL event
+                && getNodeId() < 900        // not handled by a specialized processor (e.g. AudioNode))
+                && *(dataptr + 4) > 0)        // that's flagged for saving
             {
-                int64 ts;
-                memcpy (&ts, dataptr + 6, 8);
-
-                uint8 sourceNodeId;
-                memcpy (&sourceNodeId, dataptr + 1, 1);
-
-                timestamps[sourceNodeId] = ts;
-            }
-            else
-            {
-
-                if (isWritableEvent (*dataptr)  // a TTL event
-                    && getNodeId() < 900        // not handled by a specialized processor (e.g. AudioNode))
-                    && *(dataptr + 4) > 0)        // that's flagged for saving
-                {
-                    // changing the const cast is dangerous, but probably necessary:
-                    uint8* ptr = const_cast<uint8*> (dataptr);
-                    *(ptr + 4) = 0; // set fifth byte of raw data to 0, so the event
-                    // won't be saved twice
-                }
+                // changing the const cast is dangerous, but probably necessary:
+                uint8* ptr = const_cast<uint8*> (dataptr);
+                *(ptr + 4) = 0; // set fifth byte of raw data to 0, so the event
+                // won't be saved twice
             }
         }
     }
-
-    return numRead;
 }
 
 
@@ -745,6 +764,17 @@ int GenericProcessor::checkForEvents (MidiBuffer& midiMessages)
 }
 
 
+void GenericProcessor::addTimestampIfNeeded (MidiBuffer& eventBuffer)
+{
+    if (! m_isTimestampSet
+        && ! isSource()
+        && ! isGeneratesTimestamps())
+    {
+        setTimestamp (eventBuffer, getTimestamp (0));
+    }
+}
+
+
 void GenericProcessor::addEvent (MidiBuffer& eventBuffer,
                                  uint8 type,
                                  int sampleNum,
@@ -757,16 +787,18 @@ void GenericProcessor::addEvent (MidiBuffer& eventBuffer,
     /*If the processor doesn't generates timestamps, but needs to add events to the buffer anyway
     add the timestamp of the first input channel so the event is properly timestamped. We avoid this step for
     source modules that must always provide a timestamp, even if they don't generate it*/
-    if (! isTimestamp
-        && ! m_isTimestampSet
-        && ! isSource()
-        && ! isGeneratesTimestamps())
+    if (! isTimestamp)
+        addTimestampIfNeeded (eventBuffer);
+
+    // no event carries more than a spike
+    if (numBytes > MAX_SPIKE_BUFFER_LEN)
     {
-        setTimestamp (eventBuffer, getTimestamp (0));
+        jassertfalse;
+        ++m_droppedEvents;
+        return;
     }
 
-    HeapBlock<uint8> data (static_cast<const size_t> (6 + numBytes));
-    //uint8* data = new uint8[6+numBytes];
+    uint8 data[MAX_EVENT_BYTES];
 
     data[0] = type;    // event type
     data[1] = nodeId;  // processor ID automatically added
@@ -781,9 +813,10 @@ void GenericProcessor::addEvent (MidiBuffer& eventBuffer,
 
     //std::cout << "Node id: " << data[1] << std::endl;
 
-    eventBuffer.addEvent (data,         // raw data
-                          6 + numBytes, // total bytes
-                          sampleNum);   // sample index
+    addEventData (eventBuffer,  // MidiBuffer
+                  data,         // raw data
+                  6 + numBytes, // total bytes
+                  sampleNum);   // sample index
 
     //if (type == TTL)
     //	std::cout << "Adding event for channel " << (int) eventChannel << " with ID " << (int) eventId << std::endl;
@@ -792,12 +825,93 @@ void GenericProcessor::addEvent (MidiBuffer& eventBuffer,
 
 void GenericProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer& eventBuffer)
 {
-    processEventBuffer (eventBuffer); // extract buffer sizes and timestamps,
-    // set flag on all TTL events to zero
+    processEventBuffer (eventBuffer); // set flag on all TTL events to zero
 
     m_isTimestampSet = false;
 
+    const int64 startTicks = Time::getHighResolutionTicks();
+
     process (buffer, eventBuffer);
+
+    const double elapsedUs = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks) * 1.0e6;
+
+    // the block's real-time duration is set by the data in it, not by the graph's nominal buffer size
+    const BlockContext::SourceInfo& block = getBlockInfo (0);
+    double blockDurationUs = 1.0e6 * buffer.getNumSamples() / 44100.0;
+
+    if (block.numSamples > 0 && block.sampleRate > 0)
+        blockDurationUs = 1.0e6 * block.numSamples / block.sampleRate;
+
+    m_processingTimeStats.addBlock (elapsedUs, blockDurationUs);
+}
+
+
+void GenericProcessor::processChannelsInParallel (int numItems, AudioSampleBuffer& buffer, MidiBuffer& eventBuffer)
+{
+    const int maxRanges = (m_channelJob != nullptr) ? m_channelJob->getMaxRanges() : 1;
+    const int ranges = jmin (numItems / MIN_ITEMS_PER_RANGE, maxRanges);
+
+    if (ranges < 2)
+    {
+        processChannelRange (0, numItems, buffer, eventBuffer);
+        return;
+    }
+
+    // set the block timestamp up front rather than racing to do it from each range
+    addTimestampIfNeeded (eventBuffer);
+
+    m_channelPool->process (*m_channelJob, numItems, ranges, buffer, eventBuffer);
+}
+
+
+void GenericProcessor::processChannelRange (int, int, AudioSampleBuffer&, MidiBuffer&)
+{
+}
+
+
+bool GenericProcessor::addEventData (MidiBuffer& eventBuffer, const uint8* data, int numBytes, int sampleNum)
+{
+    // the buffers were reserved before acquisition; growing one here would allocate on the audio thread
+    if (eventBuffer.data.size() + numBytes + MIDI_EVENT_OVERHEAD > getEventBufferCapacity (eventBuffer))
+    {
+        ++m_droppedEvents;
+        return false;
+    }
+
+    eventBuffer.addEvent (data, numBytes, sampleNum);
+    return true;
+}
+
+
+int GenericProcessor::getEventBufferCapacity (const MidiBuffer& eventBuffer) const
+{
+    if (m_channelJob != nullptr && m_channelJob->isRangeBuffer (eventBuffer))
+        return m_channelJob->getRangeCapacity();
+
+    return m_eventBufferCapacity;
+}
+
+
+int GenericProcessor::getEventBufferReserve (int) const
+{
+    return EVENT_BUFFER_RESERVE;
+}
+
+
+void GenericProcessor::prepareEventBuffers (int maxBlockSamples, int graphBufferBytes)
+{
+    m_eventBufferCapacity = graphBufferBytes;
+    m_droppedEvents = 0;
+
+    // a single range can end up with all of this processor's events
+    if (m_channelJob != nullptr)
+        m_channelJob->reserveEvents (getEventBufferReserve (maxBlockSamples));
+}
+
+
+int GenericProcessor::getNumDroppedEvents() const
+{
+    return m_droppedEvents.get();
 }
 
 
@@ -851,6 +965,9 @@ void GenericProcessor::saveChannelParametersToXml (XmlElement* parentElement, in
         selectionState->setAttribute ("record", r);
         selectionState->setAttribute ("audio", a);
 
+        if (channelNumber < channels.size() && channels[channelNumber]->getRecordDecimation() > 1)
+            selectionState->setAttribute ("recordDecimation", channels[channelNumber]->getRecordDecimation());
+
         saveCustomChannelParametersToXml (channelInfo, channelNumber);
     }
     else
@@ -942,6 +1059,9 @@ void GenericProcessor::loadChannelParametersFromXml (XmlElement* channelInfo, bo
                                                        subNode->getBoolAttribute ("param"),
                                                        subNode->getBoolAttribute ("record"),
                                                        subNode->getBoolAttribute ("audio"));
+
+                if (channelNum >= 0 && channelNum < channels.size())
+                    channels[channelNum]->setRecordDecimation (subNode->getIntAttribute ("recordDecimation", 1));
             }
         }
     }
@@ -991,6 +1111,8 @@ int GenericProcessor::getCurrentChannel() const { return currentChannel; }
 
 PluginProcessorType GenericProcessor::getProcessorType() const { return m_processorType; }
 
+ProcessingTimeStats& GenericProcessor::getProcessingTimeStats() { return m_processingTimeStats; }
+
 bool GenericProcessor::hasEditor() const { return false; }
 
 bool GenericProcessor::isInputChannelStereoPair  (int index) const { return true; }
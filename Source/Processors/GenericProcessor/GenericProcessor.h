@@ -45,6 +45,7 @@ enum ChannelType
 #include "../PluginManager/PluginClass.h"
 #include "../../Processors/Dsp/LinearSmoothedValueAtomic.h"
 #include "../../Processors/PluginManager/PluginIDs.h"
+#include "ProcessingTimeStats.h"
 
 #include <time.h>
 #include <stdio.h>
@@ -56,10 +57,68 @@ class UIComponent;
 class GenericEditor;
 class Parameter;
 class Channel;
+class ChannelProcessingPool;
+class ChannelProcessingJob;
 
 using namespace Plugin;
 
 
+/**
+    Flat table of per-block information about each source processor, indexed by
+    source node ID.
+
+    Sources fill in their entry through setNumSamples() and setTimestamp(); every
+    downstream processor then reads it directly (through the channel's sourceNodeId)
+    instead of scanning the event buffer and searching a map.
+
+    Each ProcessorGraph owns one context and hands it to its processors, which size
+    it for every node ID in the graph before acquisition starts.
+
+    @see GenericProcessor, ProcessorGraph
+*/
+class PLUGIN_API BlockContext
+{
+public:
+    struct SourceInfo
+    {
+        int numSamples;
+        int64 timestamp;
+        float sampleRate;
+    };
+
+    BlockContext();
+
+    /** Makes room for a node ID and maps the 8-bit processor ID carried by its events back to it.
+        Must not be called while blocks are being processed. */
+    void addNode (int nodeId);
+
+    /** Returns the full node ID of the processor that sent an event, from the event's 8-bit ID. */
+    int getNodeIdForEvent (int eventNodeId) const noexcept      { return eventNodeIds[eventNodeId & 0xff]; }
+
+    SourceInfo& operator[] (int sourceNodeId) noexcept
+    {
+        return isPositiveAndBelow (sourceNodeId, numSources) ? sources[sourceNodeId] : unknownSource;
+    }
+
+    const SourceInfo& operator[] (int sourceNodeId) const noexcept
+    {
+        return isPositiveAndBelow (sourceNodeId, numSources) ? sources[sourceNodeId] : unknownSource;
+    }
+
+
+private:
+    HeapBlock<SourceInfo> sources;
+    int numSources;
+
+    /** Written by node IDs this context was never sized for, so that they can't corrupt a real entry. */
+    SourceInfo unknownSource;
+
+    int eventNodeIds[256];
+
+    JUCE_DECLARE_NON_COPYABLE (BlockContext);
+};
+
+
 /**
     Abstract base class for creating processors.
 
@@ -509,24 +568,95 @@ public:
     /** Used to set the timestamp for a given buffer, for a given source node. */
     void setTimestamp (MidiBuffer&, int64 timestamp);
 
+    /** Returns the sample count, first timestamp and sample rate of the current block,
+        for the source feeding a given channel. */
+    const BlockContext::SourceInfo& getBlockInfo (int channelNumber) const;
+
+    /** Returns the block information shared by all processors in this processor's graph. */
+    BlockContext& getBlockContext() const;
+
+    /** Called by the ProcessorGraph to share its block information with this processor.
+        Until then, or when passed nullptr, the processor uses a context of its own. */
+    void setBlockContext (BlockContext* context);
+
+    /** Called by the ProcessorGraph to share its worker threads with processChannelsInParallel().
+        Also creates the per-range state the pool needs, so it must not be called while processing.
+        Without a pool, every range is processed on the calling thread. */
+    void setChannelProcessingPool (ChannelProcessingPool* pool);
+
     PluginProcessorType getProcessorType() const;
 
-    std::map<uint8, int> numSamples;
-    std::map<uint8, int64> timestamps;
+    /** Returns the distribution of time this processor has spent in process(). */
+    ProcessingTimeStats& getProcessingTimeStats();
+
+    /** Returns the most bytes of events this processor adds to a block of up to maxBlockSamples
+        samples per channel. Processors that can emit many or large events (e.g. spikes) should
+        override this; the default covers ordinary TTL and message traffic. */
+    virtual int getEventBufferReserve (int maxBlockSamples) const;
+
+    /** Called by the ProcessorGraph before acquisition starts, once its event buffers hold
+        graphBufferBytes. Reserves this processor's own event buffers; from then on, events that
+        don't fit in a buffer's reserve are dropped and counted instead of growing it. */
+    void prepareEventBuffers (int maxBlockSamples, int graphBufferBytes);
+
+    /** Returns the number of events dropped since prepareEventBuffers() because a buffer was full. */
+    int getNumDroppedEvents() const;
+
+    /** Map-style access to one field of the BlockContext, so code written against the
+        old per-processor maps (numSamples.at (id), timestamps[id]) keeps working. */
+    template <typename FieldType, FieldType BlockContext::SourceInfo::* field>
+    class BlockContextField
+    {
+    public:
+        explicit BlockContextField (const GenericProcessor& p) : owner (p) {}
+
+        FieldType& operator[] (int sourceNodeId) const  { return owner.getBlockContext()[sourceNodeId].*field; }
+        FieldType& at (int sourceNodeId) const          { return owner.getBlockContext()[sourceNodeId].*field; }
+
+    private:
+        const GenericProcessor& owner;
+    };
+
+    BlockContextField<int, &BlockContext::SourceInfo::numSamples> numSamples;
+    BlockContextField<int64, &BlockContext::SourceInfo::timestamp> timestamps;
 
 
 protected:
     /** Sets whether processor will have behaviour like Source, Sink, Splitter, Utility or Merge */
     void setProcessorType (PluginProcessorType processorType);
 
+    /** Splits items [0, numItems) (channels, electrodes, modules...) into contiguous ranges
+        and calls processChannelRange() for each of them on the worker threads the graph shares
+        between its processors. Returns once every range has been processed.
+
+        Ranges run concurrently, so processChannelRange() may only modify state belonging to its
+        own items. Each range gets its own event buffer; these are merged into eventBuffer, in
+        range order, before this method returns. Small blocks are processed on the calling thread. */
+    void processChannelsInParallel (int numItems, AudioSampleBuffer& continuousBuffer, MidiBuffer& eventBuffer);
+
+    /** Processes items [firstItem, lastItem) of the current block. Called by
+        processChannelsInParallel(), possibly from several threads at once. */
+    virtual void processChannelRange (int firstItem, int lastItem, AudioSampleBuffer& continuousBuffer, MidiBuffer& eventBuffer);
+
+    /** Adds an already assembled event to eventBuffer. If that would grow the buffer past its
+        reserve, the event is dropped and counted instead, and false is returned. */
+    bool addEventData (MidiBuffer& eventBuffer, const uint8* data, int numBytes, int sampleNum);
+
 
 private:
     /** Automatically extracts the number of samples in the buffer, then
     calls the process(), where custom actions take place.*/
     virtual void processBlock (AudioSampleBuffer& buffer, MidiBuffer& midiMessages);
 
-    /** Extracts sample counts and timestamps from the MidiBuffer. */
-    int processEventBuffer (MidiBuffer& buffer);
+    /** Clears the saving flag of incoming events, so they're only recorded once. */
+    void processEventBuffer (MidiBuffer& buffer);
+
+    /** Adds this block's timestamp event before the first event of a processor
+        that doesn't generate its own timestamps. */
+    void addTimestampIfNeeded (MidiBuffer& eventBuffer);
+
+    /** Returns the number of bytes reserved in eventBuffer. */
+    int getEventBufferCapacity (const MidiBuffer& eventBuffer) const;
 
     /** The type of the processor. */
     PluginProcessorType m_processorType;
@@ -537,6 +667,7 @@ private:
     /** Saves the record status of individual channels, even when other parameters are updated. */
     Array<bool> m_recordStatus;
     Array<bool> m_monitorStatus;
+    Array<int> m_recordDecimation;
 
     /** For getInputChannelName() and getOutputChannelName() */
     static const String m_unusedNameString;
@@ -546,6 +677,25 @@ private:
 
     bool m_isTimestampSet;
 
+    /** Used until the processor is added to a ProcessorGraph. */
+    BlockContext m_ownBlockContext;
+    BlockContext* m_blockContext;
+
+    /** Time spent in process(), measured around every call from processBlock(). */
+    ProcessingTimeStats m_processingTimeStats;
+
+    /** Bytes reserved in the event buffers passed to processBlock(). */
+    int m_eventBufferCapacity;
+    Atomic<int> m_droppedEvents;
+
+    /** Worker threads used by processChannelsInParallel(), owned by the ProcessorGraph. */
+    ChannelProcessingPool* m_channelPool;
+
+    /** This processor's split of the current block, created along with the pool. */
+    ScopedPointer<ChannelProcessingJob> m_channelJob;
+
+    friend class ChannelProcessingPool;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GenericProcessor);
 };
 
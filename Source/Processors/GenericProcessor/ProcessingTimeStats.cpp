@@ -0,0 +1,135 @@
+/*
+------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "ProcessingTimeStats.h"
+
+
+ProcessingTimeStats::ProcessingTimeStats()
+{
+    reset();
+}
+
+
+int ProcessingTimeStats::getBucketIndex (double us) noexcept
+{
+    if (us <= 0.0)
+        return 0;
+
+    const int bucket = (int) (std::log (1.0 + us) * (BUCKETS_PER_OCTAVE / std::log (2.0)));
+
+    return jmin (bucket, NUM_BUCKETS - 1);
+}
+
+
+double ProcessingTimeStats::getBucketUpperEdge (int bucket) noexcept
+{
+    return std::pow (2.0, (bucket + 1) / (double) BUCKETS_PER_OCTAVE) - 1.0;
+}
+
+
+void ProcessingTimeStats::addBlock (double processingTimeUs, double blockDurationUs) noexcept
+{
+    const int64 ns = (int64) (processingTimeUs * 1000.0);
+
+    ++buckets[getBucketIndex (processingTimeUs)];
+    ++numBlocks;
+    totalNs += ns;
+    lastNs = ns;
+
+    if (blockDurationUs > 0.0 && processingTimeUs > blockDurationUs)
+        ++numOverruns;
+
+    // only the processing thread writes, so a plain compare is enough here
+    if (ns > maxNs.get())
+        maxNs = ns;
+}
+
+
+void ProcessingTimeStats::reset() noexcept
+{
+    for (int i = 0; i < NUM_BUCKETS; ++i)
+        buckets[i] = 0;
+
+    numBlocks = 0;
+    numOverruns = 0;
+    totalNs = 0;
+    maxNs = 0;
+    lastNs = 0;
+}
+
+
+int64 ProcessingTimeStats::getNumBlocks() const noexcept
+{
+    return numBlocks.get();
+}
+
+
+int64 ProcessingTimeStats::getNumOverruns() const noexcept
+{
+    return numOverruns.get();
+}
+
+
+double ProcessingTimeStats::getPercentileUs (double fraction) const noexcept
+{
+    int64 total = 0;
+
+    for (int i = 0; i < NUM_BUCKETS; ++i)
+        total += buckets[i].get();
+
+    if (total == 0)
+        return 0.0;
+
+    const int64 target = jmax ((int64) 1, (int64) std::ceil (jlimit (0.0, 1.0, fraction) * total));
+    int64 count = 0;
+
+    for (int i = 0; i < NUM_BUCKETS; ++i)
+    {
+        count += buckets[i].get();
+
+        if (count >= target)
+            return jmin (getBucketUpperEdge (i), getMaxUs());
+    }
+
+    return getMaxUs();
+}
+
+
+double ProcessingTimeStats::getMeanUs() const noexcept
+{
+    const int64 n = numBlocks.get();
+
+    return n > 0 ? totalNs.get() / (1000.0 * n) : 0.0;
+}
+
+
+double ProcessingTimeStats::getMaxUs() const noexcept
+{
+    return maxNs.get() / 1000.0;
+}
+
+
+double ProcessingTimeStats::getLastUs() const noexcept
+{
+    return lastNs.get() / 1000.0;
+}
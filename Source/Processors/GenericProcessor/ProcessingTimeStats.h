@@ -0,0 +1,94 @@
+/*
+------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __PROCESSINGTIMESTATS_H_6C2A91E4__
+#define __PROCESSINGTIMESTATS_H_6C2A91E4__
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+#include "../PluginManager/OpenEphysPlugin.h"
+
+
+/**
+    Histogram of the time a processor spends in process(), one sample per block.
+
+    Samples are sorted into logarithmically spaced buckets (eight per octave of
+    microseconds), so recording a block is a handful of atomic operations and never
+    allocates or locks. Percentiles are resolved to the upper edge of their bucket,
+    i.e. to within ~9%.
+
+    A block counts as an overrun when processing it took longer than the
+    real-time duration of the data it contained.
+
+    @see GenericProcessor
+*/
+class PLUGIN_API ProcessingTimeStats
+{
+public:
+    ProcessingTimeStats();
+
+    /** Records one block. Called from the processing thread. */
+    void addBlock (double processingTimeUs, double blockDurationUs) noexcept;
+
+    /** Clears all counters. */
+    void reset() noexcept;
+
+    /** Returns the number of blocks recorded since the last reset. */
+    int64 getNumBlocks() const noexcept;
+
+    /** Returns the number of blocks that took longer than their real-time duration. */
+    int64 getNumOverruns() const noexcept;
+
+    /** Returns the processing time below which the given fraction (0-1) of blocks fell. */
+    double getPercentileUs (double fraction) const noexcept;
+
+    /** Returns the mean processing time per block. */
+    double getMeanUs() const noexcept;
+
+    /** Returns the longest processing time of any block. */
+    double getMaxUs() const noexcept;
+
+    /** Returns the most recently recorded processing time. */
+    double getLastUs() const noexcept;
+
+private:
+    enum
+    {
+        BUCKETS_PER_OCTAVE = 8,
+        NUM_BUCKETS = 20 * BUCKETS_PER_OCTAVE   // up to ~1 s
+    };
+
+    static int getBucketIndex (double us) noexcept;
+    static double getBucketUpperEdge (int bucket) noexcept;
+
+    Atomic<int> buckets[NUM_BUCKETS];
+    Atomic<int64> numBlocks;
+    Atomic<int64> numOverruns;
+    Atomic<int64> totalNs;
+    Atomic<int64> maxNs;
+    Atomic<int64> lastNs;
+
+    JUCE_DECLARE_NON_COPYABLE (ProcessingTimeStats);
+};
+
+
+#endif  // __PROCESSINGTIMESTATS_H_6C2A91E4__
@@ -327,7 +327,7 @@ void PeriStimulusTimeHistogramNode::handleEvent(int eventType, MidiMessage& even
     {
 
         const uint8* dataptr = event.getRawData();
-        int ttl_source = dataptr[1];
+        int ttl_source = getBlockContext().getNodeIdForEvent(dataptr[1]);
         bool ttl_raise = dataptr[2] > 0;
         int channel = dataptr[3]; // channel number
         int64 ttl_timestamp_hardware = timestamps[ttl_source] + samplePosition; // hardware time
@@ -0,0 +1,431 @@
+/*
+------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "GraphScheduler.h"
+
+GraphScheduler::GraphScheduler() : maxBlockSize(0), active(false)
+{
+
+}
+
+GraphScheduler::~GraphScheduler()
+{
+    release();
+}
+
+bool GraphScheduler::isActive() const
+{
+    return active;
+}
+
+int GraphScheduler::getMaxBlockSize() const
+{
+    return maxBlockSize;
+}
+
+bool GraphScheduler::prepare(AudioProcessorGraph* graph, uint32 outputNodeId, int blockSize, int eventBufferBytes)
+{
+    release();
+
+    // map node ids to schedule indices; the audio output node isn't processed,
+    // its inputs are copied straight into the graph's output buffer
+    HashMap<int, int> indexForId;
+
+    for (int i = 0; i < graph->getNumNodes(); i++)
+    {
+        AudioProcessorGraph::Node* node = graph->getNode(i);
+
+        if (node->nodeId == outputNodeId)
+            continue;
+
+        ScheduledNode* n = new ScheduledNode();
+        n->processor = node->getProcessor();
+        n->numDependencies = 0;
+
+        const int numChannels = jmax(1, n->processor->getTotalNumInputChannels(),
+                                     n->processor->getTotalNumOutputChannels());
+        n->buffer.setSize(numChannels, blockSize);
+        n->midiBuffer.ensureSize((size_t) jmax(4096, eventBufferBytes));
+
+        indexForId.set((int) node->nodeId, nodes.size());
+        nodes.add(n);
+    }
+
+    for (int i = 0; i < graph->getNumConnections(); i++)
+    {
+        const AudioProcessorGraph::Connection* c = graph->getConnection(i);
+
+        if (!indexForId.contains((int) c->sourceNodeId))
+            continue;
+
+        const int source = indexForId[(int) c->sourceNodeId];
+        const int destIndex = indexForId.contains((int) c->destNodeId) ? indexForId[(int) c->destNodeId] : -1;
+
+        if (c->destNodeId == outputNodeId)
+        {
+            AudioInput in = { source, c->sourceChannelIndex, c->destChannelIndex, false };
+            outputInputs.add(in);
+            continue;
+        }
+
+        if (destIndex < 0)
+            continue;
+
+        ScheduledNode* dest = nodes[destIndex];
+
+        if (c->sourceChannelIndex == AudioProcessorGraph::midiChannelIndex)
+        {
+            dest->midiInputs.addIfNotAlreadyThere(source);
+        }
+        else if (c->destChannelIndex < dest->buffer.getNumChannels())
+        {
+            bool first = true;
+
+            for (int j = 0; j < dest->audioInputs.size(); j++)
+            {
+                if (dest->audioInputs.getReference(j).destChannel == c->destChannelIndex)
+                    first = false;
+            }
+
+            AudioInput in = { source, c->sourceChannelIndex, c->destChannelIndex, first };
+            dest->audioInputs.add(in);
+        }
+
+        if (!nodes[source]->successors.contains(destIndex))
+        {
+            nodes[source]->successors.add(destIndex);
+            dest->numDependencies++;
+        }
+    }
+
+    // count the nodes that fan out into more than one branch doing real work;
+    // without such a split there is nothing to run in parallel
+    int numBranches = 1;
+
+    for (int i = 0; i < nodes.size(); i++)
+    {
+        ScheduledNode* n = nodes[i];
+        int branches = 0;
+
+        for (int j = 0; j < n->successors.size(); j++)
+        {
+            if (nodes[n->successors[j]]->successors.size() > 0)
+                branches++;
+        }
+
+        numBranches += jmax(0, branches - 1);
+
+        if (n->numDependencies == 0)
+            rootNodes.add(i);
+
+        for (int chan = 0; chan < n->buffer.getNumChannels(); chan++)
+        {
+            bool connected = false;
+
+            for (int j = 0; j < n->audioInputs.size(); j++)
+            {
+                if (n->audioInputs.getReference(j).destChannel == chan)
+                    connected = true;
+            }
+
+            if (!connected)
+                n->unconnectedChannels.add(chan);
+        }
+    }
+
+    const int numWorkers = jmin(numBranches, SystemStats::getNumCpus()) - 1;
+
+    if (numWorkers < 1)
+    {
+        std::cout << "Graph scheduler: no independent branches, using serial processing." << std::endl;
+        nodes.clear();
+        rootNodes.clear();
+        outputInputs.clear();
+        return false;
+    }
+
+    readySlots.calloc(nodes.size());
+    maxBlockSize = blockSize;
+
+    for (int i = 0; i < numWorkers; i++)
+    {
+        Worker* w = new Worker(*this, i);
+        workers.add(w);
+        w->startThread(9);
+    }
+
+    std::cout << "Graph scheduler: " << nodes.size() << " nodes, " << numBranches
+              << " branches, " << numWorkers << " worker threads." << std::endl;
+
+    active = true;
+    return true;
+}
+
+void GraphScheduler::release()
+{
+    for (int i = 0; i < workers.size(); i++)
+        workers[i]->signalThreadShouldExit();
+
+    for (int i = 0; i < workers.size(); i++)
+    {
+        workers[i]->wakeUp.signal();
+        workers[i]->stopThread(1000);
+    }
+
+    workers.clear();
+    nodes.clear();
+    rootNodes.clear();
+    outputInputs.clear();
+
+    maxBlockSize = 0;
+    active = false;
+}
+
+void GraphScheduler::processBlock(AudioSampleBuffer& output, MidiBuffer& /*midiMessages*/)
+{
+    const int numSamples = output.getNumSamples();
+
+    // workers that are still leaving the previous block must be parked before the queue is reset
+    while (!workersParked())
+        callerWakeUp.wait();
+
+    for (int i = 0; i < nodes.size(); i++)
+    {
+        nodes[i]->pendingInputs = nodes[i]->numDependencies;
+        readySlots[i] = -1;
+    }
+
+    queueHead = 0;
+    queueTail = 0;
+    currentNumSamples = numSamples;
+    nodesRemaining = nodes.size();
+
+    for (int i = 1; i < rootNodes.size(); i++)
+        pushReady(rootNodes[i]);
+
+    if (rootNodes.size() > 0)
+        runFrom(rootNodes[0], numSamples);
+
+    helpUntilDone();
+
+    output.clear();
+
+    for (int i = 0; i < outputInputs.size(); i++)
+    {
+        const AudioInput& in = outputInputs.getReference(i);
+
+        if (in.destChannel < output.getNumChannels())
+            output.addFrom(in.destChannel, 0, nodes[in.sourceNode]->buffer, in.sourceChannel, 0, numSamples);
+    }
+}
+
+void GraphScheduler::processNode(int index, int numSamples)
+{
+    ScheduledNode* n = nodes[index];
+
+    for (int i = 0; i < n->unconnectedChannels.size(); i++)
+        n->buffer.clear(n->unconnectedChannels[i], 0, numSamples);
+
+    for (int i = 0; i < n->audioInputs.size(); i++)
+    {
+        const AudioInput& in = n->audioInputs.getReference(i);
+        const AudioSampleBuffer& source = nodes[in.sourceNode]->buffer;
+
+        if (in.firstForChannel)
+            n->buffer.copyFrom(in.destChannel, 0, source, in.sourceChannel, 0, numSamples);
+        else
+            n->buffer.addFrom(in.destChannel, 0, source, in.sourceChannel, 0, numSamples);
+    }
+
+    n->midiBuffer.clear();
+
+    for (int i = 0; i < n->midiInputs.size(); i++)
+        n->midiBuffer.addEvents(nodes[n->midiInputs[i]]->midiBuffer, 0, -1, 0);
+
+    AudioSampleBuffer block(n->buffer.getArrayOfWritePointers(), n->buffer.getNumChannels(), numSamples);
+
+    if (!n->processor->isSuspended())
+        n->processor->processBlock(block, n->midiBuffer);
+}
+
+void GraphScheduler::runFrom(int index, int numSamples)
+{
+    while (index >= 0)
+    {
+        processNode(index, numSamples);
+
+        int next = -1;
+        const Array<int>& successors = nodes[index]->successors;
+
+        for (int i = 0; i < successors.size(); i++)
+        {
+            if (--(nodes[successors[i]]->pendingInputs) == 0)
+            {
+                if (next < 0)
+                    next = successors[i];
+                else
+                    pushReady(successors[i]);
+            }
+        }
+
+        if (--nodesRemaining == 0)
+            callerWakeUp.signal();
+
+        index = next;
+    }
+}
+
+void GraphScheduler::pushReady(int index)
+{
+    const int slot = ++queueTail - 1;
+    readySlots[slot] = index;
+
+    wakeIdleThread();
+}
+
+int GraphScheduler::popReady()
+{
+    for (;;)
+    {
+        const int head = queueHead.get();
+
+        if (head >= queueTail.get())
+            return -1;
+
+        const int index = readySlots[head].get();
+
+        // slot reserved but not written yet
+        if (index < 0)
+            return -1;
+
+        if (queueHead.compareAndSetBool(head + 1, head))
+            return index;
+    }
+}
+
+void GraphScheduler::wakeIdleThread()
+{
+    // whoever clears an idle flag owns the wake-up, so each push signals at most one thread
+    for (int i = 0; i < workers.size(); i++)
+    {
+        if (workers[i]->idle.compareAndSetBool(0, 1))
+        {
+            workers[i]->wakeUp.signal();
+            return;
+        }
+    }
+
+    if (callerIdle.compareAndSetBool(0, 1))
+        callerWakeUp.signal();
+}
+
+bool GraphScheduler::workersParked() const
+{
+    if (activeWorkers.get() > 0)
+        return false;
+
+    // a worker that was signalled but hasn't woken up yet will still look at the queue
+    for (int i = 0; i < workers.size(); i++)
+    {
+        if (workers[i]->idle.get() == 0)
+            return false;
+    }
+
+    return true;
+}
+
+void GraphScheduler::helpUntilDone()
+{
+    for (;;)
+    {
+        int index = popReady();
+
+        if (index < 0)
+        {
+            if (nodesRemaining.get() == 0)
+                return;
+
+            // announce before looking again: a node pushed after this point wakes us,
+            // and one pushed before it is found by the second popReady()
+            callerIdle = 1;
+            index = popReady();
+
+            if (index < 0 && nodesRemaining.get() > 0)
+                callerWakeUp.wait();
+
+            callerIdle = 0;
+        }
+
+        if (index >= 0)
+            runFrom(index, currentNumSamples.get());
+    }
+}
+
+GraphScheduler::Worker::Worker(GraphScheduler& owner, int index)
+    : Thread("Graph Worker " + String(index)), scheduler(owner)
+{
+    idle = 1;
+}
+
+void GraphScheduler::Worker::run()
+{
+    for (;;)
+    {
+        // parked until pushReady() or release() signals this worker
+        while (!wakeUp.wait(100))
+        {
+            if (threadShouldExit())
+                return;
+        }
+
+        if (threadShouldExit())
+            return;
+
+        ++scheduler.activeWorkers;
+
+        for (;;)
+        {
+            int index = scheduler.popReady();
+
+            if (index < 0)
+            {
+                // same handshake as helpUntilDone()
+                idle = 1;
+                index = scheduler.popReady();
+
+                if (index < 0)
+                    break;
+
+                // if a push already claimed this worker, take its signal now so the
+                // worker can't wake up later and touch the queue while it is being reset
+                if (!idle.compareAndSetBool(0, 1))
+                    wakeUp.wait();
+            }
+
+            scheduler.runFrom(index, scheduler.currentNumSamples.get());
+        }
+
+        if (--scheduler.activeWorkers == 0)
+            scheduler.callerWakeUp.signal();
+    }
+}
@@ -0,0 +1,142 @@
+/*
+------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __GRAPHSCHEDULER_H_3A61B7E2__
+#define __GRAPHSCHEDULER_H_3A61B7E2__
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+
+
+/**
+  Runs the nodes of the ProcessorGraph on a small pool of worker threads.
+
+  The schedule is built from the connections made by
+  ProcessorGraph::updateConnections(), so branches downstream of a Splitter
+  can be processed at the same time. A node only becomes ready once every
+  node feeding it has finished, which makes Mergers and sinks (RecordNode,
+  AudioNode) the join points; processBlock() only returns after all nodes
+  have run.
+
+  A thread that finishes a node carries on with the first successor that
+  became ready, so a branch tends to stay on the same core. Any other ready
+  nodes go into a shared queue that idle workers (and the calling thread)
+  take work from. Threads that find the queue empty sleep on an event until
+  a node is pushed (or, for the calling thread, until the block is done),
+  so nothing spins while a long branch is being processed.
+
+  @see ProcessorGraph
+*/
+
+class GraphScheduler
+{
+public:
+    GraphScheduler();
+    ~GraphScheduler();
+
+    /** Builds the schedule from the graph's current nodes and connections.
+    Each node's event buffer is reserved to eventBufferBytes.
+    Returns false (and stays inactive) if the graph has no independent branches,
+    in which case the graph's own serial rendering should be used.*/
+    bool prepare(AudioProcessorGraph* graph, uint32 outputNodeId, int blockSize, int eventBufferBytes);
+
+    /** Stops the workers and frees the per-node buffers.*/
+    void release();
+
+    /** Returns true if prepare() found branches that can run in parallel.*/
+    bool isActive() const;
+
+    /** Returns the largest block that can be processed without reallocating.*/
+    int getMaxBlockSize() const;
+
+    /** Processes one block of the whole graph. The output buffer receives
+    whatever the graph sends to its audio output node.*/
+    void processBlock(AudioSampleBuffer& output, MidiBuffer& midiMessages);
+
+private:
+    struct AudioInput
+    {
+        int sourceNode;
+        int sourceChannel;
+        int destChannel;
+        bool firstForChannel;
+    };
+
+    struct ScheduledNode
+    {
+        AudioProcessor* processor;
+        AudioSampleBuffer buffer;
+        MidiBuffer midiBuffer;
+        Array<AudioInput> audioInputs;
+        Array<int> midiInputs;
+        Array<int> unconnectedChannels;
+        Array<int> successors;
+        int numDependencies;
+        Atomic<int> pendingInputs;
+    };
+
+    class Worker : public Thread
+    {
+    public:
+        Worker(GraphScheduler& owner, int index);
+        void run() override;
+
+        WaitableEvent wakeUp;
+        Atomic<int> idle;
+
+    private:
+        GraphScheduler& scheduler;
+    };
+
+    void processNode(int index, int numSamples);
+    void runFrom(int index, int numSamples);
+    void pushReady(int index);
+    int popReady();
+    void wakeIdleThread();
+    bool workersParked() const;
+    void helpUntilDone();
+
+    OwnedArray<ScheduledNode> nodes;
+    Array<int> rootNodes;
+    Array<AudioInput> outputInputs;
+
+    OwnedArray<Worker> workers;
+
+    HeapBlock<Atomic<int> > readySlots;
+    Atomic<int> queueHead;
+    Atomic<int> queueTail;
+
+    Atomic<int> nodesRemaining;
+    Atomic<int> activeWorkers;
+    Atomic<int> currentNumSamples;
+
+    WaitableEvent callerWakeUp;
+    Atomic<int> callerIdle;
+
+    int maxBlockSize;
+    bool active;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GraphScheduler);
+};
+
+
+#endif  // __GRAPHSCHEDULER_H_3A61B7E2__
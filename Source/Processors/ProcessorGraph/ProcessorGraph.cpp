@@ -33,11 +33,13 @@
 #include "../Splitter/Splitter.h"
 #include "../../UI/UIComponent.h"
 #include "../../UI/EditorViewport.h"
+#include "../../Audio/AudioComponent.h"
 
 #include "../ProcessorManager/ProcessorManager.h"
     
-ProcessorGraph::ProcessorGraph() : currentNodeId(100)
+ProcessorGraph::ProcessorGraph() : currentNodeId(100), eventBufferBytes(0)
 {
+    channelPool = new ChannelProcessingPool(jmin(SystemStats::getNumCpus(), 8) - 1);
 
     // The ProcessorGraph will always have 0 inputs (all content is generated within graph)
     // but it will have N outputs, where N is the number of channels for the audio monitor
@@ -77,6 +79,44 @@ void ProcessorGraph::createDefaultNodes()
     addNode(an, AUDIO_NODE_ID);
     addNode(msgCenter, MESSAGE_CENTER_ID);
 
+    shareGraphResources(recn);
+    shareGraphResources(an);
+    shareGraphResources(msgCenter);
+
+}
+
+void ProcessorGraph::prepareToPlay(double sampleRate, int estimatedSamplesPerBlock)
+{
+    AudioProcessorGraph::prepareToPlay(sampleRate, estimatedSamplesPerBlock);
+
+    scheduler.prepare(this, OUTPUT_NODE_ID, estimatedSamplesPerBlock, eventBufferBytes);
+}
+
+void ProcessorGraph::releaseResources()
+{
+    scheduler.release();
+
+    AudioProcessorGraph::releaseResources();
+}
+
+void ProcessorGraph::processBlock(AudioSampleBuffer& buffer, MidiBuffer& midiMessages)
+{
+    const int64 startTicks = Time::getHighResolutionTicks();
+
+    if (scheduler.isActive() && buffer.getNumSamples() <= scheduler.getMaxBlockSize())
+        scheduler.processBlock(buffer, midiMessages);
+    else
+        AudioProcessorGraph::processBlock(buffer, midiMessages);
+
+    const double elapsedUs = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTicks) * 1.0e6;
+    const double sampleRate = getSampleRate() > 0 ? getSampleRate() : 44100.0;
+
+    chainTimingStats.addBlock(elapsedUs, 1.0e6 * buffer.getNumSamples() / sampleRate);
+}
+
+ProcessingTimeStats& ProcessorGraph::getProcessingTimeStats()
+{
+    return chainTimingStats;
 }
 
 void ProcessorGraph::updatePointers()
@@ -103,6 +143,7 @@ void* ProcessorGraph::createNewProcessor(Array<var>& description, int id)//,
 		std::cout << std::endl;
 		std::cout << std::endl;
 		addNode(processor,id); // have to add it so it can be deleted by the graph
+		shareGraphResources(processor);
 
 		if (processor->isSource())
 		{
@@ -252,6 +293,13 @@ void ProcessorGraph::updateConnections(Array<SignalChainTabButton*, CriticalSect
 {
     clearConnections(); // clear processor graph
 
+    // events only carry the low byte of their sender's ID, so map it back to the processors left in the graph
+    for (int i = 0; i < getNumNodes(); i++)
+    {
+        if (getNode(i)->nodeId != OUTPUT_NODE_ID)
+            shareGraphResources((GenericProcessor*) getNode(i)->getProcessor());
+    }
+
     std::cout << "Updating connections:" << std::endl;
     std::cout << std::endl;
     std::cout << std::endl;
@@ -373,6 +421,13 @@ void ProcessorGraph::updateConnections(Array<SignalChainTabButton*, CriticalSect
 
 } // end method
 
+void ProcessorGraph::shareGraphResources(GenericProcessor* processor)
+{
+    processor->setBlockContext(&blockContext);
+    processor->setChannelProcessingPool(channelPool);
+    blockContext.addNode(processor->getNodeId());
+}
+
 void ProcessorGraph::connectProcessors(GenericProcessor* source, GenericProcessor* dest)
 {
 
@@ -595,6 +650,23 @@ bool ProcessorGraph::enableProcessors()
         }
     }
 
+    // events added anywhere upstream are passed along the chain, so every event buffer
+    // of the graph is reserved for the worst case of all processors together
+    const int maxBlockSamples = AccessClass::getAudioComponent()->getBufferSize();
+    eventBufferBytes = 0;
+
+    for (int i = 0; i < getNumNodes(); i++)
+    {
+        Node* node = getNode(i);
+
+        if (node->nodeId != OUTPUT_NODE_ID)
+            eventBufferBytes += ((GenericProcessor*) node->getProcessor())->getEventBufferReserve(maxBlockSamples);
+    }
+
+    setMidiBufferReserve((size_t) eventBufferBytes);
+
+    std::cout << "Reserved " << eventBufferBytes << " bytes per event buffer." << std::endl;
+
     for (int i = 0; i < getNumNodes(); i++)
     {
 
@@ -603,6 +675,7 @@ bool ProcessorGraph::enableProcessors()
         if (node->nodeId != OUTPUT_NODE_ID)
         {
             GenericProcessor* p = (GenericProcessor*) node->getProcessor();
+            p->prepareEventBuffers(maxBlockSamples, eventBufferBytes);
             p->enableEditor();
             p->enable();
         }
@@ -629,6 +702,9 @@ bool ProcessorGraph::disableProcessors()
         {
             GenericProcessor* p = (GenericProcessor*) node->getProcessor();
             std::cout << "Disabling " << p->getName() << std::endl;
+            if (p->getNumDroppedEvents() > 0)
+                std::cout << p->getName() << " dropped " << p->getNumDroppedEvents()
+                          << " events that didn't fit in the event buffer." << std::endl;
 			if (node->nodeId != MESSAGE_CENTER_ID)
 				p->disableEditor();
             allClear = p->disable();
@@ -27,6 +27,10 @@
 #include "../../../JuceLibraryCode/JuceHeader.h"
 
 #include "../../AccessClass.h"
+#include "GraphScheduler.h"
+#include "../GenericProcessor/GenericProcessor.h"
+#include "../GenericProcessor/ChannelProcessingPool.h"
+#include "../GenericProcessor/ProcessingTimeStats.h"
 
 class GenericProcessor;
 class RecordNode;
@@ -86,6 +90,23 @@ public:
     void refreshColors();
 
     void createDefaultNodes();
+
+    /** Builds the rendering sequence and, if the signal chain splits into
+    independent branches, the parallel schedule used by processBlock().*/
+    void prepareToPlay(double sampleRate, int estimatedSamplesPerBlock) override;
+    void releaseResources() override;
+
+    using AudioProcessorGraph::processBlock;
+    void processBlock(AudioSampleBuffer& buffer, MidiBuffer& midiMessages) override;
+
+    /** Returns the distribution of time taken by the whole signal chain per block. */
+    ProcessingTimeStats& getProcessingTimeStats();
+
+    /** Gives a processor this graph's block context and worker threads, and makes room in the
+        block context for its node ID. Done for every node; can also be used for processors
+        that are run outside the graph. */
+    void shareGraphResources(GenericProcessor* processor);
+
 private:
     int currentNodeId;
 
@@ -102,6 +123,19 @@ private:
     void connectProcessors(GenericProcessor* source, GenericProcessor* dest);
     void connectProcessorToAudioAndRecordNodes(GenericProcessor* source);
 
+    GraphScheduler scheduler;
+
+    /** Per-block sample counts and timestamps of every source in this graph. */
+    BlockContext blockContext;
+
+    /** Worker threads shared by the processors that split their blocks into channel ranges. */
+    ScopedPointer<ChannelProcessingPool> channelPool;
+
+    ProcessingTimeStats chainTimingStats;
+
+    /** Bytes reserved in every event buffer of the graph, set by enableProcessors(). */
+    int eventBufferBytes;
+
 };
 
 
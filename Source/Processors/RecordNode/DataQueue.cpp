@@ -29,7 +29,9 @@ m_numChans(0),
 m_blockSize(blockSize),
 m_readInProgress(false),
 m_numBlocks(nBlocks),
-m_maxSize(blockSize*nBlocks)
+m_maxSize(blockSize*nBlocks),
+m_highWater(0),
+m_droppedSamples(0)
 {}
 
 DataQueue::~DataQueue()
@@ -44,7 +46,11 @@ void DataQueue::setChannels(int nChans)
 	m_readSamples.clear();
 	m_numChans = nChans;
 	m_timestamps.clear();
+	m_blockLengths.clear();
 	m_lastReadTimestamps.clear();
+	m_nextTimestamps.clear();
+	m_writeIndexes.clear();
+	m_readIndexes.clear();
 
 	for (int i = 0; i < nChans; ++i)
 	{
@@ -52,9 +58,16 @@ void DataQueue::setChannels(int nChans)
 		m_readSamples.add(0);
 		m_timestamps.add(new Array<int64>());
 		m_timestamps.getLast()->resize(m_numBlocks);
+		m_blockLengths.add(new Array<int>());
+		m_blockLengths.getLast()->insertMultiple(0, m_blockSize, m_numBlocks);
 		m_lastReadTimestamps.add(0);
+		m_nextTimestamps.add(0);
+		m_writeIndexes.add(0);
+		m_readIndexes.add(0);
 	}
 	m_buffer.setSize(nChans, m_maxSize);
+	m_highWater = 0;
+	m_droppedSamples = 0;
 }
 
 void DataQueue::resize(int nBlocks)
@@ -72,56 +85,73 @@ void DataQueue::resize(int nBlocks)
 		m_fifos[i]->reset();
 		m_readSamples.set(i, 0);
 		m_timestamps[i]->resize(nBlocks);
+		m_blockLengths[i]->clearQuick();
+		m_blockLengths[i]->insertMultiple(0, m_blockSize, nBlocks);
 		m_lastReadTimestamps.set(i, 0);
+		m_nextTimestamps.set(i, 0);
+		m_writeIndexes.set(i, 0);
+		m_readIndexes.set(i, 0);
 	}
 	m_buffer.setSize(m_numChans, size);
+	m_highWater = 0;
+	m_droppedSamples = 0;
 }
 
 void DataQueue::fillTimestamps(int channel, int index, int size, int64 timestamp)
 {
-	//Search for the next block start.
-	int blockMod = index % m_blockSize;
-	int blockIdx = index / m_blockSize;
-	int64 startTimestamp;
-	int blockStartPos;
-
-	if (blockMod == 0) //block starts here
+	//Every block starting inside the written range gets its timestamp and, for now, a full length
+	int offset = (m_blockSize - (index % m_blockSize)) % m_blockSize;
+	for (; offset < size; offset += m_blockSize)
 	{
-		startTimestamp = timestamp;
-		blockStartPos = index;
+		int blockIdx = (index + offset) / m_blockSize;
+		m_timestamps[channel]->set(blockIdx, timestamp + offset);
+		m_blockLengths[channel]->set(blockIdx, m_blockSize);
 	}
-	else //we're in the middle of a block, correct to jump to the start of the next-
+}
+
+int DataQueue::getWritableSpace(int channel) const
+{
+	//The block the reader is in can't be reused until it's done with it, as its timestamp
+	//and length are still needed
+	int freeSpace = m_fifos[channel]->getFreeSpace();
+	int readIndex = (m_writeIndexes[channel] + freeSpace + 1) % m_maxSize;
+	return jmax(0, freeSpace - (readIndex % m_blockSize));
+}
+
+void DataQueue::writeChannel(const AudioSampleBuffer& buffer, int channel, int sourceChannel, int nSamples, int64 timestamp, int startSample)
+{
+	int writeIndex = m_writeIndexes[channel];
+	int blockMod = writeIndex % m_blockSize;
+
+	//A jump in the timestamps ends the current block early. The reader skips the padding
+	int padding = 0;
+	if (blockMod != 0 && timestamp != m_nextTimestamps[channel])
+		padding = m_blockSize - blockMod;
+
+	int numToWrite = jlimit(0, nSamples, getWritableSpace(channel) - padding);
+	if (numToWrite < nSamples)
 	{
-		startTimestamp = timestamp + (m_blockSize - blockMod);
-		blockStartPos = index + (m_blockSize - blockMod);
-		blockIdx++;
+		//Counted for the control panel and the stats file, only the first overflow is printed
+		if (m_droppedSamples.fetch_add(nSamples - numToWrite, std::memory_order_relaxed) == 0)
+			std::cerr << "Recording Data Queue Overflow" << std::endl;
 	}
+	if (numToWrite == 0)
+		return;
 
-	//check that the block is in range
-	for (int i = 0; i < size; i += m_blockSize)
+	if (padding > 0)
 	{
-		if ((blockStartPos + i) < (index + size))
-		{
-			int64 ts = startTimestamp + (i*m_blockSize);
-			m_timestamps[channel]->set(blockIdx, ts);
-		}
-
+		m_blockLengths[channel]->set(writeIndex / m_blockSize, blockMod);
+		m_fifos[channel]->finishedWrite(padding);
+		writeIndex = (writeIndex + padding) % m_maxSize;
 	}
-}
 
-void DataQueue::writeChannel(const AudioSampleBuffer& buffer, int channel, int sourceChannel, int nSamples, int64 timestamp)
-{
 	int index1, size1, index2, size2;
-	m_fifos[channel]->prepareToWrite(nSamples, index1, size1, index2, size2);
-	if ((size1 + size2) < nSamples)
-	{ //TODO: turn this into a proper notification. Probably returning a bool.
-		std::cerr << "Recording Data Queue Overflow" << std::endl;
-	}
+	m_fifos[channel]->prepareToWrite(numToWrite, index1, size1, index2, size2);
 	m_buffer.copyFrom(channel,
 		index1,
 		buffer,
 		sourceChannel,
-		0,
+		startSample,
 		size1);
 	
 	fillTimestamps(channel, index1, size1, timestamp);
@@ -132,12 +162,19 @@ void DataQueue::writeChannel(const AudioSampleBuffer& buffer, int channel, int s
 			index2,
 			buffer,
 			sourceChannel,
-			size1,
+			startSample + size1,
 			size2);
 
 		fillTimestamps(channel, index2, size2, timestamp + size1);
 	}
 	m_fifos[channel]->finishedWrite(size1 + size2);
+	m_writeIndexes.set(channel, (writeIndex + size1 + size2) % m_maxSize);
+	m_nextTimestamps.set(channel, timestamp + size1 + size2);
+
+	//There is a single writer, so there's no need for a compare-exchange loop
+	int fill = m_fifos[channel]->getNumReady();
+	if (fill > m_highWater.load(std::memory_order_relaxed))
+		m_highWater.store(fill, std::memory_order_relaxed);
 }
 
 /* 
@@ -147,6 +184,42 @@ allowing the record subsytem to access the internal buffer is way faster, altoug
 done with special care and manually finish the read process.
 */
 
+int DataQueue::getFreeSpace() const
+{
+	int freeSpace = m_maxSize;
+	for (int chan = 0; chan < m_numChans; ++chan)
+		freeSpace = jmin(freeSpace, getWritableSpace(chan));
+	return freeSpace;
+}
+
+int DataQueue::getNumReady() const
+{
+	int numReady = 0;
+	for (int chan = 0; chan < m_numChans; ++chan)
+		numReady = jmax(numReady, m_fifos[chan]->getNumReady());
+	return numReady;
+}
+
+int DataQueue::getNumChannels() const
+{
+	return m_numChans;
+}
+
+int DataQueue::getSize() const
+{
+	return m_maxSize;
+}
+
+int DataQueue::getHighWaterMark() const
+{
+	return m_highWater.load(std::memory_order_relaxed);
+}
+
+int64 DataQueue::getNumDroppedSamples() const
+{
+	return m_droppedSamples.load(std::memory_order_relaxed);
+}
+
 const AudioSampleBuffer& DataQueue::getAudioBufferReference() const
 {
 	return m_buffer;
@@ -164,33 +237,55 @@ bool DataQueue::startRead(Array<CircularBufferIndexes>& indexes, Array<int64>& t
 
 	for (int chan = 0; chan < m_numChans; ++chan)
 	{
-		CircularBufferIndexes idx;
-		int readyToRead = m_fifos[chan]->getNumReady();
-		int samplesToRead = ((readyToRead > nMax) && (nMax > 0)) ? nMax : readyToRead;
-
-		m_fifos[chan]->prepareToRead(samplesToRead, idx.index1, idx.size1, idx.index2, idx.size2);
-		indexes.add(idx);
-		m_readSamples.set(chan, idx.size1 + idx.size2);
-		
-		int blockMod = idx.index1 % m_blockSize;
-		int blockDiff = (blockMod == 0) ? 0 : (m_blockSize - blockMod);
+		AbstractFifo* fifo = m_fifos[chan];
+		const Array<int64>& blockTimestamps = *m_timestamps[chan];
+		const Array<int>& blockLengths = *m_blockLengths[chan];
+		int readIndex = m_readIndexes[chan];
+		int readyToRead = fifo->getNumReady();
+		int samplesToRead = 0;
+		int64 ts = m_lastReadTimestamps[chan];
 
-		//If the next timestamp block is within the data we're reading, include the translated timestamp in the output
-		if (blockDiff < (idx.size1 + idx.size2))
+		int blockIdx = readIndex / m_blockSize;
+		int blockMod = readIndex % m_blockSize;
+		if (readyToRead > 0 && blockMod >= blockLengths[blockIdx])
 		{
-			int blockIdx = ((idx.index1 + blockDiff) / m_blockSize) % m_numBlocks;
-			int64 ts = m_timestamps[chan]->getUnchecked(blockIdx) - blockDiff;
-			timestamps.add(ts);
-			//update to the end of the block
-			m_lastReadTimestamps.set(chan, ts+ idx.size1 + idx.size2);
+			//Skip the padding a timestamp jump left at the end of the block
+			int padding = jmin(m_blockSize - blockMod, readyToRead);
+			fifo->finishedRead(padding);
+			readyToRead -= padding;
+			readIndex = (readIndex + padding) % m_maxSize;
+			m_readIndexes.set(chan, readIndex);
+			blockIdx = readIndex / m_blockSize;
+			blockMod = readIndex % m_blockSize;
 		}
-		//If not, copy the last sent again 
-		else
+
+		if (readyToRead > 0)
 		{
-			int64 ts = m_lastReadTimestamps[chan];
-			timestamps.add(ts);
-			m_lastReadTimestamps.set(chan, ts + idx.size1 + idx.size2);
+			int limit = ((readyToRead > nMax) && (nMax > 0)) ? nMax : readyToRead;
+			ts = blockTimestamps[blockIdx] + blockMod;
+
+			//Extend the read over the following blocks for as long as the timestamps are contiguous
+			int length = blockLengths[blockIdx];
+			samplesToRead = length - blockMod;
+			int64 nextTs = ts + samplesToRead;
+			while (samplesToRead < limit && length == m_blockSize)
+			{
+				blockIdx = (blockIdx + 1) % m_numBlocks;
+				if (blockTimestamps[blockIdx] != nextTs)
+					break;
+				length = blockLengths[blockIdx];
+				samplesToRead += length;
+				nextTs += length;
+			}
+			samplesToRead = jmin(samplesToRead, limit);
 		}
+
+		CircularBufferIndexes idx;
+		fifo->prepareToRead(samplesToRead, idx.index1, idx.size1, idx.index2, idx.size2);
+		indexes.add(idx);
+		timestamps.add(ts);
+		m_readSamples.set(chan, idx.size1 + idx.size2);
+		m_lastReadTimestamps.set(chan, ts + idx.size1 + idx.size2);
 	}
 	return true;
 }
@@ -203,6 +298,7 @@ void DataQueue::stopRead()
 	for (int i = 0; i < m_numChans; ++i)
 	{
 		m_fifos[i]->finishedRead(m_readSamples[i]);
+		m_readIndexes.set(i, (m_readIndexes[i] + m_readSamples[i]) % m_maxSize);
 		m_readSamples.set(i, 0);
 	}
 	m_readInProgress = false;
@@ -25,6 +25,7 @@
 #define DATAQUEUE_H_INCLUDED
 
 #include "../../../JuceLibraryCode/JuceHeader.h"
+#include <atomic>
 
 struct CircularBufferIndexes
 {
@@ -45,20 +46,43 @@ public:
 
 	//Only the methods after this comment are considered thread-safe.
 	//Caution must be had to avoid calling more than one of the methods above simulatenously
-	void writeChannel(const AudioSampleBuffer& buffer, int channel, int sourceChannel, int nSamples, int64 timestamp);
+	/** Queues nSamples of sourceChannel, starting at startSample, with the timestamp of the first one.
+	Writes don't need to be contiguous: a jump in the timestamps closes the current block and the
+	data continues at the next one, so every read covers a single contiguous stretch. */
+	void writeChannel(const AudioSampleBuffer& buffer, int channel, int sourceChannel, int nSamples, int64 timestamp, int startSample = 0);
+	/** Gives access to up to nMax samples per channel (all of them if nMax <= 0). Reads stop at
+	timestamp jumps, the rest of the data comes with the next read. */
 	bool startRead(Array<CircularBufferIndexes>& indexes, Array<int64>& timestamps, int nMax);
 	const AudioSampleBuffer& getAudioBufferReference() const;
 	void stopRead();
-	
+	/** Returns the number of samples that can still be written to the fullest channel. A timestamp
+	jump can take up to one block more. */
+	int getFreeSpace() const;
+	/** Returns the number of samples waiting to be read in the fullest channel */
+	int getNumReady() const;
+	/** Returns the number of channels set by setChannels */
+	int getNumChannels() const;
+	/** Returns the capacity of each channel, in samples */
+	int getSize() const;
+	/** Returns the largest getNumReady() value seen since the channels were last set */
+	int getHighWaterMark() const;
+	/** Returns the number of samples that didn't fit, added over all channels, since the channels were last set */
+	int64 getNumDroppedSamples() const;
+
 
 private:
 	void fillTimestamps(int channel, int index, int size, int64 timestamp);
+	int getWritableSpace(int channel) const;
 
 	OwnedArray<AbstractFifo> m_fifos;
 	AudioSampleBuffer m_buffer;
 	Array<int> m_readSamples;
 	OwnedArray<Array<int64>> m_timestamps;
+	OwnedArray<Array<int>> m_blockLengths;
 	Array<int64> m_lastReadTimestamps;
+	Array<int64> m_nextTimestamps;
+	Array<int> m_writeIndexes;
+	Array<int> m_readIndexes;
 
 	int m_numChans;
 	const int m_blockSize;
@@ -66,6 +90,9 @@ private:
 	int m_numBlocks;
 	int m_maxSize;
 
+	std::atomic<int> m_highWater;
+	std::atomic<int64> m_droppedSamples;
+
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DataQueue);
 };
 
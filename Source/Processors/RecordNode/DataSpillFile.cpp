@@ -0,0 +1,490 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "DataSpillFile.h"
+
+#if JUCE_LINUX || JUCE_MAC
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//Queue fill fractions that start and stop spilling
+#define SPILL_HIGH_WATER 0.5
+#define SPILL_LOW_WATER 0.25
+//Largest number of samples per channel in a spill record
+#define SPILL_BLOCK_SAMPLES 4096
+#define SPILL_MONITOR_INTERVAL_MS 10
+#define SPILL_RECORD_MAGIC 0x4C495053 //"SPIL"
+//Records read back before the index of the ones already replayed is compacted
+#define SPILL_RECORD_COMPACT 256
+
+namespace
+{
+	/** Record layout: magic, channel count, a (samples, timestamp) pair per channel and then
+	the float samples of every channel, one after the other */
+	int64 getRecordBytes(int numChannels, int64 totalSamples)
+	{
+		return 8 + 12 * int64(numChannels) + 4 * totalSamples;
+	}
+
+	/** Stores a value in the little-endian order the stream readers expect */
+	template <typename T>
+	char* putValue(char* dst, T value)
+	{
+		value = ByteOrder::swapIfBigEndian(value);
+		memcpy(dst, &value, sizeof(T));
+		return dst + sizeof(T);
+	}
+
+	/** Has the file system reserve sizeBytes for the file without writing them */
+	bool preallocateFile(const File& file, int64 sizeBytes)
+	{
+#if JUCE_LINUX || JUCE_MAC
+		int fd = ::open(file.getFullPathName().toRawUTF8(), O_WRONLY);
+		if (fd < 0)
+			return false;
+#if JUCE_LINUX
+		bool ok = (posix_fallocate(fd, 0, sizeBytes) == 0);
+#else
+		fstore_t store = { F_ALLOCATECONTIG, F_PEOFPOSMODE, 0, sizeBytes, 0 };
+		if (fcntl(fd, F_PREALLOCATE, &store) == -1)
+		{
+			store.fst_flags = F_ALLOCATEALL;
+			fcntl(fd, F_PREALLOCATE, &store);
+		}
+		bool ok = (ftruncate(fd, sizeBytes) == 0);
+#endif
+		::close(fd);
+		return ok;
+#else
+		//Setting the end of file allocates the clusters without writing to them
+		FileOutputStream output(file);
+		if (output.failedToOpen() || !output.setPosition(sizeBytes))
+			return false;
+		return output.truncate().wasOk();
+#endif
+	}
+}
+
+DataSpillFile::DataSpillFile() :
+Thread("Record Spill"),
+m_capacity(0),
+m_head(0),
+m_tail(0),
+m_end(0),
+m_wrapped(false),
+m_used(0),
+m_writing(false),
+m_queueReadOpen(false),
+m_nextRecord(0),
+m_queue(nullptr),
+m_highWater(0),
+m_spilledSamples(0),
+m_lostSamples(0),
+m_reportedFull(false)
+{
+}
+
+DataSpillFile::~DataSpillFile()
+{
+	close();
+}
+
+bool DataSpillFile::open(const File& file, int64 sizeBytes)
+{
+	close();
+
+	ScopedPointer<FileOutputStream> output = file.createOutputStream();
+	if (output == nullptr || output->failedToOpen())
+	{
+		std::cerr << "Could not create spill file " << file.getFullPathName() << std::endl;
+		return false;
+	}
+	m_file = file;
+	output->setPosition(0);
+	output->truncate();
+	output = nullptr;
+
+	//Reserve the space now, so a stall never has to wait for the file system to find it
+	if (!preallocateFile(file, sizeBytes))
+	{
+		std::cerr << "Could not allocate " << sizeBytes << " bytes for spill file " << file.getFullPathName() << std::endl;
+		m_file.deleteFile();
+		m_file = File::nonexistent;
+		return false;
+	}
+
+	output = file.createOutputStream();
+	m_input = file.createInputStream();
+	if (output == nullptr || output->failedToOpen() || m_input == nullptr)
+	{
+		output = nullptr;
+		m_input = nullptr;
+		m_file.deleteFile();
+		m_file = File::nonexistent;
+		return false;
+	}
+	m_output = output.release();
+	m_capacity = sizeBytes;
+	std::cout << "Spill file " << file.getFullPathName() << ": " << sizeBytes / (1 << 20) << " MB" << std::endl;
+	return true;
+}
+
+void DataSpillFile::close()
+{
+	stopSpilling();
+	m_output = nullptr;
+	m_input = nullptr;
+	if (m_file.existsAsFile())
+		m_file.deleteFile();
+	m_file = File::nonexistent;
+	m_capacity = 0;
+	m_used = 0;
+}
+
+bool DataSpillFile::isOpen() const
+{
+	return m_output != nullptr;
+}
+
+void DataSpillFile::startSpilling(DataQueue* queue)
+{
+	stopSpilling();
+	if (!isOpen())
+		return;
+
+	m_queue = queue;
+	m_head = 0;
+	m_tail = 0;
+	m_end = m_capacity;
+	m_wrapped = false;
+	m_used = 0;
+	m_writing = false;
+	m_queueReadOpen = false;
+	m_records.clearQuick();
+	m_nextRecord = 0;
+	m_highWater = 0;
+	m_spilledSamples = 0;
+	m_lostSamples = 0;
+	m_reportedFull = false;
+	m_record.ensureSize((size_t)getRecordBytes(queue->getNumChannels(), int64(queue->getNumChannels()) * SPILL_BLOCK_SAMPLES));
+	startThread();
+}
+
+void DataSpillFile::stopSpilling()
+{
+	signalThreadShouldExit();
+	notify();
+	stopThread(2000);
+}
+
+bool DataSpillFile::hasPendingData() const
+{
+	return m_used > 0;
+}
+
+float DataSpillFile::getFill() const
+{
+	return (m_capacity > 0) ? float(double(m_used) / double(m_capacity)) : 0.0f;
+}
+
+float DataSpillFile::getHighWaterMark() const
+{
+	return (m_capacity > 0) ? float(double(m_highWater) / double(m_capacity)) : 0.0f;
+}
+
+int64 DataSpillFile::getNumSpilledSamples() const
+{
+	return m_spilledSamples;
+}
+
+int64 DataSpillFile::getNumLostSamples() const
+{
+	return m_lostSamples;
+}
+
+void DataSpillFile::run()
+{
+	while (!threadShouldExit())
+	{
+		wait(SPILL_MONITOR_INTERVAL_MS);
+
+		int size = m_queue->getSize();
+		if (m_queue->getNumReady() <= size * SPILL_HIGH_WATER)
+			continue;
+
+		while (!threadShouldExit() && m_queue->getNumReady() > size * SPILL_LOW_WATER)
+		{
+			if (!spillBlock())
+				break;
+		}
+	}
+}
+
+bool DataSpillFile::spillBlock()
+{
+	int numChannels;
+	int64 position;
+	int64 recordBytes;
+	int64 totalSamples = 0;
+	{
+		ScopedLock lock(m_lock);
+
+		//The samples behind a window the record thread is writing in place stay put until it is released
+		if (m_queueReadOpen)
+			return false;
+
+		//Room is reserved for the largest record the read can produce, as a started read can't be undone
+		numChannels = m_queue->getNumChannels();
+		int64 maxBytes = getRecordBytes(numChannels, int64(numChannels) * jmin(m_queue->getNumReady(), SPILL_BLOCK_SAMPLES));
+		if (numChannels == 0 || !reserve(maxBytes, position))
+			return false;
+
+		Array<CircularBufferIndexes> indexes;
+		Array<int64> timestamps;
+		if (!m_queue->startRead(indexes, timestamps, SPILL_BLOCK_SAMPLES))
+			return false;
+
+		//The samples are copied out under the lock, and reach the file after it is released
+		const AudioSampleBuffer& buffer = m_queue->getAudioBufferReference();
+		for (int chan = 0; chan < numChannels; chan++)
+			totalSamples += indexes[chan].size1 + indexes[chan].size2;
+		recordBytes = getRecordBytes(numChannels, totalSamples);
+		m_record.ensureSize((size_t)recordBytes);
+
+		char* dst = static_cast<char*>(m_record.getData());
+		dst = putValue(dst, uint32(SPILL_RECORD_MAGIC));
+		dst = putValue(dst, uint32(numChannels));
+		for (int chan = 0; chan < numChannels; chan++)
+		{
+			dst = putValue(dst, uint32(indexes[chan].size1 + indexes[chan].size2));
+			dst = putValue(dst, uint64(timestamps[chan]));
+		}
+		for (int chan = 0; chan < numChannels; chan++)
+		{
+			const CircularBufferIndexes& idx = indexes[chan];
+			memcpy(dst, buffer.getReadPointer(chan, idx.index1), idx.size1 * sizeof(float));
+			dst += idx.size1 * sizeof(float);
+			if (idx.size2 > 0)
+			{
+				memcpy(dst, buffer.getReadPointer(chan, idx.index2), idx.size2 * sizeof(float));
+				dst += idx.size2 * sizeof(float);
+			}
+		}
+		m_queue->stopRead();
+
+		//Until it is committed, the queue no longer holds the oldest samples, so readNext has to wait for it
+		m_writing = true;
+	}
+
+	m_output->setPosition(position);
+	m_output->write(m_record.getData(), (size_t)recordBytes);
+	m_output->flush();
+
+	ScopedLock lock(m_lock);
+	m_writing = false;
+	if (m_output->getStatus().failed())
+	{
+		std::cerr << "Spill file write failed: " << m_output->getStatus().getErrorMessage() << std::endl;
+		return false;
+	}
+
+	commit(position, recordBytes);
+	SpillRecord record = { recordBytes, totalSamples };
+	m_records.add(record);
+	m_spilledSamples += totalSamples;
+	return true;
+}
+
+bool DataSpillFile::reserve(int64 recordBytes, int64& position)
+{
+	if (m_used == 0)
+	{
+		m_head = 0;
+		m_tail = 0;
+		m_end = m_capacity;
+		m_wrapped = false;
+		m_records.clearQuick();
+		m_nextRecord = 0;
+	}
+
+	bool fits;
+	if (m_wrapped)
+	{
+		position = m_tail;
+		fits = (m_tail + recordBytes <= m_head);
+	}
+	else if (m_tail + recordBytes <= m_capacity)
+	{
+		position = m_tail;
+		fits = true;
+	}
+	else
+	{
+		position = 0;
+		fits = (recordBytes <= m_head);
+	}
+
+	if (!fits && !m_reportedFull)
+	{
+		std::cerr << "Spill file full, recording data queue may overflow" << std::endl;
+		m_reportedFull = true;
+	}
+	return fits;
+}
+
+void DataSpillFile::commit(int64 position, int64 recordBytes)
+{
+	if (!m_wrapped && position < m_tail)
+	{
+		m_end = m_tail;
+		m_wrapped = true;
+	}
+	m_tail = position + recordBytes;
+	m_used += recordBytes;
+	if (m_used > m_highWater)
+		m_highWater = m_used.load();
+}
+
+bool DataSpillFile::readNext(AudioSampleBuffer& dest, Array<CircularBufferIndexes>& indexes, Array<int64>& timestamps, int nMax, bool& fromQueue)
+{
+	fromQueue = false;
+	int64 position;
+	SpillRecord record;
+	{
+		ScopedLock lock(m_lock);
+		//A record on its way to the file holds older samples than the queue
+		if (m_used == 0 && m_writing)
+			return false;
+
+		if (m_used == 0)
+		{
+			//Nothing spilled, so the queue holds the oldest samples
+			if (!m_queue->startRead(indexes, timestamps, nMax))
+				return false;
+
+			//Without pressure on the queue, or once the monitor is gone, the window is written in place
+			if (!isThreadRunning() || m_queue->getNumReady() <= m_queue->getSize() * SPILL_LOW_WATER)
+			{
+				m_queueReadOpen = true;
+				fromQueue = true;
+				return true;
+			}
+
+			const AudioSampleBuffer& buffer = m_queue->getAudioBufferReference();
+			int maxSamples = 1;
+			for (int chan = 0; chan < indexes.size(); chan++)
+				maxSamples = jmax(maxSamples, indexes[chan].size1 + indexes[chan].size2);
+			dest.setSize(indexes.size(), maxSamples, false, false, true);
+
+			for (int chan = 0; chan < indexes.size(); chan++)
+			{
+				CircularBufferIndexes idx = indexes[chan];
+				if (idx.size1 > 0)
+					dest.copyFrom(chan, 0, buffer, chan, idx.index1, idx.size1);
+				if (idx.size2 > 0)
+					dest.copyFrom(chan, idx.size1, buffer, chan, idx.index2, idx.size2);
+
+				idx.index1 = 0;
+				idx.size1 += idx.size2;
+				idx.index2 = 0;
+				idx.size2 = 0;
+				indexes.set(chan, idx);
+			}
+			m_queue->stopRead();
+			return true;
+		}
+
+		if (m_wrapped && m_head == m_end)
+		{
+			m_head = 0;
+			m_end = m_capacity;
+			m_wrapped = false;
+		}
+		position = m_head;
+		record = m_records[m_nextRecord];
+	}
+
+	//The monitor only writes past the tail, so the record can be read without the lock.
+	//Its header has to agree with the size it was committed with before anything is trusted
+	indexes.clearQuick();
+	timestamps.clearQuick();
+	m_input->setPosition(position);
+	int magic = m_input->readInt();
+	int numChannels = m_input->readInt();
+	bool valid = (magic == SPILL_RECORD_MAGIC && numChannels >= 0 && getRecordBytes(numChannels, 0) <= record.bytes);
+
+	int maxSamples = 1;
+	int64 totalSamples = 0;
+	for (int chan = 0; valid && chan < numChannels; chan++)
+	{
+		CircularBufferIndexes idx;
+		idx.index1 = 0;
+		idx.size1 = m_input->readInt();
+		idx.index2 = 0;
+		idx.size2 = 0;
+		indexes.add(idx);
+		timestamps.add(m_input->readInt64());
+		maxSamples = jmax(maxSamples, idx.size1);
+		totalSamples += idx.size1;
+		valid = (idx.size1 >= 0);
+	}
+	valid = valid && (getRecordBytes(numChannels, totalSamples) == record.bytes);
+
+	if (valid)
+	{
+		dest.setSize(numChannels, maxSamples, false, false, true);
+		for (int chan = 0; valid && chan < numChannels; chan++)
+		{
+			const int bytes = indexes[chan].size1 * sizeof(float);
+			valid = (m_input->read(dest.getWritePointer(chan), bytes) == bytes);
+		}
+	}
+
+	{
+		ScopedLock lock(m_lock);
+		m_head = position + record.bytes;
+		m_used -= record.bytes;
+		if (++m_nextRecord >= SPILL_RECORD_COMPACT)
+		{
+			m_records.removeRange(0, m_nextRecord);
+			m_nextRecord = 0;
+		}
+	}
+
+	if (!valid)
+	{
+		//Only this record is lost, the ones after it are still good
+		std::cerr << "Corrupt spill record at " << position << ", " << record.samples << " samples lost" << std::endl;
+		m_lostSamples += record.samples;
+		return readNext(dest, indexes, timestamps, nMax, fromQueue);
+	}
+	return true;
+}
+
+void DataSpillFile::finishQueueRead()
+{
+	ScopedLock lock(m_lock);
+	m_queue->stopRead();
+	m_queueReadOpen = false;
+}
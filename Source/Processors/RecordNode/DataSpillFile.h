@@ -0,0 +1,141 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DATASPILLFILE_H_INCLUDED
+#define DATASPILLFILE_H_INCLUDED
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+#include "DataQueue.h"
+#include <atomic>
+
+/**
+	Second tier for the DataQueue when the recording disk stalls.
+
+	A preallocated file, ideally on a different fast volume or a tmpfs, used as a ring of
+	records. While recording, a monitor thread watches the queue fill level. When it goes over
+	the high-water mark (the record thread is stuck in a write), the monitor takes the oldest
+	queued samples and appends them to the file until the queue is back under the low-water mark.
+
+	The record thread reads its windows through readNext(), which returns spilled records first,
+	in the order they were spilled, and only goes to the queue once the spill is empty. Queue
+	reads from both threads happen under the same lock as the spill bookkeeping, so samples
+	always reach the engines in order. While the queue is below the low-water mark the window
+	is handed out in place, and the monitor leaves the queue alone until finishQueueRead().
+	Closer to the high-water mark the window is copied out and released at once, so the
+	monitor can take the samples behind it if the write stalls.
+
+	@see RecordThread, DataQueue
+*/
+class DataSpillFile : public Thread
+{
+public:
+	DataSpillFile();
+	~DataSpillFile();
+
+	/** Creates the spill file, with sizeBytes reserved on disk, and keeps it open.
+	Returns false, leaving the spill disabled, if the file can't be created. */
+	bool open(const File& file, int64 sizeBytes);
+
+	/** Stops the monitor and deletes the spill file */
+	void close();
+
+	bool isOpen() const;
+
+	/** Starts watching the queue. Must be called before the first readNext() of a recording */
+	void startSpilling(DataQueue* queue);
+
+	/** Stops the monitor. Spilled records stay available to readNext() */
+	void stopSpilling();
+
+	/** Gets the next window to write: the oldest spilled record if there is one, or up to nMax
+	samples per channel (all of them if nMax <= 0) from the queue. If fromQueue is set on return,
+	indexes point into the queue buffer and finishQueueRead() must be called once the window is
+	written; otherwise the samples were copied into dest, sized as needed, and indexes always
+	describe a single contiguous part per channel. Returns false if there was nothing to read,
+	or while the oldest samples are still on their way to the file. Record thread only. */
+	bool readNext(AudioSampleBuffer& dest, Array<CircularBufferIndexes>& indexes, Array<int64>& timestamps, int nMax, bool& fromQueue);
+
+	/** Releases a window readNext() handed out in place */
+	void finishQueueRead();
+
+	/** Returns true if there are spilled records waiting to be replayed */
+	bool hasPendingData() const;
+
+	/** Fraction of the file in use */
+	float getFill() const;
+
+	/** Largest fraction of the file used at once since startSpilling() */
+	float getHighWaterMark() const;
+
+	/** Samples, added over all channels, moved to the file since startSpilling() */
+	int64 getNumSpilledSamples() const;
+
+	/** Samples, added over all channels, in spilled records that couldn't be read back */
+	int64 getNumLostSamples() const;
+
+	void run() override;
+
+private:
+	struct SpillRecord
+	{
+		int64 bytes;
+		int64 samples;
+	};
+
+	bool spillBlock();
+	bool reserve(int64 recordBytes, int64& position);
+	void commit(int64 position, int64 recordBytes);
+
+	ScopedPointer<FileOutputStream> m_output;
+	ScopedPointer<FileInputStream> m_input;
+	File m_file;
+	int64 m_capacity;
+
+	//Ring state, protected by m_lock. Data lives in [m_head, m_end) followed by [0, m_tail) once the writer has wrapped
+	CriticalSection m_lock;
+	int64 m_head;
+	int64 m_tail;
+	int64 m_end;
+	bool m_wrapped;
+	std::atomic<int64> m_used;
+	//A record taken from the queue is being written outside the lock
+	bool m_writing;
+	//The record thread holds a queue window handed out by readNext()
+	bool m_queueReadOpen;
+	//Size of every record in the file, oldest at m_nextRecord, so a bad one can be skipped
+	Array<SpillRecord> m_records;
+	int m_nextRecord;
+
+	//Monitor thread copy of the record being spilled
+	MemoryBlock m_record;
+
+	DataQueue* m_queue;
+	std::atomic<int64> m_highWater;
+	std::atomic<int64> m_spilledSamples;
+	std::atomic<int64> m_lostSamples;
+	bool m_reportedFull;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DataSpillFile);
+};
+
+#endif  // DATASPILLFILE_H_INCLUDED
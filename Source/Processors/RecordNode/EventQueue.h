@@ -26,45 +26,93 @@
 
 #include "../../../JuceLibraryCode/JuceHeader.h"
 #include <vector>
+#include <atomic>
 
 struct SpikeObject;
 
+/** Largest event (header included) an event queue slot can hold. Bigger messages are counted as overruns. */
+#define EVENT_SLOT_MAX_BYTES 512
+
+/** One preallocated, reusable entry of an EventQueue. Written by the audio thread,
+	read back in place by the record thread. */
 template <class MsgContainer>
-class AsyncEventMessage :
-	public ReferenceCountedObject
+class EventSlot
 {
 public:
-	AsyncEventMessage(const MsgContainer& m, int64 t, int extra) : 
-		ReferenceCountedObject(),
-		m_data(m),
-		m_timestamp(t),
-		m_extra(extra)
-	{}
+	EventSlot() : m_timestamp(0), m_extra(0) {}
 
-	~AsyncEventMessage() {};
+	bool set(const MsgContainer& m, int64 t, int extra)
+	{
+		m_data = m;
+		m_timestamp = t;
+		m_extra = extra;
+		return true;
+	}
 
-	const MsgContainer& getData() const { return m_data;  }
+	const MsgContainer& getData() const { return m_data; }
 	const int64& getTimestamp() const { return m_timestamp; }
-	const int& getExtra() const { return m_extra;  }
+	const int& getExtra() const { return m_extra; }
 
 private:
-	const MsgContainer m_data;
-	const int64 m_timestamp;
-	const int m_extra;
+	MsgContainer m_data;
+	int64 m_timestamp;
+	int m_extra;
+};
+
+/** MidiMessage copies allocate for anything over four bytes, so event slots keep the raw bytes
+	and the reading side hands those to RecordEngine::writeEventData. */
+template <>
+class EventSlot<MidiMessage>
+{
+public:
+	EventSlot() : m_size(0), m_timestamp(0), m_extra(0) {}
+
+	bool set(const MidiMessage& m, int64 t, int extra)
+	{
+		const int size = m.getRawDataSize();
+		if (size > EVENT_SLOT_MAX_BYTES)
+			return false;
+
+		memcpy(m_bytes, m.getRawData(), size);
+		m_size = size;
+		m_timestamp = t;
+		m_extra = extra;
+		return true;
+	}
 
+	const uint8* getRawData() const { return m_bytes; }
+	int getRawDataSize() const { return m_size; }
+	const int64& getTimestamp() const { return m_timestamp; }
+	const int& getExtra() const { return m_extra; }
+
+private:
+	uint8 m_bytes[EVENT_SLOT_MAX_BYTES];
+	int m_size;
+	int64 m_timestamp;
+	int m_extra;
 };
 
+/**
+	Single producer / single consumer queue of events, backed by a fixed slab of slots.
+
+	Nothing is allocated once the queue is built: addEvent() copies into the next free slot
+	and the reader works on the slots in place between startRead() and finishedRead().
+	Events that find the queue full (or don't fit a slot) are dropped and counted in
+	getNumOverruns().
+*/
 template <class EventClass>
 class EventQueue
 {
 public:
-	typedef AsyncEventMessage<EventClass> EventContainer;
-	typedef ReferenceCountedObjectPtr<EventContainer> EventClassPtr;
+	typedef EventSlot<EventClass> Slot;
 
 	EventQueue(int size) :
-		m_fifo(size)
+		m_slots(size),
+		m_fifo(size),
+		m_readPos1(0), m_readSize1(0), m_readPos2(0),
+		m_highWater(0),
+		m_overruns(0)
 	{
-		m_data.resize(size);
 	}
 
 	~EventQueue()
@@ -75,17 +123,43 @@ public:
 		return m_fifo.getNumReady();
 	}
 
+	int getFreeSpace() const
+	{
+		return m_fifo.getFreeSpace();
+	}
+
+	int getSize() const
+	{
+		return m_fifo.getTotalSize();
+	}
+
+	/** Largest number of events waiting at once since the last reset() */
+	int getHighWaterMark() const
+	{
+		return m_highWater.load(std::memory_order_relaxed);
+	}
+
+	/** Number of events dropped since the last reset() */
+	int64 getNumOverruns() const
+	{
+		return m_overruns.load(std::memory_order_relaxed);
+	}
+
+	/** Empties the queue. Only call while neither side is running. */
 	void reset()
 	{
-		m_data.clear();
-		m_data.resize(m_fifo.getTotalSize());
+		m_fifo.reset();
+		m_highWater = 0;
+		m_overruns = 0;
 	}
 
 	void resize(int size)
 	{
-		m_data.clear();
 		m_fifo.setTotalSize(size);
-		m_data.resize(size);
+		m_slots.clear();
+		m_slots.resize(size);
+		m_highWater = 0;
+		m_overruns = 0;
 	}
 
 	void addEvent(const EventClass& ev, int64 t, int extra = 0)
@@ -94,48 +168,76 @@ public:
 		size1 = 0;
 		m_fifo.prepareToWrite(1, pos1, size1, pos2, size2);
 
-		/* This means there is a buffer overrun. Instead of overwritting the existing data and risking a collision of both threads
-			we just skip the incoming samples. TODO: use this to notify of the overrun and act consequently   */
+		/* On a buffer overrun, instead of overwriting data the reader may still be using
+			we skip the incoming event and count it */
+		if (size1 > 0 && m_slots[pos1].set(ev, t, extra))
+			m_fifo.finishedWrite(1);
+		else
+			m_overruns.fetch_add(1, std::memory_order_relaxed);
+
+		updateHighWater();
+	}
+
+	/** Queues a copy of a slot kept somewhere else, without going through the message class */
+	void addSlot(const Slot& slot)
+	{
+		int pos1, size1, pos2, size2;
+		size1 = 0;
+		m_fifo.prepareToWrite(1, pos1, size1, pos2, size2);
+
 		if (size1 > 0)
 		{
-			m_data[pos1] = new EventContainer(ev, t, extra);
+			m_slots[pos1] = slot;
 			m_fifo.finishedWrite(1);
 		}
+		else
+			m_overruns.fetch_add(1, std::memory_order_relaxed);
+
+		updateHighWater();
 	}
 
-	int getEvents(std::vector<EventClassPtr>& vec, int max)
+	/** Makes up to max queued events (all of them if max <= 0) available through getReadSlot(),
+		oldest first. Returns how many; pass that to finishedRead() once they have been written. */
+	int startRead(int max)
 	{
-		int pos1, size1, pos2, size2;
 		int numAvailable = m_fifo.getNumReady();
 		int numToRead = ((max < numAvailable) && (max > 0)) ? max : numAvailable;
-		m_fifo.prepareToRead(numToRead, pos1, size1, pos2, size2);
-		vec.resize(numToRead);
-		for (int i = 0; i < size1; ++i)
-		{
-			vec[i] = m_data[pos1 + i];
-		}
-		if (size2 > 0)
-		{
-			for (int i = 0; i < size2; ++i)
-			{
-				vec[size1 + i] = m_data[pos2 + i];
-			}
-		}
-		m_fifo.finishedRead(numToRead);
-		return numToRead;
+		int size2;
+		m_fifo.prepareToRead(numToRead, m_readPos1, m_readSize1, m_readPos2, size2);
+		return m_readSize1 + size2;
+	}
+
+	const Slot& getReadSlot(int index) const
+	{
+		return (index < m_readSize1) ? m_slots[m_readPos1 + index] : m_slots[m_readPos2 + index - m_readSize1];
+	}
+
+	void finishedRead(int numRead)
+	{
+		m_fifo.finishedRead(numRead);
 	}
 
 private:
-	std::vector<EventClassPtr> m_data;
+	void updateHighWater()
+	{
+		//Single producer, so a plain compare is enough
+		int fill = m_fifo.getNumReady();
+		if (fill > m_highWater.load(std::memory_order_relaxed))
+			m_highWater.store(fill, std::memory_order_relaxed);
+	}
+
+	std::vector<Slot> m_slots;
 	AbstractFifo m_fifo;
 
+	int m_readPos1, m_readSize1, m_readPos2;
+
+	std::atomic<int> m_highWater;
+	std::atomic<int64> m_overruns;
+
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EventQueue);
 };
 
 typedef EventQueue<MidiMessage> EventMsgQueue;
 typedef EventQueue<SpikeObject> SpikeMsgQueue;
-typedef ReferenceCountedObjectPtr<AsyncEventMessage<MidiMessage>> EventMessagePtr;
-typedef ReferenceCountedObjectPtr<AsyncEventMessage<SpikeObject>> SpikeMessagePtr;
 
 #endif  // EVENTQUEUE_H_INCLUDED
-
@@ -25,16 +25,40 @@
 #include "../../AccessClass.h"
 #include "../../Audio/AudioComponent.h"
 
+namespace
+{
+    /** Opens one continuous file and writes its header if it's new */
+    class ChannelFileOpenJob : public ThreadPoolJob
+    {
+    public:
+        ChannelFileOpenJob(const String& path_, const String& header_) : ThreadPoolJob("Open channel file"),
+            path(path_), header(header_), file(nullptr), startPos(0) {}
+
+        JobStatus runJob() override
+        {
+            bool fileExists = File(path).exists();
+            file = fopen(path.toUTF8(), "ab");
+            if (file == nullptr)
+                return jobHasFinished;
+            if (!fileExists)
+                fwrite(header.toUTF8(), 1, header.getNumBytesAsUTF8(), file);
+            else
+                fseek(file, 0, SEEK_END);
+            startPos = ftell(file);
+            return jobHasFinished;
+        }
+
+        const String path;
+        const String header;
+        FILE* file;
+        long int startPos;
+    };
+}
+
 OriginalRecording::OriginalRecording() : separateFiles(false),
     recordingNumber(0), experimentNumber(0),  zeroBuffer(1, 50000),
-    eventFile(nullptr), messageFile(nullptr), lastProcId(0)
+    eventFile(nullptr), messageFile(nullptr), numWriteLanes(1), lastProcId(0)
 {
-    /*continuousDataIntegerBuffer = new int16[10000];
-    continuousDataFloatBuffer = new float[10000];
-
-    recordMarker = new char[10];*/
-	continuousDataIntegerBuffer.malloc(10000);
-	continuousDataFloatBuffer.malloc(10000);
 	recordMarker.malloc(10);
 
     for (int i = 0; i < 9; i++)
@@ -57,9 +81,6 @@ OriginalRecording::~OriginalRecording()
     {
         if (spikeFileArray[i] != nullptr) fclose(spikeFileArray[i]);
     }
- /*   delete continuousDataFloatBuffer;
-    delete continuousDataIntegerBuffer;
-    delete recordMarker;*/
 }
 
 String OriginalRecording::getEngineID() const
@@ -71,6 +92,7 @@ void OriginalRecording::addChannel(int index, const Channel* chan)
 {
     //Just populate the file array with null so we can address it by index afterwards
     fileArray.add(nullptr);
+    channelBuffers.add(nullptr);
     blockIndex.add(0);
     samplesSinceLastTimestamp.add(0);
 }
@@ -83,6 +105,7 @@ void OriginalRecording::addSpikeElectrode(int index, const SpikeRecordInfo* elec
 void OriginalRecording::resetChannels()
 {
     fileArray.clear();
+    channelBuffers.clear();
     spikeFileArray.clear();
     blockIndex.clear();
     processorArray.clear();
@@ -100,16 +123,20 @@ void OriginalRecording::openFiles(File rootFolder, int experimentNumber, int rec
     openFile(rootFolder,nullptr);
     openMessageFile(rootFolder);
 
+    Array<Channel*> channels;
     for (int i = 0; i < fileArray.size(); i++)
     {
         if (getChannel(i)->getRecordState())
         {
-            openFile(rootFolder,getChannel(i));
+            channels.add(getChannel(i));
             blockIndex.set(i,0);
             samplesSinceLastTimestamp.set(i,0);
         }
 
     }
+    openChannelFiles(rootFolder, channels);
+    //Channel files are independent, so they can be written from several threads
+    numWriteLanes = jlimit(1, MAX_WRITE_LANES, getNumRecordedChannels());
     for (int i = 0; i < spikeFileArray.size(); i++)
     {
         openSpikeFile(rootFolder,getSpikeElectrode(i));
@@ -189,12 +216,69 @@ void OriginalRecording::openFile(File rootFolder, Channel* ch)
         c->name = ch->name;
         c->startPos = ftell(chFile);
         c->bitVolts = ch->bitVolts;
+        c->sampleRate = ch->getRecordSampleRate();
         processorArray.getLast()->channels.add(c);
     }
     diskWriteLock.exit();
 
 }
 
+void OriginalRecording::openChannelFiles(File rootFolder, const Array<Channel*>& channels)
+{
+    String folder(rootFolder.getFullPathName() + rootFolder.separatorString);
+    recordPath = folder;
+
+    //Opening hundreds of files one after the other takes a noticeable time at record start
+    OwnedArray<ChannelFileOpenJob> jobs;
+    for (int i = 0; i < channels.size(); i++)
+    {
+        String fullPath = folder + getFileName(channels[i]);
+        std::cout << "OPENING FILE: " << fullPath << std::endl;
+        jobs.add(new ChannelFileOpenJob(fullPath, generateHeader(channels[i])));
+    }
+
+    {
+        ThreadPool pool(jlimit(1, MAX_OPEN_THREADS, jobs.size()));
+        for (int i = 0; i < jobs.size(); i++)
+            pool.addJob(jobs[i], false);
+        for (int i = 0; i < jobs.size(); i++)
+            pool.waitForJobToFinish(jobs[i], -1);
+    }
+
+    for (int i = 0; i < channels.size(); i++)
+    {
+        Channel* ch = channels[i];
+        if (jobs[i]->file == nullptr)
+        {
+            std::cerr << "Error opening file " << jobs[i]->path << std::endl;
+            continue;
+        }
+        fileArray.set(ch->recordIndex,jobs[i]->file);
+
+        ChannelBuffer* buffer = new ChannelBuffer();
+        buffer->data.malloc(RECORDS_PER_WRITE * RECORD_SIZE);
+        buffer->size = 0;
+        buffer->scaled.malloc(BLOCK_LENGTH);
+        channelBuffers.set(ch->recordIndex,buffer);
+
+        if (ch->nodeId != lastProcId)
+        {
+            lastProcId = ch->nodeId;
+            ProcInfo* p = new ProcInfo();
+            p->id = ch->nodeId;
+            p->sampleRate = ch->sampleRate;
+            processorArray.add(p);
+        }
+        ChannelInfo* c = new ChannelInfo();
+        c->filename = getFileName(ch);
+        c->name = ch->name;
+        c->startPos = jobs[i]->startPos;
+        c->bitVolts = ch->bitVolts;
+        c->sampleRate = ch->getRecordSampleRate();
+        processorArray.getLast()->channels.add(c);
+    }
+}
+
 void OriginalRecording::openSpikeFile(File rootFolder, SpikeRecordInfo* elec)
 {
 
@@ -326,8 +410,8 @@ String OriginalRecording::generateHeader(Channel* ch)
     }
 
     header += "header.sampleRate = ";
-    // all channels need to have the same sample rate under the current scheme
-    header += String(getChannel(0)->sampleRate);
+    // events are timestamped at the rate of the first channel, continuous files at the rate they are recorded at
+    header += String((ch == nullptr) ? getChannel(0)->sampleRate : ch->getRecordSampleRate());
     header += ";\n";
     header += "header.blockLength = ";
     header += BLOCK_LENGTH;
@@ -383,25 +467,31 @@ String OriginalRecording::generateSpikeHeader(SpikeRecordInfo* elec)
 }
 
 void OriginalRecording::writeEvent(int eventType, const MidiMessage& event, int64 timestamp)
+{
+    writeEventData(eventType, event.getRawData(), event.getRawDataSize(), timestamp);
+}
+
+void OriginalRecording::writeEventData(int eventType, const uint8* data, int size, int64 timestamp)
 {
     if (isWritableEvent(eventType))
-		writeTTLEvent(event, timestamp);
+		writeTTLEvent(data, timestamp);
     if (eventType == GenericProcessor::MESSAGE)
-		writeMessage(event, timestamp);
+		writeMessage(data, size, timestamp);
 }
 
-void OriginalRecording::writeMessage(const MidiMessage& event, int64 timestamp)
+void OriginalRecording::writeMessage(const uint8* data, int size, int64 timestamp)
 {
     if (messageFile == nullptr)
         return;
 
-    int msgLength = event.getRawDataSize() - 6;
-    const char* dataptr = (const char*)event.getRawData() + 6;
+    int msgLength = size - 6;
+    const char* dataptr = (const char*)data + 6;
 
-    String timestampText(timestamp);
+    char timestampText[24];
+    int textLength = snprintf(timestampText, sizeof(timestampText), "%lld", (long long)timestamp);
 
     diskWriteLock.enter();
-    fwrite(timestampText.toUTF8(),1,timestampText.length(),messageFile);
+    fwrite(timestampText,1,textLength,messageFile);
     fwrite(" ",1,1,messageFile);
     fwrite(dataptr,1,msgLength-1,messageFile);
     fwrite("\n",1,1,messageFile);
@@ -409,7 +499,7 @@ void OriginalRecording::writeMessage(const MidiMessage& event, int64 timestamp)
 
 }
 
-void OriginalRecording::writeTTLEvent(const MidiMessage& event, int64 timestamp)
+void OriginalRecording::writeTTLEvent(const uint8* dataptr, int64 timestamp)
 {
     // find file and write samples to disk
     // std::cout << "Received event!" << std::endl;
@@ -417,8 +507,6 @@ void OriginalRecording::writeTTLEvent(const MidiMessage& event, int64 timestamp)
     if (eventFile == nullptr)
         return;
 
-    const uint8* dataptr = event.getRawData();
-
     //With the new external recording thread, this field has no sense.
 	int16 samplePos = 0;
 
@@ -503,79 +591,75 @@ void OriginalRecording::writeContinuousBuffer(const float* data, int nSamples, i
     if (fileArray[channel] == nullptr)
         return;
 
+    //Records are assembled in the channel's own buffer, so different channels can be written at the same time
+    ChannelBuffer* buffer = channelBuffers[channel];
+
     // scale the data back into the range of int16
     float scaleFactor =  float(0x7fff) * getChannel(channel)->bitVolts;
 
     for (int n = 0; n < nSamples; n++)
     {
-        *(continuousDataFloatBuffer+n) = *(data+n) / scaleFactor;
+        *(buffer->scaled+n) = *(data+n) / scaleFactor;
     }
-    AudioDataConverters::convertFloatToInt16BE(continuousDataFloatBuffer, continuousDataIntegerBuffer, nSamples);
 
     if (blockIndex[channel] == 0)
     {
-        writeTimestampAndSampleCount(fileArray[channel], writeChannel);
+        writeTimestampAndSampleCount(buffer, writeChannel, channel);
     }
 
-    diskWriteLock.enter();
-
-    size_t count = fwrite(continuousDataIntegerBuffer, // ptr
-                          2,                               // size of each element
-                          nSamples,                        // count
-                          fileArray[channel]); // ptr to FILE object
-
-    //std::cout << channel << " : " << nSamples << " : " << count << std::endl;
-
-    jassert(count == nSamples); // make sure all the data was written
-    (void)count;  // Suppress unused variable warning in release builds
-
-    diskWriteLock.exit();
+    AudioDataConverters::convertFloatToInt16BE(buffer->scaled, buffer->data + buffer->size, nSamples);
+    buffer->size += 2 * nSamples;
 
     if (blockIndex[channel] + nSamples == BLOCK_LENGTH)
     {
-        writeRecordMarker(fileArray[channel]);
+        writeRecordMarker(buffer);
+        if (buffer->size + RECORD_SIZE > RECORDS_PER_WRITE * RECORD_SIZE)
+            flushChannelBuffer(channel);
     }
 }
 
-void OriginalRecording::writeTimestampAndSampleCount(FILE* file, int channel)
+void OriginalRecording::writeTimestampAndSampleCount(ChannelBuffer* buffer, int writeChannel, int channel)
 {
-    diskWriteLock.enter();
-
     uint16 samps = BLOCK_LENGTH;
 
-   // int sourceNodeId = getChannel(channel)->sourceNodeId;
+    int64 ts = getTimestamp(writeChannel) + samplesSinceLastTimestamp[channel];
 
-    int64 ts = getTimestamp(channel) + samplesSinceLastTimestamp[channel];
+    char* dst = buffer->data + buffer->size;
+    memcpy(dst, &ts, 8);
+    memcpy(dst + 8, &samps, 2);
+    memcpy(dst + 10, &recordingNumber, 2);
+    buffer->size += 12;
+}
 
-    fwrite(&ts,                       // ptr
-           8,                               // size of each element
-           1,                               // count
-           file); // ptr to FILE object
+void OriginalRecording::writeRecordMarker(ChannelBuffer* buffer)
+{
+    // write a 10-byte marker indicating the end of a record
+    memcpy(buffer->data + buffer->size, recordMarker, 10);
+    buffer->size += 10;
+}
 
-    fwrite(&samps,                           // ptr
-           2,                               // size of each element
-           1,                               // count
-           file); // ptr to FILE object
+void OriginalRecording::flushChannelBuffer(int channel)
+{
+    ChannelBuffer* buffer = channelBuffers[channel];
+    if (buffer == nullptr || buffer->size == 0)
+        return;
 
-    fwrite(&recordingNumber,                         // ptr
-           2,                               // size of each element
-           1,                               // count
-           file); // ptr to FILE object
+    size_t count = fwrite(buffer->data, 1, buffer->size, fileArray[channel]);
 
-    diskWriteLock.exit();
+    jassert(count == buffer->size); // make sure all the data was written
+    (void)count;  // Suppress unused variable warning in release builds
+
+    buffer->size = 0;
 }
 
-void OriginalRecording::writeRecordMarker(FILE* file)
+int OriginalRecording::getNumWriteLanes() const
 {
-    // write a 10-byte marker indicating the end of a record
-
-    diskWriteLock.enter();
-    fwrite(recordMarker,        // ptr
-           1,                   // size of each element
-           10,                  // count
-           file);               // ptr to FILE object
+    return numWriteLanes;
+}
 
-    diskWriteLock.exit();
+int OriginalRecording::getWriteLane(int writeChannel) const
+{
+    return writeChannel % numWriteLanes;
 }
 
 void OriginalRecording::closeFiles()
@@ -588,10 +672,9 @@ void OriginalRecording::closeFiles()
             {
                 // fill out the rest of the current buffer
                 writeContinuousBuffer(zeroBuffer.getReadPointer(0), BLOCK_LENGTH - blockIndex[i], i);
-                diskWriteLock.enter();
+                flushChannelBuffer(i);
                 fclose(fileArray[i]);
                 fileArray.set(i,nullptr);
-                diskWriteLock.exit();
             }
         }
 
@@ -692,6 +775,8 @@ void OriginalRecording::writeXml()
             XmlElement* chan = new XmlElement("CHANNEL");
             chan->setAttribute("name",c->name);
             chan->setAttribute("bitVolts",c->bitVolts);
+            if (c->sampleRate != processorArray[i]->sampleRate)
+                chan->setAttribute("samplerate",c->sampleRate);
             chan->setAttribute("filename",c->filename);
             chan->setAttribute("position",(double)(c->startPos)); //As long as the file doesnt exceed 2^53 bytes, this will have integer precission. Better than limiting to 32bits.
             proc->addChildElement(chan);
@@ -34,6 +34,13 @@
 
 #define VERSION 0.4
 
+//Bytes in one continuous record: timestamp, sample count, recording number, samples and record marker
+#define RECORD_SIZE (8 + 2 + 2 + 2*BLOCK_LENGTH + 10)
+//Records kept in memory per channel before they are written to disk
+#define RECORDS_PER_WRITE 16
+#define MAX_WRITE_LANES 4
+#define MAX_OPEN_THREADS 8
+
 #define VSTR(s) #s
 #define VSTR2(s) VSTR(s)
 #define VERSION_STRING VSTR2(VERSION)
@@ -50,27 +57,40 @@ public:
 	void closeFiles() override;
 	void writeData(int writeChannel, int realChannel, const float* buffer, int size) override;
 	void writeEvent(int eventType, const MidiMessage& event, int64 timestamp) override;
+	void writeEventData(int eventType, const uint8* data, int size, int64 timestamp) override;
 	void addChannel(int index, const Channel* chan) override;
 	void resetChannels() override;
 	void addSpikeElectrode(int index, const SpikeRecordInfo* elec) override;
 	void writeSpike(int electrodeIndex, const SpikeObject& spike, int64 timestamp) override;
+	int getNumWriteLanes() const override;
+	int getWriteLane(int writeChannel) const override;
 
     static RecordEngineManager* getEngineManager();
 
 private:
+    /** Continuous records of one channel waiting to be written */
+    struct ChannelBuffer
+    {
+        HeapBlock<char> data;
+        int size;
+        HeapBlock<float> scaled;
+    };
+
     String getFileName(Channel* ch);
     void openFile(File rootFolder, Channel* ch);
+    void openChannelFiles(File rootFolder, const Array<Channel*>& channels);
     String generateHeader(Channel* ch);
     void writeContinuousBuffer(const float* data, int nSamples, int channel);
-    void writeTimestampAndSampleCount(FILE* file, int channel);
-    void writeRecordMarker(FILE* file);
+    void writeTimestampAndSampleCount(ChannelBuffer* buffer, int writeChannel, int channel);
+    void writeRecordMarker(ChannelBuffer* buffer);
+    void flushChannelBuffer(int channel);
 
     void openSpikeFile(File rootFolder, SpikeRecordInfo* elec);
     String generateSpikeHeader(SpikeRecordInfo* elec);
 
     void openMessageFile(File rootFolder);
-    void writeTTLEvent(const MidiMessage& event, int64 timestamp);
-    void writeMessage(const MidiMessage& event, int64 timestamp);
+    void writeTTLEvent(const uint8* data, int64 timestamp);
+    void writeMessage(const uint8* data, int size, int64 timestamp);
 
     void writeXml();
 
@@ -83,18 +103,6 @@ private:
     bool renameFiles;
     String renamedPrefix;
 
-    /** Holds data that has been converted from float to int16 before
-        saving.
-    */
-	HeapBlock<int16> continuousDataIntegerBuffer;
-    //int16* continuousDataIntegerBuffer;
-
-    /** Holds data that has been converted from float to int16 before
-        saving.
-    */
-	HeapBlock<float> continuousDataFloatBuffer;
-    //float* continuousDataFloatBuffer;
-
     /** Used to indicate the end of each record */
 	HeapBlock<char> recordMarker;
     //char* recordMarker;
@@ -104,7 +112,9 @@ private:
     FILE* eventFile;
     FILE* messageFile;
     Array<FILE*> fileArray;
+    OwnedArray<ChannelBuffer> channelBuffers;
     Array<FILE*> spikeFileArray;
+    int numWriteLanes;
 
     CriticalSection diskWriteLock;
 
@@ -113,6 +123,7 @@ private:
         String name;
         String filename;
         float bitVolts;
+        float sampleRate;
         long int startPos;
     };
     struct ProcInfo
@@ -0,0 +1,166 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "PreTriggerBuffer.h"
+
+PreTriggerBuffer::PreTriggerBuffer() :
+m_buffer(0, 0),
+m_size(0),
+m_eventWriteIndex(0),
+m_numEvents(0)
+{
+}
+
+PreTriggerBuffer::~PreTriggerBuffer()
+{
+}
+
+void PreTriggerBuffer::setSize(int numChannels, int numSamples)
+{
+	if (numChannels <= 0 || numSamples <= 0)
+	{
+		numChannels = 0;
+		numSamples = 0;
+	}
+	m_size = numSamples;
+	m_buffer.setSize(numChannels, numSamples);
+	m_writeIndexes.clearQuick();
+	m_writeIndexes.insertMultiple(0, 0, numChannels);
+	m_numSamples.clearQuick();
+	m_numSamples.insertMultiple(0, 0, numChannels);
+	m_endTimestamps.clearQuick();
+	m_endTimestamps.insertMultiple(0, 0, numChannels);
+	m_firstTimestamps.clearQuick();
+	m_firstTimestamps.insertMultiple(0, 0, numChannels);
+
+	if (numChannels > 0)
+		m_events.resize(PRETRIGGER_EVENTS);
+	else
+		std::vector<EventSlot<MidiMessage>>().swap(m_events);
+	m_eventWriteIndex = 0;
+	m_numEvents = 0;
+}
+
+void PreTriggerBuffer::clear()
+{
+	for (int i = 0; i < m_writeIndexes.size(); ++i)
+	{
+		m_writeIndexes.set(i, 0);
+		m_numSamples.set(i, 0);
+		m_endTimestamps.set(i, 0);
+		m_firstTimestamps.set(i, 0);
+	}
+	m_eventWriteIndex = 0;
+	m_numEvents = 0;
+}
+
+int PreTriggerBuffer::getNumChannels() const
+{
+	return m_buffer.getNumChannels();
+}
+
+int PreTriggerBuffer::getSize() const
+{
+	return m_size;
+}
+
+void PreTriggerBuffer::addChannel(const AudioSampleBuffer& buffer, int channel, int nSamples, int64 timestamp)
+{
+	if (nSamples <= 0 || m_size == 0)
+		return;
+
+	//The history has to be contiguous, anything before a timestamp jump is dropped
+	if (timestamp != m_endTimestamps[channel] || m_numSamples[channel] == 0)
+	{
+		m_numSamples.set(channel, 0);
+		m_firstTimestamps.set(channel, timestamp);
+	}
+
+	//Only the newest samples fit if the block is longer than the history
+	int skip = jmax(0, nSamples - m_size);
+	int numToCopy = nSamples - skip;
+	int writeIndex = m_writeIndexes[channel];
+
+	int size1 = jmin(numToCopy, m_size - writeIndex);
+	m_buffer.copyFrom(channel, writeIndex, buffer, channel, skip, size1);
+	if (size1 < numToCopy)
+		m_buffer.copyFrom(channel, 0, buffer, channel, skip + size1, numToCopy - size1);
+
+	m_writeIndexes.set(channel, (writeIndex + numToCopy) % m_size);
+	m_numSamples.set(channel, jmin(m_size, m_numSamples[channel] + numToCopy));
+	m_endTimestamps.set(channel, timestamp + nSamples);
+}
+
+void PreTriggerBuffer::addEvent(const MidiMessage& event, int64 timestamp, int eventType)
+{
+	if (m_events.empty())
+		return;
+
+	if (!m_events[m_eventWriteIndex].set(event, timestamp, eventType))
+		return;
+	m_eventWriteIndex = (m_eventWriteIndex + 1) % PRETRIGGER_EVENTS;
+	m_numEvents = jmin(PRETRIGGER_EVENTS, m_numEvents + 1);
+}
+
+int64 PreTriggerBuffer::getStartTimestamp(int channel) const
+{
+	return m_endTimestamps[channel] - m_numSamples[channel];
+}
+
+int64 PreTriggerBuffer::getFirstTimestamp(int channel) const
+{
+	return m_firstTimestamps[channel];
+}
+
+int64 PreTriggerBuffer::getEndTimestamp(int channel) const
+{
+	return m_endTimestamps[channel];
+}
+
+void PreTriggerBuffer::getRange(int channel, int64 from, int64 to, CircularBufferIndexes& indexes) const
+{
+	int numSamples = jmax(0, int(to - from));
+	int offset = int(m_endTimestamps[channel] - from);
+	int readIndex = (m_size > 0) ? (m_writeIndexes[channel] - offset + m_size) % m_size : 0;
+
+	indexes.index1 = readIndex;
+	indexes.size1 = jmin(numSamples, m_size - readIndex);
+	indexes.index2 = 0;
+	indexes.size2 = numSamples - indexes.size1;
+}
+
+const AudioSampleBuffer& PreTriggerBuffer::getAudioBufferReference() const
+{
+	return m_buffer;
+}
+
+int PreTriggerBuffer::getNumEvents() const
+{
+	return m_numEvents;
+}
+
+const EventSlot<MidiMessage>& PreTriggerBuffer::getEvent(int index) const
+{
+	int first = (m_eventWriteIndex - m_numEvents + PRETRIGGER_EVENTS) % PRETRIGGER_EVENTS;
+	return m_events[(first + index) % PRETRIGGER_EVENTS];
+}
@@ -0,0 +1,105 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef PRETRIGGERBUFFER_H_INCLUDED
+#define PRETRIGGERBUFFER_H_INCLUDED
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+#include "EventQueue.h"
+#include "DataQueue.h"
+#include <vector>
+
+/** Number of events the history keeps, older ones are overwritten */
+#define PRETRIGGER_EVENTS 1024
+
+/**
+	In-memory history of the last few seconds of every continuous channel and of the events
+	that came with them.
+
+	The RecordNode appends every block to it while acquiring, recording or not, and moves
+	ranges of it into the DataQueue: the seconds before the trigger when recording starts, or
+	the windows around the gate events in gated mode. Each channel is a ring of its own, and
+	as all samples of a channel are contiguous, its timestamps are just the one of the
+	newest sample and the number of samples held.
+
+	Only used from the audio thread once acquisition has started.
+
+	@see RecordNode
+*/
+class PreTriggerBuffer
+{
+public:
+	PreTriggerBuffer();
+	~PreTriggerBuffer();
+
+	/** Makes room for numSamples per channel and empties the history. Zero channels frees it. */
+	void setSize(int numChannels, int numSamples);
+
+	/** Forgets everything held, keeping the memory */
+	void clear();
+
+	int getNumChannels() const;
+	int getSize() const;
+
+	/** Appends nSamples of a channel, which is also its row in buffer */
+	void addChannel(const AudioSampleBuffer& buffer, int channel, int nSamples, int64 timestamp);
+
+	void addEvent(const MidiMessage& event, int64 timestamp, int eventType);
+
+	/** Timestamp of the oldest sample held for the channel */
+	int64 getStartTimestamp(int channel) const;
+
+	/** Timestamp of the first sample the channel got since its history last started over, at the
+	start of acquisition or at a timestamp jump. Nothing before it was ever held. */
+	int64 getFirstTimestamp(int channel) const;
+
+	/** Timestamp the next sample of the channel will have */
+	int64 getEndTimestamp(int channel) const;
+
+	/** Where the held samples of a channel with timestamps in [from, to) are in the row of the
+	channel in getAudioBufferReference(). The range must be inside the history. */
+	void getRange(int channel, int64 from, int64 to, CircularBufferIndexes& indexes) const;
+
+	const AudioSampleBuffer& getAudioBufferReference() const;
+
+	/** Number of events held, oldest first for getEvent() */
+	int getNumEvents() const;
+
+	const EventSlot<MidiMessage>& getEvent(int index) const;
+
+private:
+	AudioSampleBuffer m_buffer;
+	Array<int> m_writeIndexes;
+	Array<int> m_numSamples;
+	Array<int64> m_endTimestamps;
+	Array<int64> m_firstTimestamps;
+	int m_size;
+
+	std::vector<EventSlot<MidiMessage>> m_events;
+	int m_eventWriteIndex;
+	int m_numEvents;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PreTriggerBuffer);
+};
+
+#endif  // PRETRIGGERBUFFER_H_INCLUDED
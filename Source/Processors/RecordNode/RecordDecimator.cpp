@@ -0,0 +1,130 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "RecordDecimator.h"
+
+RecordDecimator::RecordDecimator() :
+m_factor(1),
+m_numTaps(1),
+m_started(false),
+m_nextTimestamp(0),
+m_firstOutput(0),
+m_nextOutput(0)
+{
+	setFactor(1);
+}
+
+RecordDecimator::~RecordDecimator()
+{
+}
+
+void RecordDecimator::setFactor(int factor)
+{
+	m_factor = jlimit(1, MAX_RECORD_DECIMATION, factor);
+	const int delay = DECIMATOR_HALF_LENGTH * m_factor;
+	m_numTaps = 2 * delay + 1;
+	m_taps.allocate(m_numTaps, true);
+	m_input.allocate(m_numTaps - 1 + DECIMATOR_CHUNK, true);
+
+	//Windowed sinc, normalized for unity gain at DC
+	const double cutoff = DECIMATOR_CUTOFF / m_factor;
+	double sum = 0;
+	for (int n = 0; n < m_numTaps; ++n)
+	{
+		double x = n - delay;
+		double sinc = (x == 0) ? 2 * cutoff : std::sin(2 * double_Pi * cutoff * x) / (double_Pi * x);
+		double phase = (m_numTaps > 1) ? 2 * double_Pi * n / (m_numTaps - 1) : 0;
+		double window = 0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2 * phase);
+		m_taps[n] = float(sinc * window);
+		sum += sinc * window;
+	}
+	for (int n = 0; n < m_numTaps; ++n)
+		m_taps[n] = float(m_taps[n] / sum);
+
+	reset();
+}
+
+int RecordDecimator::getFactor() const
+{
+	return m_factor;
+}
+
+void RecordDecimator::reset()
+{
+	m_started = false;
+}
+
+int RecordDecimator::process(const float* input, int nSamples, int64 timestamp, float* output, int64& outputTimestamp)
+{
+	const int history = m_numTaps - 1;
+	const int delay = history / 2;
+	nSamples = jmin(nSamples, DECIMATOR_CHUNK);
+	outputTimestamp = m_nextOutput;
+	if (nSamples <= 0)
+		return 0;
+
+	if (!m_started || timestamp != m_nextTimestamp)
+	{
+		//New stretch: the first sample is repeated back in time, and outputs start
+		//at the first kept sample inside the stretch
+		for (int i = 0; i < history; ++i)
+			m_input[i] = input[0];
+		m_firstOutput = (timestamp + m_factor - 1) / m_factor;
+		m_nextOutput = m_firstOutput;
+		m_started = true;
+	}
+	memcpy(m_input + history, input, nSamples * sizeof(float));
+
+	//The filter for output k, centered on input k * factor, ends at input k * factor + delay,
+	//so m_input[0] holds input timestamp - history
+	outputTimestamp = m_nextOutput;
+	const int64 lastInput = timestamp + nSamples - 1;
+	int numOutput = 0;
+	while (m_nextOutput * m_factor + delay <= lastInput)
+	{
+		const float* x = m_input + int(m_nextOutput * m_factor + delay - timestamp);
+		const float* h = m_taps;
+		float acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+		int n = 0;
+		for (; n + 3 < m_numTaps; n += 4)
+		{
+			acc0 += x[n] * h[n];
+			acc1 += x[n + 1] * h[n + 1];
+			acc2 += x[n + 2] * h[n + 2];
+			acc3 += x[n + 3] * h[n + 3];
+		}
+		for (; n < m_numTaps; ++n)
+			acc0 += x[n] * h[n];
+		output[numOutput++] = (acc0 + acc1) + (acc2 + acc3);
+		m_nextOutput++;
+	}
+
+	memmove(m_input, m_input + nSamples, history * sizeof(float));
+	m_nextTimestamp = timestamp + nSamples;
+	return numOutput;
+}
+
+bool RecordDecimator::isFilling() const
+{
+	return !m_started || m_nextOutput == m_firstOutput;
+}
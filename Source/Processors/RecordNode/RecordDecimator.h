@@ -0,0 +1,92 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef RECORDDECIMATOR_H_INCLUDED
+#define RECORDDECIMATOR_H_INCLUDED
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+
+/** Largest factor a channel can be decimated by for recording */
+#define MAX_RECORD_DECIMATION 64
+/** Output samples the filter reaches on each side; it is 2 * DECIMATOR_HALF_LENGTH * factor + 1 taps long */
+#define DECIMATOR_HALF_LENGTH 12
+/** Passband edge, as a fraction of the output sample rate */
+#define DECIMATOR_CUTOFF 0.4
+/** Input samples filtered per pass */
+#define DECIMATOR_CHUNK 4096
+
+/**
+	Anti-aliased decimation of one channel for recording at a lower rate.
+
+	A linear phase FIR low-pass (Blackman windowed sinc) evaluated only at the input samples that
+	are kept, which is the polyphase form of filtering and then dropping factor - 1 of every
+	factor samples. Samples are kept where the input timestamp is a multiple of the factor, and
+	each output gets the timestamp of the input sample at the center of the filter divided by the
+	factor, so the filter delay is accounted for and timestamps are exact in units of the new rate.
+
+	A jump in the input timestamps starts a new stretch: the filter is primed with the first
+	sample and only outputs centered inside the stretch are produced, so the last
+	DECIMATOR_HALF_LENGTH outputs of a stretch are never written.
+
+	Only used from the audio thread once recording has started.
+
+	@see RecordNode
+*/
+class RecordDecimator
+{
+public:
+	RecordDecimator();
+	~RecordDecimator();
+
+	/** Designs the filter for factor and starts over. Allocates, so not from the audio thread. */
+	void setFactor(int factor);
+	int getFactor() const;
+
+	/** Forgets the input seen so far */
+	void reset();
+
+	/** Filters nSamples, at most DECIMATOR_CHUNK, whose first one has the given timestamp.
+	Writes the decimated samples to output, which needs room for nSamples / factor + 1,
+	and returns how many there are, with the timestamp of the first one in outputTimestamp. */
+	int process(const float* input, int nSamples, int64 timestamp, float* output, int64& outputTimestamp);
+
+	/** True until the filter has produced the first sample of the current stretch, including
+	before it got any input */
+	bool isFilling() const;
+
+private:
+	HeapBlock<float> m_taps;
+	/** The last m_numTaps - 1 input samples followed by the chunk being filtered */
+	HeapBlock<float> m_input;
+	int m_factor;
+	int m_numTaps;
+
+	bool m_started;
+	int64 m_nextTimestamp;
+	int64 m_firstOutput;
+	int64 m_nextOutput;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RecordDecimator);
+};
+
+#endif  // RECORDDECIMATOR_H_INCLUDED
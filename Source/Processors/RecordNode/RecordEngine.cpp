@@ -29,6 +29,10 @@
 #include "EngineConfigWindow.h"
 #include "OriginalRecording.h"
 
+#if JUCE_INTEL
+#include <emmintrin.h>
+#endif
+
 RecordEngine::RecordEngine()
     : manager (nullptr)
 {
@@ -48,6 +52,72 @@ void RecordEngine::startChannelBlock (bool lastBlock) {}
 
 void RecordEngine::endChannelBlock (bool lastBlock) {}
 
+bool RecordEngine::supportsBlockWrites() const
+{
+    return false;
+}
+
+void RecordEngine::writeBlock (const Array<int>& writeChannels, const Array<int>& realChannels, const float* const* data, int size)
+{
+    for (int i = 0; i < writeChannels.size(); i++)
+        writeData (writeChannels[i], realChannels[i], data[i], size);
+}
+
+bool RecordEngine::acceptsIntegerData() const
+{
+    return false;
+}
+
+void RecordEngine::writeIntegerData (int writeChannel, int realChannel, const int16* buffer, int size) {}
+
+void RecordEngine::writeIntegerBlock (const Array<int>& writeChannels, const Array<int>& realChannels, const int16* const* data, int size)
+{
+    for (int i = 0; i < writeChannels.size(); i++)
+        writeIntegerData (writeChannels[i], realChannels[i], data[i], size);
+}
+
+int RecordEngine::getNumWriteLanes() const
+{
+    return 1;
+}
+
+int RecordEngine::getWriteLane (int writeChannel) const
+{
+    return 0;
+}
+
+void RecordEngine::writeEventData (int eventType, const uint8* data, int size, int64 timestamp)
+{
+    writeEvent (eventType, MidiMessage (data, size), timestamp);
+}
+
+void RecordEngine::convertToInt16 (int16* dest, const float* source, float scale, int numSamples)
+{
+    const double maxVal = (double) 0x7fff;
+    int i = 0;
+#if JUCE_INTEL
+    const __m128 vScale = _mm_set1_ps (scale);
+    const __m128d vMax = _mm_set1_pd (maxVal);
+    const __m128d vMin = _mm_set1_pd (-maxVal);
+    for (; i <= numSamples - 4; i += 4)
+    {
+        __m128 s = _mm_mul_ps (_mm_loadu_ps (source + i), vScale);
+        __m128d lo = _mm_cvtps_pd (s);
+        __m128d hi = _mm_cvtps_pd (_mm_movehl_ps (s, s));
+        lo = _mm_min_pd (_mm_max_pd (_mm_mul_pd (lo, vMax), vMin), vMax);
+        hi = _mm_min_pd (_mm_max_pd (_mm_mul_pd (hi, vMax), vMin), vMax);
+        //cvtpd rounds to nearest even, as roundToInt does
+        __m128i ints = _mm_unpacklo_epi64 (_mm_cvtpd_epi32 (lo), _mm_cvtpd_epi32 (hi));
+        _mm_storel_epi64 (reinterpret_cast<__m128i*> (dest + i), _mm_packs_epi32 (ints, ints));
+    }
+#endif
+    for (; i < numSamples; i++)
+    {
+        float s = source[i] * scale;
+        dest[i] = (int16) roundToInt (jlimit (-maxVal, maxVal, maxVal * s));
+    }
+}
+
 Channel* RecordEngine::getChannel (int index) const
 {
     return AccessClass::getProcessorGraph()->getRecordNode()->getDataChannel (index);
@@ -116,6 +186,11 @@ int RecordEngine::getChannelNumInProc (int channel) const
     return chanOrderMap[channel];
 }
 
+bool RecordEngine::isRecordingGated() const
+{
+    return AccessClass::getProcessorGraph()->getRecordNode()->isRecordGated();
+}
+
 const String& RecordEngine::getLatestSettingsXml() const
 {
 	return AccessClass::getProcessorGraph()->getRecordNode()->getLastSettingsXml();
@@ -55,6 +55,7 @@ struct RecordProcessorInfo
 {
 	int processorId; 
 	Array<int> recordedChannels; //Indexes of the recorded channels. From 0-maxRecordChannels, not 0-totalChannels
+	int decimation; //All the channels of a group are recorded at the processor rate divided by this
 };
 
 struct EngineParameter;
@@ -83,9 +84,10 @@ public:
       During recording: (RecordThread loop)
         1-(updateTimestamps*) (can be called in a per-channel basis when the circular buffer wraps)
         2-startChannelBlock*
-        3-writeData* (per channel. Can be called more than once to account for the circular buffer wrap)
+        3-writeData* (per channel, or writeIntegerData if acceptsIntegerData. Can be called more than once to account for the circular buffer wrap.
+          Channels in different write lanes, and different engines, may be written concurrently)
         4-endChannelBlock*
-        4-writeEvent* (if needed)
+        4-writeEventData* (if needed)
         5-writeSpike* (if needed)
       When recording stops:
         closeFiles*
@@ -114,9 +116,46 @@ public:
     /** Called by the record thread after it has written a channel block */
     virtual void endChannelBlock (bool lastBlock);
 
+    /** Returns true if the engine implements writeBlock. Defaults to false */
+    virtual bool supportsBlockWrites() const;
+
+    /** Writes the same time window of all the channels of a write lane at once. data[i] holds
+        size samples of writeChannels[i], whose actual channel number is realChannels[i].
+        Only called if supportsBlockWrites returns true, and only when every channel in the lane
+        has the same timestamp and block layout; otherwise writeData is called per channel.  */
+    virtual void writeBlock (const Array<int>& writeChannels, const Array<int>& realChannels, const float* const* data, int size);
+
+    /** Returns true if the engine can take continuous data already converted to int16.
+        The record thread then converts every channel once per window, shared between all
+        the engines that accept it, and calls writeIntegerData/writeIntegerBlock instead of
+        writeData/writeBlock. Defaults to false */
+    virtual bool acceptsIntegerData() const;
+
+    /** Same as writeData, with the samples already scaled and converted by convertToInt16.
+        Only called if acceptsIntegerData returns true */
+    virtual void writeIntegerData (int writeChannel, int realChannel, const int16* buffer, int size);
+
+    /** Integer counterpart of writeBlock, called under the same conditions. Defaults to calling
+        writeIntegerData for each channel */
+    virtual void writeIntegerBlock (const Array<int>& writeChannels, const Array<int>& realChannels, const int16* const* data, int size);
+
+    /** Returns the number of outputs (typically files) that can be written independently.
+        Called once after openFiles. Defaults to a single lane. */
+    virtual int getNumWriteLanes() const;
+
+    /** Returns the lane, between 0 and getNumWriteLanes()-1, a recorded channel belongs to.
+        writeData calls for channels of the same lane always come in order from a single thread,
+        but calls for different lanes can run at the same time. */
+    virtual int getWriteLane (int writeChannel) const;
+
     /** Write a single event to disk.  */
     virtual void writeEvent (int eventType, const MidiMessage& event, int64 timestamp) = 0;
 
+    /** Writes an event from its raw bytes, which is how the RecordThread gets them from the event
+        queue. Engines that override it avoid building a MidiMessage, which allocates for anything
+        over four bytes. The default wraps the bytes in one and calls writeEvent. */
+    virtual void writeEventData (int eventType, const uint8* data, int size, int64 timestamp);
+
     /** Called when acquisition starts once for each processor that might record continuous data */
     virtual void registerProcessor (const GenericProcessor* processor);
 
@@ -153,6 +192,11 @@ public:
     void registerManager (RecordEngineManager* engineManager);
     void configureEngine();
 
+    /** Multiplies numSamples samples by scale and stores them as int16, with the same result as
+        FloatVectorOperations::copyWithMultiply followed by AudioDataConverters::convertFloatToInt16LE.
+        The scale that turns a channel's samples into ADC counts is 1 / (0x7fff * bitVolts) */
+    static void convertToInt16 (int16* dest, const float* source, float scale, int numSamples);
+
     //Method needed by the factory methods in the manager
     //static RecordEngineManager* getEngineManager();
 
@@ -194,6 +238,11 @@ protected:
     */
     int getChannelNumInProc (int channel) const;
 
+    /** Returns true if RecordNode only writes the continuous data inside gate windows,
+        so the timestamps of consecutive blocks can jump
+    */
+    bool isRecordingGated() const;
+
 	/** Gets the last created settings.xml in text form. Should be called at file opening to get the latest version.
 		Since the string will be large, returns a const reference. It should never be const_casted.
 	*/
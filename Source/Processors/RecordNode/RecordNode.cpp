@@ -29,6 +29,10 @@
 #include "RecordEngine.h"
 #include "RecordThread.h"
 #include "DataQueue.h"
+#include "PreTriggerBuffer.h"
+#include "RecordDecimator.h"
+#include "../SourceNode/SourceNode.h"
+#include "../DataThreads/DataThread.h"
 
 #define EVERY_ENGINE for(int eng = 0; eng < engineArray.size(); eng++) engineArray[eng]
 
@@ -38,12 +42,24 @@
 
 RecordNode::RecordNode()
     : GenericProcessor("Record Node"),
-      newDirectoryNeeded(true),  timestamp(0)
+      newDirectoryNeeded(true),  timestamp(0), m_decimatedBuffer(1, DECIMATOR_CHUNK / 2 + 1)
 {
 
     isProcessing = false;
     isRecording = false;
 	setFirstBlock = false;
+	blockingWrites = false;
+	m_spillFileSize = 0;
+	m_preTriggerSeconds = 0;
+	m_gatePreSeconds = 0;
+	m_gatePostSeconds = 0;
+	m_gated = false;
+	m_recordStartPending = false;
+	m_recordingBlock = false;
+	m_numGateWindows = 0;
+	m_lostHistorySamples = 0;
+	m_numChannelsWaiting = 0;
+	m_gateWindows.calloc(RECORD_GATE_WINDOWS);
 
     settings.numInputs = 2048;
     settings.numOutputs = 0;
@@ -63,6 +79,7 @@ RecordNode::RecordNode()
 	m_eventQueue = new EventMsgQueue(EVENT_BUFFER_NEVENTS);
 	m_spikeQueue = new SpikeMsgQueue(SPIKE_BUFFER_NSPIKES);
 	m_recordThread->setQueuePointers(m_dataQueue, m_eventQueue, m_spikeQueue);
+	m_preTrigger = new PreTriggerBuffer();
 }
 
 
@@ -94,6 +111,15 @@ void RecordNode::setChannelStatus(Channel* ch, bool status)
 
 }
 
+bool RecordNode::setChannelDecimation(Channel* ch, int factor)
+{
+	if (isRecording || ch == nullptr)
+		return false;
+
+	ch->setRecordDecimation(jlimit(1, MAX_RECORD_DECIMATION, factor));
+	return true;
+}
+
 
 void RecordNode::resetConnections()
 {
@@ -118,6 +144,12 @@ void RecordNode::filenameComponentChanged(FilenameComponent* fnc)
 
 }
 
+void RecordNode::setDataDirectory(const File& directory)
+{
+	dataDirectory = directory;
+	newDirectoryNeeded = true;
+}
+
 
 void RecordNode::getChannelNamesAndRecordingStatus(StringArray& names, Array<bool>& recording)
 {
@@ -195,7 +227,9 @@ String RecordNode::generateDirectoryName()
     t.add(calendar.getMinutes());
     t.add(calendar.getSeconds());
 
-    String filename = AccessClass::getControlPanel()->getTextToPrepend();
+    ControlPanel* controlPanel = AccessClass::getControlPanel();
+
+    String filename = controlPanel != nullptr ? controlPanel->getTextToPrepend() : String::empty;
 
     String datestring = "";
 
@@ -212,10 +246,13 @@ String RecordNode::generateDirectoryName()
             datestring += "-";
     }
 
-    AccessClass::getControlPanel()->setDateText(datestring);
-
     filename += datestring;
-    filename += AccessClass::getControlPanel()->getTextToAppend();
+
+    if (controlPanel != nullptr)
+    {
+        controlPanel->setDateText(datestring);
+        filename += controlPanel->getTextToAppend();
+    }
 
     return filename;
 
@@ -296,7 +333,7 @@ void RecordNode::setParameter(int parameterIndex, float newValue)
         {
             rootFolder.createDirectory();
         }
-        if (settingsNeeded)
+        if (settingsNeeded && AccessClass::getEditorViewport() != nullptr)
         {
             String settingsFileName = rootFolder.getFullPathName() + File::separator + "settings" + ((experimentNumber > 1) ? "_" + String(experimentNumber) : String::empty) + ".xml";
             AccessClass::getEditorViewport()->saveState(File(settingsFileName), m_lastSettingsText);
@@ -310,30 +347,47 @@ void RecordNode::setParameter(int parameterIndex, float newValue)
 		OwnedArray<RecordProcessorInfo> procInfo;
 		Array<int> chanProcessorMap;
 		Array<int> chanOrderinProc;
+		Array<float> chanBitVolts;
 		int lastProcessor = -1;
-		int procIndex = -1;
-		int chanProcOrder = 0;
+		int firstProcIndex = 0;
+		m_decimators.clear();
 		for (int ch = 0; ch < totChans; ++ch)
 		{
 			Channel* chan = channelPointers[ch];
 			if (chan->getRecordState())
 			{
 				channelMap.add(ch);
+				chanBitVolts.add(chan->bitVolts);
 				//This is bassed on the assumption that all channels from the same processor are added contiguously
 				//If this behaviour changes, this check should be most thorough
 				if (chan->nodeId != lastProcessor)
 				{
 					lastProcessor = chan->nodeId;
+					firstProcIndex = procInfo.size();
+				}
+				//Each record rate of a processor is a group of its own
+				int decimation = chan->getRecordDecimation();
+				int procIndex = firstProcIndex;
+				while (procIndex < procInfo.size() && procInfo[procIndex]->decimation != decimation)
+					procIndex++;
+				if (procIndex == procInfo.size())
+				{
 					RecordProcessorInfo* pi = new RecordProcessorInfo();
 					pi->processorId = chan->nodeId;
+					pi->decimation = decimation;
 					procInfo.add(pi);
-					procIndex++;
-					chanProcOrder = 0;
 				}
-				procInfo.getLast()->recordedChannels.add(channelMap.size()-1);
+				chanOrderinProc.add(procInfo[procIndex]->recordedChannels.size());
+				procInfo[procIndex]->recordedChannels.add(channelMap.size()-1);
 				chanProcessorMap.add(procIndex);
-				chanOrderinProc.add(chanProcOrder);
-				chanProcOrder++;
+
+				RecordDecimator* decimator = nullptr;
+				if (decimation > 1)
+				{
+					decimator = new RecordDecimator();
+					decimator->setFactor(decimation);
+				}
+				m_decimators.add(decimator);
 			}
 		}
 		std::cout << "Num Recording Processors: " << procInfo.size() << std::endl;
@@ -341,15 +395,21 @@ void RecordNode::setParameter(int parameterIndex, float newValue)
 
 		//WARNING: If at some point we record at more that one recordEngine at once, we should change this, as using OwnedArrays only works for the first
 		EVERY_ENGINE->setChannelMapping(channelMap, chanProcessorMap, chanOrderinProc, procInfo);
-		m_recordThread->setChannelMap(channelMap);
+		m_recordThread->setChannelMap(channelMap, chanBitVolts);
 		m_dataQueue->setChannels(numRecordedChannels);
 		m_eventQueue->reset();
 		m_spikeQueue->reset();
 		m_recordThread->setFirstBlockFlag(false);
 
 		setFirstBlock = false;
+		m_lostHistorySamples = 0;
+		m_channelQueued.clearQuick();
+		m_channelQueued.insertMultiple(0, false, numRecordedChannels);
+		m_numChannelsWaiting = numRecordedChannels;
 		m_recordThread->startThread();
 
+		//Has to be set before isRecording, so the first recorded block sees it
+		m_recordStartPending = true;
 		isRecording = true;
 		hasRecorded = true;
 
@@ -384,6 +444,15 @@ void RecordNode::setParameter(int parameterIndex, float newValue)
 				}
 			}
 
+			const int64 lostSpillSamples = m_recordThread->getSpillFile().getNumLostSamples();
+			if (m_dataQueue->getNumDroppedSamples() > 0 || m_lostHistorySamples > 0 || lostSpillSamples > 0 || m_eventQueue->getNumOverruns() > 0 || m_spikeQueue->getNumOverruns() > 0)
+			{
+				std::cerr << "Record queues overran: " << m_dataQueue->getNumDroppedSamples() + m_lostHistorySamples + lostSpillSamples << " samples, "
+					<< m_eventQueue->getNumOverruns() << " events and "
+					<< m_spikeQueue->getNumOverruns() << " spikes were not written" << std::endl;
+			}
+			writeQueueStats();
+
         }
     }
     else if (parameterIndex == 2)
@@ -426,6 +495,25 @@ bool RecordNode::enable()
 
     //When starting a recording, if a new directory is needed it gets rewritten. Else is incremented by one.
     recordingNumber = -1;
+
+	//The history is sized for the longest stretch before a trigger that is needed, at the highest sample rate
+	m_gated = m_gateChannels.size() > 0;
+	float historySeconds = jmax(m_preTriggerSeconds, m_gated ? m_gatePreSeconds : 0.0f);
+	float maxSampleRate = 0;
+	for (int ch = 0; ch < channelPointers.size(); ++ch)
+		maxSampleRate = jmax(maxSampleRate, channelPointers[ch]->sampleRate);
+	if ((m_preTriggerSeconds > 0 || m_gated) && maxSampleRate > 0)
+		m_preTrigger->setSize(channelPointers.size(), int(std::ceil((historySeconds + PRETRIGGER_MARGIN_SECONDS) * maxSampleRate)));
+	else
+		m_preTrigger->setSize(0, 0);
+	m_queuedUntil.clearQuick();
+	m_queuedUntil.insertMultiple(0, 0, channelPointers.size());
+	m_segmentStarts.clearQuick();
+	m_segmentStarts.insertMultiple(0, 0, channelPointers.size());
+	m_channelWindows.clearQuick();
+	m_channelWindows.insertMultiple(0, 0, channelPointers.size());
+	m_numGateWindows = 0;
+
     EVERY_ENGINE->configureEngine();
     EVERY_ENGINE->startAcquisition();
     isProcessing = true;
@@ -439,6 +527,7 @@ bool RecordNode::disable()
     setParameter(0, 10.0f);
 
     isProcessing = false;
+	m_preTrigger->setSize(0, 0);
 
     return true;
 }
@@ -451,45 +540,114 @@ float RecordNode::getFreeSpace()
 
 void RecordNode::handleEvent(int eventType, MidiMessage& event, int samplePosition)
 {
-    if (isRecording)
+    if (isWritableEvent(eventType))
     {
-        if (isWritableEvent(eventType))
+        if (*(event.getRawData()+4) > 0) // saving flag > 0 (i.e., event has not already been processed)
         {
-            if (*(event.getRawData()+4) > 0) // saving flag > 0 (i.e., event has not already been processed)
-            {
-				uint8 sourceNodeId = event.getNoteNumber();
-				int64 timestamp = timestamps[sourceNodeId] + samplePosition;
+			int sourceNodeId = getBlockContext().getNodeIdForEvent(event.getNoteNumber());
+			int64 timestamp = timestamps[sourceNodeId] + samplePosition;
+			if (m_recordingBlock)
 				m_eventQueue->addEvent(event, timestamp, eventType);
-            }
+			else
+				m_preTrigger->addEvent(event, timestamp, eventType);
         }
     }
+
+	//Rising edges on the gate channels open a recording window
+	if (m_gated && m_recordingBlock && eventType == TTL)
+	{
+		const uint8* dataptr = event.getRawData();
+		if (*(dataptr + 2) == 1 && m_gateChannels.contains(*(dataptr + 3)))
+		{
+			int sourceNodeId = getBlockContext().getNodeIdForEvent(event.getNoteNumber());
+			addGateWindow(sourceNodeId, timestamps[sourceNodeId] + samplePosition);
+		}
+	}
 }
 
 void RecordNode::process(AudioSampleBuffer& buffer,
                          MidiBuffer& events)
 {
-	
+	m_recordingBlock = isRecording;
+	const bool useHistory = m_preTrigger->getNumChannels() > 0;
+
+	//The history of every channel, recorded or not, is kept up to date
+	if (useHistory)
+	{
+		for (int ch = 0; ch < m_preTrigger->getNumChannels(); ++ch)
+		{
+			int sourceNodeId = channelPointers[ch]->sourceNodeId;
+			m_preTrigger->addChannel(buffer, ch, numSamples.at(sourceNodeId), timestamps.at(sourceNodeId));
+		}
+	}
+	if (m_recordingBlock && m_recordStartPending)
+	{
+		//Before the events, so the ones in the history are queued ahead of the live ones
+		if (useHistory)
+			startFromHistory();
+		m_recordStartPending = false;
+	}
+
 	// FIRST: cycle through events -- extract the TTLs and the timestamps
     checkForEvents(events);
 
-    if (isRecording)
+    if (m_recordingBlock)
     {
+		if (blockingWrites)
+		{
+			while ((m_dataQueue->getFreeSpace() < buffer.getNumSamples()
+				|| m_eventQueue->getFreeSpace() < EVENT_BUFFER_NEVENTS / 2
+				|| m_spikeQueue->getFreeSpace() < SPIKE_BUFFER_NSPIKES / 2)
+				&& m_recordThread->isThreadRunning())
+			{
+				m_recordThread->waitForQueueSpace(100);
+			}
+		}
+
         // SECOND: write channel data
 		int recordChans = channelMap.size();
+		int maxSamples = 0;
+		//With a history the data goes through it, and whatever doesn't fit in the queue waits there.
+		//A block is left free for the padding of a timestamp jump
+		int queueSpace = useHistory ? jmax(0, m_dataQueue->getFreeSpace() - WRITE_BLOCK_LENGTH) : 0;
 		for (int chan = 0; chan < recordChans; ++chan)
 		{
 			int realChan = channelMap[chan];
 			int sourceNodeId = channelPointers[realChan]->sourceNodeId;
 			int nSamples = numSamples.at(sourceNodeId);
-			int timestamp = timestamps.at(sourceNodeId);
-			m_dataQueue->writeChannel(buffer, chan, realChan, nSamples, timestamp);
+			if (!useHistory)
+			{
+				int64 timestamp = timestamps.at(sourceNodeId);
+				queueChannel(chan, buffer, realChan, 0, nSamples, timestamp);
+			}
+			else
+			{
+				int maxQueued = jmin(nSamples + PRETRIGGER_CATCHUP_SAMPLES, queueSpace);
+				nSamples = m_gated ? queueGatedHistory(chan, realChan, maxQueued) : queueHistory(chan, realChan, maxQueued);
+			}
+			maxSamples = jmax(maxSamples, nSamples);
+			if (nSamples > 0 && !m_channelQueued[chan])
+			{
+				m_channelQueued.set(chan, true);
+				m_numChannelsWaiting--;
+			}
 		}
+		m_recordThread->notifyDataWritten(maxSamples);
 
         //  std::cout << nSamples << " " << samplesWritten << " " << blockIndex << std::endl;
 		if (!setFirstBlock)
 		{
-			m_recordThread->setFirstBlockFlag(true);
-			setFirstBlock = true;
+			//The files are opened with the timestamps of the first queued block, so it has to
+			//wait for the decimated channels to get through their filter delay, and in gated
+			//mode for every channel to get its first window
+			bool filling = m_gated && m_numChannelsWaiting > 0;
+			for (int chan = 0; chan < m_decimators.size() && !filling; ++chan)
+				filling = m_decimators[chan] != nullptr && m_decimators[chan]->isFilling();
+			if (!filling)
+			{
+				m_recordThread->setFirstBlockFlag(true);
+				setFirstBlock = true;
+			}
 		}
         
     }
@@ -497,6 +655,177 @@ void RecordNode::process(AudioSampleBuffer& buffer,
 
 }
 
+void RecordNode::startFromHistory()
+{
+	for (int chan = 0; chan < channelMap.size(); ++chan)
+	{
+		int realChan = channelMap[chan];
+		int64 start = m_preTrigger->getStartTimestamp(realChan);
+		if (!m_gated)
+		{
+			//Back to the pre-trigger time before this block, but not over what the last recording wrote
+			Channel* ch = channelPointers[realChan];
+			start = jmax(start, timestamps.at(ch->sourceNodeId) - int64(m_preTriggerSeconds * ch->sampleRate));
+		}
+		m_queuedUntil.set(realChan, jmax(m_queuedUntil[realChan], start));
+		m_channelWindows.set(realChan, 0);
+	}
+	m_numGateWindows = 0;
+
+	if (m_gated)
+		return;
+
+	for (int ev = 0; ev < m_preTrigger->getNumEvents(); ++ev)
+	{
+		const EventSlot<MidiMessage>& event = m_preTrigger->getEvent(ev);
+		//The note number is the id of the source node
+		int sourceNodeId = getBlockContext().getNodeIdForEvent(event.getRawData()[1]);
+		const BlockContext::SourceInfo& source = getBlockContext()[sourceNodeId];
+		float sampleRate = (source.sampleRate > 0) ? source.sampleRate : getSampleRate();
+		if (event.getTimestamp() >= source.timestamp - int64(m_preTriggerSeconds * sampleRate))
+			m_eventQueue->addSlot(event);
+	}
+}
+
+int RecordNode::queueHistory(int chan, int realChan, int maxSamples)
+{
+	int64 from = m_queuedUntil[realChan];
+	int64 start = m_preTrigger->getStartTimestamp(realChan);
+	if (from < start)
+	{
+		//Only what the history held and overwrote is lost, not what came before its first sample
+		countLostHistory(start - jmax(from, m_preTrigger->getFirstTimestamp(realChan)));
+		from = start;
+	}
+
+	int64 to = jmin(m_preTrigger->getEndTimestamp(realChan), from + maxSamples);
+	if (to <= from)
+		return 0;
+
+	queueRange(chan, realChan, from, to);
+	m_queuedUntil.set(realChan, to);
+	return int(to - from);
+}
+
+int RecordNode::queueGatedHistory(int chan, int realChan, int maxSamples)
+{
+	const double sampleRate = channelPointers[realChan]->sampleRate;
+	const int64 start = m_preTrigger->getStartTimestamp(realChan);
+	const int64 end = m_preTrigger->getEndTimestamp(realChan);
+	int queued = 0;
+
+	while (queued < maxSamples && m_channelWindows[realChan] < m_numGateWindows)
+	{
+		//A channel that fell too far behind skips the windows that have already been reused
+		int64 windowIndex = jmax(m_channelWindows[realChan], m_numGateWindows - RECORD_GATE_WINDOWS);
+		const RecordGateWindow& window = m_gateWindows[int(windowIndex % RECORD_GATE_WINDOWS)];
+
+		int64 queuedUntil = m_queuedUntil[realChan];
+		int64 from = jmax(int64(std::floor(window.start * sampleRate)), queuedUntil);
+		if (from < start)
+		{
+			//Only what the history held and overwrote is lost, not what came before its first sample
+			countLostHistory(start - jmax(from, m_preTrigger->getFirstTimestamp(realChan)));
+			from = start;
+		}
+
+		//Windows are rounded up to whole blocks from the start of the stretch they belong to, so
+		//the formats that write one timestamp per record stay aligned
+		int64 segmentStart = (from == queuedUntil) ? m_segmentStarts[realChan] : from;
+		int64 windowEnd = jmax(from, int64(std::ceil(window.end * sampleRate)));
+		windowEnd = segmentStart + (windowEnd - segmentStart + WRITE_BLOCK_LENGTH - 1) / WRITE_BLOCK_LENGTH * WRITE_BLOCK_LENGTH;
+
+		int64 to = jmin(windowEnd, end, from + (maxSamples - queued));
+		if (to > from)
+		{
+			queueRange(chan, realChan, from, to);
+			m_queuedUntil.set(realChan, to);
+			m_segmentStarts.set(realChan, segmentStart);
+			queued += int(to - from);
+		}
+
+		//The last window stays current, as a new trigger can still extend it
+		if (to < windowEnd || windowIndex + 1 >= m_numGateWindows)
+		{
+			m_channelWindows.set(realChan, windowIndex);
+			break;
+		}
+		m_channelWindows.set(realChan, windowIndex + 1);
+	}
+	return queued;
+}
+
+int RecordNode::queueChannel(int chan, const AudioSampleBuffer& buffer, int sourceChannel, int startSample, int nSamples, int64 timestamp)
+{
+	RecordDecimator* decimator = m_decimators[chan];
+	if (decimator == nullptr)
+	{
+		m_dataQueue->writeChannel(buffer, chan, sourceChannel, nSamples, timestamp, startSample);
+		return nSamples;
+	}
+
+	const float* input = buffer.getReadPointer(sourceChannel, startSample);
+	int queued = 0;
+	while (nSamples > 0)
+	{
+		int numInput = jmin(nSamples, DECIMATOR_CHUNK);
+		int64 outputTimestamp;
+		int numOutput = decimator->process(input, numInput, timestamp, m_decimatedBuffer.getWritePointer(0), outputTimestamp);
+		if (numOutput > 0)
+			m_dataQueue->writeChannel(m_decimatedBuffer, chan, 0, numOutput, outputTimestamp);
+		input += numInput;
+		timestamp += numInput;
+		nSamples -= numInput;
+		queued += numOutput;
+	}
+	return queued;
+}
+
+void RecordNode::queueRange(int chan, int realChan, int64 from, int64 to)
+{
+	CircularBufferIndexes indexes;
+	m_preTrigger->getRange(realChan, from, to, indexes);
+	const AudioSampleBuffer& history = m_preTrigger->getAudioBufferReference();
+	if (indexes.size1 > 0)
+		queueChannel(chan, history, realChan, indexes.index1, indexes.size1, from);
+	if (indexes.size2 > 0)
+		queueChannel(chan, history, realChan, indexes.index2, indexes.size2, from + indexes.size1);
+}
+
+void RecordNode::addGateWindow(int sourceNodeId, int64 timestamp)
+{
+	float sampleRate = getBlockContext()[sourceNodeId].sampleRate;
+	if (sampleRate <= 0)
+		sampleRate = getSampleRate();
+
+	double t = double(timestamp) / sampleRate;
+	double start = t - m_gatePreSeconds;
+	double end = t + m_gatePostSeconds;
+
+	if (m_numGateWindows > 0)
+	{
+		RecordGateWindow& last = m_gateWindows[int((m_numGateWindows - 1) % RECORD_GATE_WINDOWS)];
+		if (start <= last.end)
+		{
+			last.end = jmax(last.end, end);
+			return;
+		}
+	}
+	RecordGateWindow& window = m_gateWindows[int(m_numGateWindows % RECORD_GATE_WINDOWS)];
+	window.start = start;
+	window.end = end;
+	m_numGateWindows++;
+}
+
+void RecordNode::countLostHistory(int64 numSamples)
+{
+	if (numSamples <= 0)
+		return;
+	//Same treatment as a queue overflow: counted, and only the first one is printed
+	if (m_lostHistorySamples.fetch_add(numSamples) == 0)
+		std::cerr << "Recording fell behind the pre-trigger history, data lost" << std::endl;
+}
+
 void RecordNode::registerProcessor(GenericProcessor* sourceNode)
 {
     EVERY_ENGINE->registerProcessor(sourceNode);
@@ -529,6 +858,8 @@ void RecordNode::writeSpike(SpikeObject& spike, int electrodeIndex)
 {
 	if (isRecording)
 	{
+		// spike sources on parallel branches may call this concurrently
+		const ScopedLock sl(spikeQueueLock);
 		m_spikeQueue->addEvent(spike, spike.timestamp, electrodeIndex);
 	}
 }
@@ -546,4 +877,229 @@ void RecordNode::clearRecordEngines()
 const String& RecordNode::getLastSettingsXml() const
 {
 	return m_lastSettingsText;
+}
+
+void RecordNode::setFlushCadence(int samples, int intervalMs)
+{
+	m_recordThread->setFlushCadence(samples, intervalMs);
+}
+
+float RecordNode::getRecordThreadDutyCycle() const
+{
+	return m_recordThread->getDutyCycle();
+}
+
+RecordQueueStats::RecordQueueStats() :
+    dataFill(0), dataHighWater(0),
+    eventFill(0), eventHighWater(0),
+    spikeFill(0), spikeHighWater(0),
+    sourceFill(0), sourceHighWater(0),
+    spillFill(0), spillHighWater(0),
+    spillEnabled(false), spilledSamples(0),
+    droppedSamples(0), droppedEvents(0), droppedSpikes(0), droppedSourceSamples(0),
+    drainRate(0), dutyCycle(0)
+{
+}
+
+namespace
+{
+	/** Input buffers of the source nodes in the signal chain */
+	void getSourceBuffers(Array<DataBuffer*>& buffers, StringArray& names)
+	{
+		Array<GenericProcessor*> processors = AccessClass::getProcessorGraph()->getListOfProcessors();
+		for (int i = 0; i < processors.size(); i++)
+		{
+			SourceNode* source = dynamic_cast<SourceNode*>(processors[i]);
+			if (source == nullptr || source->getThread() == nullptr)
+				continue;
+
+			DataBuffer* buffer = source->getThread()->getBufferAddress();
+			if (buffer != nullptr && buffer->getBufferSize() > 0)
+			{
+				buffers.add(buffer);
+				names.add(source->getName() + " (" + String(source->getNodeId()) + ")");
+			}
+		}
+	}
+
+	float fraction(int value, int size)
+	{
+		return (size > 0) ? float(value) / float(size) : 0.0f;
+	}
+}
+
+RecordQueueStats RecordNode::getQueueStats() const
+{
+	RecordQueueStats stats;
+
+	stats.dataFill = fraction(m_dataQueue->getNumReady(), m_dataQueue->getSize());
+	stats.dataHighWater = fraction(m_dataQueue->getHighWaterMark(), m_dataQueue->getSize());
+	stats.eventFill = fraction(m_eventQueue->getRemainingEvents(), m_eventQueue->getSize());
+	stats.eventHighWater = fraction(m_eventQueue->getHighWaterMark(), m_eventQueue->getSize());
+	stats.spikeFill = fraction(m_spikeQueue->getRemainingEvents(), m_spikeQueue->getSize());
+	stats.spikeHighWater = fraction(m_spikeQueue->getHighWaterMark(), m_spikeQueue->getSize());
+
+	stats.droppedSamples = m_dataQueue->getNumDroppedSamples() + m_lostHistorySamples
+		+ m_recordThread->getSpillFile().getNumLostSamples();
+	stats.droppedEvents = m_eventQueue->getNumOverruns();
+	stats.droppedSpikes = m_spikeQueue->getNumOverruns();
+
+	Array<DataBuffer*> buffers;
+	StringArray names;
+	getSourceBuffers(buffers, names);
+	for (int i = 0; i < buffers.size(); i++)
+	{
+		stats.sourceFill = jmax(stats.sourceFill, fraction(buffers[i]->getNumSamples(), buffers[i]->getBufferSize()));
+		stats.sourceHighWater = jmax(stats.sourceHighWater, fraction(buffers[i]->getHighWaterMark(), buffers[i]->getBufferSize()));
+		stats.droppedSourceSamples += buffers[i]->getNumDroppedSamples();
+	}
+
+	const DataSpillFile& spill = m_recordThread->getSpillFile();
+	stats.spillEnabled = spill.isOpen();
+	if (stats.spillEnabled)
+	{
+		stats.spillFill = spill.getFill();
+		stats.spillHighWater = spill.getHighWaterMark();
+		stats.spilledSamples = spill.getNumSpilledSamples();
+	}
+
+	if (isRecording)
+	{
+		stats.drainRate = m_recordThread->getDrainRate();
+		stats.dutyCycle = m_recordThread->getDutyCycle();
+	}
+	return stats;
+}
+
+bool RecordNode::setSpillFile(const File& file, int64 sizeBytes)
+{
+	if (isRecording)
+		return false;
+
+	bool ok = m_recordThread->setSpillFile(file, sizeBytes);
+	m_spillFile = ok ? file : File::nonexistent;
+	m_spillFileSize = ok ? sizeBytes : 0;
+	return ok;
+}
+
+bool RecordNode::setPreTriggerHistory(float seconds)
+{
+	if (isProcessing)
+		return false;
+
+	m_preTriggerSeconds = jmax(0.0f, seconds);
+	return true;
+}
+
+float RecordNode::getPreTriggerHistory() const
+{
+	return m_preTriggerSeconds;
+}
+
+bool RecordNode::setRecordGate(const Array<int>& eventChannels, float preSeconds, float postSeconds)
+{
+	if (isProcessing)
+		return false;
+
+	m_gateChannels = eventChannels;
+	m_gatePreSeconds = jmax(0.0f, preSeconds);
+	m_gatePostSeconds = jmax(0.0f, postSeconds);
+	return true;
+}
+
+const Array<int>& RecordNode::getRecordGateChannels() const
+{
+	return m_gateChannels;
+}
+
+float RecordNode::getRecordGatePreSeconds() const
+{
+	return m_gatePreSeconds;
+}
+
+float RecordNode::getRecordGatePostSeconds() const
+{
+	return m_gatePostSeconds;
+}
+
+bool RecordNode::isRecordGated() const
+{
+	return m_gated;
+}
+
+const File& RecordNode::getSpillFile() const
+{
+	return m_spillFile;
+}
+
+int64 RecordNode::getSpillFileSize() const
+{
+	return m_spillFileSize;
+}
+
+void RecordNode::writeQueueStats() const
+{
+	XmlElement xml("RECORD_QUEUES");
+	xml.setAttribute("experiment", experimentNumber);
+	xml.setAttribute("recording", recordingNumber);
+
+	XmlElement* thread = xml.createNewChildElement("RECORD_THREAD");
+	thread->setAttribute("averageDrainRate", m_recordThread->getAverageDrainRate());
+
+	XmlElement* data = xml.createNewChildElement("DATA_QUEUE");
+	data->setAttribute("size", m_dataQueue->getSize());
+	data->setAttribute("highWater", m_dataQueue->getHighWaterMark());
+	data->setAttribute("droppedSamples", String(m_dataQueue->getNumDroppedSamples()));
+
+	const DataSpillFile& spill = m_recordThread->getSpillFile();
+	if (spill.isOpen())
+	{
+		XmlElement* spillXml = xml.createNewChildElement("SPILL_FILE");
+		spillXml->setAttribute("path", m_spillFile.getFullPathName());
+		spillXml->setAttribute("size", String(m_spillFileSize));
+		spillXml->setAttribute("highWater", spill.getHighWaterMark());
+		spillXml->setAttribute("spilledSamples", String(spill.getNumSpilledSamples()));
+		spillXml->setAttribute("lostSamples", String(spill.getNumLostSamples()));
+	}
+
+	if (m_preTrigger->getNumChannels() > 0)
+	{
+		XmlElement* history = xml.createNewChildElement("PRETRIGGER_HISTORY");
+		history->setAttribute("size", m_preTrigger->getSize());
+		history->setAttribute("preTriggerSeconds", m_preTriggerSeconds);
+		history->setAttribute("gated", m_gated);
+		history->setAttribute("lostSamples", String(m_lostHistorySamples.load()));
+	}
+
+	XmlElement* events = xml.createNewChildElement("EVENT_QUEUE");
+	events->setAttribute("size", m_eventQueue->getSize());
+	events->setAttribute("highWater", m_eventQueue->getHighWaterMark());
+	events->setAttribute("droppedEvents", String(m_eventQueue->getNumOverruns()));
+
+	XmlElement* spikes = xml.createNewChildElement("SPIKE_QUEUE");
+	spikes->setAttribute("size", m_spikeQueue->getSize());
+	spikes->setAttribute("highWater", m_spikeQueue->getHighWaterMark());
+	spikes->setAttribute("droppedSpikes", String(m_spikeQueue->getNumOverruns()));
+
+	//Source buffers keep counting over the whole acquisition
+	Array<DataBuffer*> buffers;
+	StringArray names;
+	getSourceBuffers(buffers, names);
+	for (int i = 0; i < buffers.size(); i++)
+	{
+		XmlElement* source = xml.createNewChildElement("SOURCE_BUFFER");
+		source->setAttribute("name", names[i]);
+		source->setAttribute("size", buffers[i]->getBufferSize());
+		source->setAttribute("highWater", buffers[i]->getHighWaterMark());
+		source->setAttribute("droppedSamples", String(buffers[i]->getNumDroppedSamples()));
+	}
+
+	File statsFile = rootFolder.getChildFile("record_queues_" + String(experimentNumber) + "_" + String(recordingNumber) + ".xml");
+	if (!xml.writeToFile(statsFile, String::empty))
+		std::cerr << "Could not write " << statsFile.getFullPathName() << std::endl;
+}
+
+void RecordNode::setBlockingWrites(bool shouldBlock)
+{
+	blockingWrites = shouldBlock;
 }
\ No newline at end of file
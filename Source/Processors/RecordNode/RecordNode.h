@@ -37,12 +37,54 @@
 #define DATA_BUFFER_NBLOCKS 300
 #define EVENT_BUFFER_NEVENTS 512
 #define SPIKE_BUFFER_NSPIKES 512
+/** Samples per channel the pre-trigger history can move into the queue on top of the live block */
+#define PRETRIGGER_CATCHUP_SAMPLES 8192
+/** Extra history kept over the longest pre-trigger time, for the time it takes to catch up */
+#define PRETRIGGER_MARGIN_SECONDS 1.0f
+#define RECORD_GATE_WINDOWS 64
 
 struct SpikeRecordInfo;
 struct SpikeObject;
 class RecordEngine;
 class RecordThread;
 class DataQueue;
+class PreTriggerBuffer;
+class RecordDecimator;
+
+/** A stretch of time, in seconds from the start of the source timestamps, that gated recording writes */
+struct RecordGateWindow
+{
+    double start;
+    double end;
+};
+
+/**
+  Snapshot of the buffers data goes through on its way to disk: the DataBuffers of the
+  source nodes and the data, event and spike queues of the RecordNode. Fill levels are
+  fractions of each buffer's capacity; for the source buffers they are the fullest one.
+
+  @see RecordNode::getQueueStats
+*/
+struct RecordQueueStats
+{
+    RecordQueueStats();
+
+    float dataFill, dataHighWater;
+    float eventFill, eventHighWater;
+    float spikeFill, spikeHighWater;
+    float sourceFill, sourceHighWater;
+    float spillFill, spillHighWater; // only meaningful if spillEnabled
+
+    bool spillEnabled;
+    int64 spilledSamples;       // added over the recorded channels
+    int64 droppedSamples;       // added over the recorded channels
+    int64 droppedEvents;
+    int64 droppedSpikes;
+    int64 droppedSourceSamples; // per channel, added over the sources
+
+    float drainRate;            // samples per channel written per second
+    float dutyCycle;
+};
 
 /**
 
@@ -116,6 +158,13 @@ public:
     */
     void setChannelStatus(Channel* ch, bool status);
 
+    /** Records a channel at its sample rate divided by factor, through an anti-aliasing
+        filter. Each rate of a processor goes to its own file or dataset. The factor is kept
+        with the channel, so it is saved and restored with the rest of its settings.
+        Returns false while recording.
+    */
+    bool setChannelDecimation(Channel* ch, int factor);
+
     /** Used to clear all connections prior to the start of acquisition.
     */
     void resetConnections();
@@ -124,6 +173,10 @@ public:
     */
     void filenameComponentChanged(FilenameComponent*);
 
+    /** Sets the data directory directly, for use without a ControlPanel.
+    */
+    void setDataDirectory(const File& directory);
+
     /** Creates a new data directory in the location specified by the fileNameComponent.
     */
     void createNewDirectory();
@@ -169,6 +222,49 @@ public:
 	/** Get the last settings.xml in string form. Since the string will be large, returns a const ref.*/
 	const String& getLastSettingsXml() const;
 
+	/** When enabled, process() waits for the RecordThread to make room in the queues
+	instead of dropping data. For offline reprocessing, where the signal chain runs
+	faster than the disk. */
+	void setBlockingWrites(bool shouldBlock);
+
+	/** Sets how many queued samples (or, failing that, how many milliseconds) it takes
+	to wake the RecordThread up. Larger values mean fewer, bigger writes. */
+	void setFlushCadence(int samples, int intervalMs);
+
+	/** Fraction of time the RecordThread spent writing over the last second */
+	float getRecordThreadDutyCycle() const;
+
+	/** Current fill levels and loss counters of the record pipeline. The record queue
+	counters start over with every recording, the source ones with every acquisition. */
+	RecordQueueStats getQueueStats() const;
+
+	/** Sets a file, ideally on a separate fast volume or tmpfs, where queued data is moved
+	to if the recording disk stalls and written back in order once it recovers. The file
+	is preallocated to sizeBytes right away. An empty file disables spilling. Returns false
+	if recording or if the file couldn't be created. */
+	bool setSpillFile(const File& file, int64 sizeBytes);
+
+	const File& getSpillFile() const;
+	int64 getSpillFileSize() const;
+
+	/** Keeps the last seconds of every channel, and the events that came with them, in memory while
+	not recording. Whatever starts the recording (the record button, RecordControl, a network
+	command) then gets that history written ahead of the live data. Memory use is seconds (plus one)
+	times sample rate times four bytes per channel. 0 disables it. Returns false while acquiring. */
+	bool setPreTriggerHistory(float seconds);
+	float getPreTriggerHistory() const;
+
+	/** Gated recording: while recording, only the continuous data from preSeconds before to postSeconds
+	after each rising edge on one of the given TTL channels is written. Overlapping windows are merged
+	and each one is rounded up to whole blocks. Events and spikes are still written in full. An empty
+	channel list turns gating off. Returns false while acquiring. */
+	bool setRecordGate(const Array<int>& eventChannels, float preSeconds, float postSeconds);
+	const Array<int>& getRecordGateChannels() const;
+	float getRecordGatePreSeconds() const;
+	float getRecordGatePostSeconds() const;
+	/** Returns true if the current acquisition records gated data */
+	bool isRecordGated() const;
+
 private:
 
     /** Keep the RecordNode informed of acquisition and record states.
@@ -212,12 +308,29 @@ private:
     bool hasRecorded;
     bool settingsNeeded;
 	std::atomic<bool> setFirstBlock;
+	std::atomic<bool> blockingWrites;
     /** Generates a default directory name, based on the current date and time */
     String generateDirectoryName();
 
     /** Cycle through the event buffer, looking for data to save */
     void handleEvent(int eventType, MidiMessage& event, int samplePos);
 
+	/** Writes the queue counters of the recording that just stopped next to its files */
+	void writeQueueStats() const;
+
+	/** Sets where each recorded channel starts reading its history, on the first recorded block */
+	void startFromHistory();
+	/** Moves the next part of the history of a channel into the queue. Returns the samples queued */
+	int queueHistory(int chan, int realChan, int maxSamples);
+	/** Same, for the parts of the history inside the gate windows */
+	int queueGatedHistory(int chan, int realChan, int maxSamples);
+	void addGateWindow(int sourceNodeId, int64 timestamp);
+	void countLostHistory(int64 numSamples);
+	/** Queues the data of a recorded channel, decimating it if needed. Returns the samples queued */
+	int queueChannel(int chan, const AudioSampleBuffer& buffer, int sourceChannel, int startSample, int nSamples, int64 timestamp);
+	/** Queues the history of a channel with timestamps in [from, to) */
+	void queueRange(int chan, int realChan, int64 from, int64 to);
+
     /**RecordEngines loaded**/
     OwnedArray<RecordEngine> engineArray;
 
@@ -225,11 +338,45 @@ private:
 	ScopedPointer<DataQueue> m_dataQueue;
 	ScopedPointer<EventMsgQueue> m_eventQueue;
 	ScopedPointer<SpikeMsgQueue> m_spikeQueue;
+	CriticalSection spikeQueueLock;
 	
 	Array<int> m_recordedChannelMap;
 
 	String m_lastSettingsText;
 
+	File m_spillFile;
+	int64 m_spillFileSize;
+
+	ScopedPointer<PreTriggerBuffer> m_preTrigger;
+	float m_preTriggerSeconds;
+	Array<int> m_gateChannels;
+	float m_gatePreSeconds;
+	float m_gatePostSeconds;
+	bool m_gated;
+
+	/** Set when recording starts, cleared by the first recorded block */
+	std::atomic<bool> m_recordStartPending;
+	/** isRecording, latched at the start of each block so the whole block sees the same value */
+	bool m_recordingBlock;
+
+	/** Per channel, the timestamp of the first sample not yet moved from the history to the queue */
+	Array<int64> m_queuedUntil;
+	/** Per channel, where the stretch of gated data being written started */
+	Array<int64> m_segmentStarts;
+	/** Per channel, the gate window being written */
+	Array<int64> m_channelWindows;
+	HeapBlock<RecordGateWindow> m_gateWindows;
+	int64 m_numGateWindows;
+	std::atomic<int64> m_lostHistorySamples;
+
+	/** Per recorded channel, whether anything has been queued since recording started */
+	Array<bool> m_channelQueued;
+	int m_numChannelsWaiting;
+
+	/** Per recorded channel, null for the ones recorded at full rate */
+	OwnedArray<RecordDecimator> m_decimators;
+	AudioSampleBuffer m_decimatedBuffer;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RecordNode);
 
 };
@@ -0,0 +1,99 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "RecordNodeConfigWindow.h"
+#include "RecordNode.h"
+
+class RecordNodeConfigComponent : public Component
+{
+public:
+    RecordNodeConfigComponent() {}
+
+    void paint(Graphics& g)
+    {
+        g.setColour(Colours::darkgrey);
+        g.fillAll();
+    }
+};
+
+RecordNodeConfigWindow::RecordNodeConfigWindow(RecordNode* node)
+    : DocumentWindow("Record Options", Colours::red, DocumentWindow::closeButton),
+      recordNode(node)
+{
+    StringArray channelList;
+    const Array<int>& gateChannels = node->getRecordGateChannels();
+    for (int i = 0; i < gateChannels.size(); i++)
+        channelList.add(String(gateChannels[i]));
+
+    parameters.add(new EngineParameter(EngineParameter::FLOAT, 0, "Pre-trigger s", double(node->getPreTriggerHistory()), 0, 60));
+    parameters.add(new EngineParameter(EngineParameter::STR, 1, "Gate TTL chans", channelList.joinIntoString(" ")));
+    parameters.add(new EngineParameter(EngineParameter::FLOAT, 2, "Gate pre s", double(node->getRecordGatePreSeconds()), 0, 60));
+    parameters.add(new EngineParameter(EngineParameter::FLOAT, 3, "Gate post s", double(node->getRecordGatePostSeconds()), 0, 60));
+
+    Component* ui = new RecordNodeConfigComponent();
+    for (int i = 0; i < parameters.size(); i++)
+    {
+        EngineParameterComponent* par = new EngineParameterComponent(*parameters[i]);
+        par->setBounds(10, 10 + 40 * i, 300, 30);
+        ui->addAndMakeVisible(par);
+        parameterComponents.add(par);
+    }
+    parameterComponents[1]->setTooltip("TTL channels whose rising edges open a recording window, separated by spaces. Empty records everything");
+
+    int height = parameters.size() * 50;
+    ui->setSize(300, height);
+    setContentOwned(ui, true);
+    centreWithSize(300, height);
+    setUsingNativeTitleBar(true);
+    setResizable(false, false);
+    setVisible(true);
+}
+
+RecordNodeConfigWindow::~RecordNodeConfigWindow()
+{
+}
+
+bool RecordNodeConfigWindow::saveParameters()
+{
+    for (int i = 0; i < parameterComponents.size(); i++)
+        parameterComponents[i]->saveValue();
+
+    StringArray gateList;
+    gateList.addTokens(parameters[1]->strParam.value, " ,", String::empty);
+    gateList.removeEmptyStrings();
+    Array<int> gateChannels;
+    for (int i = 0; i < gateList.size(); i++)
+        gateChannels.addIfNotAlreadyThere(gateList[i].getIntValue());
+
+    bool applied = recordNode->setPreTriggerHistory(parameters[0]->floatParam.value);
+    applied = recordNode->setRecordGate(gateChannels, parameters[2]->floatParam.value, parameters[3]->floatParam.value) && applied;
+    if (!applied)
+        CoreServices::sendStatusMessage("Record options can't be changed while acquiring");
+    return applied;
+}
+
+void RecordNodeConfigWindow::closeButtonPressed()
+{
+    saveParameters();
+    setVisible(false);
+}
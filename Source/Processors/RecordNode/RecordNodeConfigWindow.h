@@ -0,0 +1,60 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef RECORDNODECONFIGWINDOW_H_INCLUDED
+#define RECORDNODECONFIGWINDOW_H_INCLUDED
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+#include "EngineConfigWindow.h"
+
+class RecordNode;
+
+/**
+    Edits the RecordNode options that don't belong to any record engine: the
+    pre-trigger history and gated recording. Values are read from the RecordNode
+    when the window opens and applied to it when the window closes.
+
+    @see RecordNode, ControlPanel
+*/
+class RecordNodeConfigWindow : public DocumentWindow
+{
+public:
+    RecordNodeConfigWindow(RecordNode* node);
+    ~RecordNodeConfigWindow();
+
+    /** Applies the values to the RecordNode. Returns false if it refused them. */
+    bool saveParameters();
+
+    /** Applies the values and hides the window */
+    void closeButtonPressed();
+
+private:
+    RecordNode* recordNode;
+    OwnedArray<EngineParameter> parameters;
+    OwnedArray<EngineParameterComponent> parameterComponents;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RecordNodeConfigWindow);
+};
+
+
+#endif  // RECORDNODECONFIGWINDOW_H_INCLUDED
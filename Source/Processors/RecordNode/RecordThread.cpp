@@ -32,7 +32,18 @@ RecordThread::RecordThread(const OwnedArray<RecordEngine>& engines) :
 Thread("Record Thread"),
 m_engineArray(engines),
 m_receivedFirstBlock(false),
-m_cleanExit(true)
+m_cleanExit(true),
+m_flushSamples(DEFAULT_FLUSH_SAMPLES),
+m_flushInterval(DEFAULT_FLUSH_INTERVAL_MS),
+m_pendingSamples(0),
+m_dutyCycle(0),
+m_drainRate(0),
+m_averageDrainRate(0),
+m_windowStart(0),
+m_windowBusy(0),
+m_totalBusy(0),
+m_windowSamples(0),
+m_totalSamples(0)
 {
 }
 
@@ -50,11 +61,12 @@ void RecordThread::setFileComponents(File rootFolder, int experimentNumber, int
 	m_recordingNumber = recordingNumber;
 }
 
-void RecordThread::setChannelMap(const Array<int>& channels)
+void RecordThread::setChannelMap(const Array<int>& channels, const Array<float>& bitVolts)
 {
 	if (isThreadRunning())
 		return;
 	m_channelArray = channels;
+	m_channelBitVolts = bitVolts;
 	m_numChannels = channels.size();
 }
 
@@ -71,6 +83,83 @@ void RecordThread::setFirstBlockFlag(bool state)
 	this->notify();
 }
 
+void RecordThread::setFlushCadence(int samples, int intervalMs)
+{
+	m_flushSamples = jlimit(1, BLOCK_MAX_WRITE_SAMPLES * 16, samples);
+	m_flushInterval = jmax(1, intervalMs);
+	this->notify();
+}
+
+void RecordThread::notifyDataWritten(int nSamples)
+{
+	int pending = m_pendingSamples.fetch_add(nSamples) + nSamples;
+	int threshold = m_flushSamples;
+
+	//Only signal on the crossing, the thread clears the count when it wakes up
+	if ((pending >= threshold && pending - nSamples < threshold)
+		|| m_eventQueue->getRemainingEvents() > m_eventQueue->getFreeSpace()
+		|| m_spikeQueue->getRemainingEvents() > m_spikeQueue->getFreeSpace())
+	{
+		this->notify();
+	}
+}
+
+bool RecordThread::waitForQueueSpace(int timeoutMs)
+{
+	this->notify();
+	return m_dataConsumed.wait(timeoutMs);
+}
+
+bool RecordThread::setSpillFile(const File& file, int64 sizeBytes)
+{
+	if (isThreadRunning())
+		return false;
+
+	if (file == File::nonexistent || sizeBytes <= 0)
+	{
+		m_spill.close();
+		return true;
+	}
+	return m_spill.open(file, sizeBytes);
+}
+
+const DataSpillFile& RecordThread::getSpillFile() const
+{
+	return m_spill;
+}
+
+float RecordThread::getDutyCycle() const
+{
+	return m_dutyCycle;
+}
+
+float RecordThread::getDrainRate() const
+{
+	return m_drainRate;
+}
+
+float RecordThread::getAverageDrainRate() const
+{
+	return m_averageDrainRate;
+}
+
+void RecordThread::updateDutyCycle(int64 busyTicks)
+{
+	m_windowBusy += busyTicks;
+	m_totalBusy += busyTicks;
+
+	int64 now = Time::getHighResolutionTicks();
+	double elapsed = Time::highResolutionTicksToSeconds(now - m_windowStart);
+	if (elapsed >= 1.0)
+	{
+		m_dutyCycle = float(Time::highResolutionTicksToSeconds(m_windowBusy) / elapsed);
+		m_drainRate = float(m_windowSamples / elapsed);
+		m_windowStart = now;
+		m_windowBusy = 0;
+		m_windowSamples = 0;
+	}
+}
+
 void RecordThread::run()
 {
 	const AudioSampleBuffer& dataBuffer = m_dataQueue->getAudioBufferReference();
@@ -90,17 +179,57 @@ void RecordThread::run()
 		m_dataQueue->getTimestampsForBlock(0, timestamps);
 		EVERY_ENGINE->updateTimestamps(timestamps);
 		EVERY_ENGINE->openFiles(m_rootFolder, m_experimentNumber, m_recordingNumber);
+		m_writerPool.prepare(m_engineArray, m_channelArray, m_channelBitVolts);
+		if (m_spill.isOpen())
+			m_spill.startSpilling(m_dataQueue);
 	}
-	//3-Normal loop
+	//3-Normal loop. Sleep until the producer has queued enough data (or the flush interval
+	//expires) and then write everything that's ready in large chunks
+	int64 recordStart = Time::getHighResolutionTicks();
+	m_windowStart = recordStart;
+	m_windowBusy = 0;
+	m_totalBusy = 0;
+	m_dutyCycle = 0;
+	m_windowSamples = 0;
+	m_totalSamples = 0;
+	m_drainRate = 0;
+	m_averageDrainRate = 0;
 	while (!threadShouldExit())
 	{
-		writeData(dataBuffer, BLOCK_MAX_WRITE_SAMPLES, BLOCK_MAX_WRITE_EVENTS, BLOCK_MAX_WRITE_SPIKES);
+		wait(m_flushInterval);
+		m_pendingSamples = 0;
+
+		int64 busyStart = Time::getHighResolutionTicks();
+		do
+		{
+			writeData(dataBuffer, BLOCK_MAX_WRITE_SAMPLES, BLOCK_MAX_WRITE_EVENTS, BLOCK_MAX_WRITE_SPIKES);
+		} while (!threadShouldExit()
+			&& (m_dataQueue->getNumReady() >= BLOCK_MAX_WRITE_SAMPLES
+			|| m_spill.hasPendingData()
+			|| m_eventQueue->getRemainingEvents() >= BLOCK_MAX_WRITE_EVENTS
+			|| m_spikeQueue->getRemainingEvents() >= BLOCK_MAX_WRITE_SPIKES));
+		updateDutyCycle(Time::getHighResolutionTicks() - busyStart);
 	}
 	std::cout << "Exiting record thread" << std::endl;
+	if (!closeEarly)
+	{
+		double totalTime = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - recordStart);
+		if (totalTime > 0)
+		{
+			m_averageDrainRate = float(m_totalSamples / totalTime);
+			std::cout << "Record thread was busy " << 100.0 * Time::highResolutionTicksToSeconds(m_totalBusy) / totalTime
+			<< "% of the time" << std::endl;
+		}
+	}
 	//4-Before closing the thread, try to write the remaining samples
 	if (!closeEarly)
 	{
+		//Spilled data goes first, in normal sized windows, and then whatever is left in the queue
+		m_spill.stopSpilling();
+		while (m_spill.hasPendingData())
+			writeData(dataBuffer, BLOCK_MAX_WRITE_SAMPLES, BLOCK_MAX_WRITE_EVENTS, BLOCK_MAX_WRITE_SPIKES);
 		writeData(dataBuffer, -1, -1, -1, true);
+		m_writerPool.release();
 
 		std::cout << "Closing files" << std::endl;
 		//5-Close files
@@ -108,44 +237,56 @@ void RecordThread::run()
 	}
 	m_cleanExit = true;
 	m_receivedFirstBlock = false;
+	m_dataConsumed.signal();
 }
 
 void RecordThread::writeData(const AudioSampleBuffer& dataBuffer, int maxSamples, int maxEvents, int maxSpikes, bool lastBlock)
 {
 	Array<int64> timestamps;
 	Array<CircularBufferIndexes> idx;
-	m_dataQueue->startRead(idx, timestamps, maxSamples);
-	EVERY_ENGINE->updateTimestamps(timestamps);
-	EVERY_ENGINE->startChannelBlock(lastBlock);
-	for (int chan = 0; chan < m_numChannels; ++chan)
+	//With a spill file, the spill thread can read the queue too, so windows go through it
+	const bool spilling = m_spill.isOpen();
+	bool haveWindow = true;
+	bool fromQueue = true;
+	if (spilling)
+		//No window while the spill thread is still writing out samples older than the queue
+		haveWindow = m_spill.readNext(m_spillBuffer, idx, timestamps, maxSamples, fromQueue);
+	else
+		m_dataQueue->startRead(idx, timestamps, maxSamples);
+	if (haveWindow)
 	{
-		if (idx[chan].size1 > 0)
-		{
-			EVERY_ENGINE->writeData(chan, m_channelArray[chan], dataBuffer.getReadPointer(chan, idx[chan].index1), idx[chan].size1);
-			if (idx[chan].size2 > 0)
-			{
-				timestamps.set(chan, timestamps[chan] + idx[chan].size1);
-				EVERY_ENGINE->updateTimestamps(timestamps, chan);
-				EVERY_ENGINE->writeData(chan, m_channelArray[chan], dataBuffer.getReadPointer(chan, idx[chan].index2), idx[chan].size2);
-			}
-		}
+		int numRead = 0;
+		for (int i = 0; i < idx.size(); i++)
+			numRead = jmax(numRead, idx[i].size1 + idx[i].size2);
+		m_windowSamples += numRead;
+		m_totalSamples += numRead;
+		EVERY_ENGINE->updateTimestamps(timestamps);
+		EVERY_ENGINE->startChannelBlock(lastBlock);
+		//Returns once every lane is done, so the window can be released
+		m_writerPool.writeBlock(fromQueue ? dataBuffer : m_spillBuffer, idx, timestamps);
+		if (!spilling)
+			m_dataQueue->stopRead();
+		else if (fromQueue)
+			m_spill.finishQueueRead();
+		EVERY_ENGINE->endChannelBlock(lastBlock);
 	}
-	m_dataQueue->stopRead();
-	EVERY_ENGINE->endChannelBlock(lastBlock);
 
-	std::vector<EventMessagePtr> events;
-	int nEvents = m_eventQueue->getEvents(events, maxEvents);
+	int nEvents = m_eventQueue->startRead(maxEvents);
 	for (int ev = 0; ev < nEvents; ++ev)
 	{
-		EVERY_ENGINE->writeEvent(events[ev]->getExtra(), events[ev]->getData(), events[ev]->getTimestamp());
+		const EventMsgQueue::Slot& event = m_eventQueue->getReadSlot(ev);
+		EVERY_ENGINE->writeEventData(event.getExtra(), event.getRawData(), event.getRawDataSize(), event.getTimestamp());
 	}
+	m_eventQueue->finishedRead(nEvents);
 
-	std::vector<SpikeMessagePtr> spikes;
-	int nSpikes = m_spikeQueue->getEvents(spikes, maxSpikes);
+	int nSpikes = m_spikeQueue->startRead(maxSpikes);
 	for (int sp = 0; sp < nSpikes; ++sp)
 	{
-		EVERY_ENGINE->writeSpike(spikes[sp]->getExtra(), spikes[sp]->getData(), spikes[sp]->getTimestamp());
+		const SpikeMsgQueue::Slot& spike = m_spikeQueue->getReadSlot(sp);
+		EVERY_ENGINE->writeSpike(spike.getExtra(), spike.getData(), spike.getTimestamp());
 	}
+	m_spikeQueue->finishedRead(nSpikes);
+	m_dataConsumed.signal();
 }
 
 void RecordThread::forceCloseFiles()
@@ -153,6 +294,8 @@ void RecordThread::forceCloseFiles()
 	if (isThreadRunning() || m_cleanExit)
 		return;
 
+	m_spill.stopSpilling();
+	m_writerPool.release();
 	EVERY_ENGINE->closeFiles();
 	m_cleanExit = true;
 }
\ No newline at end of file
@@ -27,12 +27,19 @@
 #include "../../../JuceLibraryCode/JuceHeader.h"
 #include "EventQueue.h"
 #include "DataQueue.h"
+#include "RecordWriterPool.h"
+#include "DataSpillFile.h"
 #include <atomic>
 
 #define BLOCK_MAX_WRITE_SAMPLES 4096
 #define BLOCK_MAX_WRITE_EVENTS 32
 #define BLOCK_MAX_WRITE_SPIKES 32
 
+/** Default wakeup cadence: the thread writes once this many samples are queued, or this many
+	milliseconds have passed, whichever comes first */
+#define DEFAULT_FLUSH_SAMPLES 4096
+#define DEFAULT_FLUSH_INTERVAL_MS 100
+
 class Channel;
 class RecordEngine;
 
@@ -43,7 +50,7 @@ public:
 	RecordThread(const OwnedArray<RecordEngine>& engines);
 	~RecordThread();
 	void setFileComponents(File rootFolder, int experimentNumber, int recordingNumber);
-	void setChannelMap(const Array<int>& channels);
+	void setChannelMap(const Array<int>& channels, const Array<float>& bitVolts);
 	void setQueuePointers(DataQueue* data, EventMsgQueue* events, SpikeMsgQueue* spikes);
 
 	void run() override;
@@ -51,11 +58,44 @@ public:
 	void setFirstBlockFlag(bool state);
 	void forceCloseFiles();
 
+	/** Sets how much data has to be queued before the thread wakes up to write it. The thread also
+	wakes every intervalMs milliseconds, so slow streams and events still reach the disk. */
+	void setFlushCadence(int samples, int intervalMs);
+
+	/** Called by the producer after queueing a block. Wakes the thread when the flush
+	threshold is crossed or the event queues start filling up. */
+	void notifyDataWritten(int nSamples);
+
+	/** Called by the producer when the queues are too full for the next block. Wakes the thread
+	and waits until it has taken a write window out of the queues, the thread exits, or timeoutMs
+	expires. Returns false on timeout. */
+	bool waitForQueueSpace(int timeoutMs);
+
+	/** Fraction of the last second the thread spent writing, between 0 and 1 */
+	float getDutyCycle() const;
+
+	/** Samples per channel taken out of the data queue per second, over the last second */
+	float getDrainRate() const;
+
+	/** Samples per channel taken out of the data queue per second, averaged over the last recording */
+	float getAverageDrainRate() const;
+
+	/** Sets a file the data queue overflows into when the disk stalls, preallocated to sizeBytes.
+	An empty file or size disables spilling. Can't be changed while recording. */
+	bool setSpillFile(const File& file, int64 sizeBytes);
+
+	const DataSpillFile& getSpillFile() const;
+
 private:
 	void writeData(const AudioSampleBuffer& buffer, int maxSamples, int maxEvents, int maxSpikes, bool lastBlock = false);
+	void updateDutyCycle(int64 busyTicks);
 
 	const OwnedArray<RecordEngine>& m_engineArray;
+	RecordWriterPool m_writerPool;
+	DataSpillFile m_spill;
+	AudioSampleBuffer m_spillBuffer;
 	Array<int> m_channelArray;
+	Array<float> m_channelBitVolts;
 	
 	DataQueue* m_dataQueue;
 	EventMsgQueue* m_eventQueue;
@@ -64,6 +104,20 @@ private:
 	std::atomic<bool> m_receivedFirstBlock;
 	std::atomic<bool> m_cleanExit;
 
+	std::atomic<int> m_flushSamples;
+	std::atomic<int> m_flushInterval;
+	std::atomic<int> m_pendingSamples;
+	WaitableEvent m_dataConsumed;
+
+	std::atomic<float> m_dutyCycle;
+	std::atomic<float> m_drainRate;
+	std::atomic<float> m_averageDrainRate;
+	int64 m_windowStart;
+	int64 m_windowBusy;
+	int64 m_totalBusy;
+	int64 m_windowSamples;
+	int64 m_totalSamples;
+
 	File m_rootFolder;
 	int m_experimentNumber;
 	int m_recordingNumber;
@@ -0,0 +1,332 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "RecordWriterPool.h"
+#include "RecordEngine.h"
+
+//Channels converted to int16 by each conversion task
+#define CONVERSION_GROUP_CHANNELS 32
+
+RecordWriterPool::RecordWriterPool() :
+m_nextTask(0),
+m_conversionsRemaining(0),
+m_lanesRemaining(0),
+m_conversionsFinished(true),
+m_numConversions(0),
+m_intStride(0),
+m_intCapacity(0),
+m_buffer(nullptr),
+m_indexes(nullptr),
+m_timestamps(nullptr)
+{
+}
+
+RecordWriterPool::~RecordWriterPool()
+{
+	release();
+}
+
+void RecordWriterPool::prepare(const OwnedArray<RecordEngine>& engines, const Array<int>& channelMap, const Array<float>& bitVolts)
+{
+	release();
+
+	m_channelMap = channelMap;
+	int numChannels = channelMap.size();
+	bool anyInteger = false;
+
+	for (int eng = 0; eng < engines.size(); eng++)
+	{
+		RecordEngine* engine = engines[eng];
+		int numLanes = jmax(1, engine->getNumWriteLanes());
+		int firstLane = m_lanes.size();
+		bool integerData = engine->acceptsIntegerData();
+		anyInteger = anyInteger || integerData;
+
+		for (int i = 0; i < numLanes; i++)
+		{
+			Lane* lane = new Lane();
+			lane->engine = engine;
+			lane->integerData = integerData;
+			m_lanes.add(lane);
+		}
+
+		for (int chan = 0; chan < numChannels; chan++)
+		{
+			int laneIndex = jlimit(0, numLanes - 1, engine->getWriteLane(chan));
+			m_lanes[firstLane + laneIndex]->channels.add(chan);
+			m_lanes[firstLane + laneIndex]->realChannels.add(channelMap[chan]);
+		}
+	}
+
+	//Lanes without channels would only add synchronization overhead
+	for (int i = m_lanes.size() - 1; i >= 0; i--)
+	{
+		if (m_lanes[i]->channels.size() == 0)
+			m_lanes.remove(i);
+		else
+		{
+			m_lanes[i]->pointers.malloc(m_lanes[i]->channels.size());
+			m_lanes[i]->intPointers.malloc(m_lanes[i]->channels.size());
+		}
+	}
+
+	m_scales.clearQuick();
+	m_numConversions = 0;
+	if (anyInteger && m_lanes.size() > 0)
+	{
+		for (int chan = 0; chan < numChannels; chan++)
+			m_scales.add(1 / (float(0x7fff) * bitVolts[chan]));
+		m_numConversions = (numChannels + CONVERSION_GROUP_CHANNELS - 1) / CONVERSION_GROUP_CHANNELS;
+	}
+
+	m_nextTask = m_numConversions + m_lanes.size();
+	m_conversionsRemaining = 0;
+	m_lanesRemaining = 0;
+
+	//The calling thread takes tasks too
+	int numWorkers = jmin(jmax(m_lanes.size(), m_numConversions), SystemStats::getNumCpus()) - 1;
+	for (int i = 0; i < numWorkers; i++)
+	{
+		Worker* w = new Worker(*this, i);
+		m_workers.add(w);
+		w->startThread();
+	}
+
+	std::cout << "Record writer pool: " << m_lanes.size() << " lanes, " << m_numConversions << " int16 conversion groups, "
+		<< m_workers.size() << " worker threads" << std::endl;
+}
+
+void RecordWriterPool::release()
+{
+	for (int i = 0; i < m_workers.size(); i++)
+		m_workers[i]->signalThreadShouldExit();
+
+	for (int i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i]->blockStarted.signal();
+		m_workers[i]->stopThread(1000);
+	}
+
+	m_workers.clear();
+	m_lanes.clear();
+	m_intData.free();
+	m_intCapacity = 0;
+}
+
+int RecordWriterPool::getNumLanes() const
+{
+	return m_lanes.size();
+}
+
+void RecordWriterPool::writeBlock(const AudioSampleBuffer& buffer, const Array<CircularBufferIndexes>& indexes,
+	const Array<int64>& timestamps)
+{
+	int numLanes = m_lanes.size();
+	if (numLanes == 0)
+		return;
+
+	m_buffer = &buffer;
+	m_indexes = &indexes;
+	m_timestamps = &timestamps;
+
+	if (m_numConversions > 0)
+	{
+		//Each channel gets a row of the int16 stage, holding both parts of a wrapped window
+		m_intStride = 0;
+		for (int chan = 0; chan < indexes.size(); chan++)
+			m_intStride = jmax(m_intStride, indexes[chan].size1 + indexes[chan].size2);
+
+		int needed = m_intStride * indexes.size();
+		if (needed > m_intCapacity)
+		{
+			m_intData.malloc(needed);
+			m_intCapacity = needed;
+		}
+	}
+
+	//The block pointers must be in place before any task can be claimed
+	m_conversionsRemaining = m_numConversions;
+	m_lanesRemaining = numLanes;
+	m_conversionsFinished.reset();
+	m_blockFinished.reset();
+	if (m_numConversions == 0)
+		m_conversionsFinished.signal();
+	m_nextTask = 0;
+
+	for (int i = 0; i < m_workers.size(); i++)
+		m_workers[i]->blockStarted.signal();
+
+	runTasks();
+
+	m_blockFinished.wait();
+}
+
+void RecordWriterPool::runTasks()
+{
+	int numTasks = m_numConversions + m_lanes.size();
+	int task;
+	while ((task = m_nextTask++) < numTasks)
+	{
+		if (task < m_numConversions)
+		{
+			convertChannels(task);
+			if (--m_conversionsRemaining == 0)
+				m_conversionsFinished.signal();
+			continue;
+		}
+
+		//Any conversion still pending is already running on another thread
+		Lane& lane = *m_lanes[task - m_numConversions];
+		if (lane.integerData)
+			m_conversionsFinished.wait();
+
+		writeLane(lane);
+
+		if (--m_lanesRemaining == 0)
+			m_blockFinished.signal();
+	}
+}
+
+void RecordWriterPool::convertChannels(int group)
+{
+	const AudioSampleBuffer& buffer = *m_buffer;
+	int first = group * CONVERSION_GROUP_CHANNELS;
+	int last = jmin(first + CONVERSION_GROUP_CHANNELS, m_indexes->size());
+
+	for (int chan = first; chan < last; chan++)
+	{
+		const CircularBufferIndexes& idx = m_indexes->getReference(chan);
+		int16* dest = m_intData + chan * m_intStride;
+		if (idx.size1 > 0)
+			RecordEngine::convertToInt16(dest, buffer.getReadPointer(chan, idx.index1), m_scales[chan], idx.size1);
+		if (idx.size2 > 0)
+			RecordEngine::convertToInt16(dest + idx.size1, buffer.getReadPointer(chan, idx.index2), m_scales[chan], idx.size2);
+	}
+}
+
+const int16* RecordWriterPool::getIntData(int chan) const
+{
+	return m_intData + chan * m_intStride;
+}
+
+void RecordWriterPool::writeLane(Lane& lane)
+{
+	const AudioSampleBuffer& buffer = *m_buffer;
+	RecordEngine* engine = lane.engine;
+
+	//Each lane keeps its own copy, as the wrap correction below is per engine
+	lane.timestamps = *m_timestamps;
+
+	if (engine->supportsBlockWrites() && writeLaneBlock(lane))
+		return;
+
+	for (int i = 0; i < lane.channels.size(); i++)
+	{
+		int chan = lane.channels[i];
+		const CircularBufferIndexes& idx = m_indexes->getReference(chan);
+
+		if (idx.size1 > 0)
+		{
+			if (lane.integerData)
+				engine->writeIntegerData(chan, m_channelMap[chan], getIntData(chan), idx.size1);
+			else
+				engine->writeData(chan, m_channelMap[chan], buffer.getReadPointer(chan, idx.index1), idx.size1);
+			if (idx.size2 > 0)
+			{
+				lane.timestamps.set(chan, lane.timestamps[chan] + idx.size1);
+				engine->updateTimestamps(lane.timestamps, chan);
+				if (lane.integerData)
+					engine->writeIntegerData(chan, m_channelMap[chan], getIntData(chan) + idx.size1, idx.size2);
+				else
+					engine->writeData(chan, m_channelMap[chan], buffer.getReadPointer(chan, idx.index2), idx.size2);
+			}
+		}
+	}
+}
+
+bool RecordWriterPool::writeLaneBlock(Lane& lane)
+{
+	const AudioSampleBuffer& buffer = *m_buffer;
+	RecordEngine* engine = lane.engine;
+	int numChans = lane.channels.size();
+
+	//Channels of the same source are queued in lockstep, so this only fails for mixed lanes
+	const CircularBufferIndexes& first = m_indexes->getReference(lane.channels[0]);
+	int64 firstTimestamp = lane.timestamps[lane.channels[0]];
+	for (int i = 1; i < numChans; i++)
+	{
+		const CircularBufferIndexes& idx = m_indexes->getReference(lane.channels[i]);
+		if (idx.index1 != first.index1 || idx.size1 != first.size1 || idx.index2 != first.index2
+			|| idx.size2 != first.size2 || lane.timestamps[lane.channels[i]] != firstTimestamp)
+			return false;
+	}
+
+	if (first.size1 > 0)
+	{
+		for (int i = 0; i < numChans; i++)
+		{
+			if (lane.integerData)
+				lane.intPointers[i] = getIntData(lane.channels[i]);
+			else
+				lane.pointers[i] = buffer.getReadPointer(lane.channels[i], first.index1);
+		}
+		if (lane.integerData)
+			engine->writeIntegerBlock(lane.channels, lane.realChannels, lane.intPointers, first.size1);
+		else
+			engine->writeBlock(lane.channels, lane.realChannels, lane.pointers, first.size1);
+
+		if (first.size2 > 0)
+		{
+			for (int i = 0; i < numChans; i++)
+			{
+				int chan = lane.channels[i];
+				lane.timestamps.set(chan, firstTimestamp + first.size1);
+				engine->updateTimestamps(lane.timestamps, chan);
+				if (lane.integerData)
+					lane.intPointers[i] = getIntData(chan) + first.size1;
+				else
+					lane.pointers[i] = buffer.getReadPointer(chan, first.index2);
+			}
+			if (lane.integerData)
+				engine->writeIntegerBlock(lane.channels, lane.realChannels, lane.intPointers, first.size2);
+			else
+				engine->writeBlock(lane.channels, lane.realChannels, lane.pointers, first.size2);
+		}
+	}
+	return true;
+}
+
+RecordWriterPool::Worker::Worker(RecordWriterPool& owner, int index) :
+Thread("Record Writer " + String(index)),
+m_pool(owner)
+{
+}
+
+void RecordWriterPool::Worker::run()
+{
+	while (!threadShouldExit())
+	{
+		if (blockStarted.wait() && !threadShouldExit())
+			m_pool.runTasks();
+	}
+}
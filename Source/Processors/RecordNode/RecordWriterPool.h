@@ -0,0 +1,125 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef RECORDWRITERPOOL_H_INCLUDED
+#define RECORDWRITERPOOL_H_INCLUDED
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+#include "DataQueue.h"
+#include <atomic>
+
+class RecordEngine;
+
+/**
+	Writes the continuous data of a DataQueue read window through several threads.
+
+	Every engine is split into write lanes (see RecordEngine::getNumWriteLanes), usually one
+	per independent output file. Each lane writes its channels in order on a single thread,
+	while different lanes run in parallel on a small set of workers plus the calling thread.
+	writeBlock() only returns once every lane has finished, so the caller can release the
+	window right after.
+
+	If any engine accepts integer data (see RecordEngine::acceptsIntegerData), every channel of
+	the window is first converted to int16 once, in groups of channels spread over the same
+	threads, and the lanes of those engines write the shared converted samples.
+
+	With a single lane, or a single core, everything is written on the calling thread.
+
+	@see RecordThread
+*/
+class RecordWriterPool
+{
+public:
+	RecordWriterPool();
+	~RecordWriterPool();
+
+	/** Builds the lanes from the engines' current files and starts the workers.
+	bitVolts holds the scale of each recorded channel, in channelMap order.
+	Must be called after the engines have opened their files. */
+	void prepare(const OwnedArray<RecordEngine>& engines, const Array<int>& channelMap, const Array<float>& bitVolts);
+
+	/** Stops the workers and forgets the lanes */
+	void release();
+
+	int getNumLanes() const;
+
+	/** Writes one read window of the DataQueue buffer. Timestamps must already have been
+	sent to the engines with updateTimestamps(). */
+	void writeBlock(const AudioSampleBuffer& buffer, const Array<CircularBufferIndexes>& indexes,
+		const Array<int64>& timestamps);
+
+private:
+	struct Lane
+	{
+		RecordEngine* engine;
+		Array<int> channels;
+		Array<int> realChannels;
+		Array<int64> timestamps;
+		HeapBlock<const float*> pointers;
+		HeapBlock<const int16*> intPointers;
+		bool integerData;
+	};
+
+	class Worker : public Thread
+	{
+	public:
+		Worker(RecordWriterPool& owner, int index);
+		void run() override;
+
+		WaitableEvent blockStarted;
+
+	private:
+		RecordWriterPool& m_pool;
+	};
+
+	void runTasks();
+	void convertChannels(int group);
+	void writeLane(Lane& lane);
+	bool writeLaneBlock(Lane& lane);
+	const int16* getIntData(int chan) const;
+
+	OwnedArray<Lane> m_lanes;
+	OwnedArray<Worker> m_workers;
+
+	//Tasks are numbered with the conversion groups first, so all of them are claimed before any lane
+	std::atomic<int> m_nextTask;
+	std::atomic<int> m_conversionsRemaining;
+	std::atomic<int> m_lanesRemaining;
+	WaitableEvent m_conversionsFinished;
+	WaitableEvent m_blockFinished;
+
+	int m_numConversions;
+	Array<float> m_scales;
+	HeapBlock<int16> m_intData;
+	int m_intStride;
+	int m_intCapacity;
+
+	const AudioSampleBuffer* m_buffer;
+	const Array<CircularBufferIndexes>* m_indexes;
+	const Array<int64>* m_timestamps;
+	Array<int> m_channelMap;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RecordWriterPool);
+};
+
+#endif  // RECORDWRITERPOOL_H_INCLUDED
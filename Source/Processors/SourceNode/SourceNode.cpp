@@ -329,6 +329,18 @@ void SourceNode::acquisitionStopped()
 }
 
 
+bool SourceNode::waitForSamples (int numSamples, int timeOutMs)
+{
+    if (inputBuffer == nullptr)
+    {
+        Thread::sleep (timeOutMs);
+        return false;
+    }
+
+    return inputBuffer->waitForSamples (numSamples, timeOutMs);
+}
+
+
 void SourceNode::process (AudioSampleBuffer& buffer, MidiBuffer& events)
 {
     // clear the input buffers
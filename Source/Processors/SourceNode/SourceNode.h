@@ -87,6 +87,10 @@ public:
 
     DataThread* getThread() const { return dataThread; }
 
+    /** Blocks until the DataBuffer holds at least numSamples or the timeout expires.
+        Used by the ProcessingThread to pace the signal chain from the source clock. */
+    bool waitForSamples (int numSamples, int timeOutMs);
+
     int getTTLState() const { return ttlState; }
 
     bool tryEnablingEditor();
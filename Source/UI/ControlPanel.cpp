@@ -135,6 +135,62 @@ void CPUMeter::paint(Graphics& g)
 }
 
 
+RecordQueueMeter::RecordQueueMeter() : fill(0.0f), dropped(false)
+{
+
+    font = Font("Small Text", 12, Font::plain);
+
+    setTooltip("Record buffers");
+}
+
+RecordQueueMeter::~RecordQueueMeter()
+{
+}
+
+namespace
+{
+    String queueLine(const String& name, float current, float peak, int64 dropped, const String& units)
+    {
+        return name + ": " + String(roundToInt(current * 100)) + "% (peak " + String(roundToInt(peak * 100)) + "%), "
+               + String(dropped) + " " + units + " dropped\n";
+    }
+}
+
+void RecordQueueMeter::updateStats(const RecordQueueStats& stats)
+{
+    fill = jmax(jmax(stats.dataFill, stats.eventFill), jmax(stats.spikeFill, stats.sourceFill));
+    dropped = stats.droppedSamples > 0 || stats.droppedEvents > 0
+              || stats.droppedSpikes > 0 || stats.droppedSourceSamples > 0;
+
+    String tip;
+    tip << queueLine("Source buffers", stats.sourceFill, stats.sourceHighWater, stats.droppedSourceSamples, "samples");
+    tip << queueLine("Data queue", stats.dataFill, stats.dataHighWater, stats.droppedSamples, "samples");
+    tip << queueLine("Event queue", stats.eventFill, stats.eventHighWater, stats.droppedEvents, "events");
+    tip << queueLine("Spike queue", stats.spikeFill, stats.spikeHighWater, stats.droppedSpikes, "spikes");
+    if (stats.spillEnabled)
+        tip << "Spill file: " << String(roundToInt(stats.spillFill * 100)) << "% (peak "
+            << String(roundToInt(stats.spillHighWater * 100)) << "%), " << String(stats.spilledSamples) << " samples spilled\n";
+    tip << "Writing " << String(roundToInt(stats.drainRate)) << " samples/s, busy "
+        << String(roundToInt(stats.dutyCycle * 100)) << "% of the time";
+    setTooltip(tip);
+}
+
+void RecordQueueMeter::paint(Graphics& g)
+{
+    g.fillAll(Colours::grey);
+
+    g.setColour(dropped ? Colours::red : Colours::yellow);
+    g.fillRect(0.0f,0.0f,getWidth()*fill,float(getHeight()));
+
+    g.setColour(Colours::black);
+    g.drawRect(0,0,getWidth(),getHeight(),1);
+
+    g.setFont(font);
+    g.drawSingleLineText("BUF",65,12);
+
+}
+
+
 DiskSpaceMeter::DiskSpaceMeter()
 
 {
@@ -402,6 +458,9 @@ ControlPanel::ControlPanel(ProcessorGraph* graph_, AudioComponent* audio_)
     cpuMeter = new CPUMeter();
     addAndMakeVisible(cpuMeter);
 
+    queueMeter = new RecordQueueMeter();
+    addAndMakeVisible(queueMeter);
+
     diskMeter = new DiskSpaceMeter();
     addAndMakeVisible(diskMeter);
 
@@ -419,6 +478,12 @@ ControlPanel::ControlPanel(ProcessorGraph* graph_, AudioComponent* audio_)
     recordOptionsButton->setTooltip("Configure options for selected record engine");
     addChildComponent(recordOptionsButton);
 
+    recordNodeOptionsButton = new UtilityButton("T",Font("Small Text", 15, Font::plain));
+    recordNodeOptionsButton->setEnabledState(true);
+    recordNodeOptionsButton->addListener(this);
+    recordNodeOptionsButton->setTooltip("Configure pre-trigger history and gated recording");
+    addChildComponent(recordNodeOptionsButton);
+
     newDirectoryButton = new UtilityButton("+", Font("Small Text", 15, Font::plain));
     newDirectoryButton->setEnabledState(false);
     newDirectoryButton->addListener(this);
@@ -640,7 +705,7 @@ void ControlPanel::resized()
                                 : (w < threeRowsWidth - 23)
                                     ? 3 : 1;
 
-    // Set positions for CPU and Disk meter components
+    // Set positions for CPU, record buffer and Disk meter components
     // ====================================================================
     int meterComponentsY            = h / 4;
     int meterComponentsWidth        = h * 3;
@@ -663,8 +728,9 @@ void ControlPanel::resized()
     }
 
     juce::Rectangle<int> meterBounds (meterComponentsMargin, meterComponentsY, meterComponentsWidth, meterComponentsHeight);
-    cpuMeter->setBounds  (meterBounds);
-    diskMeter->setBounds (meterBounds.translated (meterComponentsWidth + meterComponentsMargin, 0));
+    cpuMeter->setBounds   (meterBounds);
+    queueMeter->setBounds (meterBounds.translated (meterComponentsWidth + meterComponentsMargin, 0));
+    diskMeter->setBounds  (meterBounds.translated ((meterComponentsWidth + meterComponentsMargin) * 2, 0));
     // ====================================================================
 
     // Set positions for controls and clock
@@ -731,12 +797,15 @@ void ControlPanel::resized()
     {
         int topBound = getHeight() - h + 10 - 5;
 
-        recordSelector->setBounds ( (w - 435) > 40 ? 35 : w - 450, topBound, 100, h - 10);
+        recordSelector->setBounds ( (w - 435) > 40 ? 35 : w - 450, topBound, 75, h - 10);
         recordSelector->setVisible (true);
 
-        recordOptionsButton->setBounds ( (w - 435) > 40 ? 140 : w - 350, topBound, h - 10, h - 10);
+        recordOptionsButton->setBounds ( (w - 435) > 40 ? 115 : w - 370, topBound, h - 10, h - 10);
         recordOptionsButton->setVisible (true);
 
+        recordNodeOptionsButton->setBounds ( (w - 435) > 40 ? 140 : w - 345, topBound, h - 10, h - 10);
+        recordNodeOptionsButton->setVisible (true);
+
         filenameComponent->setBounds (165, topBound, w - 500, h - 10);
         filenameComponent->setVisible (true);
 
@@ -762,6 +831,7 @@ void ControlPanel::resized()
         appendText->setVisible          (false);
         recordSelector->setVisible      (false);
         recordOptionsButton->setVisible (false);
+        recordNodeOptionsButton->setVisible (false);
     }
 
     repaint();
@@ -834,6 +904,10 @@ void ControlPanel::buttonClicked(Button* button)
         if (playButton->getToggleState())
         {
 
+            //The RecordNode options have to be in place before it is enabled
+            if (recordNodeWindow != nullptr && recordNodeWindow->isVisible())
+                recordNodeWindow->closeButtonPressed();
+
             if (graph->enableProcessors()) // start the processor graph
             {
                 if (recordEngines[recordSelector->getSelectedId()-1]->isWindowOpen())
@@ -849,6 +923,7 @@ void ControlPanel::buttonClicked(Button* button)
             }
             recordSelector->setEnabled(false);
             recordOptionsButton->setEnabled(false);
+            recordNodeOptionsButton->setEnabled(false);
         }
         else
         {
@@ -867,6 +942,7 @@ void ControlPanel::buttonClicked(Button* button)
             audioEditor->enable();
             recordSelector->setEnabled(true);
             recordOptionsButton->setEnabled(true);
+            recordNodeOptionsButton->setEnabled(true);
 
         }
 
@@ -883,23 +959,29 @@ void ControlPanel::buttonClicked(Button* button)
             }
             else
             {
+                if (recordNodeWindow != nullptr && recordNodeWindow->isVisible())
+                    recordNodeWindow->closeButtonPressed();
+
                 if (graph->enableProcessors()) // start the processor graph
                 {
                     if (recordEngines[recordSelector->getSelectedId()-1]->isWindowOpen())
                         recordEngines[recordSelector->getSelectedId()-1]->toggleConfigWindow();
 
+                    // the record node has to be recording before the first block is processed,
+                    // or sources that don't wait for real time (e.g. a free-running File Reader)
+                    // lose the start of their data
+                    startRecording();
+
                     audio->beginCallbacks();
-                    masterClock->start();
                     audioEditor->disable();
 
                     stopTimer();
                     startTimer(250); // refresh every 250 ms
 
-                    startRecording();
-
                     playButton->setToggleState(true, dontSendNotification);
                     recordSelector->setEnabled(false);
                     recordOptionsButton->setEnabled(false);
+                    recordNodeOptionsButton->setEnabled(false);
 
                 }
             }
@@ -918,6 +1000,14 @@ void ControlPanel::buttonClicked(Button* button)
         recordEngines[id]->toggleConfigWindow();
     }
 
+    if (button == recordNodeOptionsButton)
+    {
+        if (recordNodeWindow != nullptr && recordNodeWindow->isVisible())
+            recordNodeWindow->closeButtonPressed();
+        else
+            recordNodeWindow = new RecordNodeConfigWindow(graph->getRecordNode());
+    }
+
 }
 
 void ControlPanel::comboBoxChanged(ComboBox* combo)
@@ -1003,7 +1093,7 @@ void ControlPanel::refreshMeters()
 {
     if (playButton->getToggleState())
     {
-        cpuMeter->updateCPU(audio->deviceManager.getCpuUsage());
+        cpuMeter->updateCPU(audio->getCpuUsage());
     }
     else
     {
@@ -1012,6 +1102,9 @@ void ControlPanel::refreshMeters()
 
     cpuMeter->repaint();
 
+    queueMeter->updateStats(graph->getRecordNode()->getQueueStats());
+    queueMeter->repaint();
+
     masterClock->repaint();
 
     diskMeter->updateDiskSpace(graph->getRecordNode()->getFreeSpace());
@@ -1095,6 +1188,25 @@ void ControlPanel::saveStateToXml(XmlElement* xml)
     controlPanelState->setAttribute("appendText",appendText->getText());
     controlPanelState->setAttribute("recordEngine",recordEngines[recordSelector->getSelectedId()-1]->getID());
 
+    RecordNode* recordNode = graph->getRecordNode();
+    if (recordNode->getSpillFile() != File::nonexistent)
+    {
+        controlPanelState->setAttribute("spillFile", recordNode->getSpillFile().getFullPathName());
+        controlPanelState->setAttribute("spillSizeMB", int(recordNode->getSpillFileSize() >> 20));
+    }
+    if (recordNode->getPreTriggerHistory() > 0)
+        controlPanelState->setAttribute("preTriggerSeconds", recordNode->getPreTriggerHistory());
+    const Array<int>& gateChannels = recordNode->getRecordGateChannels();
+    if (gateChannels.size() > 0)
+    {
+        StringArray channelList;
+        for (int i = 0; i < gateChannels.size(); i++)
+            channelList.add(String(gateChannels[i]));
+        controlPanelState->setAttribute("gateChannels", channelList.joinIntoString(" "));
+        controlPanelState->setAttribute("gatePreSeconds", recordNode->getRecordGatePreSeconds());
+        controlPanelState->setAttribute("gatePostSeconds", recordNode->getRecordGatePostSeconds());
+    }
+
     audioEditor->saveStateToXml(xml);
 
     XmlElement* recordEnginesState = xml->createNewChildElement("RECORDENGINES");
@@ -1134,6 +1246,24 @@ void ControlPanel::loadStateFromXml(XmlElement* xml)
             bool isOpen = xmlNode->getBoolAttribute("isOpen");
             openState(isOpen);
 
+            // optional disk-stall spill file for the record node
+            String spillPath = xmlNode->getStringAttribute("spillFile", String::empty);
+            int spillSizeMB = xmlNode->getIntAttribute("spillSizeMB", 0);
+            if (spillPath.isNotEmpty() && spillSizeMB > 0)
+                graph->getRecordNode()->setSpillFile(File(spillPath), int64(spillSizeMB) << 20);
+
+            // optional pre-trigger history and gated recording
+            graph->getRecordNode()->setPreTriggerHistory(float(xmlNode->getDoubleAttribute("preTriggerSeconds", 0)));
+            StringArray gateList;
+            gateList.addTokens(xmlNode->getStringAttribute("gateChannels", String::empty), " ", String::empty);
+            gateList.removeEmptyStrings();
+            Array<int> gateChannels;
+            for (int i = 0; i < gateList.size(); i++)
+                gateChannels.add(gateList[i].getIntValue());
+            graph->getRecordNode()->setRecordGate(gateChannels,
+                float(xmlNode->getDoubleAttribute("gatePreSeconds", 0)),
+                float(xmlNode->getDoubleAttribute("gatePostSeconds", 0)));
+
         }
         else if (xmlNode->hasTagName("RECORDENGINES"))
         {
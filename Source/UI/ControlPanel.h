@@ -30,6 +30,7 @@
 #include "../Processors/ProcessorGraph/ProcessorGraph.h"
 #include "../Processors/RecordNode/RecordNode.h"
 #include "../Processors/RecordNode/RecordEngine.h"
+#include "../Processors/RecordNode/RecordNodeConfigWindow.h"
 #include "LookAndFeel/CustomLookAndFeel.h"
 #include "../AccessClass.h"
 #include "../Processors/Editors/GenericEditor.h" // for UtilityButton
@@ -118,6 +119,41 @@ private:
 
 };
 
+/**
+
+  Displays how full the record pipeline buffers are.
+
+  The RecordQueueMeter sits next to the CPUMeter in the ControlPanel. The bar shows the
+  fullest of the source buffers and the RecordNode data, event and spike queues, turning
+  red once any of them has dropped data. The tooltip lists every queue, with its peak fill
+  and loss counters, and the rate at which the record thread is draining the data queue.
+
+  @see ControlPanel, RecordNode
+
+*/
+
+class RecordQueueMeter : public Component, public SettableTooltipClient
+{
+public:
+    RecordQueueMeter();
+    ~RecordQueueMeter();
+
+    /** Updates the values displayed by the RecordQueueMeter. Called by
+        the ControlPanel. */
+    void updateStats(const RecordQueueStats& stats);
+
+    /** Draws the RecordQueueMeter. */
+    void paint(Graphics& g);
+
+private:
+
+    Font font;
+
+    float fill;
+    bool dropped;
+
+};
+
 /**
 
   Displays the amount of disk space left in the current data directory.
@@ -375,6 +411,7 @@ private:
 
     ScopedPointer<Clock> masterClock;
     ScopedPointer<CPUMeter> cpuMeter;
+    ScopedPointer<RecordQueueMeter> queueMeter;
     ScopedPointer<DiskSpaceMeter> diskMeter;
     ScopedPointer<FilenameComponent> filenameComponent;
     ScopedPointer<UtilityButton> newDirectoryButton;
@@ -402,7 +439,7 @@ private:
 
     void timerCallback();
 
-    /** Updates the values displayed by the CPUMeter and DiskSpaceMeter.*/
+    /** Updates the values displayed by the CPUMeter, RecordQueueMeter and DiskSpaceMeter.*/
     void refreshMeters();
 
     bool keyPressed(const KeyPress& key);
@@ -421,6 +458,8 @@ private:
 
     OwnedArray<RecordEngineManager> recordEngines;
     ScopedPointer<UtilityButton> recordOptionsButton;
+    ScopedPointer<UtilityButton> recordNodeOptionsButton;
+    ScopedPointer<RecordNodeConfigWindow> recordNodeWindow;
     int lastEngineIndex;
 
 };
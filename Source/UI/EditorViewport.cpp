@@ -1385,6 +1385,8 @@ const String EditorViewport::saveState(File fileToUse, String* xmlText)
     XmlElement* audioSettings = new XmlElement("AUDIO");
 
     audioSettings->setAttribute("bufferSize", AccessClass::getAudioComponent()->getBufferSize());
+    audioSettings->setAttribute("useAudioDevice", AccessClass::getAudioComponent()->isUsingAudioDevice());
+    audioSettings->setAttribute("monitorAudio", AccessClass::getAudioComponent()->isAudioMonitoringEnabled());
     xml->addChildElement(audioSettings);
 
 
@@ -1621,6 +1623,9 @@ const String EditorViewport::loadState(File fileToLoad)
         }
         else if (element->hasTagName("AUDIO"))
         {
+            AccessClass::getAudioComponent()->setUseAudioDevice(element->getBoolAttribute("useAudioDevice", true));
+            AccessClass::getAudioComponent()->setAudioMonitoring(element->getBoolAttribute("monitorAudio", true));
+
             int bufferSize = element->getIntAttribute("bufferSize");
             AccessClass::getAudioComponent()->setBufferSize(bufferSize);
         }
@@ -0,0 +1,207 @@
+/*
+------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "ProcessorTimingWindow.h"
+#include "../Processors/ProcessorGraph/ProcessorGraph.h"
+#include "../Processors/GenericProcessor/GenericProcessor.h"
+#include "../CoreServices.h"
+
+namespace
+{
+    const int rowHeight = 20;
+    const int headerHeight = 24;
+    const int buttonBarHeight = 34;
+
+    const char* const columnNames[] = { "Processor", "Blocks", "Mean (us)", "p50 (us)", "p99 (us)", "Max (us)", "Overruns" };
+    const int numColumns = sizeof(columnNames) / sizeof(columnNames[0]);
+
+    StringArray getRow(const String& name, ProcessingTimeStats& stats)
+    {
+        StringArray row;
+        row.add(name);
+        row.add(String(stats.getNumBlocks()));
+        row.add(String(stats.getMeanUs(), 1));
+        row.add(String(stats.getPercentileUs(0.5), 1));
+        row.add(String(stats.getPercentileUs(0.99), 1));
+        row.add(String(stats.getMaxUs(), 1));
+        row.add(String(stats.getNumOverruns()));
+        return row;
+    }
+
+    /** The whole chain first, then each processor. */
+    void getRows(ProcessorGraph* graph, Array<StringArray>& rows, Array<bool>& overrun)
+    {
+        rows.add(getRow("Signal chain", graph->getProcessingTimeStats()));
+        overrun.add(graph->getProcessingTimeStats().getNumOverruns() > 0);
+
+        Array<GenericProcessor*> processors = graph->getListOfProcessors();
+
+        for (int i = 0; i < processors.size(); i++)
+        {
+            GenericProcessor* p = processors[i];
+            rows.add(getRow(p->getName() + " (" + String(p->getNodeId()) + ")", p->getProcessingTimeStats()));
+            overrun.add(p->getProcessingTimeStats().getNumOverruns() > 0);
+        }
+    }
+}
+
+
+ProcessorTimingComponent::ProcessorTimingComponent(ProcessorGraph* graph)
+    : processorGraph(graph)
+{
+    resetButton = new TextButton("Reset");
+    resetButton->addListener(this);
+    addAndMakeVisible(resetButton);
+
+    saveButton = new TextButton("Save to file...");
+    saveButton->addListener(this);
+    addAndMakeVisible(saveButton);
+
+    startTimer(500);
+}
+
+ProcessorTimingComponent::~ProcessorTimingComponent()
+{
+}
+
+void ProcessorTimingComponent::paint(Graphics& g)
+{
+    g.fillAll(Colours::darkgrey);
+
+    const float columnWidth = (getWidth() - 10) / (numColumns + 2.0f);
+    const float firstColumnWidth = columnWidth * 3.0f;
+
+    g.setFont(Font("Default", 14, Font::bold));
+    g.setColour(Colours::white);
+
+    float x = 5;
+    for (int c = 0; c < numColumns; c++)
+    {
+        const float w = (c == 0) ? firstColumnWidth : columnWidth;
+        g.drawText(columnNames[c], (int) x, 0, (int) w, headerHeight, c == 0 ? Justification::left : Justification::right, true);
+        x += w;
+    }
+
+    g.setFont(Font("Default", 13, Font::plain));
+
+    Array<StringArray> rows;
+    Array<bool> overrun;
+    getRows(processorGraph, rows, overrun);
+
+    for (int i = 0; i < rows.size(); i++)
+    {
+        const int y = headerHeight + i * rowHeight;
+
+        if (y + rowHeight > getHeight() - buttonBarHeight)
+            break;
+
+        g.setColour(overrun[i] ? Colours::orange : Colours::lightgrey);
+
+        x = 5;
+        for (int c = 0; c < numColumns; c++)
+        {
+            const float w = (c == 0) ? firstColumnWidth : columnWidth;
+            g.drawText(rows.getReference(i)[c], (int) x, y, (int) w, rowHeight, c == 0 ? Justification::left : Justification::right, true);
+            x += w;
+        }
+    }
+}
+
+void ProcessorTimingComponent::resized()
+{
+    resetButton->setBounds(getWidth() - 230, getHeight() - buttonBarHeight + 5, 100, 24);
+    saveButton->setBounds(getWidth() - 120, getHeight() - buttonBarHeight + 5, 110, 24);
+}
+
+void ProcessorTimingComponent::timerCallback()
+{
+    if (isShowing())
+        repaint();
+}
+
+void ProcessorTimingComponent::buttonClicked(Button* button)
+{
+    if (button == resetButton)
+    {
+        processorGraph->getProcessingTimeStats().reset();
+
+        Array<GenericProcessor*> processors = processorGraph->getListOfProcessors();
+
+        for (int i = 0; i < processors.size(); i++)
+            processors[i]->getProcessingTimeStats().reset();
+
+        repaint();
+    }
+    else if (button == saveButton)
+    {
+        File defaultFile = CoreServices::getDefaultUserSaveDirectory().getChildFile("processor_timing.txt");
+
+        FileChooser fc("Save processor timing...", defaultFile, "*.txt", true);
+
+        if (fc.browseForFileToSave(true))
+        {
+            if (writeReport(processorGraph, fc.getResult()))
+                CoreServices::sendStatusMessage("Saved processor timing to " + fc.getResult().getFileName());
+            else
+                CoreServices::sendStatusMessage("Could not write processor timing file.");
+        }
+    }
+}
+
+bool ProcessorTimingComponent::writeReport(ProcessorGraph* graph, const File& file)
+{
+    String report;
+
+    for (int c = 0; c < numColumns; c++)
+        report << columnNames[c] << (c < numColumns - 1 ? "\t" : "\n");
+
+    Array<StringArray> rows;
+    Array<bool> overrun;
+    getRows(graph, rows, overrun);
+
+    for (int i = 0; i < rows.size(); i++)
+        report << rows.getReference(i).joinIntoString("\t") << "\n";
+
+    return file.replaceWithText(report);
+}
+
+
+ProcessorTimingWindow::ProcessorTimingWindow(ProcessorGraph* graph)
+    : DocumentWindow("Processor timing",
+                     Colours::darkgrey,
+                     DocumentWindow::closeButton)
+{
+    setUsingNativeTitleBar(true);
+    setResizable(true, false);
+    setContentOwned(new ProcessorTimingComponent(graph), false);
+    centreWithSize(640, 360);
+}
+
+ProcessorTimingWindow::~ProcessorTimingWindow()
+{
+}
+
+void ProcessorTimingWindow::closeButtonPressed()
+{
+    setVisible(false);
+}
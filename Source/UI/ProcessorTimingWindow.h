@@ -0,0 +1,83 @@
+/*
+------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __PROCESSORTIMINGWINDOW_H_3B7E0C15__
+#define __PROCESSORTIMINGWINDOW_H_3B7E0C15__
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+
+class ProcessorGraph;
+
+/**
+
+  Lists how long each processor in the signal chain takes to process a block
+  (median, 99th percentile and maximum), along with the number of blocks that
+  took longer than their real-time duration.
+
+  Refreshes itself twice a second while visible. The same table can be
+  written to a text file.
+
+  @see ProcessingTimeStats, UIComponent
+
+*/
+
+class ProcessorTimingComponent : public Component,
+    public Timer,
+    public Button::Listener
+{
+public:
+    ProcessorTimingComponent(ProcessorGraph* graph);
+    ~ProcessorTimingComponent();
+
+    void paint(Graphics& g);
+    void resized();
+    void timerCallback();
+    void buttonClicked(Button* button);
+
+    /** Writes the current statistics of every processor to a tab-separated text file. */
+    static bool writeReport(ProcessorGraph* graph, const File& file);
+
+private:
+    ProcessorGraph* processorGraph;
+
+    ScopedPointer<TextButton> resetButton;
+    ScopedPointer<TextButton> saveButton;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProcessorTimingComponent);
+};
+
+
+class ProcessorTimingWindow : public DocumentWindow
+{
+public:
+    ProcessorTimingWindow(ProcessorGraph* graph);
+    ~ProcessorTimingWindow();
+
+    void closeButtonPressed();
+
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProcessorTimingWindow);
+};
+
+
+#endif  // __PROCESSORTIMINGWINDOW_H_3B7E0C15__
@@ -381,6 +381,7 @@ PopupMenu UIComponent::getMenuForIndex(int menuIndex, const String& menuName)
 		menu.addCommandItem(commandManager, toggleProcessorList);
 		menu.addCommandItem(commandManager, toggleSignalChain);
 		menu.addCommandItem(commandManager, toggleFileInfo);
+		menu.addCommandItem(commandManager, showProcessorTiming);
 		menu.addSeparator();
 		menu.addCommandItem(commandManager, resizeWindow);
 
@@ -423,6 +424,7 @@ void UIComponent::getAllCommands(Array <CommandID>& commands)
 		toggleProcessorList,
 		toggleSignalChain,
 		toggleFileInfo,
+		showProcessorTiming,
 		showHelp,
 		resizeWindow
 	};
@@ -508,6 +510,11 @@ void UIComponent::getCommandInfo(CommandID commandID, ApplicationCommandInfo& re
 			result.setTicked(controlPanel->isOpen());
 			break;
 
+		case showProcessorTiming:
+			result.setInfo("Processor Timing", "Show per-processor processing times.", "General", 0);
+			result.setTicked(processorTimingWindow != nullptr && processorTimingWindow->isVisible());
+			break;
+
 		case showHelp:
 			result.setInfo("Show help...", "Take me to the GUI wiki.", "General", 0);
 			result.setActive(true);
@@ -630,6 +637,13 @@ bool UIComponent::perform(const InvocationInfo& info)
 			editorViewportButton->toggleState();
 			break;
 
+		case showProcessorTiming:
+			if (processorTimingWindow == nullptr)
+				processorTimingWindow = new ProcessorTimingWindow(processorGraph);
+			processorTimingWindow->setVisible(true);
+			processorTimingWindow->toFront(true);
+			break;
+
 		case resizeWindow:
 			mainWindow->centreWithSize(800, 600);
 			break;
@@ -32,6 +32,7 @@
 #include "DataViewport.h"
 #include "../Processors/MessageCenter/MessageCenterEditor.h"
 #include "GraphViewer.h"
+#include "ProcessorTimingWindow.h"
 #include "../Processors/ProcessorGraph/ProcessorGraph.h"
 #include "../Audio/AudioComponent.h"
 #include "../MainWindow.h"
@@ -151,6 +152,7 @@ private:
     ScopedPointer<InfoLabel> infoLabel;
     ScopedPointer<GraphViewer> graphViewer;
 	ScopedPointer<PluginManager> pluginManager;
+    ScopedPointer<ProcessorTimingWindow> processorTimingWindow;
 
     Viewport processorListViewport;
 
@@ -187,7 +189,8 @@ private:
         showHelp				= 0x2011,
         resizeWindow            = 0x2012,
         reloadOnStartup         = 0x2013,
-        saveConfigurationAs     = 0x2014
+        saveConfigurationAs     = 0x2014,
+        showProcessorTiming     = 0x2015
     };
 
     File currentConfigFile;